@@ -83,6 +83,12 @@ extern "C" {
 #define     Board_MPU9250_ADDR      (0x68)
 #define     Board_MPU9250_MAG_ADDR  (0x0C)
 
+/* OPT3001 INT in end-of-conversion mode. Leave unassigned when the pin is
+ * not routed; the driver then times conversions with a Clock instead. */
+#ifndef Board_OPT3001_INT
+#define     Board_OPT3001_INT       PIN_UNASSIGNED
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -58,6 +58,7 @@
 #include <driverlib/udma.h>
 
 #include <Board.h>
+#include "powertrack.h"
 
 /*
  *  ========================= IO driver initialization =========================
@@ -118,7 +119,7 @@ const PINCC26XX_HWAttrs PINCC26XX_hwAttrs = {
 #endif
 const PowerCC26XX_Config PowerCC26XX_config = {
     .policyInitFxn      = NULL,
-    .policyFxn          = &PowerCC26XX_standbyPolicy,
+    .policyFxn          = &powertrack_policy,  /* wraps PowerCC26XX_standbyPolicy */
     .calibrateFxn       = &PowerCC26XX_calibrate,
     .enablePolicy       = TRUE,
     .calibrateRCOSC_LF  = TRUE,
@@ -134,40 +135,35 @@ const PowerCC26XX_Config PowerCC26XX_config = {
 /* Place into subsections to allow the TI linker to remove items properly */
 #if defined(__TI_COMPILER_VERSION__)
 #pragma DATA_SECTION(UART_config, ".const:UART_config")
-#pragma DATA_SECTION(uartCC26XXHWAttrs, ".const:uartCC26XXHWAttrs")
+#pragma DATA_SECTION(uartDmaHWAttrs, ".const:uartDmaHWAttrs")
 #endif
 
 /* Include drivers */
 #include <ti/drivers/UART.h>
-#include <ti/drivers/uart/UARTCC26XX.h>
+#include "uartdma.h"
 
-/* UART objects */
-UARTCC26XX_Object uartCC26XXObjects[CC2650STK_UARTCOUNT];
-unsigned char uartCC26XXRingBuffer[CC2650STK_UARTCOUNT][32];
+/* UART objects, uDMA transmit path (uartdma.h) instead of UARTCC26XX */
+UartDmaObject uartDmaObjects[CC2650STK_UARTCOUNT];
 
 /* UART hardware parameter structure, also used to assign UART pins */
-const UARTCC26XX_HWAttrsV2 uartCC26XXHWAttrs[CC2650STK_UARTCOUNT] = {
+const UartDmaHWAttrs uartDmaHWAttrs[CC2650STK_UARTCOUNT] = {
     {
-        .baseAddr       = UART0_BASE,
-        .powerMngrId    = PowerCC26XX_PERIPH_UART0,
-        .intNum         = INT_UART0_COMB,
-        .intPriority    = ~0,
-        .swiPriority    = 0,
-        .txPin          = Board_UART_TX,
-        .rxPin          = Board_UART_RX,
-        .ctsPin         = PIN_UNASSIGNED,
-        .rtsPin         = PIN_UNASSIGNED,
-        .ringBufPtr     = uartCC26XXRingBuffer[0],
-        .ringBufSize    = sizeof(uartCC26XXRingBuffer[0])
+        .baseAddr         = UART0_BASE,
+        .powerMngrId      = PowerCC26XX_PERIPH_UART0,
+        .intNum           = INT_UART0_COMB,
+        .intPriority      = ~0,
+        .txChannelBitMask = 1<<UDMA_CHAN_UART0_TX,
+        .txPin            = Board_UART_TX,
+        .rxPin            = Board_UART_RX
     }
 };
 
 /* UART configuration structure */
 const UART_Config UART_config[] = {
     {
-        .fxnTablePtr = &UARTCC26XX_fxnTable,
-        .object      = &uartCC26XXObjects[0],
-        .hwAttrs     = &uartCC26XXHWAttrs[0]
+        .fxnTablePtr = &uartdma_fxnTable,
+        .object      = &uartDmaObjects[0],
+        .hwAttrs     = &uartDmaHWAttrs[0]
     },
     {NULL, NULL, NULL}
 };
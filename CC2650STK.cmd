@@ -48,24 +48,38 @@
 /* must be located at the beginning of the application.                      */
 #define FLASH_BASE              0x0
 #define FLASH_SIZE              0x20000
+/* Two sectors below the CCFG sector for the configuration store (config.h) */
+#define CONFIG_BASE             0x1D000
+#define CONFIG_SIZE             0x2000
 #define RAM_BASE                0x20000000
 #define RAM_SIZE                0x5000
+/* Flash cache used as RAM, enabled with CACHE_AS_RAM (see ccfg.c)           */
+#define GPRAM_BASE              0x11000000
+#define GPRAM_SIZE              0x2000
 
 /* System memory map */
 
 MEMORY
 {
     /* Application stored in and executes from internal flash */
-    FLASH (RX) : origin = FLASH_BASE, length = FLASH_SIZE
+    FLASH (RX) : origin = FLASH_BASE, length = CONFIG_BASE - FLASH_BASE
+    /* Configuration store, written at run time, nothing is linked here */
+    CONFIG (R) : origin = CONFIG_BASE, length = CONFIG_SIZE
+    /* Last sector, CCFG at its top and code below it */
+    FLASH_LAST (RX) : origin = CONFIG_BASE + CONFIG_SIZE, length = FLASH_SIZE - CONFIG_BASE - CONFIG_SIZE
     /* Application uses internal RAM for data */
     SRAM (RWX) : origin = RAM_BASE, length = RAM_SIZE
+#ifdef CACHE_AS_RAM
+    /* Application can use GPRAM region as RAM if cache is disabled in CCFG */
+    GPRAM (RWX) : origin = GPRAM_BASE, length = GPRAM_SIZE
+#endif
 }
 
 /* Section allocation in memory */
 
 SECTIONS
 {
-    .text           :   > FLASH
+    .text           :   >> FLASH | FLASH_LAST
     .const          :   > FLASH
     .constdata      :   > FLASH
     .rodata         :   > FLASH
@@ -73,16 +87,29 @@ SECTIONS
     .pinit          :   > FLASH
     .init_array     :   > FLASH
     .emb_text       :   > FLASH
-    .ccfg           :   > FLASH (HIGH)
+    .trace_fmt      :   > FLASH
+    .ccfg           :   > FLASH_LAST (HIGH)
 
 #ifdef __TI_COMPILER_VERSION__
 #if __TI_COMPILER_VERSION__ >= 15009000
-    .TI.ramfunc     : {} load=FLASH, run=SRAM, table(BINIT)
+    .TI.ramfunc     : {} load=FLASH, run=SRAM, table(BINIT), RUN_SIZE(ramFuncSize)
 #endif
 #endif
-    .data           :   > SRAM
-    .bss            :   > SRAM
+    .data           :   > SRAM, SIZE(ramDataSize)
+    .bss            :   > SRAM, SIZE(ramBssSize)
     .sysmem         :   > SRAM
-    .stack          :   > SRAM (HIGH)
+    .stack          :   > SRAM (HIGH), START(ramSysStack), SIZE(ramSysStackSize)
     .nonretenvar    :   > SRAM
+#ifdef CACHE_AS_RAM
+    .gpram          :   > GPRAM, type = NOINIT
+#endif
 }
+
+/* Configuration store location for intflash.c */
+configFlashBase = CONFIG_BASE;
+configFlashSize = CONFIG_SIZE;
+
+/* No .TI.ramfunc support: report an empty RAMFUNC budget to stackmon       */
+#if !defined(__TI_COMPILER_VERSION__) || __TI_COMPILER_VERSION__ < 15009000
+ramFuncSize = 0;
+#endif
@@ -0,0 +1,414 @@
+/*
+ * bench.c
+ *
+ *  On-target micro benchmarks of the hot loops, see bench.h.
+ *
+ *  Output, one line per benchmark:
+ *      bench <name> <cycles per iteration> <cache|gpram> <ramfunc|flash>
+ *  and for the sample compressor
+ *      comp <varint|rice> in=<bytes> out=<bytes> ratio=<percent>
+ */
+
+#include <stdio.h>
+
+#include <xdc/std.h>
+#include <ti/sysbios/hal/Hwi.h>
+
+#include "bench.h"
+#include "cycles.h"
+#include "ringbuffer.h"
+#include "trace.h"
+#include "memsection.h"
+#include "sensors/mpu9250.h"
+#include "sensors/bmp280.h"
+#include "flashram.h"
+#include "logstore.h"
+#include "imucomp.h"
+#include "tonedet.h"
+#include "mic.h"
+#include "gesture.h"
+#include "imufeat.h"
+#include "report.h"
+
+#define BENCH_ITERATIONS    256
+
+#ifdef CACHE_AS_RAM
+#define BENCH_CACHE "gpram"
+#else
+#define BENCH_CACHE "cache"
+#endif
+
+#ifdef NO_RAMFUNC
+#define BENCH_CODE  "flash"
+#else
+#define BENCH_CODE  "ramfunc"
+#endif
+
+// Flash resident table, the loop over it is dominated by flash fetches
+static const uint16_t benchTable[64] = {
+    0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7, 0x8108,
+    0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef, 0x1231,
+    0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6, 0x9339,
+    0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de, 0x2462,
+    0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485, 0xa56a,
+    0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d, 0x3653,
+    0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4, 0xb75b,
+    0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc, 0x48c4
+};
+
+// Two blocks of RAM flash, enough for the log store to wrap and erase
+#define BENCH_FLASH_BLOCK   512
+
+// The benchmarks run one after another, so their working state shares one
+// area the size of the largest (the RAM flash and its log store)
+static union {
+    uint8_t ringData[256];
+    struct {
+        uint8_t flash[2 * BENCH_FLASH_BLOCK];
+        LogStore log;
+    } store;
+    ImuEncoder encoder;
+    struct {
+        int16_t pcm[MIC_BLOCK_SAMPLES];
+        ToneDetector tone;
+    } mic;
+    ImuFeatures features;
+    GestureWindow gesture;
+} bench GPRAM_DATA;
+static uint32_t benchCompBytes;
+
+// 100 Hz IMU trace in mg and cdps as the SAMPLEALL path stores it: at rest,
+// tilted towards +x and back, with sensor noise
+#define BENCH_TRACE_SAMPLES 128
+static const int16_t benchImuTrace[BENCH_TRACE_SAMPLES][6] = {
+    { -1, 11, 1000, -34, -31, 28 },
+    { -5, 14, 1003, -33, 24, -13 },
+    { -6, 10, 1000, 13, -32, -10 },
+    { -5, 17, 1000, -33, 32, -25 },
+    { -3, 19, 1004, 34, -33, 33 },
+    { 3, 15, 994, -12, -35, 31 },
+    { -4, 13, 1000, -22, 29, -25 },
+    { 3, 13, 1002, -17, -27, 34 },
+    { 3, 19, 997, 7, -28, 30 },
+    { 5, 10, 1003, -33, 39, -14 },
+    { 1, 19, 1002, 14, 0, 19 },
+    { 3, 16, 999, -2, -9, -17 },
+    { 5, 21, 997, -30, 33, -2 },
+    { 2, 16, 999, 17, -4, 37 },
+    { -5, 10, 1002, 13, -19, 3 },
+    { -4, 16, 1000, -35, -31, 31 },
+    { 3, 21, 999, 3, 4, 36 },
+    { 1, 18, 1006, 18, -32, -29 },
+    { -2, 16, 1005, -32, -33, -1 },
+    { 4, 18, 1004, 17, -4, 9 },
+    { 4, 14, 994, 19, 5, -19 },
+    { 3, 10, 1001, -33, -13, -4 },
+    { -4, 20, 997, 10, 10, 23 },
+    { -5, 11, 1001, 11, 30, -5 },
+    { -4, 15, 1002, -5, 13, 5 },
+    { 4, 15, 997, -21, -30, -18 },
+    { -4, 12, 1004, -11, -39, 22 },
+    { 3, 11, 998, -4, -40, -22 },
+    { 0, 17, 999, 38, 32, 0 },
+    { -4, 20, 1002, 39, -34, 18 },
+    { 6, 19, 1006, 31, 10, 10 },
+    { 0, 15, 995, 21, 11, -33 },
+    { 561, 10, 822, 16, 16855, -26 },
+    { 587, 18, 802, -27, 16814, 32 },
+    { 608, 17, 785, 6, 16831, -37 },
+    { 630, 12, 775, 8, 16671, -8 },
+    { 656, 18, 752, 20, 16525, -26 },
+    { 679, 16, 735, 21, 16368, -30 },
+    { 695, 10, 720, 3, 16141, 21 },
+    { 723, 11, 697, -38, 15874, 27 },
+    { 736, 11, 680, 29, 15553, 27 },
+    { 753, 19, 650, -7, 15280, 6 },
+    { 768, 14, 640, -12, 14910, 29 },
+    { 794, 17, 613, -12, 14512, -16 },
+    { 809, 12, 595, -11, 14016, 26 },
+    { 818, 14, 580, -37, 13517, -5 },
+    { 831, 13, 553, 37, 13048, 17 },
+    { 849, 20, 536, 6, 12473, -12 },
+    { 849, 12, 520, -15, 11935, -14 },
+    { 865, 18, 505, -40, 11353, 4 },
+    { 880, 19, 480, -25, 10714, -15 },
+    { 883, 11, 469, 2, 10023, 10 },
+    { 891, 15, 459, -30, 9355, -19 },
+    { 893, 9, 436, 35, 8694, -22 },
+    { 907, 18, 428, 4, 7933, 30 },
+    { 911, 11, 409, -39, 7187, 27 },
+    { 919, 11, 404, -16, 6444, -37 },
+    { 916, 12, 392, 24, 5675, 35 },
+    { 921, 13, 388, 13, 4874, -33 },
+    { 930, 14, 380, 34, 4126, 13 },
+    { 929, 11, 375, -21, 3319, 25 },
+    { 923, 16, 374, -17, 2513, -40 },
+    { 936, 21, 361, -18, 1632, 20 },
+    { 934, 20, 358, 31, 795, 1 },
+    { 936, 17, 364, 31, 21, -27 },
+    { 933, 9, 360, -16, -833, -35 },
+    { 936, 10, 367, 17, -1623, -37 },
+    { 935, 10, 369, 1, -2438, 24 },
+    { 930, 17, 370, -5, -3275, 25 },
+    { 927, 21, 380, 24, -4109, 26 },
+    { 920, 17, 383, 17, -4921, 13 },
+    { 913, 15, 395, 0, -5716, -10 },
+    { 914, 10, 401, -2, -6482, -21 },
+    { 914, 19, 419, 6, -7236, -8 },
+    { 900, 16, 424, -28, -7944, 22 },
+    { 893, 19, 437, -20, -8660, 25 },
+    { 890, 14, 454, -15, -9370, 0 },
+    { 877, 20, 468, -38, -10049, 30 },
+    { 875, 16, 490, -38, -10696, 2 },
+    { 866, 18, 500, 25, -11364, -26 },
+    { 860, 12, 514, -30, -11939, -6 },
+    { 837, 21, 533, -6, -12527, 14 },
+    { 834, 13, 556, -21, -13016, 25 },
+    { 820, 16, 580, 1, -13583, -5 },
+    { 797, 21, 600, -17, -14017, -31 },
+    { 786, 9, 618, -29, -14481, -30 },
+    { 775, 12, 629, -7, -14907, 18 },
+    { 749, 14, 657, 13, -15260, 39 },
+    { 733, 9, 677, -10, -15616, -20 },
+    { 716, 9, 691, -15, -15889, 40 },
+    { 697, 17, 721, -14, -16151, 17 },
+    { 680, 19, 730, -6, -16365, -38 },
+    { 655, 9, 747, -38, -16526, 30 },
+    { 632, 17, 773, -9, -16675, -27 },
+    { 616, 19, 790, 23, -16764, 10 },
+    { 590, 13, 813, -13, -16865, 3 },
+    { -3, 20, 1005, -23, 11, 4 },
+    { -6, 11, 994, -31, 40, -8 },
+    { 0, 11, 994, -30, 8, 24 },
+    { 4, 13, 1003, -9, -3, -35 },
+    { 1, 11, 996, -6, 17, -40 },
+    { -2, 14, 999, 30, 1, -9 },
+    { -6, 13, 997, 5, -17, -40 },
+    { -1, 15, 995, 20, -5, 24 },
+    { 4, 12, 997, 24, -40, -29 },
+    { -2, 10, 996, 11, 35, -35 },
+    { 0, 9, 998, -2, 40, -11 },
+    { -5, 18, 1002, -21, 36, 9 },
+    { 6, 14, 1005, 23, -21, -4 },
+    { 5, 18, 1004, -22, -35, 25 },
+    { 4, 15, 1005, 24, -23, 27 },
+    { 6, 17, 1003, -38, 34, -11 },
+    { -5, 9, 994, -23, 6, -27 },
+    { 0, 16, 1002, -34, 40, -38 },
+    { 4, 17, 1004, -9, 22, -7 },
+    { -6, 16, 1006, -32, 24, 28 },
+    { -5, 19, 1002, -32, 20, -8 },
+    { 6, 10, 998, -10, -14, -11 },
+    { 5, 19, 1001, 23, 8, -31 },
+    { 1, 19, 998, -35, 38, 40 },
+    { 4, 12, 995, 36, -22, 2 },
+    { -2, 19, 1005, -2, 39, 32 },
+    { -4, 9, 1001, -33, 22, -6 },
+    { 4, 10, 1005, -13, 22, -3 },
+    { 5, 17, 998, 19, 19, 19 },
+    { 6, 10, 1002, -15, -1, -30 },
+    { 1, 9, 998, 18, -31, 24 },
+    { 1, 13, 1000, -14, -14, -31 }
+};
+
+// One period of a 1 kHz tone at 16 kHz, a quarter of full scale
+static const int16_t benchSine[16] = {
+    0, 3061, 5657, 7391, 8000, 7391, 5657, 3061,
+    0, -3061, -5657, -7391, -8000, -7391, -5657, -3061
+};
+
+// BMP280 datasheet compensation example, s.23
+static const Bmp280Calib benchBmpCalib = {
+    27504, 26435, -1000, 36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000
+};
+
+static void bench_compBlock(const uint8_t *block, uint16_t length, uint32_t time, void *arg) {
+
+    benchCompBytes += length;
+}
+
+static void bench_toneFrame(bool down, uint32_t timeUs, void *arg) {
+
+}
+
+static void bench_print(UART_Handle uart, const char *name, uint32_t cycles) {
+
+    char line[64];
+    report_printf(uart, line, sizeof(line), "bench %s %lu %s %s\r\n", name,
+                  (unsigned long)(cycles / BENCH_ITERATIONS), BENCH_CACHE, BENCH_CODE);
+}
+
+void bench_run(UART_Handle uart) {
+
+    RingBuffer ring = RINGBUFFER_INIT(bench.ringData);
+    volatile uint32_t sink = 0;
+    uint32_t start, cycles;
+    const FlashDev *flash;
+    uint8_t byte;
+    int i, j;
+    UInt key;
+
+    cycles_init();
+
+    // Interrupts are off while measuring so the numbers are not polluted by
+    // ISRs; every loop is short enough not to lose UART bytes at 9600 baud.
+    key = Hwi_disable();
+    start = cycles_now();
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        RingBuffer_Write(&ring, (uint8_t)i);
+        RingBuffer_Read(&ring, &byte);
+    }
+    cycles = cycles_now() - start;
+    Hwi_restore(key);
+    bench_print(uart, "ringbuffer", cycles);
+
+    key = Hwi_disable();
+    start = cycles_now();
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        uint16_t crc = 0xFFFF;
+        for (j = 0; j < 64; j++) {
+            crc = (crc << 1) ^ benchTable[(crc ^ j) & 63];
+        }
+        sink += crc;
+    }
+    cycles = cycles_now() - start;
+    Hwi_restore(key);
+    bench_print(uart, "flashtable", cycles);
+
+    key = Hwi_disable();
+    start = cycles_now();
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        static const uint8_t raw[14] = { 0x01, 0x23, 0xfe, 0xdc, 0x40, 0x00, 0x00, 0x00,
+                                         0x00, 0x7f, 0xff, 0x80, 0x12, 0x34 };
+        float ax, ay, az, gx, gy, gz;
+        mpu9250_convert(raw, &ax, &ay, &az, &gx, &gy, &gz);
+        sink += (uint32_t)az;
+    }
+    cycles = cycles_now() - start;
+    Hwi_restore(key);
+    bench_print(uart, "convert", cycles);
+
+    key = Hwi_disable();
+    start = cycles_now();
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        int32_t t_fine;
+        sink += bmp280_compensate_temp(&benchBmpCalib, 519888 + i, &t_fine);
+        sink += bmp280_compensate_pres(&benchBmpCalib, 415148 + i, t_fine);
+    }
+    cycles = cycles_now() - start;
+    Hwi_restore(key);
+    bench_print(uart, "bmp280_32", cycles);
+
+    key = Hwi_disable();
+    start = cycles_now();
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        int32_t t_fine;
+        sink += bmp280_compensate_temp(&benchBmpCalib, 519888 + i, &t_fine);
+        sink += bmp280_compensate_pres64(&benchBmpCalib, 415148 + i, t_fine);
+    }
+    cycles = cycles_now() - start;
+    Hwi_restore(key);
+    bench_print(uart, "bmp280_64", cycles);
+
+    // IMU record as stored in SAMPLEALL, page CRC and programming included
+    flash = flashram_open(bench.store.flash, sizeof(bench.store.flash), LOGSTORE_PAGE_SIZE, BENCH_FLASH_BLOCK);
+    flashram_erase();
+    logstore_open(&bench.store.log, flash, 0, 2);
+    key = Hwi_disable();
+    start = cycles_now();
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        static const uint8_t record[25] = { 0, 12, 0, 0, 0, 216, 255, 255, 255, 235, 3, 0, 0,
+                                            150, 0, 0, 0, 181, 255, 255, 255, 20, 0, 0, 0 };
+        logstore_append(&bench.store.log, i, record, sizeof(record));
+    }
+    cycles = cycles_now() - start;
+    Hwi_restore(key);
+    bench_print(uart, "logstore", cycles);
+
+    // Cycles per sample over two laps of the trace, then the ratio
+    for (j = IMUCOMP_VARINT; j <= IMUCOMP_RICE; j++) {
+        char line[72];
+        imucomp_init(&bench.encoder, 6, (enum imucompCoding)j, bench_compBlock, NULL);
+        benchCompBytes = 0;
+        key = Hwi_disable();
+        start = cycles_now();
+        for (i = 0; i < BENCH_ITERATIONS; i++) {
+            const int16_t *raw = benchImuTrace[i % BENCH_TRACE_SAMPLES];
+            int32_t sample[6] = { raw[0], raw[1], raw[2], raw[3], raw[4], raw[5] };
+            imucomp_push(&bench.encoder, i * 10, 10, sample);
+        }
+        imucomp_flush(&bench.encoder);
+        cycles = cycles_now() - start;
+        Hwi_restore(key);
+        bench_print(uart, j == IMUCOMP_RICE ? "imucomp_rice" : "imucomp_varint", cycles);
+        report_printf(uart, line, sizeof(line), "comp %s in=%lu out=%lu ratio=%lu%%\r\n",
+                      j == IMUCOMP_RICE ? "rice" : "varint",
+                      (unsigned long)bench.encoder.stats.bytesIn, (unsigned long)benchCompBytes,
+                      (unsigned long)(bench.encoder.stats.bytesIn * 100 / benchCompBytes));
+    }
+
+    // Cycles per microphone block, compare with MIC_BUDGET_CYCLES
+    for (i = 0; i < MIC_BLOCK_SAMPLES; i++) {
+        bench.mic.pcm[i] = benchSine[i & 15];
+    }
+    tonedet_init(&bench.mic.tone, MIC_SAMPLE_RATE, 1000, bench_toneFrame, NULL);
+    key = Hwi_disable();
+    start = cycles_now();
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        tonedet_process(&bench.mic.tone, bench.mic.pcm, MIC_BLOCK_SAMPLES, i * 4000);
+    }
+    cycles = cycles_now() - start;
+    Hwi_restore(key);
+    bench_print(uart, "tonedet", cycles);
+
+    // Cycles per IMU sample to update the window features of all six axes
+    // and read them back
+    imufeat_init(&bench.features, 6, GESTURE_WINDOW_LOG2);
+    key = Hwi_disable();
+    start = cycles_now();
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        const int16_t *raw = benchImuTrace[i % BENCH_TRACE_SAMPLES];
+        int32_t sample[6] = { raw[0], raw[1], raw[2], raw[3], raw[4], raw[5] };
+        imufeat_push(&bench.features, sample);
+        for (j = 0; j < 6; j++) {
+            sink += imufeat_mean(&bench.features, j) + imufeat_variance(&bench.features, j) +
+                    imufeat_peakToPeak(&bench.features, j) + imufeat_crossings(&bench.features, j) +
+                    imufeat_jerk(&bench.features, j);
+        }
+    }
+    cycles = cycles_now() - start;
+    Hwi_restore(key);
+    bench_print(uart, "imufeat", cycles);
+
+    // Cycles per IMU sample of the two gesture classifiers in mode gyro
+    gesture_reset(&bench.gesture);
+    key = Hwi_disable();
+    start = cycles_now();
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        const int16_t *raw = benchImuTrace[i % BENCH_TRACE_SAMPLES];
+        int32_t sample[6] = { raw[0], raw[1], raw[2], raw[3], raw[4], raw[5] };
+        sink += gesture_update(&bench.gesture, sample);
+    }
+    cycles = cycles_now() - start;
+    Hwi_restore(key);
+    bench_print(uart, "gesture_tree", cycles);
+    key = Hwi_disable();
+    start = cycles_now();
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        const int16_t *raw = benchImuTrace[i % BENCH_TRACE_SAMPLES];
+        int32_t sample[6] = { raw[0], raw[1], raw[2], raw[3], raw[4], raw[5] };
+        sink += gesture_threshold(sample, 400, 1300);
+    }
+    cycles = cycles_now() - start;
+    Hwi_restore(key);
+    bench_print(uart, "gesture_thr", cycles);
+
+    // trace_write drops records once the ring is full, which is the same
+    // cost a hot path pays, so the loop is not split up
+    start = cycles_now();
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        TRACE2("bench %u %u", i, sink);
+    }
+    cycles = cycles_now() - start;
+    bench_print(uart, "trace", cycles);
+}
@@ -0,0 +1,16 @@
+/*
+ * bench.h
+ *
+ *  On-target micro benchmarks of the hot loops, measured with the DWT cycle
+ *  counter. Run the same image built with and without CACHE_AS_RAM to see
+ *  what turning the flash cache into GPRAM costs.
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <ti/drivers/UART.h>
+
+void bench_run(UART_Handle uart);
+
+#endif /* BENCH_H_ */
@@ -52,6 +52,7 @@
 #include <driverlib/timer.h>
 
 #include "buzzer.h"
+#include "powertrack.h"
 
 /* -----------------------------------------------------------------------------
 *  Local variables
@@ -79,7 +80,8 @@ void buzzerOpen(PIN_Handle hGpioPin)
 
     // Turn on PERIPH power domain and clock for GPT0 and GPIO
     Power_setDependency(PowerCC26XX_PERIPH_GPT0);
-    Power_setConstraint(PowerCC26XX_SB_DISALLOW);
+    powertrack_setConstraint(POWER_OWNER_BUZZER, PowerCC26XX_SB_DISALLOW);
+    powertrack_setLoad(POWER_OWNER_BUZZER, BUZZER_LOAD_UA);
 
     // Assign GPT0
     TimerConfigure(GPT0_BASE, TIMER_CFG_SPLIT_PAIR | TIMER_CFG_A_PWM);
@@ -147,5 +149,6 @@ void buzzerClose(void)
 
     // Turn off PERIPH power domain and clock for GPT0
     Power_releaseDependency(PowerCC26XX_PERIPH_GPT0);
-    Power_releaseConstraint(PowerCC26XX_SB_DISALLOW);
+    powertrack_releaseConstraint(POWER_OWNER_BUZZER, PowerCC26XX_SB_DISALLOW);
+    powertrack_setLoad(POWER_OWNER_BUZZER, 0);
 }
@@ -51,6 +51,7 @@
 */
 #define BUZZER_FREQ_MIN            3
 #define BUZZER_FREQ_MAX            8000
+#define BUZZER_LOAD_UA             3000  // GPT0 + PERIPH domain + piezo drive, estimate
 
 /* -----------------------------------------------------------------------------
 *                                          Functions
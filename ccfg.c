@@ -47,4 +47,9 @@
  *        remain unmodified.
  */
 
+#ifdef CACHE_AS_RAM
+/* Boot ROM leaves the flash cache disabled and maps it as 8 KB GPRAM */
+#define SET_CCFG_SIZE_AND_DIS_FLAGS_DIS_GPRAM   0x0
+#endif
+
 #include <startup_files/ccfg.c>
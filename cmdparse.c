@@ -0,0 +1,224 @@
+/*
+ * cmdparse.c
+ *
+ *  Incremental UART command parser, see cmdparse.h.
+ */
+
+#include <string.h>
+
+#include "cmdparse.h"
+
+typedef struct {
+    const char *name;
+    uint8_t minArgs;
+    uint8_t maxArgs;
+} CmdDef;
+
+static const CmdDef cmdDefs[CMD_OPCOUNT] = {
+    [CMD_GET]    = { "get",    1, 1 },
+    [CMD_SET]    = { "set",    2, 2 },
+    [CMD_RESET]  = { "reset",  1, 1 },
+    [CMD_MODE]   = { "mode",   0, 1 },
+    [CMD_RATE]   = { "rate",   0, 2 },
+    [CMD_STREAM] = { "stream", 1, 1 },
+    [CMD_STATS]  = { "stats",  0, 1 },
+    [CMD_CAL]    = { "cal",    0, 0 },
+    [CMD_MIC]    = { "mic",    1, 1 },
+    [CMD_KEY]    = { "key",    1, 1 },
+    [CMD_LOG]    = { "log",    2, 2 },
+    [CMD_HELP]   = { "help",   0, 0 }
+};
+
+void cmdparse_init(CmdParser *parser) {
+
+    parser->active = false;
+    parser->overflow = false;
+    parser->fed = false;
+    parser->len = 0;
+}
+
+const char *cmdparse_name(enum cmdOp op) {
+
+    return op < CMD_OPCOUNT ? cmdDefs[op].name : "";
+}
+
+// Splits the line on spaces and looks up the command
+static enum cmdResult cmdparse_line(CmdParser *parser, Command *cmd) {
+
+    const char *tokens[CMD_MAX_ARGS + 1];
+    int count = 0;
+    char *p = parser->line;
+    int op;
+
+    parser->line[parser->len] = '\0';
+    while (*p != '\0') {
+        while (*p == ' ') {
+            *p++ = '\0';
+        }
+        if (*p == '\0') {
+            break;
+        }
+        if (count == CMD_MAX_ARGS + 1) {
+            cmd->error = "arguments";
+            return CMDPARSE_ERROR;
+        }
+        tokens[count++] = p;
+        while (*p != ' ' && *p != '\0') {
+            p++;
+        }
+    }
+    if (count == 0) {
+        cmd->error = "empty";
+        return CMDPARSE_ERROR;
+    }
+
+    for (op = 0; op < CMD_OPCOUNT; op++) {
+        if (strcmp(tokens[0], cmdDefs[op].name) == 0) {
+            break;
+        }
+    }
+    if (op == CMD_OPCOUNT) {
+        cmd->error = "unknown command";
+        return CMDPARSE_ERROR;
+    }
+    if (count - 1 < cmdDefs[op].minArgs || count - 1 > cmdDefs[op].maxArgs) {
+        cmd->error = "arguments";
+        return CMDPARSE_ERROR;
+    }
+
+    cmd->op = (enum cmdOp)op;
+    cmd->argc = count - 1;
+    for (count = 0; count < cmd->argc; count++) {
+        cmd->argv[count] = tokens[count + 1];
+    }
+    cmd->error = NULL;
+    return CMDPARSE_READY;
+}
+
+static bool cmdparse_isCommandByte(uint8_t byte) {
+
+    return (byte >= 'a' && byte <= 'z') || (byte >= '0' && byte <= '9')
+        || byte == ' ' || byte == '.' || byte == '-' || byte == '_';
+}
+
+enum cmdResult cmdparse_feed(CmdParser *parser, uint8_t byte, Command *cmd) {
+
+    bool endOfLine = byte == '\r' || byte == '\n';
+    bool erase = byte == '\b' || byte == 0x7F;
+
+    parser->fed = true;
+    if (parser->overflow) {
+        if (endOfLine || erase || cmdparse_isCommandByte(byte)) {
+            parser->overflow = !endOfLine;
+            return CMDPARSE_PENDING;
+        }
+        // Not part of the long line, handled like any byte outside a command
+        parser->overflow = false;
+    }
+
+    if (!parser->active || byte == CMD_PREFIX) {
+        if (byte != CMD_PREFIX) {
+            return CMDPARSE_PASS;
+        }
+        parser->active = true;
+        parser->len = 0;
+        return CMDPARSE_PENDING;
+    }
+
+    if (endOfLine) {
+        parser->active = false;
+        return cmdparse_line(parser, cmd);
+    }
+    if (erase) {
+        if (parser->len > 0) {
+            parser->len--;
+        }
+        return CMDPARSE_PENDING;
+    }
+    // Binary, control or other bytes end the line, they were never meant as a command
+    if (!cmdparse_isCommandByte(byte)) {
+        parser->active = false;
+        cmd->error = "bad byte";
+        return CMDPARSE_ERROR;
+    }
+    if (parser->len == CMD_MAX_LINE) {
+        parser->active = false;
+        parser->overflow = true;
+        cmd->error = "too long";
+        return CMDPARSE_ERROR;
+    }
+    parser->line[parser->len++] = (char)byte;
+    return CMDPARSE_PENDING;
+}
+
+// Called periodically, from the UART housekeeping. Drops a partial line that
+// has not been fed a byte since the previous call and returns true; the rest
+// of a long line, already answered with "too long", ends quietly.
+bool cmdparse_timeout(CmdParser *parser) {
+
+    bool expired = parser->active && !parser->fed;
+
+    if (!parser->fed) {
+        parser->active = false;
+        parser->overflow = false;
+    }
+    parser->fed = false;
+    return expired;
+}
+
+// Decimal, at most 4294967295
+bool cmdparse_uint(const char *s, uint32_t *value) {
+
+    uint32_t v = 0;
+
+    if (*s == '\0') {
+        return false;
+    }
+    for (; *s != '\0'; s++) {
+        uint32_t digit = (uint32_t)(*s - '0');
+        if (digit > 9 || v > (0xFFFFFFFF - digit) / 10) {
+            return false;
+        }
+        v = v * 10 + digit;
+    }
+    *value = v;
+    return true;
+}
+
+// [-]digits[.digits], up to 6 integer and 6 fraction digits
+bool cmdparse_float(const char *s, float *value) {
+
+    uint32_t whole = 0, fraction = 0, scale = 1;
+    bool negative = false;
+    int digits = 0;
+
+    if (*s == '-') {
+        negative = true;
+        s++;
+    }
+    for (; *s >= '0' && *s <= '9'; s++) {
+        if (++digits > 6) {
+            return false;
+        }
+        whole = whole * 10 + (uint32_t)(*s - '0');
+    }
+    if (*s == '.') {
+        s++;
+        for (; *s >= '0' && *s <= '9'; s++) {
+            if (scale == 1000000) {
+                return false;
+            }
+            fraction = fraction * 10 + (uint32_t)(*s - '0');
+            scale *= 10;
+            digits++;
+        }
+    }
+    if (*s != '\0' || digits == 0) {
+        return false;
+    }
+    *value = (float)whole + (float)fraction / (float)scale;
+    if (negative) {
+        *value = -*value;
+    }
+    return true;
+}
@@ -0,0 +1,89 @@
+/*
+ * cmdparse.h
+ *
+ *  Incremental parser for text commands on the UART RX path. A command is a
+ *  line starting with CMD_PREFIX; everything outside such a line is passed
+ *  back to the caller untouched, so single-key commands and Morse playback
+ *  bytes keep working. Bytes are fed one at a time as they come out of the
+ *  RX ring, the line is kept in the parser and tokenised in place.
+ *
+ *      $get <key>                 configuration value, see config.h
+ *      $set <key> <value>
+ *      $reset <key>|all
+ *      $mode [menu|gyro|light|all|optrx]
+ *      $rate [<sensor> <ms>]      period in mode all, 0 for adaptive IMU rate
+ *      $stream on|off             compressed IMU blocks, see imucomp.h
+ *      $stats [<report>|reset]    reset clears the rate tier residency
+ *      $cal                       recalibrate the IMU
+ *      $mic on|off                acoustic Morse input, see mic.h
+ *      $key on|off                button as a straight key, see straightkey.h
+ *      $log <t0> <t1>             stored records with t0 <= time <= t1, in ms
+ *      $help
+ *
+ *  A partial line is abandoned, so a stray prefix cannot swallow the bytes
+ *  after it: on a byte outside the command alphabet (lower case letters,
+ *  digits, space, '.', '-' and '_'), where another prefix starts a new line;
+ *  on overflow, which also skips the rest of that line; and when
+ *  cmdparse_timeout finds no byte since its previous call.
+ *
+ *  Replies are one or more lines, the last one "ok" or "err <reason>".
+ *  Plain C, builds on a host.
+ */
+
+#ifndef CMDPARSE_H_
+#define CMDPARSE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CMD_PREFIX      '$'
+#define CMD_MAX_LINE    48
+#define CMD_MAX_ARGS    3
+
+enum cmdOp {
+    CMD_GET = 0,
+    CMD_SET,
+    CMD_RESET,
+    CMD_MODE,
+    CMD_RATE,
+    CMD_STREAM,
+    CMD_STATS,
+    CMD_CAL,
+    CMD_MIC,
+    CMD_KEY,
+    CMD_LOG,
+    CMD_HELP,
+    CMD_OPCOUNT
+};
+
+enum cmdResult {
+    CMDPARSE_PASS = 0,      // not part of a command, the caller handles the byte
+    CMDPARSE_PENDING,       // consumed, command not complete yet
+    CMDPARSE_READY,         // command complete
+    CMDPARSE_ERROR          // line rejected, cmd->error says why
+};
+
+// Arguments point into the parser, valid until the next byte is fed
+typedef struct {
+    enum cmdOp op;
+    uint8_t argc;
+    const char *argv[CMD_MAX_ARGS];
+    const char *error;
+} Command;
+
+typedef struct {
+    bool active;
+    bool overflow;          // skipping the rest of a line that was too long
+    bool fed;               // a byte since the last cmdparse_timeout
+    uint8_t len;
+    char line[CMD_MAX_LINE + 1];
+} CmdParser;
+
+void cmdparse_init(CmdParser *parser);
+enum cmdResult cmdparse_feed(CmdParser *parser, uint8_t byte, Command *cmd);
+bool cmdparse_timeout(CmdParser *parser);
+const char *cmdparse_name(enum cmdOp op);
+bool cmdparse_uint(const char *s, uint32_t *value);
+bool cmdparse_float(const char *s, float *value);
+
+#endif /* CMDPARSE_H_ */
@@ -0,0 +1,170 @@
+/*
+ * config.c
+ *
+ *  Persistent runtime configuration, see config.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <xdc/std.h>
+
+#include "config.h"
+#include "intflash.h"
+#include "report.h"
+
+#define CONFIG_FIRST_BLOCK  0   // of the reserved sectors
+
+static const ConfigDef configDefs[CONFIG_KEY_COUNT] = {
+    [CONFIG_THRESHOLD]      = { "threshold",   KVSTORE_FLOAT, { .f = 0.4f },  { .f = 0.05f }, { .f = 2.0f } },
+    [CONFIG_THRESHOLD_Z]    = { "threshold_z", KVSTORE_FLOAT, { .f = 1.3f },  { .f = 0.05f }, { .f = 2.0f } },
+    [CONFIG_MENU_THRESHOLD] = { "menu_thr",    KVSTORE_FLOAT, { .f = 0.40f }, { .f = 0.05f }, { .f = 2.0f } },
+    [CONFIG_TIMER_LIMIT]    = { "timer_limit", KVSTORE_U32,   { .u = 1000 },  { .u = 100 },   { .u = 60000 } },
+    [CONFIG_ASCALE]         = { "ascale",      KVSTORE_U32,   { .u = 2 },     { .u = 0 },     { .u = 3 } },
+    [CONFIG_GSCALE]         = { "gscale",      KVSTORE_U32,   { .u = 0 },     { .u = 0 },     { .u = 3 } },
+    [CONFIG_BAUD_RATE]      = { "baud",        KVSTORE_U32,   { .u = 9600 },  { .u = 1200 },  { .u = 115200 } },
+    [CONFIG_MORSE_UNIT_US]  = { "morse_unit",  KVSTORE_U32,   { .u = 40000 }, { .u = 10000 }, { .u = 500000 } },
+    [CONFIG_TONE_HZ]        = { "tone_hz",     KVSTORE_U32,   { .u = 700 },   { .u = 300 },   { .u = 1300 } },
+    [CONFIG_GESTURE]        = { "gesture",     KVSTORE_U32,   { .u = 0 },     { .u = 0 },     { .u = 1 } },
+    [CONFIG_WOM_IDLE_MS]    = { "wom_idle",    KVSTORE_U32,   { .u = 30000 }, { .u = 1000 },  { .u = 600000 } },
+    [CONFIG_TMP_ALERT]      = { "tmp_alert",   KVSTORE_U32,   { .u = 0 },     { .u = 0 },     { .u = 1 } },
+    [CONFIG_TMP_HIGH]       = { "tmp_high",    KVSTORE_I32,   { .i = 3500 },  { .i = -4000 }, { .i = 12500 } },
+    [CONFIG_TMP_LOW]        = { "tmp_low",     KVSTORE_I32,   { .i = 1500 },  { .i = -4000 }, { .i = 12500 } }
+};
+
+static KvStore store;
+
+void config_init(void) {
+
+    kvstore_open(&store, intflash_open(), CONFIG_FIRST_BLOCK);
+}
+
+const ConfigDef *config_def(enum configKey key) {
+
+    return key < CONFIG_KEY_COUNT ? &configDefs[key] : NULL;
+}
+
+// Key number for a name, -1 if there is none
+int config_find(const char *name) {
+
+    int key;
+
+    for (key = 0; key < CONFIG_KEY_COUNT; key++) {
+        if (strcmp(configDefs[key].name, name) == 0) {
+            return key;
+        }
+    }
+    return -1;
+}
+
+static ConfigValue config_get(enum configKey key) {
+
+    ConfigValue value = configDefs[key].def;
+    kvstore_get(&store, key, configDefs[key].type, &value.u);
+    return value;
+}
+
+uint32_t config_getU32(enum configKey key) {
+
+    return config_get(key).u;
+}
+
+int32_t config_getI32(enum configKey key) {
+
+    return config_get(key).i;
+}
+
+float config_getFloat(enum configKey key) {
+
+    return config_get(key).f;
+}
+
+bool config_isStored(enum configKey key) {
+
+    uint32_t value;
+    return kvstore_get(&store, key, configDefs[key].type, &value);
+}
+
+// Rejects values outside the key's range. Storing the default removes the
+// key instead, so later default changes in the firmware apply to it.
+bool config_set(enum configKey key, ConfigValue value) {
+
+    const ConfigDef *def = config_def(key);
+    bool inRange;
+
+    if (def == NULL) {
+        return false;
+    }
+    switch (def->type) {
+        case KVSTORE_FLOAT:
+            inRange = value.f >= def->min.f && value.f <= def->max.f;
+            break;
+        case KVSTORE_I32:
+            inRange = value.i >= def->min.i && value.i <= def->max.i;
+            break;
+        default:
+            inRange = value.u >= def->min.u && value.u <= def->max.u;
+            break;
+    }
+    if (!inRange) {
+        return false;
+    }
+    if (value.u == def->def.u) {
+        return kvstore_remove(&store, key);
+    }
+    return kvstore_set(&store, key, def->type, value.u);
+}
+
+bool config_reset(enum configKey key) {
+
+    return key < CONFIG_KEY_COUNT && kvstore_remove(&store, key);
+}
+
+bool config_resetAll(void) {
+
+    return kvstore_clear(&store);
+}
+
+static int config_formatValue(char *buf, enum kvType type, ConfigValue value) {
+
+    if (type == KVSTORE_FLOAT) {
+        int32_t milli = (int32_t)(value.f * 1000.0f + (value.f < 0 ? -0.5f : 0.5f));
+        uint32_t abs = milli < 0 ? -milli : milli;
+        return sprintf(buf, "%s%lu.%03lu", milli < 0 ? "-" : "",
+                       (unsigned long)(abs / 1000), (unsigned long)(abs % 1000));
+    }
+    if (type == KVSTORE_I32) {
+        return sprintf(buf, "%ld", (long)value.i);
+    }
+    return sprintf(buf, "%lu", (unsigned long)value.u);
+}
+
+// "<name>=<value> <stored|default>", returns the length
+int config_format(char *buf, enum configKey key) {
+
+    int len = sprintf(buf, "%s=", configDefs[key].name);
+
+    len += config_formatValue(&buf[len], configDefs[key].type, config_get(key));
+    len += sprintf(&buf[len], " %s", config_isStored(key) ? "stored" : "default");
+    return len;
+}
+
+// Export format, one line per key and a summary:
+//   cfg <name>=<value> <stored|default>
+//   cfg bank=<n> seq=<n> used=<bytes> writes=<n> compactions=<n> skipped=<n> fail=<n>
+void config_report(UART_Handle uart) {
+
+    char line[136];
+    int key, len;
+
+    for (key = 0; key < CONFIG_KEY_COUNT; key++) {
+        len = sprintf(line, "cfg ");
+        len += config_format(&line[len], (enum configKey)key);
+        len += sprintf(&line[len], "\r\n");
+        UART_write(uart, line, len);
+    }
+    report_printf(uart, line, sizeof(line), "cfg bank=%d seq=%lu used=%lu writes=%lu compactions=%lu skipped=%lu fail=%lu\r\n",
+                  store.active, (unsigned long)store.seq, (unsigned long)kvstore_used(&store),
+                  (unsigned long)store.stats.writes, (unsigned long)store.stats.compactions,
+                  (unsigned long)store.stats.skipped, (unsigned long)store.stats.failures);
+}
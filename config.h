@@ -0,0 +1,69 @@
+/*
+ * config.h
+ *
+ *  Persistent runtime configuration: tuning values that used to be
+ *  compile-time constants, kept in the key-value store (kvstore.h) on two
+ *  reserved internal flash sectors. Keys without a stored value read as
+ *  their default. config_init runs in main before BIOS_start; after it
+ *  every get is a RAM lookup.
+ *
+ *  Most values are read where they are used, the scale and baud settings
+ *  are applied at start-up and need a reset to take effect.
+ */
+
+#ifndef CONFIG_H_
+#define CONFIG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ti/drivers/UART.h>
+
+#include "kvstore.h"
+
+// Key numbers are stored in flash, only append
+enum configKey {
+    CONFIG_THRESHOLD = 0,       // g, '.' gesture on x
+    CONFIG_THRESHOLD_Z,         // g, '-' gesture on z
+    CONFIG_MENU_THRESHOLD,      // g, menu tilt
+    CONFIG_TIMER_LIMIT,         // 0.01 s, menu timeout
+    CONFIG_ASCALE,              // MPU9250 AFS_SEL, 0-3 for 2-16 g
+    CONFIG_GSCALE,              // MPU9250 GFS_SEL, 0-3 for 250-2000 dps
+    CONFIG_BAUD_RATE,
+    CONFIG_MORSE_UNIT_US,       // dot length of the Morse LED
+    CONFIG_TONE_HZ,             // acoustic Morse tone, see mic.h
+    CONFIG_GESTURE,             // 0 threshold rule, 1 decision tree, see gesture.h
+    CONFIG_WOM_IDLE_MS,         // still time in MENU before the IMU sleeps in wake-on-motion
+    CONFIG_TMP_ALERT,           // 0 TMP007 result every conversion, 1 only outside tmp_low..tmp_high
+    CONFIG_TMP_HIGH,            // 0.01 degC, object temperature
+    CONFIG_TMP_LOW,             // 0.01 degC, object temperature
+    CONFIG_KEY_COUNT
+};
+
+typedef union {
+    uint32_t u;
+    int32_t i;
+    float f;
+} ConfigValue;
+
+typedef struct {
+    const char *name;
+    enum kvType type;
+    ConfigValue def;
+    ConfigValue min;
+    ConfigValue max;
+} ConfigDef;
+
+void config_init(void);
+const ConfigDef *config_def(enum configKey key);
+int config_find(const char *name);
+uint32_t config_getU32(enum configKey key);
+int32_t config_getI32(enum configKey key);
+float config_getFloat(enum configKey key);
+bool config_isStored(enum configKey key);
+bool config_set(enum configKey key, ConfigValue value);
+bool config_reset(enum configKey key);
+bool config_resetAll(void);
+int config_format(char *buf, enum configKey key);
+void config_report(UART_Handle uart);
+
+#endif /* CONFIG_H_ */
@@ -0,0 +1,24 @@
+/*
+ * crc16.c
+ *
+ *  CRC-16/CCITT-FALSE, see crc16.h.
+ */
+
+#include "crc16.h"
+
+static const uint16_t crcNibble[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef
+};
+
+uint16_t crc16(uint16_t crc, const void *data, size_t len) {
+
+    const uint8_t *p = data;
+
+    while (len--) {
+        crc = (crc << 4) ^ crcNibble[(crc >> 12) ^ (*p >> 4)];
+        crc = (crc << 4) ^ crcNibble[(crc >> 12) ^ (*p & 0x0f)];
+        p++;
+    }
+    return crc;
+}
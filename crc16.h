@@ -0,0 +1,19 @@
+/*
+ * crc16.h
+ *
+ *  CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) for records kept in flash.
+ *  Nibble table, 32 bytes of flash and about 2 cycles per bit.
+ */
+
+#ifndef CRC16_H_
+#define CRC16_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CRC16_INIT  0xFFFF
+
+// Continues crc over len bytes, start with CRC16_INIT
+uint16_t crc16(uint16_t crc, const void *data, size_t len);
+
+#endif /* CRC16_H_ */
@@ -0,0 +1,30 @@
+/*
+ * cycles.h
+ *
+ *  Cortex-M3 DWT cycle counter, 48 MHz CPU clock -> 48 cycles per us.
+ *  The counter stops while the CPU sleeps, so only use it around code that
+ *  does not block.
+ */
+
+#ifndef CYCLES_H_
+#define CYCLES_H_
+
+#include <stdint.h>
+
+#define CYCLES_DEMCR    (*(volatile uint32_t *)0xE000EDFC)
+#define CYCLES_DWT_CTRL (*(volatile uint32_t *)0xE0001000)
+#define CYCLES_DWT_CNT  (*(volatile uint32_t *)0xE0001004)
+
+static inline void cycles_init(void) {
+
+    CYCLES_DEMCR |= 1UL << 24;    // TRCENA
+    CYCLES_DWT_CNT = 0;
+    CYCLES_DWT_CTRL |= 1UL;       // CYCCNTENA
+}
+
+static inline uint32_t cycles_now(void) {
+
+    return CYCLES_DWT_CNT;
+}
+
+#endif /* CYCLES_H_ */
@@ -0,0 +1,62 @@
+/*
+ * dblbuf.c
+ *
+ *  Double transmit buffer, see dblbuf.h.
+ */
+
+#include <string.h>
+
+#include "dblbuf.h"
+
+void dblbuf_init(DblBuf *d) {
+
+    d->len[0] = d->len[1] = 0;
+    d->fill = 0;
+    d->active = false;
+}
+
+// Copies what fits into the fill buffer, returns the bytes taken; 0 when
+// both buffers are full
+size_t dblbuf_put(DblBuf *d, const uint8_t *src, size_t size) {
+
+    uint8_t b = d->fill;
+    size_t n = DBLBUF_SIZE - d->len[b];
+
+    if (n > size) {
+        n = size;
+    }
+    memcpy(&d->data[b][d->len[b]], src, n);
+    d->len[b] += n;
+    return n;
+}
+
+// With no transfer running: hands out the fill buffer for sending and
+// swaps, writes go to the other one from now on. Returns its length, 0 if
+// there is nothing to send.
+uint16_t dblbuf_start(DblBuf *d, const uint8_t **data) {
+
+    uint8_t b = d->fill;
+
+    if (d->active || d->len[b] == 0) {
+        return 0;
+    }
+    *data = d->data[b];
+    d->active = true;
+    d->fill = b ^ 1;
+    return d->len[b];
+}
+
+// The transfer finished, its buffer is free again. Returns true when the
+// fill buffer holds data, the caller then starts it.
+bool dblbuf_done(DblBuf *d) {
+
+    d->len[d->fill ^ 1] = 0;
+    d->active = false;
+    return d->len[d->fill] > 0;
+}
+
+// Bytes queued, the buffer in flight included
+uint16_t dblbuf_queued(const DblBuf *d) {
+
+    return d->len[0] + d->len[1];
+}
@@ -0,0 +1,35 @@
+/*
+ * dblbuf.h
+ *
+ *  Double transmit buffer of the uDMA UART driver (uartdma.h). Writes are
+ *  copied into the fill buffer while the other one is in flight. Starting a
+ *  transfer hands out the fill buffer and swaps the two; its completion
+ *  frees the buffer that was sent and tells whether the next one is ready.
+ *
+ *  The caller serialises the calls (uartdma: interrupts off) and moves the
+ *  bytes. Plain C, builds on a host.
+ */
+
+#ifndef DBLBUF_H_
+#define DBLBUF_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DBLBUF_SIZE     256     // per buffer, two of them
+
+typedef struct {
+    uint8_t data[2][DBLBUF_SIZE];
+    uint16_t len[2];
+    uint8_t fill;           // buffer taking writes, the other one may be in flight
+    bool active;            // a transfer is running
+} DblBuf;
+
+void dblbuf_init(DblBuf *d);
+size_t dblbuf_put(DblBuf *d, const uint8_t *src, size_t size);
+uint16_t dblbuf_start(DblBuf *d, const uint8_t **data);
+bool dblbuf_done(DblBuf *d);
+uint16_t dblbuf_queued(const DblBuf *d);
+
+#endif /* DBLBUF_H_ */
@@ -0,0 +1,225 @@
+/*
+ * extflash.c
+ *
+ *  SensorTag external SPI flash, see extflash.h.
+ */
+
+#include <string.h>
+
+#include <xdc/std.h>
+#include <ti/sysbios/knl/Clock.h>
+#include <ti/sysbios/knl/Task.h>
+#include <ti/drivers/PIN.h>
+#include <ti/drivers/SPI.h>
+
+#include "Board.h"
+#include "extflash.h"
+#include "trace.h"
+
+// Command set common to both parts
+#define CMD_WRITE_ENABLE    0x06
+#define CMD_READ_STATUS     0x05
+#define CMD_READ            0x03
+#define CMD_PAGE_PROGRAM    0x02
+#define CMD_SECTOR_ERASE    0x20
+#define CMD_JEDEC_ID        0x9F
+#define CMD_POWER_DOWN      0xB9
+#define CMD_RELEASE_PD      0xAB
+
+#define STATUS_BUSY         0x01
+
+#define MANF_WINBOND        0xEF
+#define MANF_MACRONIX       0xC2
+
+// Typical program time is under 1 ms, erase tens of ms (max 400 ms)
+#define PROGRAM_TIMEOUT_US  5000
+#define ERASE_TIMEOUT_US    500000
+#define ERASE_POLL_US       2000
+#define RELEASE_PD_US       30
+
+#define MAX_TRANSFER        1024    // SPICC26XXDMA limit per transaction
+
+static SPI_Handle spi = NULL;
+static PIN_Handle hCsPin;
+static PIN_State csState;
+static bool asleep = false;
+static FlashDev dev;
+
+static PIN_Config csConfig[] = {
+    Board_SPI_FLASH_CS | PIN_GPIO_OUTPUT_EN | PIN_GPIO_HIGH | PIN_PUSHPULL | PIN_DRVSTR_MIN,
+    PIN_TERMINATE
+};
+
+static bool extflash_transfer(const void *tx, void *rx, uint32_t len) {
+
+    SPI_Transaction t;
+
+    while (len > 0) {
+        uint32_t n = len < MAX_TRANSFER ? len : MAX_TRANSFER;
+        t.count = n;
+        t.txBuf = (void *)tx;
+        t.rxBuf = rx;
+        if (!SPI_transfer(spi, &t)) {
+            return false;
+        }
+        if (tx != NULL) {
+            tx = (const uint8_t *)tx + n;
+        }
+        if (rx != NULL) {
+            rx = (uint8_t *)rx + n;
+        }
+        len -= n;
+    }
+    return true;
+}
+
+// One command with an optional 24-bit address, then len bytes out or in
+static bool extflash_command(uint8_t cmd, int32_t addr, const void *tx, void *rx, uint32_t len) {
+
+    uint8_t header[4];
+    uint32_t headerLen = 1;
+    bool ok;
+
+    header[0] = cmd;
+    if (addr >= 0) {
+        header[1] = (uint8_t)(addr >> 16);
+        header[2] = (uint8_t)(addr >> 8);
+        header[3] = (uint8_t)addr;
+        headerLen = 4;
+    }
+    PIN_setOutputValue(hCsPin, Board_SPI_FLASH_CS, Board_FLASH_CS_ON);
+    ok = extflash_transfer(header, NULL, headerLen);
+    if (ok && len > 0) {
+        ok = extflash_transfer(tx, rx, len);
+    }
+    PIN_setOutputValue(hCsPin, Board_SPI_FLASH_CS, Board_FLASH_CS_OFF);
+    return ok;
+}
+
+static void extflash_wake(void) {
+
+    if (asleep) {
+        extflash_command(CMD_RELEASE_PD, -1, NULL, NULL, 0);
+        Task_sleep(RELEASE_PD_US / Clock_tickPeriod + 1);
+        asleep = false;
+    }
+}
+
+static bool extflash_waitReady(uint32_t timeoutUs, uint32_t pollUs) {
+
+    uint32_t start = Clock_getTicks();
+    uint8_t status;
+
+    while (true) {
+        if (!extflash_command(CMD_READ_STATUS, -1, NULL, &status, 1)) {
+            return false;
+        }
+        if ((status & STATUS_BUSY) == 0) {
+            return true;
+        }
+        if ((Clock_getTicks() - start) * Clock_tickPeriod > timeoutUs) {
+            TRACE1("extflash: busy timeout, status %x", status);
+            return false;
+        }
+        if (pollUs > 0) {
+            Task_sleep(pollUs / Clock_tickPeriod);
+        }
+    }
+}
+
+static bool extflash_read(uint32_t addr, void *buf, uint32_t len) {
+
+    extflash_wake();
+    return extflash_command(CMD_READ, addr, NULL, buf, len);
+}
+
+static bool extflash_program(uint32_t addr, const void *buf, uint32_t len) {
+
+    if ((addr % EXTFLASH_PAGE_SIZE) + len > EXTFLASH_PAGE_SIZE) {
+        return false;
+    }
+    extflash_wake();
+    if (!extflash_command(CMD_WRITE_ENABLE, -1, NULL, NULL, 0) ||
+        !extflash_command(CMD_PAGE_PROGRAM, addr, buf, NULL, len)) {
+        return false;
+    }
+    // Busy poll, a Task_sleep tick is longer than the program time
+    return extflash_waitReady(PROGRAM_TIMEOUT_US, 0);
+}
+
+static bool extflash_erase(uint32_t addr) {
+
+    extflash_wake();
+    if (!extflash_command(CMD_WRITE_ENABLE, -1, NULL, NULL, 0) ||
+        !extflash_command(CMD_SECTOR_ERASE, addr, NULL, NULL, 0)) {
+        return false;
+    }
+    return extflash_waitReady(ERASE_TIMEOUT_US, ERASE_POLL_US);
+}
+
+// Call after Board_initSPI()
+const FlashDev *extflash_open(void) {
+
+    SPI_Params spiParams;
+    uint8_t id[3];
+
+    if (spi != NULL) {
+        return &dev;
+    }
+    hCsPin = PIN_open(&csState, csConfig);
+    if (hCsPin == NULL) {
+        return NULL;
+    }
+    SPI_Params_init(&spiParams);
+    spiParams.bitRate = EXTFLASH_BITRATE;
+    spiParams.mode = SPI_MASTER;
+    spiParams.frameFormat = SPI_POL0_PHA0;
+    spiParams.dataSize = 8;
+    spiParams.transferMode = SPI_MODE_BLOCKING;
+    spi = SPI_open(Board_SPI0, &spiParams);
+    if (spi == NULL) {
+        PIN_close(hCsPin);
+        return NULL;
+    }
+
+    // The chip may still be powered down from before a reset
+    asleep = true;
+    extflash_wake();
+    memset(id, 0, sizeof(id));
+    extflash_command(CMD_JEDEC_ID, -1, NULL, id, sizeof(id));
+    if ((id[0] != MANF_WINBOND && id[0] != MANF_MACRONIX) || id[2] < 16 || id[2] > 24) {
+        TRACE3("extflash: unknown id %x %x %x", id[0], id[1], id[2]);
+        extflash_close();
+        return NULL;
+    }
+
+    dev.name = id[0] == MANF_WINBOND ? "w25x" : "mx25r";
+    dev.size = 1UL << id[2];
+    dev.pageSize = EXTFLASH_PAGE_SIZE;
+    dev.blockSize = EXTFLASH_BLOCK_SIZE;
+    dev.read = extflash_read;
+    dev.program = extflash_program;
+    dev.erase = extflash_erase;
+    TRACE1("extflash: %d KB", (int32_t)(dev.size >> 10));
+    return &dev;
+}
+
+// Deep power-down, about 1 uA instead of the 10-25 uA standby current
+void extflash_sleep(void) {
+
+    if (spi != NULL && !asleep) {
+        extflash_command(CMD_POWER_DOWN, -1, NULL, NULL, 0);
+        asleep = true;
+    }
+}
+
+void extflash_close(void) {
+
+    if (spi == NULL) {
+        return;
+    }
+    extflash_sleep();
+    SPI_close(spi);
+    PIN_close(hCsPin);
+    spi = NULL;
+}
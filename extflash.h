@@ -0,0 +1,27 @@
+/*
+ * extflash.h
+ *
+ *  SensorTag external SPI flash (W25X40CL or MX25R8035F, found by JEDEC ID)
+ *  on SPI0 with a GPIO chip select. Transfers longer than a few bytes go
+ *  through the SPICC26XXDMA uDMA channels, so a 256 byte page program is one
+ *  DMA transfer. The chip is kept in deep power-down between accesses and
+ *  woken by the first command after extflash_sleep().
+ */
+
+#ifndef EXTFLASH_H_
+#define EXTFLASH_H_
+
+#include <stdbool.h>
+
+#include "flashdev.h"
+
+#define EXTFLASH_PAGE_SIZE      256
+#define EXTFLASH_BLOCK_SIZE     4096        // 4 KB sector erase
+#define EXTFLASH_BITRATE        4000000
+
+// Returns NULL when the chip does not answer with a known ID
+const FlashDev *extflash_open(void);
+void extflash_sleep(void);
+void extflash_close(void);
+
+#endif /* EXTFLASH_H_ */
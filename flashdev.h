@@ -0,0 +1,28 @@
+/*
+ * flashdev.h
+ *
+ *  NOR flash device interface used by the log store. NOR rules apply to every
+ *  implementation: erase sets a whole block to 0xFF, program can only clear
+ *  bits and must not cross a page boundary.
+ *
+ *  extflash.c drives the SensorTag's SPI flash, flashram.c is a RAM model of
+ *  the same rules that also builds on a host.
+ */
+
+#ifndef FLASHDEV_H_
+#define FLASHDEV_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+    const char *name;
+    uint32_t size;          // bytes
+    uint16_t pageSize;      // program unit
+    uint16_t blockSize;     // erase unit
+    bool (*read)(uint32_t addr, void *buf, uint32_t len);
+    bool (*program)(uint32_t addr, const void *buf, uint32_t len);
+    bool (*erase)(uint32_t addr);
+} FlashDev;
+
+#endif /* FLASHDEV_H_ */
@@ -0,0 +1,107 @@
+/*
+ * flashram.c
+ *
+ *  RAM model of a NOR flash, see flashram.h.
+ */
+
+#include <string.h>
+
+#include "flashram.h"
+
+#define FLASHRAM_NO_FAIL    0xFFFFFFFF
+
+static uint8_t *ram;
+static uint32_t failAfter = FLASHRAM_NO_FAIL;
+static FlashRamStats stats;
+static FlashDev dev;
+
+static bool flashram_read(uint32_t addr, void *buf, uint32_t len) {
+
+    if (addr + len > dev.size) {
+        return false;
+    }
+    memcpy(buf, &ram[addr], len);
+    stats.reads++;
+    stats.readBytes += len;
+    return true;
+}
+
+static bool flashram_program(uint32_t addr, const void *buf, uint32_t len) {
+
+    const uint8_t *src = buf;
+    uint32_t i;
+
+    if (addr + len > dev.size) {
+        return false;
+    }
+    if ((addr % dev.pageSize) + len > dev.pageSize) {
+        stats.violations++;
+        return false;
+    }
+    if (len > failAfter) {
+        len = failAfter;
+    }
+    for (i = 0; i < len; i++) {
+        if ((ram[addr + i] & src[i]) != src[i]) {
+            stats.violations++;
+        }
+        ram[addr + i] &= src[i];
+    }
+    stats.programs++;
+    stats.programBytes += len;
+    if (failAfter != FLASHRAM_NO_FAIL) {
+        failAfter = FLASHRAM_NO_FAIL;
+        return false;
+    }
+    return true;
+}
+
+static bool flashram_eraseBlock(uint32_t addr) {
+
+    uint32_t block = addr / dev.blockSize;
+
+    if (addr >= dev.size || addr % dev.blockSize != 0) {
+        return false;
+    }
+    memset(&ram[addr], 0xFF, dev.blockSize);
+    stats.erases++;
+    if (block < FLASHRAM_MAX_BLOCKS) {
+        stats.blockErases[block]++;
+    }
+    return true;
+}
+
+const FlashDev *flashram_open(uint8_t *mem, uint32_t size, uint16_t pageSize, uint16_t blockSize) {
+
+    ram = mem;
+    dev.name = "ram";
+    dev.size = size;
+    dev.pageSize = pageSize;
+    dev.blockSize = blockSize;
+    dev.read = flashram_read;
+    dev.program = flashram_program;
+    dev.erase = flashram_eraseBlock;
+    failAfter = FLASHRAM_NO_FAIL;
+    flashram_resetStats();
+    return &dev;
+}
+
+void flashram_erase(void) {
+
+    memset(ram, 0xFF, dev.size);
+}
+
+void flashram_failAfter(uint32_t len) {
+
+    failAfter = len;
+}
+
+const FlashRamStats *flashram_stats(void) {
+
+    return &stats;
+}
+
+void flashram_resetStats(void) {
+
+    memset(&stats, 0, sizeof(stats));
+}
@@ -0,0 +1,38 @@
+/*
+ * flashram.h
+ *
+ *  RAM model of a NOR flash, see flashdev.h. Programming ANDs into the
+ *  storage like the real array does, so a missed erase shows up as corrupt
+ *  data instead of passing silently. Counts operations and erases per block
+ *  for wear and cost measurements. Plain C, builds on a host as well.
+ */
+
+#ifndef FLASHRAM_H_
+#define FLASHRAM_H_
+
+#include <stdint.h>
+
+#include "flashdev.h"
+
+#define FLASHRAM_MAX_BLOCKS     32      // blocks with their own erase count
+
+typedef struct {
+    uint32_t reads;
+    uint32_t readBytes;
+    uint32_t programs;
+    uint32_t programBytes;
+    uint32_t erases;
+    uint32_t violations;    // program over a page boundary or onto cleared bits
+    uint32_t blockErases[FLASHRAM_MAX_BLOCKS];
+} FlashRamStats;
+
+// mem must hold size bytes, size a multiple of blockSize. Contents are kept,
+// call flashram_erase to start from an erased array.
+const FlashDev *flashram_open(uint8_t *mem, uint32_t size, uint16_t pageSize, uint16_t blockSize);
+void flashram_erase(void);
+// Power-loss model: the next program stops after len bytes
+void flashram_failAfter(uint32_t len);
+const FlashRamStats *flashram_stats(void);
+void flashram_resetStats(void);
+
+#endif /* FLASHRAM_H_ */
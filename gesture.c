@@ -0,0 +1,115 @@
+/*
+ * gesture.c
+ *
+ *  Threshold and decision tree gesture classifiers, see gesture.h.
+ */
+
+#include "gesture.h"
+#include "gesture_model.h"
+
+void gesture_reset(GestureWindow *w) {
+
+    imufeat_init(&w->window, GESTURE_AXES, GESTURE_WINDOW_LOG2);
+    w->state = GESTURE_NONE;
+    w->candidate = GESTURE_NONE;
+    w->run = 0;
+}
+
+void gesture_push(GestureWindow *w, const int32_t *sample) {
+
+    imufeat_push(&w->window, sample);
+}
+
+// One feature of a full window, only the ones the tree walks through are
+// computed
+static int32_t gesture_feature(const ImuFeatures *f, int index) {
+
+    int a = index / GESTURE_AXIS_FEATURES;
+
+    switch (index % GESTURE_AXIS_FEATURES) {
+        case GESTURE_MEAN:
+            return imufeat_mean(f, a);
+        case GESTURE_MIN:
+            return imufeat_min(f, a);
+        case GESTURE_MAX:
+            return imufeat_max(f, a);
+        case GESTURE_LAST:
+            return imufeat_last(f, a);
+        case GESTURE_PEAK_TO_PEAK:
+            return imufeat_peakToPeak(f, a);
+        case GESTURE_VARIANCE:
+            return (int32_t)imufeat_variance(f, a);
+        case GESTURE_CROSSINGS:
+            return imufeat_crossings(f, a);
+        default:
+            return (int32_t)imufeat_jerk(f, a);
+    }
+}
+
+// The window has to be full
+void gesture_features(const GestureWindow *w, int32_t *features) {
+
+    int i;
+
+    for (i = 0; i < GESTURE_FEATURES; i++) {
+        features[i] = gesture_feature(&w->window, i);
+    }
+}
+
+enum gestureClass gesture_classify(const GestureWindow *w) {
+
+    const GestureNode *node = &gestureModel[0];
+    int depth;
+
+    if (!imufeat_full(&w->window)) {
+        return GESTURE_NONE;
+    }
+    // Bounded in case of a broken table
+    for (depth = 0; depth < GESTURE_MODEL_NODES && node->feature >= 0; depth++) {
+        int32_t x = gesture_feature(&w->window, node->feature);
+        node = &gestureModel[x <= node->threshold ? node->left : node->right];
+    }
+    return node->feature < 0 ? (enum gestureClass)node->left : GESTURE_NONE;
+}
+
+// Pushes a sample and returns the class the state changed to, GESTURE_NONE
+// if it did not change or changed back to rest
+enum gestureClass gesture_update(GestureWindow *w, const int32_t *sample) {
+
+    enum gestureClass c;
+
+    gesture_push(w, sample);
+    c = gesture_classify(w);
+    if (c == w->state) {
+        w->run = 0;
+        return GESTURE_NONE;
+    }
+    if (c != w->candidate) {
+        w->candidate = c;
+        w->run = 0;
+    }
+    if (++w->run < GESTURE_HOLD) {
+        return GESTURE_NONE;
+    }
+    w->state = c;
+    w->run = 0;
+    return c;
+}
+
+enum gestureClass gesture_threshold(const int32_t *sample, int32_t thresholdMg, int32_t thresholdZMg) {
+
+    int32_t ax = sample[0], ay = sample[1], az = sample[2];
+
+    if (ax > thresholdMg && ay < thresholdMg && az < GESTURE_DOT_AZ_MG) {
+        return GESTURE_DOT;
+    }
+    if (az > thresholdZMg && ax < thresholdMg) {
+        return GESTURE_DASH;
+    }
+    return GESTURE_NONE;
+}
+
+uint8_t gesture_modelNodes(void) {
+
+    return GESTURE_MODEL_NODES;
+}
@@ -0,0 +1,84 @@
+/*
+ * gesture.h
+ *
+ *  Morse gesture classifiers on IMU samples in mg and cdps, the units the
+ *  sensor log and the IMU stream use.
+ *
+ *  gesture_threshold() is the original rule on a single sample: '.' is the
+ *  tag tilted onto its x side, '-' an upward flick on z. The caller latches
+ *  it until the axis falls back under the threshold.
+ *
+ *  gesture_update() runs a decision tree trained offline by
+ *  tools/gesture_train.py on labelled recordings and compiled into
+ *  gesture_model.h. The tree looks at the last GESTURE_WINDOW samples
+ *  through GESTURE_FEATURES integer features, eight per axis from the
+ *  running window of imufeat.h. A node compares one feature with a
+ *  threshold, x <= threshold goes left. A class has to win GESTURE_HOLD
+ *  windows in a row before it replaces the current one, and a change to
+ *  '.' or '-' is a symbol. All integer, so the script reproduces every
+ *  decision exactly.
+ *
+ *  The window is counted in samples and the model is trained at 100 Hz,
+ *  the rate ratectl.h switches to on the first moving sample.
+ *  Plain C, builds on a host.
+ */
+
+#ifndef GESTURE_H_
+#define GESTURE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "imufeat.h"
+
+#define GESTURE_AXES            6
+#define GESTURE_WINDOW_LOG2     4
+#define GESTURE_WINDOW          (1 << GESTURE_WINDOW_LOG2)     // 160 ms at 100 Hz
+#define GESTURE_AXIS_FEATURES   8
+#define GESTURE_FEATURES        (GESTURE_AXIS_FEATURES * GESTURE_AXES)
+#define GESTURE_HOLD            2
+#define GESTURE_DOT_AZ_MG       1100        // threshold rule, '.' only below this
+
+enum gestureClass {
+    GESTURE_NONE = 0,
+    GESTURE_DOT,
+    GESTURE_DASH,
+    GESTURE_CLASSES
+};
+
+// Feature f of axis a is at index GESTURE_AXIS_FEATURES * a + f
+enum gestureFeature {
+    GESTURE_MEAN = 0,
+    GESTURE_MIN,
+    GESTURE_MAX,
+    GESTURE_LAST,
+    GESTURE_PEAK_TO_PEAK,
+    GESTURE_VARIANCE,
+    GESTURE_CROSSINGS,
+    GESTURE_JERK
+};
+
+// feature < 0 is a leaf of class left
+typedef struct {
+    int8_t feature;
+    uint8_t left;
+    uint8_t right;
+    int32_t threshold;
+} GestureNode;
+
+typedef struct {
+    ImuFeatures window;
+    uint8_t state;          // enum gestureClass
+    uint8_t candidate;
+    uint8_t run;            // windows the candidate has won
+} GestureWindow;
+
+void gesture_reset(GestureWindow *w);
+void gesture_push(GestureWindow *w, const int32_t *sample);
+void gesture_features(const GestureWindow *w, int32_t *features);
+enum gestureClass gesture_classify(const GestureWindow *w);
+enum gestureClass gesture_update(GestureWindow *w, const int32_t *sample);
+enum gestureClass gesture_threshold(const int32_t *sample, int32_t thresholdMg, int32_t thresholdZMg);
+uint8_t gesture_modelNodes(void);
+
+#endif /* GESTURE_H_ */
@@ -0,0 +1,49 @@
+/*
+ * gesture_model.h
+ *
+ *  Generated by tools/gesture_train.py, do not edit.
+ *  Trained on 40 synthetic recordings (seed 1), depth 5.
+ *  Held out: windows 98.1 % correct (threshold rule 92.5 %),
+ *  symbol errors 4.6 % of 240 (threshold rule 10.4 %).
+ */
+
+#ifndef GESTURE_MODEL_H_
+#define GESTURE_MODEL_H_
+
+#include "gesture.h"
+
+#define GESTURE_MODEL_NODES 29
+
+static const GestureNode gestureModel[GESTURE_MODEL_NODES] = {
+    { 3, 1, 18, 513 },         // 0: ax last <= 513
+    { 18, 2, 13, 1030 },       // 1: az max <= 1030
+    { 1, 3, 8, 435 },          // 2: ax min <= 435
+    { 19, 4, 5, 1020 },        // 3: az last <= 1020
+    { -1, 0, 0, 0 },           // 4: none
+    { 16, 6, 7, 1000 },        // 5: az mean <= 1000
+    { -1, 2, 0, 0 },           // 6: dash
+    { -1, 0, 0, 0 },           // 7: none
+    { 20, 9, 12, 460 },        // 8: az p2p <= 460
+    { 34, 10, 11, -1644 },     // 9: gy max <= -1644
+    { -1, 0, 0, 0 },           // 10: none
+    { -1, 1, 0, 0 },           // 11: dot
+    { -1, 0, 0, 0 },           // 12: none
+    { 16, 14, 15, 958 },       // 13: az mean <= 958
+    { -1, 0, 0, 0 },           // 14: none
+    { 20, 16, 17, 47 },        // 15: az p2p <= 47
+    { -1, 0, 0, 0 },           // 16: none
+    { -1, 2, 0, 0 },           // 17: dash
+    { 17, 19, 22, 799 },       // 18: az min <= 799
+    { 34, 20, 21, -1988 },     // 19: gy max <= -1988
+    { -1, 0, 0, 0 },           // 20: none
+    { -1, 1, 0, 0 },           // 21: dot
+    { 32, 23, 28, 18322 },     // 22: gy mean <= 18322
+    { 37, 24, 25, 128526818 }, // 23: gy var <= 128526818
+    { -1, 0, 0, 0 },           // 24: none
+    { 5, 26, 27, 43855 },      // 25: ax var <= 43855
+    { -1, 0, 0, 0 },           // 26: none
+    { -1, 1, 0, 0 },           // 27: dot
+    { -1, 1, 0, 0 }            // 28: dot
+};
+
+#endif /* GESTURE_MODEL_H_ */
@@ -0,0 +1,318 @@
+/*
+ * imucomp.c
+ *
+ *  Delta / zig-zag / varint or Rice sample compression, see imucomp.h.
+ */
+
+#include <string.h>
+
+#include "imucomp.h"
+
+#define IMUCOMP_DEFAULT_K   3
+#define IMUCOMP_SUM_LIMIT   0xFFFF
+
+typedef struct {
+    uint16_t pos;
+    uint8_t bits;
+    uint32_t acc;
+    bool overflow;
+} BitWriterState;
+
+static uint32_t imucomp_zigzag(int32_t v) {
+
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t imucomp_unzigzag(uint32_t u) {
+
+    return (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+}
+
+// Appends the low n bits of value, n <= 24
+static void imucomp_put(ImuEncoder *enc, uint32_t value, uint8_t n) {
+
+    enc->acc = (enc->acc << n) | (value & ((1UL << n) - 1));
+    enc->bits += n;
+    while (enc->bits >= 8) {
+        enc->bits -= 8;
+        if (enc->pos < IMUCOMP_BLOCK_SIZE) {
+            enc->block[enc->pos++] = (uint8_t)(enc->acc >> enc->bits);
+        } else {
+            enc->overflow = true;
+        }
+    }
+}
+
+static void imucomp_putVarint(ImuEncoder *enc, uint32_t u) {
+
+    while (u >= 0x80) {
+        imucomp_put(enc, (u & 0x7F) | 0x80, 8);
+        u >>= 7;
+    }
+    imucomp_put(enc, u, 8);
+}
+
+static void imucomp_putRice(ImuEncoder *enc, uint32_t u, uint8_t k) {
+
+    uint32_t q = u >> k;
+
+    if (q < IMUCOMP_RICE_ESCAPE) {
+        imucomp_put(enc, ((1UL << q) - 1) << 1, q + 1);
+        if (k > 0) {
+            imucomp_put(enc, u, k);
+        }
+    } else {
+        imucomp_put(enc, 0xFFFF, IMUCOMP_RICE_ESCAPE);
+        imucomp_put(enc, u >> 16, 16);
+        imucomp_put(enc, u, 16);
+    }
+}
+
+static uint32_t imucomp_saturate(uint32_t u) {
+
+    return u < IMUCOMP_SUM_LIMIT ? u : IMUCOMP_SUM_LIMIT;
+}
+
+// Order and Rice parameter for the next block from this block's residuals
+static void imucomp_chooseModes(ImuEncoder *enc) {
+
+    uint16_t n = enc->count > 2 ? enc->count - 2 : 0;
+    int a;
+
+    if (n == 0) {
+        return;
+    }
+    for (a = 0; a < enc->axes; a++) {
+        bool order2 = enc->sum2[a] < enc->sum1[a];
+        uint32_t mean = (order2 ? enc->sum2[a] : enc->sum1[a]) / n;
+        uint8_t k = 0;
+        while (k < IMUCOMP_MAX_K && (2UL << k) <= mean) {
+            k++;
+        }
+        enc->mode[a] = (order2 ? IMUCOMP_ORDER2 : 0) | k;
+    }
+}
+
+static void imucomp_start(ImuEncoder *enc, uint32_t time, uint16_t periodMs, const int32_t *values) {
+
+    int a;
+
+    enc->pos = 0;
+    enc->bits = 0;
+    enc->acc = 0;
+    enc->overflow = false;
+    enc->time = time;
+    enc->periodMs = periodMs;
+    enc->count = 1;
+
+    imucomp_put(enc, IMUCOMP_MAGIC, 8);
+    imucomp_put(enc, (enc->coding << 4) | enc->axes, 8);
+    imucomp_put(enc, 0, 16);                // sample count, set when closing
+    imucomp_put(enc, time & 0xFF, 8);
+    imucomp_put(enc, (time >> 8) & 0xFF, 8);
+    imucomp_put(enc, (time >> 16) & 0xFF, 8);
+    imucomp_put(enc, time >> 24, 8);
+    imucomp_put(enc, periodMs & 0xFF, 8);
+    imucomp_put(enc, periodMs >> 8, 8);
+    for (a = 0; a < enc->axes; a++) {
+        imucomp_put(enc, enc->mode[a], 8);
+    }
+    for (a = 0; a < enc->axes; a++) {
+        imucomp_putVarint(enc, imucomp_zigzag(values[a]));
+        enc->prev[a] = values[a];
+        enc->delta[a] = 0;
+        enc->sum1[a] = 0;
+        enc->sum2[a] = 0;
+    }
+}
+
+void imucomp_init(ImuEncoder *enc, uint8_t axes, enum imucompCoding coding, ImuBlockFxn blockFxn, void *arg) {
+
+    int a;
+
+    memset(enc, 0, sizeof(*enc));
+    enc->axes = axes <= IMUCOMP_MAX_AXES ? axes : IMUCOMP_MAX_AXES;
+    enc->coding = coding;
+    enc->blockFxn = blockFxn;
+    enc->arg = arg;
+    for (a = 0; a < IMUCOMP_MAX_AXES; a++) {
+        enc->mode[a] = IMUCOMP_DEFAULT_K;
+    }
+}
+
+// Closes the open block and hands it to the block function
+void imucomp_flush(ImuEncoder *enc) {
+
+    if (enc->count == 0) {
+        return;
+    }
+    if (enc->bits > 0) {
+        imucomp_put(enc, 0, 8 - enc->bits);
+    }
+    enc->block[2] = (uint8_t)enc->count;
+    enc->block[3] = (uint8_t)(enc->count >> 8);
+    enc->stats.blocks++;
+    enc->stats.bytesOut += enc->pos;
+    imucomp_chooseModes(enc);
+    enc->count = 0;
+    if (enc->blockFxn != NULL) {
+        enc->blockFxn(enc->block, enc->pos, enc->time, enc->arg);
+    }
+}
+
+void imucomp_push(ImuEncoder *enc, uint32_t time, uint16_t periodMs, const int32_t *values) {
+
+    BitWriterState saved;
+    int32_t d1[IMUCOMP_MAX_AXES];
+    int32_t late;
+    int a;
+
+    enc->stats.samples++;
+    enc->stats.bytesIn += enc->axes * sizeof(int16_t);
+
+    // Sample times are implied by the period, a skipped or late sample
+    // starts a new block
+    if (enc->count > 0) {
+        late = (int32_t)(time - (enc->time + (uint32_t)enc->count * enc->periodMs));
+        if (periodMs != enc->periodMs || late > periodMs / 2 || late < -(int32_t)(periodMs / 2)) {
+            imucomp_flush(enc);
+        }
+    }
+    if (enc->count == 0) {
+        imucomp_start(enc, time, periodMs, values);
+        return;
+    }
+
+    saved.pos = enc->pos;
+    saved.bits = enc->bits;
+    saved.acc = enc->acc;
+    for (a = 0; a < enc->axes; a++) {
+        uint32_t u;
+        d1[a] = values[a] - enc->prev[a];
+        if ((enc->mode[a] & IMUCOMP_ORDER2) && enc->count >= 2) {
+            u = imucomp_zigzag(d1[a] - enc->delta[a]);
+        } else {
+            u = imucomp_zigzag(d1[a]);
+        }
+        if (enc->coding == IMUCOMP_RICE) {
+            imucomp_putRice(enc, u, enc->mode[a] & 0x1F);
+        } else {
+            imucomp_putVarint(enc, u);
+        }
+    }
+
+    // Pending bits need a byte of their own when the block is closed
+    if (enc->overflow || (enc->bits > 0 && enc->pos == IMUCOMP_BLOCK_SIZE)) {
+        enc->pos = saved.pos;
+        enc->bits = saved.bits;
+        enc->acc = saved.acc;
+        enc->overflow = false;
+        imucomp_flush(enc);
+        imucomp_start(enc, time, periodMs, values);
+        return;
+    }
+
+    for (a = 0; a < enc->axes; a++) {
+        if (enc->count >= 2) {
+            enc->sum1[a] += imucomp_saturate(imucomp_zigzag(d1[a]));
+            enc->sum2[a] += imucomp_saturate(imucomp_zigzag(d1[a] - enc->delta[a]));
+        }
+        enc->prev[a] = values[a];
+        enc->delta[a] = d1[a];
+    }
+    enc->count++;
+}
+
+typedef struct {
+    const uint8_t *data;
+    uint16_t length;
+    uint32_t bitPos;
+} BitReader;
+
+static uint32_t imucomp_get(BitReader *r, uint8_t n) {
+
+    uint32_t value = 0;
+
+    while (n--) {
+        uint32_t byte = r->bitPos >> 3;
+        uint32_t bit = byte < r->length ? (r->data[byte] >> (7 - (r->bitPos & 7))) & 1 : 0;
+        value = (value << 1) | bit;
+        r->bitPos++;
+    }
+    return value;
+}
+
+static uint32_t imucomp_getVarint(BitReader *r) {
+
+    uint32_t u = 0;
+    uint8_t shift = 0;
+    uint32_t byte;
+
+    do {
+        byte = imucomp_get(r, 8);
+        u |= (byte & 0x7F) << shift;
+        shift += 7;
+    } while ((byte & 0x80) && shift < 35);
+    return u;
+}
+
+static uint32_t imucomp_getRice(BitReader *r, uint8_t k) {
+
+    uint32_t q = 0;
+
+    while (q < IMUCOMP_RICE_ESCAPE && imucomp_get(r, 1)) {
+        q++;
+    }
+    if (q == IMUCOMP_RICE_ESCAPE) {
+        uint32_t high = imucomp_get(r, 16);
+        return (high << 16) | imucomp_get(r, 16);
+    }
+    return (q << k) | imucomp_get(r, k);
+}
+
+// Decodes a block into values[sample * axes + axis]. Returns the number of
+// samples, or -1 for a malformed block or too small a buffer.
+int imucomp_decode(const uint8_t *block, uint16_t length, int32_t *values, int maxSamples) {
+
+    BitReader r = { block, length, 0 };
+    int32_t prev[IMUCOMP_MAX_AXES], delta[IMUCOMP_MAX_AXES];
+    const uint8_t *mode = &block[10];
+    uint8_t axes, coding;
+    uint16_t count;
+    int a, i;
+
+    if (length < IMUCOMP_HEADER_SIZE(0) || block[0] != IMUCOMP_MAGIC) {
+        return -1;
+    }
+    coding = block[1] >> 4;
+    axes = block[1] & 0x0F;
+    count = block[2] | (block[3] << 8);
+    if (axes == 0 || axes > IMUCOMP_MAX_AXES || length < IMUCOMP_HEADER_SIZE(axes) || count > maxSamples) {
+        return -1;
+    }
+
+    r.bitPos = IMUCOMP_HEADER_SIZE(axes) * 8;
+    for (a = 0; a < axes; a++) {
+        prev[a] = imucomp_unzigzag(imucomp_getVarint(&r));
+        delta[a] = 0;
+        values[a] = prev[a];
+    }
+    for (i = 1; i < count; i++) {
+        for (a = 0; a < axes; a++) {
+            uint32_t u = coding == IMUCOMP_RICE ? imucomp_getRice(&r, mode[a] & 0x1F)
+                                                : imucomp_getVarint(&r);
+            int32_t d = imucomp_unzigzag(u);
+            if ((mode[a] & IMUCOMP_ORDER2) && i >= 2) {
+                delta[a] += d;
+            } else {
+                delta[a] = d;
+            }
+            prev[a] += delta[a];
+            values[i * axes + a] = prev[a];
+        }
+    }
+    if ((r.bitPos + 7) / 8 > length) {
+        return -1;
+    }
+    return count;
+}
@@ -0,0 +1,85 @@
+/*
+ * imucomp.h
+ *
+ *  Streaming compressor for multi-axis sensor samples. Every axis is coded as
+ *  the first or second order difference of its samples, zig-zag mapped and
+ *  then written either as a varint or Rice coded. The order and Rice
+ *  parameter of an axis are picked per block from the residuals of the
+ *  previous block, so the encoder needs no look-ahead.
+ *
+ *  Blocks are self-contained for random access and never longer than
+ *  IMUCOMP_BLOCK_SIZE, which fits one log store record:
+ *
+ *      0       magic 0xD7
+ *      1       coding << 4 | axes
+ *      2..3    samples (little endian)
+ *      4..7    time of the first sample, ms
+ *      8..9    sample period, ms
+ *      10..    one mode byte per axis: bit 7 second order, bits 0-4 Rice k
+ *      ..      first sample, zig-zag varint per axis
+ *      ..      residuals of the other samples, axis by axis, MSB first
+ *
+ *  Rice codes are q ones, a zero and k bits; q of IMUCOMP_RICE_ESCAPE ones is
+ *  followed by the 32-bit value. A block ends when the next sample would not
+ *  fit or the period or timing changes. Decoder in tools/imucomp_decode.py.
+ *
+ *  RAM is the ImuEncoder, cycles per sample are linear in the axis count.
+ *  Plain C, builds on a host.
+ */
+
+#ifndef IMUCOMP_H_
+#define IMUCOMP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define IMUCOMP_MAGIC           0xD7
+#define IMUCOMP_MAX_AXES        6
+#define IMUCOMP_BLOCK_SIZE      224
+#define IMUCOMP_HEADER_SIZE(axes)   (10 + (axes))
+#define IMUCOMP_RICE_ESCAPE     16
+#define IMUCOMP_MAX_K           20
+#define IMUCOMP_ORDER2          0x80
+
+enum imucompCoding {
+    IMUCOMP_VARINT = 0,
+    IMUCOMP_RICE
+};
+
+// Called with every finished block, the buffer is reused afterwards
+typedef void (*ImuBlockFxn)(const uint8_t *block, uint16_t length, uint32_t time, void *arg);
+
+typedef struct {
+    uint32_t samples;
+    uint32_t blocks;
+    uint32_t bytesIn;       // as 16-bit axes
+    uint32_t bytesOut;
+} ImuCompStats;
+
+typedef struct {
+    uint8_t axes;
+    enum imucompCoding coding;
+    ImuBlockFxn blockFxn;
+    void *arg;
+    uint16_t count;         // samples in the open block, 0 if none
+    uint16_t periodMs;
+    uint32_t time;          // first sample of the block
+    uint16_t pos;           // bit writer
+    uint8_t bits;
+    uint32_t acc;
+    bool overflow;
+    uint8_t mode[IMUCOMP_MAX_AXES];
+    int32_t prev[IMUCOMP_MAX_AXES];
+    int32_t delta[IMUCOMP_MAX_AXES];
+    uint32_t sum1[IMUCOMP_MAX_AXES];    // residuals of the open block, first order
+    uint32_t sum2[IMUCOMP_MAX_AXES];    // and second order
+    uint8_t block[IMUCOMP_BLOCK_SIZE];
+    ImuCompStats stats;
+} ImuEncoder;
+
+void imucomp_init(ImuEncoder *enc, uint8_t axes, enum imucompCoding coding, ImuBlockFxn blockFxn, void *arg);
+void imucomp_push(ImuEncoder *enc, uint32_t time, uint16_t periodMs, const int32_t *values);
+void imucomp_flush(ImuEncoder *enc);
+int imucomp_decode(const uint8_t *block, uint16_t length, int32_t *values, int maxSamples);
+
+#endif /* IMUCOMP_H_ */
@@ -0,0 +1,154 @@
+/*
+ * imufeat.c
+ *
+ *  Sliding-window features with running sums, see imufeat.h.
+ */
+
+#include "imufeat.h"
+
+#define IMUFEAT_MASK(f)     ((1u << (f)->windowLog2) - 1)
+
+bool imufeat_init(ImuFeatures *f, uint8_t axes, uint8_t windowLog2) {
+
+    if (axes == 0 || axes > IMUFEAT_MAX_AXES || windowLog2 == 0 ||
+        (1u << windowLog2) > IMUFEAT_MAX_WINDOW) {
+        return false;
+    }
+    f->axes = axes;
+    f->windowLog2 = windowLog2;
+    imufeat_reset(f);
+    return true;
+}
+
+void imufeat_reset(ImuFeatures *f) {
+
+    int a;
+
+    for (a = 0; a < f->axes; a++) {
+        f->sum[a] = 0;
+        f->sumSquares[a] = 0;
+        f->jerkSum[a] = 0;
+        f->crossings[a] = 0;
+        f->minHead[a] = f->minCount[a] = 0;
+        f->maxHead[a] = f->maxCount[a] = 0;
+    }
+    f->next = 0;
+    f->count = 0;
+}
+
+static uint32_t imufeat_absDiff(int32_t a, int32_t b) {
+
+    return a > b ? (uint32_t)(a - b) : (uint32_t)(b - a);
+}
+
+void imufeat_push(ImuFeatures *f, const int32_t *sample) {
+
+    uint8_t mask = IMUFEAT_MASK(f);
+    uint8_t p = f->next;
+    bool full = f->count > mask;
+    int a;
+
+    for (a = 0; a < f->axes; a++) {
+        int32_t *ring = f->ring[a];
+        uint8_t *minQueue = f->minQueue[a];
+        uint8_t *maxQueue = f->maxQueue[a];
+        int32_t x = sample[a];
+
+        if (full) {
+            // Drop the oldest sample and its difference to the one after it
+            int32_t old = ring[p];
+            int32_t after = ring[(p + 1) & mask];
+            f->sum[a] -= old;
+            f->sumSquares[a] -= (int64_t)old * old;
+            f->jerkSum[a] -= imufeat_absDiff(after, old);
+            f->crossings[a] -= (old < 0) != (after < 0);
+            if (f->minCount[a] && minQueue[f->minHead[a]] == p) {
+                f->minHead[a] = (f->minHead[a] + 1) & mask;
+                f->minCount[a]--;
+            }
+            if (f->maxCount[a] && maxQueue[f->maxHead[a]] == p) {
+                f->maxHead[a] = (f->maxHead[a] + 1) & mask;
+                f->maxCount[a]--;
+            }
+        }
+        if (f->count) {
+            int32_t prev = ring[(p - 1) & mask];
+            f->jerkSum[a] += imufeat_absDiff(x, prev);
+            f->crossings[a] += (prev < 0) != (x < 0);
+        }
+        f->sum[a] += x;
+        f->sumSquares[a] += (int64_t)x * x;
+
+        // The queues keep the positions whose value can still become the
+        // minimum or maximum, oldest first
+        while (f->minCount[a] && ring[minQueue[(f->minHead[a] + f->minCount[a] - 1) & mask]] >= x) {
+            f->minCount[a]--;
+        }
+        minQueue[(f->minHead[a] + f->minCount[a]++) & mask] = p;
+        while (f->maxCount[a] && ring[maxQueue[(f->maxHead[a] + f->maxCount[a] - 1) & mask]] <= x) {
+            f->maxCount[a]--;
+        }
+        maxQueue[(f->maxHead[a] + f->maxCount[a]++) & mask] = p;
+        ring[p] = x;
+    }
+    f->next = (p + 1) & mask;
+    if (!full) {
+        f->count++;
+    }
+}
+
+bool imufeat_full(const ImuFeatures *f) {
+
+    return f->count > IMUFEAT_MASK(f);
+}
+
+int32_t imufeat_last(const ImuFeatures *f, int axis) {
+
+    return f->ring[axis][(f->next - 1) & IMUFEAT_MASK(f)];
+}
+
+int32_t imufeat_mean(const ImuFeatures *f, int axis) {
+
+    return f->sum[axis] >> f->windowLog2;
+}
+
+uint32_t imufeat_variance(const ImuFeatures *f, int axis) {
+
+    int64_t sum = f->sum[axis];
+    int64_t scaled = (f->sumSquares[axis] << f->windowLog2) - sum * sum;
+    int64_t variance = scaled >> (2 * f->windowLog2);
+
+    return variance > INT32_MAX ? INT32_MAX : (uint32_t)variance;
+}
+
+uint32_t imufeat_energy(const ImuFeatures *f, int axis) {
+
+    int64_t energy = f->sumSquares[axis] >> f->windowLog2;
+
+    return energy > UINT32_MAX ? UINT32_MAX : (uint32_t)energy;
+}
+
+int32_t imufeat_min(const ImuFeatures *f, int axis) {
+
+    return f->ring[axis][f->minQueue[axis][f->minHead[axis]]];
+}
+
+int32_t imufeat_max(const ImuFeatures *f, int axis) {
+
+    return f->ring[axis][f->maxQueue[axis][f->maxHead[axis]]];
+}
+
+int32_t imufeat_peakToPeak(const ImuFeatures *f, int axis) {
+
+    return imufeat_max(f, axis) - imufeat_min(f, axis);
+}
+
+uint16_t imufeat_crossings(const ImuFeatures *f, int axis) {
+
+    return f->crossings[axis];
+}
+
+uint32_t imufeat_jerk(const ImuFeatures *f, int axis) {
+
+    return f->jerkSum[axis] / ((1u << f->windowLog2) - 1);
+}
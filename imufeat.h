@@ -0,0 +1,69 @@
+/*
+ * imufeat.h
+ *
+ *  Streaming features over a sliding window of multi-axis samples, for the
+ *  IMU in mg and cdps. Each push updates running integer sums, so the cost
+ *  per sample does not depend on the window length:
+ *
+ *      mean            sum >> windowLog2, rounded towards minus infinity
+ *      variance        (n * sum of squares - sum^2) / n^2, in units^2
+ *      energy          mean square, in units^2
+ *      min, max        monotonic queues, amortised O(1)
+ *      peak to peak    max - min
+ *      zero crossings  sign changes between neighbouring samples
+ *      jerk            mean absolute difference of the 2^windowLog2 - 1
+ *                      neighbouring pairs, units per sample period
+ *
+ *  The window holds 2^windowLog2 samples, up to IMUFEAT_MAX_WINDOW. The
+ *  state is laid out per axis (structure of arrays) so an axis' samples and
+ *  queues are contiguous. Features are valid once the window is full.
+ *  Energy saturates at UINT32_MAX, variance at INT32_MAX so it can be
+ *  compared with signed thresholds.
+ *
+ *  Plain C, builds on a host.
+ */
+
+#ifndef IMUFEAT_H_
+#define IMUFEAT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define IMUFEAT_MAX_AXES    6
+#ifndef IMUFEAT_MAX_WINDOW
+#define IMUFEAT_MAX_WINDOW  16      // power of two, at most 128
+#endif
+
+typedef struct {
+    int32_t ring[IMUFEAT_MAX_AXES][IMUFEAT_MAX_WINDOW];
+    uint8_t minQueue[IMUFEAT_MAX_AXES][IMUFEAT_MAX_WINDOW];  // ring positions
+    uint8_t maxQueue[IMUFEAT_MAX_AXES][IMUFEAT_MAX_WINDOW];
+    int64_t sumSquares[IMUFEAT_MAX_AXES];
+    int32_t sum[IMUFEAT_MAX_AXES];
+    uint32_t jerkSum[IMUFEAT_MAX_AXES];
+    uint16_t crossings[IMUFEAT_MAX_AXES];
+    uint8_t minHead[IMUFEAT_MAX_AXES];
+    uint8_t minCount[IMUFEAT_MAX_AXES];
+    uint8_t maxHead[IMUFEAT_MAX_AXES];
+    uint8_t maxCount[IMUFEAT_MAX_AXES];
+    uint8_t axes;
+    uint8_t windowLog2;
+    uint8_t next;           // ring position of the next sample
+    uint8_t count;
+} ImuFeatures;
+
+bool imufeat_init(ImuFeatures *f, uint8_t axes, uint8_t windowLog2);
+void imufeat_reset(ImuFeatures *f);
+void imufeat_push(ImuFeatures *f, const int32_t *sample);
+bool imufeat_full(const ImuFeatures *f);
+int32_t imufeat_last(const ImuFeatures *f, int axis);
+int32_t imufeat_mean(const ImuFeatures *f, int axis);
+uint32_t imufeat_variance(const ImuFeatures *f, int axis);
+uint32_t imufeat_energy(const ImuFeatures *f, int axis);
+int32_t imufeat_min(const ImuFeatures *f, int axis);
+int32_t imufeat_max(const ImuFeatures *f, int axis);
+int32_t imufeat_peakToPeak(const ImuFeatures *f, int axis);
+uint16_t imufeat_crossings(const ImuFeatures *f, int axis);
+uint32_t imufeat_jerk(const ImuFeatures *f, int axis);
+
+#endif /* IMUFEAT_H_ */
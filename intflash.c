@@ -0,0 +1,93 @@
+/*
+ * intflash.c
+ *
+ *  Internal flash sectors as a FlashDev, see intflash.h.
+ */
+
+#include <string.h>
+
+#include <xdc/std.h>
+#include <ti/sysbios/hal/Hwi.h>
+#include <driverlib/flash.h>
+#include <driverlib/vims.h>
+
+#include "intflash.h"
+
+// Reserved in CC2650STK.cmd
+extern uint8_t configFlashBase[];
+extern uint8_t configFlashSize[];
+
+static FlashDev dev;
+
+static bool intflash_read(uint32_t addr, void *buf, uint32_t len) {
+
+    if (addr + len > dev.size) {
+        return false;
+    }
+    memcpy(buf, configFlashBase + addr, len);
+    return true;
+}
+
+// The cache must not serve stale lines of the sector being changed. With
+// CACHE_AS_RAM the VIMS is in GPRAM mode and has no flash lines to drop.
+static uint32_t intflash_cacheOff(void) {
+
+    uint32_t mode = VIMSModeGet(VIMS_BASE);
+
+    if (mode == VIMS_MODE_ENABLED) {
+        VIMSModeSet(VIMS_BASE, VIMS_MODE_DISABLED);
+        while (VIMSModeGet(VIMS_BASE) != VIMS_MODE_DISABLED);
+    }
+    return mode;
+}
+
+static void intflash_cacheRestore(uint32_t mode) {
+
+    if (mode == VIMS_MODE_ENABLED) {
+        VIMSModeSet(VIMS_BASE, VIMS_MODE_ENABLED);
+    }
+}
+
+static bool intflash_program(uint32_t addr, const void *buf, uint32_t len) {
+
+    uint32_t status, mode;
+    UInt key;
+
+    if (addr + len > dev.size) {
+        return false;
+    }
+    key = Hwi_disable();
+    mode = intflash_cacheOff();
+    status = FlashProgram((uint8_t *)buf, (uint32_t)(uintptr_t)configFlashBase + addr, len);
+    intflash_cacheRestore(mode);
+    Hwi_restore(key);
+    return status == FAPI_STATUS_SUCCESS;
+}
+
+static bool intflash_erase(uint32_t addr) {
+
+    uint32_t status, mode;
+    UInt key;
+
+    if (addr >= dev.size || addr % INTFLASH_SECTOR_SIZE != 0) {
+        return false;
+    }
+    key = Hwi_disable();
+    mode = intflash_cacheOff();
+    status = FlashSectorErase((uint32_t)(uintptr_t)configFlashBase + addr);
+    intflash_cacheRestore(mode);
+    Hwi_restore(key);
+    return status == FAPI_STATUS_SUCCESS;
+}
+
+const FlashDev *intflash_open(void) {
+
+    dev.name = "internal";
+    dev.size = (uint32_t)(uintptr_t)configFlashSize;
+    dev.pageSize = INTFLASH_SECTOR_SIZE;    // any length can be programmed
+    dev.blockSize = INTFLASH_SECTOR_SIZE;
+    dev.read = intflash_read;
+    dev.program = intflash_program;
+    dev.erase = intflash_erase;
+    return &dev;
+}
@@ -0,0 +1,21 @@
+/*
+ * intflash.h
+ *
+ *  The CC2650's own flash as a FlashDev (see flashdev.h), limited to the
+ *  sectors the linker file reserves for it (configFlashBase, configFlashSize
+ *  in CC2650STK.cmd). Reads are plain memory reads and work before
+ *  BIOS_start. Program and erase run the ROM flash API with interrupts
+ *  disabled, the CPU cannot fetch from flash meanwhile: a sector erase
+ *  blocks interrupts for about 10 ms, so use it for rare writes only.
+ */
+
+#ifndef INTFLASH_H_
+#define INTFLASH_H_
+
+#include "flashdev.h"
+
+#define INTFLASH_SECTOR_SIZE    4096
+
+const FlashDev *intflash_open(void);
+
+#endif /* INTFLASH_H_ */
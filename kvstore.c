@@ -0,0 +1,230 @@
+/*
+ * kvstore.c
+ *
+ *  Two-bank key-value store on a NOR flash, see kvstore.h.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "kvstore.h"
+#include "crc16.h"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint16_t crc;
+    uint8_t reserved[KVSTORE_HEADER_SIZE - 10];
+} KvBankHeader;
+
+static uint16_t kvstore_recordCrc(const KvRecord *record) {
+
+    uint16_t crc = crc16(CRC16_INIT, &record->key, 2);
+    return crc16(crc, &record->value, sizeof(record->value));
+}
+
+static bool kvstore_readHeader(const KvStore *kv, int bank, uint32_t *seq) {
+
+    KvBankHeader header;
+
+    if (!kv->dev->read(kv->bank[bank], &header, sizeof(header)) ||
+        header.magic != KVSTORE_MAGIC ||
+        header.crc != crc16(CRC16_INIT, &header, offsetof(KvBankHeader, crc))) {
+        return false;
+    }
+    *seq = header.seq;
+    return true;
+}
+
+static bool kvstore_writeRecord(KvStore *kv, uint8_t key, enum kvType type, uint32_t value) {
+
+    KvRecord record;
+
+    record.key = key;
+    record.type = type;
+    record.value = value;
+    record.crc = kvstore_recordCrc(&record);
+
+    // The slot is used up even if programming fails, it is not clean anymore
+    kv->writeOffset += KVSTORE_RECORD_SIZE;
+    if (!kv->dev->program(kv->bank[kv->active] + kv->writeOffset - KVSTORE_RECORD_SIZE,
+                          &record, KVSTORE_RECORD_SIZE)) {
+        kv->stats.failures++;
+        return false;
+    }
+    kv->stats.writes++;
+    return true;
+}
+
+// Copies the live values into the other bank and switches to it. The header
+// is the commit point.
+static bool kvstore_compact(KvStore *kv) {
+
+    KvBankHeader header;
+    int8_t previous = kv->active;
+    uint32_t previousOffset = kv->writeOffset;
+    uint8_t key;
+
+    kv->active = previous < 0 ? 0 : 1 - previous;
+    kv->writeOffset = KVSTORE_HEADER_SIZE;
+    kv->stats.compactions++;
+    if (!kv->dev->erase(kv->bank[kv->active])) {
+        kv->stats.failures++;
+        kv->active = previous;
+        kv->writeOffset = previousOffset;
+        return false;
+    }
+    for (key = 0; key < KVSTORE_MAX_KEYS; key++) {
+        if ((kv->present & (1UL << key)) &&
+            !kvstore_writeRecord(kv, key, (enum kvType)kv->type[key], kv->value[key])) {
+            kv->active = previous;
+            kv->writeOffset = previousOffset;
+            return false;
+        }
+    }
+
+    memset(&header, 0xFF, sizeof(header));
+    header.magic = KVSTORE_MAGIC;
+    header.seq = kv->seq + 1;
+    header.crc = crc16(CRC16_INIT, &header, offsetof(KvBankHeader, crc));
+    if (!kv->dev->program(kv->bank[kv->active], &header, sizeof(header))) {
+        kv->stats.failures++;
+        kv->active = previous;
+        kv->writeOffset = previousOffset;
+        return false;
+    }
+    kv->seq = header.seq;
+    return true;
+}
+
+bool kvstore_open(KvStore *kv, const FlashDev *dev, uint16_t firstBlock) {
+
+    uint32_t seq[2];
+    bool valid[2];
+    KvRecord record;
+    int b;
+
+    memset(kv, 0, sizeof(*kv));
+    if ((uint32_t)(firstBlock + 2) * dev->blockSize > dev->size) {
+        return false;
+    }
+    kv->dev = dev;
+    kv->active = -1;
+    for (b = 0; b < 2; b++) {
+        kv->bank[b] = (uint32_t)(firstBlock + b) * dev->blockSize;
+        valid[b] = kvstore_readHeader(kv, b, &seq[b]);
+    }
+    if (valid[0] && (!valid[1] || (int32_t)(seq[0] - seq[1]) > 0)) {
+        kv->active = 0;
+    } else if (valid[1]) {
+        kv->active = 1;
+    } else {
+        return true;
+    }
+    kv->seq = seq[kv->active];
+
+    // Later records override earlier ones, stop at the first blank slot
+    for (kv->writeOffset = KVSTORE_HEADER_SIZE;
+         kv->writeOffset + KVSTORE_RECORD_SIZE <= dev->blockSize;
+         kv->writeOffset += KVSTORE_RECORD_SIZE) {
+        if (!dev->read(kv->bank[kv->active] + kv->writeOffset, &record, sizeof(record))) {
+            return false;
+        }
+        if (record.key == 0xFF && record.type == 0xFF && record.crc == 0xFFFF &&
+            record.value == 0xFFFFFFFF) {
+            break;
+        }
+        if (record.key >= KVSTORE_MAX_KEYS || record.crc != kvstore_recordCrc(&record)) {
+            kv->stats.skipped++;
+            continue;
+        }
+        if (record.type == KVSTORE_DELETED) {
+            kv->present &= ~(1UL << record.key);
+        } else {
+            kv->present |= 1UL << record.key;
+            kv->type[record.key] = record.type;
+            kv->value[record.key] = record.value;
+        }
+    }
+    return true;
+}
+
+// False if the key has no stored value of this type
+bool kvstore_get(const KvStore *kv, uint8_t key, enum kvType type, uint32_t *value) {
+
+    if (key >= KVSTORE_MAX_KEYS || !(kv->present & (1UL << key)) || kv->type[key] != type) {
+        return false;
+    }
+    *value = kv->value[key];
+    return true;
+}
+
+static bool kvstore_append(KvStore *kv, uint8_t key, enum kvType type, uint32_t value) {
+
+    if (kv->active < 0 || kv->writeOffset + KVSTORE_RECORD_SIZE > kv->dev->blockSize) {
+        // The copy already holds the new value
+        return kvstore_compact(kv);
+    }
+    return kvstore_writeRecord(kv, key, type, value);
+}
+
+bool kvstore_set(KvStore *kv, uint8_t key, enum kvType type, uint32_t value) {
+
+    uint32_t previousPresent = kv->present;
+    uint8_t previousType;
+    uint32_t previousValue;
+
+    if (key >= KVSTORE_MAX_KEYS || type == KVSTORE_DELETED) {
+        return false;
+    }
+    if ((kv->present & (1UL << key)) && kv->type[key] == type && kv->value[key] == value) {
+        return true;
+    }
+    previousType = kv->type[key];
+    previousValue = kv->value[key];
+    kv->present |= 1UL << key;
+    kv->type[key] = type;
+    kv->value[key] = value;
+    if (!kvstore_append(kv, key, type, value)) {
+        kv->present = previousPresent;
+        kv->type[key] = previousType;
+        kv->value[key] = previousValue;
+        return false;
+    }
+    return true;
+}
+
+bool kvstore_remove(KvStore *kv, uint8_t key) {
+
+    if (key >= KVSTORE_MAX_KEYS) {
+        return false;
+    }
+    if (!(kv->present & (1UL << key))) {
+        return true;
+    }
+    kv->present &= ~(1UL << key);
+    if (!kvstore_append(kv, key, KVSTORE_DELETED, 0)) {
+        kv->present |= 1UL << key;
+        return false;
+    }
+    return true;
+}
+
+// Drops every key with a single compaction
+bool kvstore_clear(KvStore *kv) {
+
+    uint32_t previousPresent = kv->present;
+
+    kv->present = 0;
+    if (!kvstore_compact(kv)) {
+        kv->present = previousPresent;
+        return false;
+    }
+    return true;
+}
+
+// Bytes of the active bank in use
+uint32_t kvstore_used(const KvStore *kv) {
+
+    return kv->active < 0 ? 0 : kv->writeOffset;
+}
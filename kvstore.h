@@ -0,0 +1,70 @@
+/*
+ * kvstore.h
+ *
+ *  Small key-value store on two erase blocks of a NOR flash (see
+ *  flashdev.h). Each key holds one typed 32-bit value. Writes append an
+ *  8 byte record with its own CRC to the active bank; the newest record of
+ *  a key wins. When the bank is full the live values are copied to the
+ *  other bank and its header, with the next sequence number, is programmed
+ *  last. A bank without a valid header is ignored, so a power loss during
+ *  the copy leaves the old bank in use and a torn record is skipped.
+ *
+ *  kvstore_open scans the active bank once into a RAM table, after which
+ *  every read is O(1) and touches no flash. Plain C, builds on a host.
+ */
+
+#ifndef KVSTORE_H_
+#define KVSTORE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "flashdev.h"
+
+#define KVSTORE_MAX_KEYS        32
+#define KVSTORE_MAGIC           0x3130564B      // "KV01"
+#define KVSTORE_HEADER_SIZE     16
+#define KVSTORE_RECORD_SIZE     8
+
+// Record types, KVSTORE_DELETED removes the key
+enum kvType {
+    KVSTORE_DELETED = 0,
+    KVSTORE_U32,
+    KVSTORE_I32,
+    KVSTORE_FLOAT
+};
+
+typedef struct {
+    uint8_t key;
+    uint8_t type;
+    uint16_t crc;
+    uint32_t value;
+} KvRecord;
+
+typedef struct {
+    uint32_t writes;
+    uint32_t compactions;
+    uint32_t skipped;       // corrupt records found by kvstore_open
+    uint32_t failures;      // program or erase errors
+} KvStats;
+
+typedef struct {
+    const FlashDev *dev;
+    uint32_t bank[2];       // flash address of each bank
+    int8_t active;          // -1 until the first write
+    uint32_t seq;           // sequence number of the active bank
+    uint32_t writeOffset;   // next free record in the active bank
+    uint32_t present;       // bit per key with a stored value
+    uint8_t type[KVSTORE_MAX_KEYS];
+    uint32_t value[KVSTORE_MAX_KEYS];
+    KvStats stats;
+} KvStore;
+
+bool kvstore_open(KvStore *kv, const FlashDev *dev, uint16_t firstBlock);
+bool kvstore_get(const KvStore *kv, uint8_t key, enum kvType type, uint32_t *value);
+bool kvstore_set(KvStore *kv, uint8_t key, enum kvType type, uint32_t value);
+bool kvstore_remove(KvStore *kv, uint8_t key);
+bool kvstore_clear(KvStore *kv);
+uint32_t kvstore_used(const KvStore *kv);
+
+#endif /* KVSTORE_H_ */
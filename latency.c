@@ -0,0 +1,86 @@
+/*
+ * latency.c
+ *
+ *  Log2-bucketed latency histograms for the gesture -> UART pipeline.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <xdc/std.h>
+#include <ti/sysbios/hal/Hwi.h>
+
+#include "latency.h"
+#include "report.h"
+
+static LatencyHistogram histograms[LATENCY_STAGECOUNT];
+
+static const char *stageNames[LATENCY_STAGECOUNT] = {
+    "decide", "enqueue", "tx", "total", "rx", "wake"
+};
+
+static uint8_t latency_bucket(uint32_t us) {
+
+    uint8_t bucket = 0;
+
+    while (us != 0 && bucket < LATENCY_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void latency_record(enum latencyStage stage, uint32_t us) {
+
+    LatencyHistogram *h = &histograms[stage];
+    UInt key = Hwi_disable();
+
+    h->count++;
+    if (us > h->max) {
+        h->max = us;
+    }
+    h->buckets[latency_bucket(us)]++;
+    Hwi_restore(key);
+}
+
+void latency_record_symbol(const Symbol *symbol, uint32_t tTx) {
+
+    latency_record(LATENCY_DECIDE, symbol->tDecision - symbol->tSample);
+    latency_record(LATENCY_ENQUEUE, symbol->tEnqueue - symbol->tDecision);
+    latency_record(LATENCY_TX, tTx - symbol->tEnqueue);
+    latency_record(LATENCY_TOTAL, tTx - symbol->tSample);
+}
+
+const LatencyHistogram *latency_get(enum latencyStage stage) {
+
+    return &histograms[stage];
+}
+
+void latency_reset(void) {
+
+    UInt key = Hwi_disable();
+    memset(histograms, 0, sizeof(histograms));
+    Hwi_restore(key);
+}
+
+// Export format, one line per stage:
+//   lat <stage> n=<count> max=<us> <bucket0> <bucket1> ... <bucketN-1>
+void latency_report(UART_Handle uart) {
+
+    char line[48];
+    int stage, i;
+
+    for (stage = 0; stage < LATENCY_STAGECOUNT; stage++) {
+        LatencyHistogram h;
+        UInt key = Hwi_disable();
+        h = histograms[stage];
+        Hwi_restore(key);
+
+        report_printf(uart, line, sizeof(line), "lat %s n=%lu max=%lu", stageNames[stage],
+                      (unsigned long)h.count, (unsigned long)h.max);
+        for (i = 0; i < LATENCY_BUCKETS; i++) {
+            report_printf(uart, line, sizeof(line), " %lu", (unsigned long)h.buckets[i]);
+        }
+        UART_write(uart, "\r\n", 2);
+    }
+}
@@ -0,0 +1,40 @@
+/*
+ * latency.h
+ *
+ *  Log2-bucketed latency histograms for the gesture -> UART pipeline.
+ *  Bucket 0 holds 0 us, bucket n holds [2^(n-1), 2^n) us.
+ */
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stdint.h>
+#include <ti/drivers/UART.h>
+
+#include "symbol.h"
+
+#define LATENCY_BUCKETS     24   // last bucket collects everything >= 4.2 s
+
+enum latencyStage {
+    LATENCY_DECIDE = 0,   // sample acquired -> gesture decided
+    LATENCY_ENQUEUE,      // gesture decided -> symbol queued
+    LATENCY_TX,           // symbol queued -> UART write completed
+    LATENCY_TOTAL,        // sample acquired -> UART write completed
+    LATENCY_RX,           // UART read callback -> byte handled in the UART task
+    LATENCY_WAKE,         // MPU9250 motion interrupt -> full configuration restored
+    LATENCY_STAGECOUNT
+};
+
+typedef struct {
+    uint32_t count;
+    uint32_t max;
+    uint32_t buckets[LATENCY_BUCKETS];
+} LatencyHistogram;
+
+void latency_record(enum latencyStage stage, uint32_t us);
+void latency_record_symbol(const Symbol *symbol, uint32_t tTx);
+const LatencyHistogram *latency_get(enum latencyStage stage);
+void latency_reset(void);
+void latency_report(UART_Handle uart);
+
+#endif /* LATENCY_H_ */
@@ -0,0 +1,339 @@
+/*
+ * logstore.c
+ *
+ *  Append-only sensor log on a NOR flash, see logstore.h.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "logstore.h"
+#include "crc16.h"
+
+#define BLANK_MAGIC     0xFFFF
+
+static uint32_t logstore_size(const LogStore *ls) {
+
+    return (uint32_t)ls->blockCount * ls->dev->blockSize;
+}
+
+static uint32_t logstore_advance(const LogStore *ls, uint32_t offset) {
+
+    offset += LOGSTORE_PAGE_SIZE;
+    return offset < logstore_size(ls) ? offset : 0;
+}
+
+static uint16_t logstore_crc(const LogPageHeader *header, const uint8_t *payload) {
+
+    uint16_t crc = crc16(CRC16_INIT, header, offsetof(LogPageHeader, crc));
+    return crc16(crc, payload, header->length);
+}
+
+// 1 for a plausible header, 0 for an unwritten one, -1 otherwise
+static int logstore_readHeader(const LogStore *ls, uint32_t offset, LogPageHeader *header) {
+
+    if (!ls->dev->read(ls->base + offset, header, LOGSTORE_HEADER_SIZE)) {
+        return -1;
+    }
+    if (header->magic == BLANK_MAGIC) {
+        return 0;
+    }
+    if (header->magic != LOGSTORE_MAGIC || header->length > LOGSTORE_PAYLOAD_SIZE) {
+        return -1;
+    }
+    return 1;
+}
+
+static bool logstore_readPayload(const LogStore *ls, uint32_t offset, const LogPageHeader *header, uint8_t *payload) {
+
+    if (!ls->dev->read(ls->base + offset + LOGSTORE_HEADER_SIZE, payload, header->length)) {
+        return false;
+    }
+    return logstore_crc(header, payload) == header->crc;
+}
+
+// A program cut short can leave the header blank and later bytes written
+static bool logstore_isBlank(LogStore *ls, uint32_t offset) {
+
+    int i;
+
+    if (!ls->dev->read(ls->base + offset, ls->page, LOGSTORE_PAGE_SIZE)) {
+        return false;
+    }
+    for (i = 0; i < LOGSTORE_PAGE_SIZE; i++) {
+        if (ls->page[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool logstore_readPage(LogStore *ls, uint32_t offset, LogPageHeader *header) {
+
+    return logstore_readHeader(ls, offset, header) == 1 &&
+           logstore_readPayload(ls, offset, header, ls->page);
+}
+
+// Rebuilds the block index and finds the head: the newest block is the one
+// whose first page has the highest sequence number, the head is the first
+// blank page after its last good page.
+bool logstore_open(LogStore *ls, const FlashDev *dev, uint16_t firstBlock, uint16_t blockCount) {
+
+    LogPageHeader header;
+    int32_t newest = -1;
+    uint32_t offset;
+    int b, p;
+
+    memset(ls, 0, sizeof(*ls));
+    if (blockCount < 2 || blockCount > LOGSTORE_MAX_BLOCKS ||
+        dev->pageSize % LOGSTORE_PAGE_SIZE != 0 || dev->blockSize % dev->pageSize != 0 ||
+        (uint32_t)(firstBlock + blockCount) * dev->blockSize > dev->size) {
+        return false;
+    }
+    ls->dev = dev;
+    ls->base = (uint32_t)firstBlock * dev->blockSize;
+    ls->blockCount = blockCount;
+    ls->pagesPerBlock = dev->blockSize / LOGSTORE_PAGE_SIZE;
+
+    for (b = 0; b < blockCount; b++) {
+        ls->blockTime[b] = LOGSTORE_NO_TIME;
+        if (logstore_readPage(ls, (uint32_t)b * dev->blockSize, &header)) {
+            ls->blockTime[b] = header.tFirst;
+            if (newest < 0 || (int32_t)(header.seq - ls->seq) >= 0) {
+                newest = b;
+                ls->seq = header.seq + 1;
+                ls->lastTime = header.tLast;
+            }
+        }
+    }
+    if (newest < 0) {
+        return true;
+    }
+
+    offset = (uint32_t)newest * dev->blockSize;
+    ls->head = logstore_advance(ls, offset + dev->blockSize - LOGSTORE_PAGE_SIZE);
+    for (p = 1; p < ls->pagesPerBlock; p++) {
+        offset += LOGSTORE_PAGE_SIZE;
+        if (logstore_readPage(ls, offset, &header) && (int32_t)(header.seq - ls->seq) >= 0) {
+            ls->seq = header.seq + 1;
+            ls->lastTime = header.tLast;
+        } else if (header.magic == BLANK_MAGIC && logstore_isBlank(ls, offset)) {
+            ls->head = offset;
+            break;
+        } else {
+            // Torn by a power loss, left as is until the block is erased
+            ls->stats.torn++;
+        }
+    }
+    return true;
+}
+
+bool logstore_append(LogStore *ls, uint32_t time, const void *data, uint8_t len) {
+
+    uint8_t *record;
+
+    if (len > LOGSTORE_MAX_RECORD) {
+        ls->stats.dropped++;
+        return false;
+    }
+    if ((uint32_t)ls->fill + LOGSTORE_RECORD_HEADER + len > LOGSTORE_PAYLOAD_SIZE) {
+        logstore_flush(ls);
+    }
+
+    record = &ls->page[LOGSTORE_HEADER_SIZE + ls->fill];
+    record[0] = len;
+    record[1] = (uint8_t)time;
+    record[2] = (uint8_t)(time >> 8);
+    record[3] = (uint8_t)(time >> 16);
+    record[4] = (uint8_t)(time >> 24);
+    memcpy(&record[LOGSTORE_RECORD_HEADER], data, len);
+
+    if (ls->pending.records == 0) {
+        ls->pending.tFirst = time;
+    }
+    ls->pending.tLast = time;
+    ls->pending.records++;
+    ls->fill += LOGSTORE_RECORD_HEADER + len;
+    return true;
+}
+
+// Programs the RAM page, erasing the block first when the head enters it.
+// The page is consumed even if erasing or programming fails, which returns
+// false.
+bool logstore_flush(LogStore *ls) {
+
+    LogPageHeader *header = &ls->pending;
+    uint16_t block = ls->head / ls->dev->blockSize;
+    bool blockStart = ls->head % ls->dev->blockSize == 0;
+    bool programmed;
+
+    if (ls->fill == 0) {
+        return true;
+    }
+
+    if (blockStart) {
+        ls->blockTime[block] = LOGSTORE_NO_TIME;
+        ls->stats.erases++;
+        if (!ls->dev->erase(ls->base + ls->head)) {
+            // Leave the block alone for this lap
+            ls->stats.failures++;
+            ls->stats.dropped += header->records;
+            ls->head = logstore_advance(ls, ls->head + ls->dev->blockSize - LOGSTORE_PAGE_SIZE);
+            ls->fill = 0;
+            header->records = 0;
+            return false;
+        }
+    }
+
+    header->magic = LOGSTORE_MAGIC;
+    header->length = ls->fill;
+    header->seq = ls->seq++;
+    header->crc = logstore_crc(header, &ls->page[LOGSTORE_HEADER_SIZE]);
+    memcpy(ls->page, header, LOGSTORE_HEADER_SIZE);
+
+    ls->stats.pages++;
+    programmed = ls->dev->program(ls->base + ls->head, ls->page, LOGSTORE_HEADER_SIZE + ls->fill);
+    if (!programmed) {
+        ls->stats.failures++;
+        ls->stats.dropped += header->records;
+    } else {
+        if (blockStart) {
+            ls->blockTime[block] = header->tFirst;
+        }
+        ls->lastTime = header->tLast;
+    }
+    ls->head = logstore_advance(ls, ls->head);
+    ls->fill = 0;
+    header->records = 0;
+    return programmed;
+}
+
+uint32_t logstore_lastTime(const LogStore *ls) {
+
+    return ls->lastTime;
+}
+
+// The block the head erases next holds the oldest pages
+static uint16_t logstore_oldestBlock(const LogStore *ls) {
+
+    uint16_t block = ls->head / ls->dev->blockSize;
+
+    if (ls->head % ls->dev->blockSize == 0) {
+        return block;
+    }
+    return block + 1 < ls->blockCount ? block + 1 : 0;
+}
+
+uint32_t logstore_firstTime(const LogStore *ls) {
+
+    uint16_t b = logstore_oldestBlock(ls);
+    int i;
+
+    for (i = 0; i < ls->blockCount; i++) {
+        if (ls->blockTime[b] != LOGSTORE_NO_TIME) {
+            return ls->blockTime[b];
+        }
+        b = b + 1 < ls->blockCount ? b + 1 : 0;
+    }
+    return LOGSTORE_NO_TIME;
+}
+
+// Positions the cursor at the start of the newest block that begins before
+// time, or at the oldest block. A block that begins at time can follow
+// records with the same time at the end of the one before. Uses only the
+// RAM index.
+bool logstore_seek(const LogStore *ls, LogCursor *cursor, uint32_t time) {
+
+    uint16_t b = logstore_oldestBlock(ls);
+    int32_t start = -1;
+    uint32_t distance;
+    int i;
+
+    for (i = 0; i < ls->blockCount; i++) {
+        uint32_t t = ls->blockTime[b];
+        if (t != LOGSTORE_NO_TIME) {
+            if (start >= 0 && t >= time) {
+                break;
+            }
+            start = b;
+        }
+        b = b + 1 < ls->blockCount ? b + 1 : 0;
+    }
+    if (start < 0) {
+        return false;
+    }
+
+    cursor->offset = (uint32_t)start * ls->dev->blockSize;
+    distance = (ls->head + logstore_size(ls) - cursor->offset) % logstore_size(ls);
+    if (distance == 0) {
+        distance = logstore_size(ls);
+    }
+    cursor->pages = distance / LOGSTORE_PAGE_SIZE;
+    return true;
+}
+
+// Reads the page under the cursor and moves on. With payload NULL only the
+// header is read and not checked against the CRC. Returns 1 for a page, 0
+// at the head and -1 for a page that is blank or corrupt.
+int logstore_nextPage(const LogStore *ls, LogCursor *cursor, LogPageHeader *header, uint8_t *payload) {
+
+    uint32_t offset = cursor->offset;
+
+    if (cursor->pages == 0) {
+        return 0;
+    }
+    cursor->offset = logstore_advance(ls, offset);
+    cursor->pages--;
+
+    if (logstore_readHeader(ls, offset, header) != 1) {
+        return -1;
+    }
+    if (payload != NULL && !logstore_readPayload(ls, offset, header, payload)) {
+        return -1;
+    }
+    return 1;
+}
+
+// Calls fxn for every stored record with t0 <= time <= t1, returns the
+// number of records. Records still in the RAM page are not included.
+int32_t logstore_readRange(const LogStore *ls, uint32_t t0, uint32_t t1, LogRecordFxn fxn, void *arg) {
+
+    LogCursor cursor;
+    LogPageHeader header;
+    uint8_t payload[LOGSTORE_PAYLOAD_SIZE];
+    int32_t count = 0;
+
+    if (t0 > t1 || !logstore_seek(ls, &cursor, t0)) {
+        return 0;
+    }
+    while (cursor.pages > 0) {
+        uint32_t offset = cursor.offset;
+        uint16_t p = 0;
+
+        // Header first, the payload is only read for pages in the range
+        if (logstore_nextPage(ls, &cursor, &header, NULL) != 1 || header.tLast < t0) {
+            continue;
+        }
+        if (!logstore_readPayload(ls, offset, &header, payload)) {
+            continue;
+        }
+        // Only a checked header ends the range, a torn one reads as 0xFF
+        if (header.tFirst > t1) {
+            break;
+        }
+        while (p + LOGSTORE_RECORD_HEADER <= header.length) {
+            uint8_t len = payload[p];
+            uint32_t time = (uint32_t)payload[p + 1] | ((uint32_t)payload[p + 2] << 8) |
+                            ((uint32_t)payload[p + 3] << 16) | ((uint32_t)payload[p + 4] << 24);
+            if (p + LOGSTORE_RECORD_HEADER + len > header.length || time > t1) {
+                break;
+            }
+            if (time >= t0) {
+                fxn(time, &payload[p + LOGSTORE_RECORD_HEADER], len, arg);
+                count++;
+            }
+            p += LOGSTORE_RECORD_HEADER + len;
+        }
+    }
+    return count;
+}
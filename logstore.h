@@ -0,0 +1,91 @@
+/*
+ * logstore.h
+ *
+ *  Append-only sensor log on a NOR flash (see flashdev.h). Records are packed
+ *  into a RAM page and written one whole page at a time, each page behind a
+ *  header with a sequence number, its time span and a CRC. The log is a ring
+ *  over its erase blocks: the block after the head is erased just before it
+ *  is reused, so every block is erased once per lap and wear is even.
+ *
+ *  Power loss costs at most the unwritten RAM page. logstore_open finds the
+ *  head again by reading the first page header of every block and then the
+ *  pages of the newest block; a torn page fails its CRC and is skipped.
+ *
+ *  Record times must not decrease. A RAM index holds the first time of every
+ *  block, so a time range read starts at the right block without touching
+ *  flash and then reads only the headers of pages before the range.
+ *
+ *  Not thread safe, one task owns a LogStore. Plain C, builds on a host with
+ *  flashram.c.
+ */
+
+#ifndef LOGSTORE_H_
+#define LOGSTORE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "flashdev.h"
+
+#define LOGSTORE_PAGE_SIZE      256     // must divide the device page size
+#define LOGSTORE_MAX_BLOCKS     128     // RAM index size, 4 bytes per block
+#define LOGSTORE_MAGIC          0x4C47
+#define LOGSTORE_NO_TIME        0xFFFFFFFF
+
+typedef struct {
+    uint16_t magic;
+    uint16_t length;        // payload bytes
+    uint32_t seq;           // page sequence number, +1 per page written
+    uint32_t tFirst;        // time of the first record
+    uint32_t tLast;         // time of the last record
+    uint16_t records;
+    uint16_t crc;           // CRC-16 of the header up to here and the payload
+} LogPageHeader;
+
+#define LOGSTORE_HEADER_SIZE    sizeof(LogPageHeader)
+#define LOGSTORE_PAYLOAD_SIZE   (LOGSTORE_PAGE_SIZE - LOGSTORE_HEADER_SIZE)
+#define LOGSTORE_RECORD_HEADER  5       // length byte and 32-bit time
+#define LOGSTORE_MAX_RECORD     (LOGSTORE_PAYLOAD_SIZE - LOGSTORE_RECORD_HEADER)
+
+typedef struct {
+    uint32_t pages;         // pages programmed since open
+    uint32_t erases;
+    uint32_t torn;          // pages skipped on open for a bad CRC
+    uint32_t failures;      // program or erase errors
+    uint32_t dropped;       // records not stored
+} LogStoreStats;
+
+typedef struct {
+    const FlashDev *dev;
+    uint32_t base;          // flash address of the first block
+    uint16_t blockCount;
+    uint16_t pagesPerBlock;
+    uint32_t head;          // offset of the next page to program
+    uint32_t seq;           // sequence number of the next page
+    uint32_t lastTime;      // time of the newest stored record
+    LogPageHeader pending;  // header of the page being filled
+    uint16_t fill;          // payload bytes in page
+    uint8_t page[LOGSTORE_PAGE_SIZE];
+    uint32_t blockTime[LOGSTORE_MAX_BLOCKS];   // first time per block
+    LogStoreStats stats;
+} LogStore;
+
+typedef struct {
+    uint32_t offset;        // next page to read
+    uint32_t pages;         // pages left before the head
+} LogCursor;
+
+// Called for every record of a range read
+typedef void (*LogRecordFxn)(uint32_t time, const uint8_t *data, uint8_t len, void *arg);
+
+bool logstore_open(LogStore *ls, const FlashDev *dev, uint16_t firstBlock, uint16_t blockCount);
+bool logstore_append(LogStore *ls, uint32_t time, const void *data, uint8_t len);
+bool logstore_flush(LogStore *ls);
+uint32_t logstore_lastTime(const LogStore *ls);
+uint32_t logstore_firstTime(const LogStore *ls);
+
+bool logstore_seek(const LogStore *ls, LogCursor *cursor, uint32_t time);
+int logstore_nextPage(const LogStore *ls, LogCursor *cursor, LogPageHeader *header, uint8_t *payload);
+int32_t logstore_readRange(const LogStore *ls, uint32_t t0, uint32_t t1, LogRecordFxn fxn, void *arg);
+
+#endif /* LOGSTORE_H_ */
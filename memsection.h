@@ -0,0 +1,36 @@
+/*
+ * memsection.h
+ *
+ *  Placement of hot code in SRAM and of large buffers in GPRAM.
+ *
+ *  RAMFUNC functions are linked into .TI.ramfunc, copied from flash to SRAM
+ *  at boot and run without flash wait states or cache misses. Their total
+ *  size is checked against RAMFUNC_BUDGET by stackmon. Define NO_RAMFUNC to
+ *  build everything from flash, e.g. to compare timings.
+ *
+ *  Build with CACHE_AS_RAM defined (compiler and linker) to disable the flash
+ *  cache and map GPRAM at 0x11000000, see ccfg.c and CC2650STK.cmd. Without
+ *  it GPRAM_DATA is empty and the buffers stay in SRAM.
+ *
+ *  GPRAM variables are not zero-initialised, only use it for buffers whose
+ *  contents are tracked by indices kept elsewhere.
+ */
+
+#ifndef MEMSECTION_H_
+#define MEMSECTION_H_
+
+#define RAMFUNC_BUDGET  1024   // bytes of SRAM allowed for RAMFUNC code
+
+#ifdef NO_RAMFUNC
+#define RAMFUNC
+#else
+#define RAMFUNC     __attribute__((section(".TI.ramfunc"), noinline))
+#endif
+
+#ifdef CACHE_AS_RAM
+#define GPRAM_DATA  __attribute__((section(".gpram")))
+#else
+#define GPRAM_DATA
+#endif
+
+#endif /* MEMSECTION_H_ */
@@ -0,0 +1,210 @@
+/*
+ * mic.c
+ *
+ *  PDM microphone capture and tone detection, see mic.h.
+ */
+
+#include <stdio.h>
+
+#include <xdc/std.h>
+#include <ti/sysbios/hal/Hwi.h>
+#include <ti/sysbios/knl/Swi.h>
+#include <ti/drivers/pdm/PDMCC26XX.h>
+
+#include "Board.h"
+#include "mic.h"
+#include "cycles.h"
+#include "symbol.h"
+#include "powertrack.h"
+#include "report.h"
+
+#define MIC_BUFFER_BYTES    (sizeof(PDMCC26XX_metaData) + MIC_BLOCK_SAMPLES * sizeof(int16_t))
+#define MIC_POOL_WORDS      ((MIC_BUFFER_BYTES + 3) / 4)
+
+static uint32_t pool[MIC_POOL_BLOCKS][MIC_POOL_WORDS];
+static uint8_t poolUsed;        // bit per block
+
+static PDMCC26XX_Handle pdm = NULL;
+static Swi_Struct micSwiStruct;
+static Swi_Handle micSwi = NULL;
+static volatile bool running = false;
+static ToneDetector detector;
+static MicStats stats;
+
+// PDMCC26XX mallocFxn/freeFxn, called from the driver's interrupts
+static void *mic_alloc(size_t size) {
+
+    UInt key = Hwi_disable();
+    int i;
+
+    if (size <= sizeof(pool[0])) {
+        for (i = 0; i < MIC_POOL_BLOCKS; i++) {
+            if (!(poolUsed & (1 << i))) {
+                poolUsed |= 1 << i;
+                Hwi_restore(key);
+                return pool[i];
+            }
+        }
+    }
+    stats.allocFails++;
+    Hwi_restore(key);
+    return NULL;
+}
+
+static void mic_free(void *ptr, size_t size) {
+
+    UInt key;
+    int i;
+
+    if (ptr == NULL) {
+        return;
+    }
+    i = ((uint32_t *)ptr - pool[0]) / MIC_POOL_WORDS;
+    key = Hwi_disable();
+    if (i >= 0 && i < MIC_POOL_BLOCKS) {
+        poolUsed &= ~(1 << i);
+    }
+    Hwi_restore(key);
+}
+
+// Runs every completed block through the detector. The frame callback runs
+// from here too, its cost is part of the block's cycles.
+static void mic_swiFxn(UArg arg0, UArg arg1) {
+
+    PDMCC26XX_BufferRequest request;
+
+    while (running && PDMCC26XX_requestBuffer(pdm, &request)) {
+        PDMCC26XX_pcmBuffer *buffer = request.buffer;
+        uint32_t start = cycles_now();
+        uint32_t cycles;
+
+        tonedet_process(&detector, (const int16_t *)buffer->pBuffer, MIC_BLOCK_SAMPLES, symbol_now());
+        cycles = cycles_now() - start;
+        mic_free(buffer, MIC_BUFFER_BYTES);
+
+        stats.blocks++;
+        stats.cycles += cycles;
+        if (cycles > stats.maxCycles) {
+            stats.maxCycles = cycles;
+        }
+        if (cycles > MIC_BUDGET_CYCLES) {
+            stats.overBudget++;
+        }
+    }
+}
+
+static void mic_callback(PDMCC26XX_Handle handle, PDMCC26XX_StreamNotification *notification) {
+
+    switch (notification->status) {
+        case PDMCC26XX_STREAM_BLOCK_READY_BUT_PDM_OVERFLOW:
+            stats.overflows++;
+            // fall through
+        case PDMCC26XX_STREAM_BLOCK_READY:
+            Swi_post(micSwi);
+            break;
+        case PDMCC26XX_STREAM_ERROR:
+        case PDMCC26XX_STREAM_FAILED_TO_STOP:
+            stats.errors++;
+            break;
+        default:
+            break;
+    }
+}
+
+// toneHz is checked by tonedet_init, false when it is out of range or the
+// driver could not be started
+bool mic_start(uint16_t toneHz, ToneFrameFxn fxn, void *arg) {
+
+    static bool initialised = false;
+    PDMCC26XX_Params params;
+
+    if (running) {
+        mic_stop();
+    }
+    if (!tonedet_init(&detector, MIC_SAMPLE_RATE, toneHz, fxn, arg)) {
+        return false;
+    }
+    if (!initialised) {
+        Swi_Params swiParams;
+        Swi_Params_init(&swiParams);
+        swiParams.priority = 1;
+        Swi_construct(&micSwiStruct, (Swi_FuncPtr)mic_swiFxn, &swiParams, NULL);
+        micSwi = Swi_handle(&micSwiStruct);
+        PDMCC26XX_init((PDMCC26XX_Handle)&PDMCC26XX_config[Board_PDM]);
+        initialised = true;
+    }
+    cycles_init();
+
+    PDMCC26XX_Params_init(&params);
+    params.callbackFxn = mic_callback;
+    params.useDefaultFilter = true;
+    params.micGain = PDMCC26XX_GAIN_18;
+    params.micPowerActiveHigh = true;
+    params.applyCompression = false;
+    params.startupDelayWithClockInSamples = 512;    // microphone settling, 32 ms
+    params.retBufSizeInBytes = MIC_BUFFER_BYTES;
+    params.mallocFxn = mic_alloc;
+    params.freeFxn = mic_free;
+
+    pdm = PDMCC26XX_open((PDMCC26XX_Handle)&PDMCC26XX_config[Board_PDM], &params);
+    if (pdm == NULL) {
+        return false;
+    }
+    running = true;
+    if (!PDMCC26XX_startStream(pdm)) {
+        running = false;
+        PDMCC26XX_close(pdm);
+        pdm = NULL;
+        return false;
+    }
+    powertrack_setLoad(POWER_OWNER_MIC, MIC_LOAD_UA);
+    return true;
+}
+
+void mic_stop(void) {
+
+    PDMCC26XX_BufferRequest request;
+
+    if (!running) {
+        return;
+    }
+    running = false;
+    PDMCC26XX_stopStream(pdm);
+    while (PDMCC26XX_requestBuffer(pdm, &request)) {
+        mic_free(request.buffer, MIC_BUFFER_BYTES);
+    }
+    PDMCC26XX_close(pdm);
+    pdm = NULL;
+    powertrack_setLoad(POWER_OWNER_MIC, 0);
+}
+
+bool mic_running(void) {
+
+    return running;
+}
+
+// Export format:
+//   mic on=<0|1> tone=<Hz> blocks=<n> ovf=<n> err=<n> alloc=<n>
+//   mic cycles max=<n> avg=<n> budget=<n> over=<n>     per 64-sample block
+//   mic det frames=<n> down=<n> tone=<p> ref=<p> noise=<p>
+void mic_report(UART_Handle uart) {
+
+    char line[104];
+    MicStats s;
+    ToneDetStats d;
+    UInt key = Hwi_disable();
+
+    s = stats;
+    d = detector.stats;
+    Hwi_restore(key);
+
+    report_printf(uart, line, sizeof(line), "mic on=%d tone=%u blocks=%lu ovf=%lu err=%lu alloc=%lu\r\n",
+                  running, detector.toneHz, (unsigned long)s.blocks, (unsigned long)s.overflows,
+                  (unsigned long)s.errors, (unsigned long)s.allocFails);
+    report_printf(uart, line, sizeof(line), "mic cycles max=%lu avg=%lu budget=%u over=%lu\r\n",
+                  (unsigned long)s.maxCycles, (unsigned long)(s.blocks ? s.cycles / s.blocks : 0),
+                  MIC_BUDGET_CYCLES, (unsigned long)s.overBudget);
+    report_printf(uart, line, sizeof(line), "mic det frames=%lu down=%lu tone=%lu ref=%lu noise=%lu\r\n",
+                  (unsigned long)d.frames, (unsigned long)d.downFrames, (unsigned long)d.tone,
+                  (unsigned long)d.reference, (unsigned long)d.noise);
+}
@@ -0,0 +1,46 @@
+/*
+ * mic.h
+ *
+ *  Acoustic Morse input from the SensorTag PDM microphone. The PDMCC26XX
+ *  driver clocks the microphone over I2S with uDMA and decimates the PDM
+ *  bit stream to 16 kHz 16-bit PCM; every MIC_BLOCK_SAMPLES it hands over a
+ *  buffer, which a Swi runs through the tone detector (tonedet.h). The
+ *  detector's key state goes to the frame callback once per 16 ms frame.
+ *
+ *  Return buffers come from a small static pool, not the 1 kB BIOS heap.
+ *  The DWT cycles of every block are measured against MIC_BUDGET_CYCLES;
+ *  the mic report has the maximum, the average and the blocks over budget.
+ *  The microphone and I2S keep the device out of standby while running.
+ */
+
+#ifndef MIC_H_
+#define MIC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ti/drivers/UART.h>
+
+#include "tonedet.h"
+
+#define MIC_SAMPLE_RATE     16000
+#define MIC_BLOCK_SAMPLES   64          // 4 ms
+#define MIC_POOL_BLOCKS     6
+#define MIC_BUDGET_CYCLES   2000        // per block, 1 % of the CPU at 250 blocks/s
+#define MIC_LOAD_UA         700         // microphone + I2S, estimate
+
+typedef struct {
+    uint32_t blocks;
+    uint32_t overflows;     // PDM data lost before a block was ready
+    uint32_t errors;
+    uint32_t allocFails;    // pool empty or request too large
+    uint32_t maxCycles;
+    uint64_t cycles;
+    uint32_t overBudget;
+} MicStats;
+
+bool mic_start(uint16_t toneHz, ToneFrameFxn fxn, void *arg);
+void mic_stop(void);
+bool mic_running(void);
+void mic_report(UART_Handle uart);
+
+#endif /* MIC_H_ */
@@ -0,0 +1,108 @@
+/*
+ * morsekey.c
+ *
+ *  Adaptive Morse timing classifier, see morsekey.h.
+ */
+
+#include "morsekey.h"
+
+void morsekey_init(MorseKey *key, uint32_t dotUs, MorseSymbolFxn fxn, void *arg) {
+
+    key->dotUs = dotUs;
+    key->dashUs = 3 * dotUs;
+    key->down = false;
+    key->started = false;
+    key->gaps = 0;
+    key->edgeUs = 0;
+    key->upUs = 0;
+    key->fxn = fxn;
+    key->arg = arg;
+    key->stats.dots = key->stats.dashes = 0;
+    key->stats.letters = key->stats.words = key->stats.glitches = 0;
+}
+
+static uint32_t morsekey_adapt(uint32_t estimate, uint32_t mark, uint32_t min, uint32_t max) {
+
+    estimate += (int32_t)(mark - estimate) / (1 << MORSEKEY_ADAPT);
+    if (estimate < min) {
+        return min;
+    }
+    if (estimate > max) {
+        return max;
+    }
+    return estimate;
+}
+
+// Letter and word gaps of the pause that started at edgeUs
+static void morsekey_gap(MorseKey *key, uint32_t timeUs) {
+
+    uint32_t pause = timeUs - key->edgeUs;
+
+    if (!key->started) {
+        return;
+    }
+    if (key->gaps == 0 && pause >= 2 * key->dotUs) {
+        key->gaps = 1;
+        key->stats.letters++;
+        key->fxn(' ', timeUs, key->arg);
+    }
+    if (key->gaps == 1 && pause >= 5 * key->dotUs) {
+        key->gaps = 2;
+        key->started = false;
+        key->stats.words++;
+        key->fxn(' ', timeUs, key->arg);
+    }
+}
+
+void morsekey_update(MorseKey *key, bool down, uint32_t timeUs) {
+
+    uint32_t mark;
+
+    if (down == key->down) {
+        if (!down) {
+            morsekey_gap(key, timeUs);
+        }
+        return;
+    }
+
+    key->down = down;
+    if (down) {
+        morsekey_gap(key, timeUs);
+        key->upUs = key->edgeUs;
+        key->edgeUs = timeUs;
+        return;
+    }
+
+    mark = timeUs - key->edgeUs;
+    if (mark < key->dotUs / 2) {
+        // The pause before the glitch carries on
+        key->stats.glitches++;
+        key->edgeUs = key->upUs;
+        return;
+    }
+    key->edgeUs = timeUs;
+    key->gaps = 0;
+    key->started = true;
+    if (mark < (key->dotUs + key->dashUs) / 2) {
+        key->stats.dots++;
+        key->dotUs = morsekey_adapt(key->dotUs, mark, MORSEKEY_MIN_DOT_US, MORSEKEY_MAX_DOT_US);
+        key->fxn('.', timeUs, key->arg);
+    } else {
+        key->stats.dashes++;
+        if (mark < 3 * key->dashUs) {   // a held key says nothing about the speed
+            key->dashUs = morsekey_adapt(key->dashUs, mark, 2 * MORSEKEY_MIN_DOT_US,
+                                         5 * MORSEKEY_MAX_DOT_US);
+        }
+        key->fxn('-', timeUs, key->arg);
+    }
+}
+
+// Drops the mark in progress, the pause before it carries on
+void morsekey_cancel(MorseKey *key) {
+
+    if (key->down) {
+        key->down = false;
+        key->stats.glitches++;
+        key->edgeUs = key->upUs;
+    }
+}
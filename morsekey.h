@@ -0,0 +1,55 @@
+/*
+ * morsekey.h
+ *
+ *  Turns key-down/key-up timing into Morse symbols, for any key input (tone
+ *  detector, light receiver, button). The classifier keeps a running dot
+ *  and dash length; a mark shorter than their midpoint is a dot, longer a
+ *  dash, and pulls that estimate a quarter of the way towards itself, so
+ *  the split follows the sender in either direction. A pause of two dots
+ *  ends the letter and five dots the word, each reported as a ' ' symbol.
+ *  Marks under half a dot are dropped as glitches, and an input that finds a
+ *  mark was not one drops it with morsekey_cancel().
+ *
+ *  Feed every edge to morsekey_update(); gaps are reported on the next edge
+ *  or on any update while the key is up, so a periodic caller gets them
+ *  without waiting for the next mark. Plain C, builds on a host.
+ */
+
+#ifndef MORSEKEY_H_
+#define MORSEKEY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MORSEKEY_MIN_DOT_US     20000       // 60 wpm
+#define MORSEKEY_MAX_DOT_US     400000      // 3 wpm
+#define MORSEKEY_ADAPT          2           // dot estimate moves 1/2^n per mark
+
+typedef void (*MorseSymbolFxn)(char symbol, uint32_t timeUs, void *arg);
+
+typedef struct {
+    uint32_t dots;
+    uint32_t dashes;
+    uint32_t letters;
+    uint32_t words;
+    uint32_t glitches;
+} MorseKeyStats;
+
+typedef struct {
+    uint32_t dotUs;
+    uint32_t dashUs;
+    bool down;
+    bool started;           // a mark has been sent since the last word gap
+    uint8_t gaps;           // gap symbols sent in the current pause
+    uint32_t edgeUs;        // last accepted edge
+    uint32_t upUs;          // start of the pause before the current mark
+    MorseSymbolFxn fxn;
+    void *arg;
+    MorseKeyStats stats;
+} MorseKey;
+
+void morsekey_init(MorseKey *key, uint32_t dotUs, MorseSymbolFxn fxn, void *arg);
+void morsekey_update(MorseKey *key, bool down, uint32_t timeUs);
+void morsekey_cancel(MorseKey *key);
+
+#endif /* MORSEKEY_H_ */
@@ -0,0 +1,79 @@
+/*
+ * optrx.c
+ *
+ *  Baseline tracking and flash detection on light samples, see optrx.h.
+ */
+
+#include "optrx.h"
+
+void optrx_init(OptReceiver *rx, MorseKey *key) {
+
+    rx->baseline = 0;
+    rx->peak = 0;
+    rx->amplitude = 0;
+    rx->primed = false;
+    rx->down = false;
+    rx->downUs = 0;
+    rx->key = key;
+    rx->stats.samples = rx->stats.marks = rx->stats.rebases = 0;
+    rx->stats.peak = 0;
+}
+
+// Level the next sample has to cross to change the key state
+int32_t optrx_threshold(const OptReceiver *rx) {
+
+    int32_t delta = rx->baseline / OPTRX_ON_DIV + OPTRX_MIN_DELTA;
+
+    if (rx->down) {
+        return rx->baseline + (rx->peak - rx->baseline) / 2;
+    }
+    if (rx->amplitude / 2 > delta) {
+        delta = rx->amplitude / 2;
+    }
+    return rx->baseline + delta;
+}
+
+void optrx_sample(OptReceiver *rx, int32_t centilux, uint32_t timeUs) {
+
+    int32_t threshold = optrx_threshold(rx);
+
+    rx->stats.samples++;
+    if (!rx->primed) {
+        rx->baseline = centilux;
+        rx->primed = true;
+        return;
+    }
+
+    if (!rx->down) {
+        if (centilux >= threshold) {
+            rx->down = true;
+            rx->downUs = timeUs;
+            rx->peak = centilux;
+            morsekey_update(rx->key, true, timeUs);
+            return;
+        }
+        if (centilux > rx->baseline) {
+            rx->baseline += (centilux - rx->baseline) / (1 << OPTRX_RISE_FILTER);
+        } else {
+            rx->baseline -= (rx->baseline - centilux) / (1 << OPTRX_FALL_FILTER);
+        }
+        morsekey_update(rx->key, false, timeUs);
+        return;
+    }
+
+    if (centilux > rx->peak) {
+        rx->peak = centilux;
+    }
+    if (centilux < threshold) {
+        rx->down = false;
+        rx->stats.marks++;
+        rx->stats.peak = rx->peak;
+        rx->amplitude += (rx->peak - rx->baseline - rx->amplitude) / (1 << OPTRX_AMPLITUDE_FILTER);
+        morsekey_update(rx->key, false, timeUs);
+    } else if (timeUs - rx->downUs >= OPTRX_STUCK_US) {
+        rx->down = false;
+        rx->baseline = centilux;
+        rx->stats.rebases++;
+        morsekey_cancel(rx->key);
+    }
+}
@@ -0,0 +1,60 @@
+/*
+ * optrx.h
+ *
+ *  Optical Morse receiver on the OPT3001 light sensor. Each conversion
+ *  result is compared with a background-light baseline. The key goes down
+ *  when the light rises above the baseline by half the usual flash
+ *  amplitude. That is at least 1/OPTRX_ON_DIV of the baseline plus
+ *  OPTRX_MIN_DELTA, which is also the rule before the first flash. The key
+ *  goes up again when the light falls below halfway between the baseline
+ *  and the brightest sample of the flash. The edges go to a MorseKey
+ *  (morsekey.h).
+ *
+ *  The baseline follows the light only while the key is up: slowly when it
+ *  rises, quickly when it falls. A mark longer than OPTRX_STUCK_US is taken
+ *  as a change of the background, not a flash. The mark is cancelled and
+ *  the level becomes the new baseline.
+ *
+ *  At the fastest conversion time, 100 ms, edges are only known to a
+ *  sample, so the sender's dot has to be at least two samples long, three
+ *  for faint flashes; see tools/optrx_bench.c. Plain C, builds on a host.
+ */
+
+#ifndef OPTRX_H_
+#define OPTRX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "morsekey.h"
+
+#define OPTRX_ON_DIV            128         // rise of 1/128 of the baseline
+#define OPTRX_MIN_DELTA         100         // plus 1 lux, in 0.01 lux
+#define OPTRX_RISE_FILTER       2           // baseline EWMA weight 1/2^n upwards
+#define OPTRX_FALL_FILTER       1           // and downwards
+#define OPTRX_AMPLITUDE_FILTER  2           // flash amplitude EWMA weight 1/2^n
+#define OPTRX_STUCK_US          4000000
+
+typedef struct {
+    uint32_t samples;
+    uint32_t marks;
+    uint32_t rebases;       // marks cancelled as background changes
+    int32_t peak;           // brightest sample of the last mark
+} OptRxStats;
+
+typedef struct {
+    int32_t baseline;       // 0.01 lux
+    int32_t peak;
+    int32_t amplitude;      // filtered peak - baseline of the flashes
+    bool primed;            // baseline holds a sample
+    bool down;
+    uint32_t downUs;
+    MorseKey *key;
+    OptRxStats stats;
+} OptReceiver;
+
+void optrx_init(OptReceiver *rx, MorseKey *key);
+void optrx_sample(OptReceiver *rx, int32_t centilux, uint32_t timeUs);
+int32_t optrx_threshold(const OptReceiver *rx);
+
+#endif /* OPTRX_H_ */
@@ -0,0 +1,218 @@
+/*
+ * powertrack.c
+ *
+ *  Power-state residency and charge estimate, see powertrack.h.
+ */
+
+#include <stdio.h>
+
+#include <xdc/std.h>
+#include <ti/sysbios/hal/Hwi.h>
+#include <ti/sysbios/knl/Clock.h>
+#include <ti/drivers/Power.h>
+#include <ti/drivers/power/PowerCC26XX.h>
+
+#include "powertrack.h"
+#include "wakeup.h"
+#include "report.h"
+
+static Power_NotifyObj standbyNotify;
+
+static uint32_t lastTicks;
+static uint64_t wrapTicks;          // 2^32 per Clock tick wrap
+static uint64_t startTicks;
+static uint64_t idleTicks;          // inside the policy, standby included
+static uint64_t standbyTicks;
+static uint32_t standbyStart;
+static uint32_t wakes;
+static uint64_t blockedTicks[POWERTRACK_CONSTRAINTS];   // idle with the constraint set
+static PowerOwnerStats owners[POWER_OWNER_COUNT];
+
+static const char *ownerNames[POWER_OWNER_COUNT] = { "buzzer", "sensors", "cache", "uart", "mic" };
+
+static const char *constraintNames[POWERTRACK_CONSTRAINTS] = {
+    [PowerCC26XX_SB_VIMS_CACHE_RETAIN] = "cache",
+    [PowerCC26XX_SD_DISALLOW] = "sd",
+    [PowerCC26XX_SB_DISALLOW] = "sb",
+    [PowerCC26XX_IDLE_PD_DISALLOW] = "idlepd",
+    [PowerCC26XX_NEED_FLASH_IN_IDLE] = "flash"
+};
+
+static int powertrack_notifyFxn(unsigned int eventType, uintptr_t eventArg, uintptr_t clientArg) {
+
+    uint32_t now = Clock_getTicks();
+
+    if (eventType == PowerCC26XX_ENTERING_STANDBY) {
+        standbyStart = now;
+    } else {
+        standbyTicks += now - standbyStart;
+        wakes++;
+    }
+    return Power_NOTIFYDONE;
+}
+
+// Clock ticks since boot. The policy calls it on every idle entry, so the
+// wrap of Clock_getTicks is never missed.
+uint64_t powertrack_now(void) {
+
+    uint32_t now;
+    uint64_t ticks;
+    UInt key = Hwi_disable();
+
+    now = Clock_getTicks();
+    if (now < lastTicks) {
+        wrapTicks += 1ULL << 32;
+    }
+    lastTicks = now;
+    ticks = wrapTicks + now;
+    Hwi_restore(key);
+    return ticks;
+}
+
+// Call after Board_initGeneral, which initialises the Power driver
+void powertrack_init(void) {
+
+    int i;
+
+    startTicks = powertrack_now();
+    for (i = 0; i < POWER_OWNER_COUNT; i++) {
+        owners[i].loadStart = startTicks;
+    }
+    Power_registerNotify(&standbyNotify,
+                         PowerCC26XX_ENTERING_STANDBY | PowerCC26XX_AWAKE_STANDBY,
+                         (Power_NotifyFxn)powertrack_notifyFxn, 0);
+}
+
+// Installed as PowerCC26XX_config.policyFxn. Runs from the Idle loop; the
+// wake-up interrupt runs before the policy returns and is counted as idle.
+void powertrack_policy(void) {
+
+    uint32_t constraints = Power_getConstraintMask();
+    uint32_t start = Clock_getTicks();
+    uint32_t elapsed;
+    int i;
+
+    powertrack_now();
+    wakeup_enterIdle();
+    PowerCC26XX_standbyPolicy();
+    wakeup_exitIdle();
+
+    elapsed = Clock_getTicks() - start;
+    idleTicks += elapsed;
+    for (i = 0; i < POWERTRACK_CONSTRAINTS; i++) {
+        if (constraints & (1 << i)) {
+            blockedTicks[i] += elapsed;
+        }
+    }
+}
+
+void powertrack_setConstraint(enum powerOwner owner, unsigned int constraint) {
+
+    PowerOwnerStats *o = &owners[owner];
+    UInt key = Hwi_disable();
+
+    if (o->depth++ == 0) {
+        o->holdStart = powertrack_now();
+        o->holds++;
+    }
+    Hwi_restore(key);
+    Power_setConstraint(constraint);
+}
+
+void powertrack_releaseConstraint(enum powerOwner owner, unsigned int constraint) {
+
+    PowerOwnerStats *o = &owners[owner];
+    UInt key = Hwi_disable();
+
+    if (o->depth > 0 && --o->depth == 0) {
+        o->heldTicks += powertrack_now() - o->holdStart;
+    }
+    Hwi_restore(key);
+    Power_releaseConstraint(constraint);
+}
+
+// Current drawn by a subsystem from now on, on top of the CPU
+void powertrack_setLoad(enum powerOwner owner, uint16_t ua) {
+
+    PowerOwnerStats *o = &owners[owner];
+    uint64_t now = powertrack_now();
+    UInt key = Hwi_disable();
+
+    o->chargeUaTicks += (uint64_t)o->loadUa * (now - o->loadStart);
+    o->loadStart = now;
+    o->loadUa = ua;
+    Hwi_restore(key);
+}
+
+static unsigned long powertrack_ms(uint64_t ticks) {
+
+    return (unsigned long)(ticks * Clock_tickPeriod / 1000);
+}
+
+static unsigned long powertrack_uC(uint64_t uaTicks) {
+
+    return (unsigned long)(uaTicks * Clock_tickPeriod / 1000000);
+}
+
+// Export format:
+//   pwr total=<ms> active=<ms> idle=<ms> standby=<ms> wakes=<n>
+//   pwr blocked <constraint> <ms>             idle time with the constraint set
+//   pwr owner <name> holds=<n> held=<ms> load=<uA> charge=<uC>
+//   pwr charge cpu=<uC> total=<uC> avg=<uA>
+void powertrack_report(UART_Handle uart) {
+
+    char line[112];
+    uint64_t now, total, idle, standby, active, cpuCharge, charge;
+    uint64_t blocked[POWERTRACK_CONSTRAINTS];
+    PowerOwnerStats o[POWER_OWNER_COUNT];
+    uint32_t wakeCount;
+    int i;
+    UInt key = Hwi_disable();
+
+    now = powertrack_now();
+    total = now - startTicks;
+    idle = idleTicks;
+    standby = standbyTicks;
+    wakeCount = wakes;
+    for (i = 0; i < POWERTRACK_CONSTRAINTS; i++) {
+        blocked[i] = blockedTicks[i];
+    }
+    for (i = 0; i < POWER_OWNER_COUNT; i++) {
+        o[i] = owners[i];
+        if (o[i].depth > 0) {
+            o[i].heldTicks += now - o[i].holdStart;
+        }
+        o[i].chargeUaTicks += (uint64_t)o[i].loadUa * (now - o[i].loadStart);
+    }
+    Hwi_restore(key);
+
+    if (standby > idle) {
+        standby = idle;
+    }
+    active = total > idle ? total - idle : 0;
+    idle -= standby;
+
+    report_printf(uart, line, sizeof(line), "pwr total=%lu active=%lu idle=%lu standby=%lu wakes=%lu\r\n",
+                  powertrack_ms(total), powertrack_ms(active), powertrack_ms(idle),
+                  powertrack_ms(standby), (unsigned long)wakeCount);
+
+    for (i = 0; i < POWERTRACK_CONSTRAINTS; i++) {
+        if (blocked[i] != 0) {
+            report_printf(uart, line, sizeof(line), "pwr blocked %s %lu\r\n", constraintNames[i], powertrack_ms(blocked[i]));
+        }
+    }
+
+    cpuCharge = active * POWERTRACK_ACTIVE_UA + idle * POWERTRACK_IDLE_UA
+              + standby * POWERTRACK_STANDBY_UA;
+    charge = cpuCharge;
+    for (i = 0; i < POWER_OWNER_COUNT; i++) {
+        charge += o[i].chargeUaTicks;
+        report_printf(uart, line, sizeof(line), "pwr owner %s holds=%lu held=%lu load=%u charge=%lu\r\n",
+                      ownerNames[i], (unsigned long)o[i].holds, powertrack_ms(o[i].heldTicks),
+                      o[i].loadUa, powertrack_uC(o[i].chargeUaTicks));
+    }
+
+    report_printf(uart, line, sizeof(line), "pwr charge cpu=%lu total=%lu avg=%lu\r\n",
+                  powertrack_uC(cpuCharge), powertrack_uC(charge),
+                  (unsigned long)(total ? charge / total : 0));
+}
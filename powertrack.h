@@ -0,0 +1,64 @@
+/*
+ * powertrack.h
+ *
+ *  Power-state residency and charge estimate. powertrack_policy wraps
+ *  PowerCC26XX_standbyPolicy: time spent inside it is idle, the rest is
+ *  active, and the standby notifications split standby out of idle. Idle time
+ *  with a constraint set is charged to that constraint, so it is visible what
+ *  kept the device out of standby.
+ *
+ *  Subsystems report their own current with powertrack_setLoad and take
+ *  constraints through powertrack_setConstraint, which adds the time held to
+ *  the owner. Charge is current model x residency, in uC.
+ *
+ *  The 32-bit Clock tick count wraps after 11.9 h; powertrack_now extends it
+ *  to 64 bits for the residency and for other long-running statistics.
+ */
+
+#ifndef POWERTRACK_H_
+#define POWERTRACK_H_
+
+#include <stdint.h>
+#include <ti/drivers/UART.h>
+
+// CPU current model, CC2650 datasheet s.5.4 at 3.0 V
+#ifndef POWERTRACK_ACTIVE_UA
+#define POWERTRACK_ACTIVE_UA    2930    // 48 MHz, 61 uA/MHz
+#endif
+#ifndef POWERTRACK_IDLE_UA
+#define POWERTRACK_IDLE_UA      550     // CPU in WFI, peripherals on
+#endif
+#ifndef POWERTRACK_STANDBY_UA
+#define POWERTRACK_STANDBY_UA   1       // RTC running, RAM retained
+#endif
+
+#define POWERTRACK_CONSTRAINTS  5       // PowerCC26XX_NUMCONSTRAINTS
+
+enum powerOwner {
+    POWER_OWNER_BUZZER = 0,
+    POWER_OWNER_SENSORS,
+    POWER_OWNER_CACHE,
+    POWER_OWNER_UART,
+    POWER_OWNER_MIC,
+    POWER_OWNER_COUNT
+};
+
+typedef struct {
+    uint32_t holds;
+    uint8_t depth;
+    uint64_t holdStart;
+    uint64_t heldTicks;
+    uint16_t loadUa;
+    uint64_t loadStart;
+    uint64_t chargeUaTicks;
+} PowerOwnerStats;
+
+void powertrack_init(void);
+uint64_t powertrack_now(void);
+void powertrack_policy(void);
+void powertrack_setConstraint(enum powerOwner owner, unsigned int constraint);
+void powertrack_releaseConstraint(enum powerOwner owner, unsigned int constraint);
+void powertrack_setLoad(enum powerOwner owner, uint16_t ua);
+void powertrack_report(UART_Handle uart);
+
+#endif /* POWERTRACK_H_ */
@@ -14,31 +14,65 @@
 #include <ti/sysbios/BIOS.h>
 #include <ti/sysbios/knl/Clock.h>
 #include <ti/sysbios/knl/Task.h>
+#include <ti/sysbios/knl/Semaphore.h>
 #include <ti/drivers/PIN.h>
 #include <ti/drivers/pin/PINCC26XX.h>
 #include <ti/drivers/I2C.h>
 #include <ti/drivers/Power.h>
 #include <ti/drivers/power/PowerCC26XX.h>
 #include <ti/drivers/UART.h>
-#include <ti/drivers/i2c/I2CCC26XX.h>
 
 #include "buzzer.h"
+#include "symbol.h"
+#include "latency.h"
+#include "trace.h"
+#include "stackmon.h"
+#include "ringbuffer.h"
+#include "memsection.h"
+#include "bench.h"
+#include "scheduler.h"
+#include "ratectl.h"
+#include "powertrack.h"
+#include "wakeup.h"
+#include "extflash.h"
+#include "logstore.h"
+#include "imucomp.h"
+#include "config.h"
+#include "cmdparse.h"
+#include "uartdma.h"
+#include "morsekey.h"
+#include "mic.h"
+#include "optrx.h"
+#include "straightkey.h"
+#include "gesture.h"
 
 /* Board Header files */
 #include "Board.h"
 #include "sensors/opt3001.h"
 #include "sensors/mpu9250.h"
+#include "sensors/tmp007.h"
+#include "sensors/sensor.h"
+#include "report.h"
 
 #define STACKSIZE 2048
 Char sensorTaskStack[STACKSIZE];
 Char uartTaskStack[STACKSIZE];
-Char uartTaskStackWrite[STACKSIZE];
 Char taskStack[STACKSIZE];
 
-enum state { WAITING=1, DATA_READY };
-enum state programState = WAITING;
-enum sensorReadState { MENU, READGYRO, READLIGHT };
+#define UART_HOUSEKEEPING_MS    5000    // UART task wakes at least this often for stack checks
+
+#define MPU_WOM_THRESHOLD_MG    40
+#define MPU_WOM_LOAD_UA         10      // accelerometer low-power cycling at 3.91 Hz
+
+enum sensorReadState { MENU, READGYRO, READLIGHT, SAMPLEALL, LIGHTRX };
+#ifdef SAMPLE_ALL_SENSORS
+enum sensorReadState sensorState = SAMPLEALL;
+#else
 enum sensorReadState sensorState = MENU;
+#endif
+
+// Latest result of every sensor in SAMPLEALL, units as in SensorCaps
+int32_t sensorValues[SENSOR_COUNT][SENSOR_MAX_CHANNELS];
 
 
 //Voi tehä järkevämmin Mr SpagettiCoder Illikainen
@@ -52,10 +86,9 @@ static PIN_Handle ledHandle;
 static PIN_State ledState;
 static PIN_Handle hMpuPin;
 static PIN_Handle powerButtonHandle;
+static PIN_State powerButtonState;
 
-static char char_to_send;
-
-float ambientLight = -1000.0;
+int32_t ambientLight = -1; // 0.01 lux, -1 until the first result
 
 //Buzzer
 static PIN_Handle hBuzzer;
@@ -65,24 +98,15 @@ PIN_Config cBuzzer[] = {
   PIN_TERMINATE
 };
 
-// Light Button / Send " " Button
+// Button 0 is the straight key, see straightkey.h
 PIN_Config buttonConfig[] = {
-   Board_BUTTON0  | PIN_INPUT_EN | PIN_PULLUP | PIN_IRQ_NEGEDGE,
+   Board_BUTTON0  | PIN_INPUT_EN | PIN_PULLUP | PIN_IRQ_BOTHEDGES,
    PIN_TERMINATE
 };
 PIN_Config ledConfig[] = {
    Board_LED0 | PIN_GPIO_OUTPUT_EN | PIN_GPIO_LOW | PIN_PUSHPULL | PIN_DRVSTR_MAX,
    PIN_TERMINATE
 };
-void buttonFxn(PIN_Handle handle, PIN_Id pinId) {
-    PIN_setOutputValue(ledHandle, Board_LED0, 1);
-    System_printf("buttonfxn");
-    System_flush();
-    char_to_send = ' ';
-    programState = DATA_READY;
-    Task_sleep(10000 / Clock_tickPeriod);
-    PIN_setOutputValue(ledHandle, Board_LED0, 0);
-}
 
 //Power Button
 PIN_Config powerButtonConfig[] = {
@@ -93,27 +117,15 @@ PIN_Config powerButtonWakeConfig[] = {
    Board_BUTTON1 | PIN_INPUT_EN | PIN_PULLUP | PINCC26XX_WAKEUP_NEGEDGE,
    PIN_TERMINATE
 };
-void powerFxn(PIN_Handle handle, PIN_Id pinId) {
-   Task_sleep(100000 / Clock_tickPeriod);
-
-   PIN_close(powerButtonHandle);
-   PINCC26XX_setWakeup(powerButtonWakeConfig);
-   Power_shutdown(NULL,0);
-}
-
-// I2C config for reading gyro and accelerometer (should we have another const for other configs?)
-static const I2CCC26XX_I2CPinCfg i2cMPUCfg = {
-    .pinSDA = Board_I2C0_SDA1,
-    .pinSCL = Board_I2C0_SCL1
-};
-
 void morse_led(char letter) {
-    const int point_period = 40000;
+    const int point_period = config_getU32(CONFIG_MORSE_UNIT_US);
     switch (letter) {
         case ' ':
             PIN_setOutputValue(ledHandle, Board_LED0, 0);
+            // With the unit after the last mark, letters are 4 units and
+            // words 7 apart; the optical receiver needs them told apart
             Task_sleep(point_period * 3 / Clock_tickPeriod);
-            break;
+            return;
         case '.':   
             PIN_setOutputValue(ledHandle, Board_LED0, 1);
             Task_sleep(point_period / Clock_tickPeriod);
@@ -140,51 +152,537 @@ int send_char(UART_Handle uart, char letter) {
 char UARTBuffer[1];
 #define BUFFER_SIZE 256
 
-typedef struct {
-    uint8_t data[BUFFER_SIZE];
-    volatile uint16_t head;
-    volatile uint16_t tail;
-} RingBuffer;
+static uint8_t uartBufferData[BUFFER_SIZE] GPRAM_DATA;
+RingBuffer uartBuffer = RINGBUFFER_INIT(uartBufferData);
 
-RingBuffer uartBuffer = { .head = 0, .tail = 0 };
+static volatile uint32_t rxStamp;
 
-void RingBuffer_Write(RingBuffer *buffer, uint8_t byte) {
-    uint16_t next = (buffer->head + 1) % BUFFER_SIZE;
+// The UART task blocks on uartWake; received bytes, queued symbols, trace
+// frames, the housekeeping Clock and the power button post it
+static Semaphore_Struct uartWakeStruct;
+static Semaphore_Handle uartWake;
+static UART_Handle uartHandle = NULL;   // for sleepUntilMotion, set once the UART task opened it
+static Clock_Struct housekeepingClock;
+static volatile bool housekeepingDue = false;
 
-    if (next != buffer->tail) {
-        buffer->data[buffer->head] = byte;
-        buffer->head = next;
-    }
+void housekeepingFxn(UArg arg) {
+    wakeup_mark(WAKE_CLOCK_UART);
+    housekeepingDue = true;
+    Semaphore_post(uartWake);
 }
 
-int RingBuffer_Read(RingBuffer *buffer, uint8_t *byte) {
-    if (buffer->head == buffer->tail) {
-        return -1;
-    }
-    *byte = buffer->data[buffer->tail];
-    buffer->tail = (buffer->tail + 1) % BUFFER_SIZE;
-    return 0;
+// The power button callback only flags the press, the UART task shuts down
+static volatile bool powerOffDue = false;
+
+void powerFxn(PIN_Handle handle, PIN_Id pinId) {
+    wakeup_mark(WAKE_PIN_POWER);
+    powerOffDue = true;
+    Semaphore_post(uartWake);
+}
+
+// Task context. Waits for the press to settle, then shuts down until the
+// button wakes the tag again
+void powerOff(void) {
+    Task_sleep(100000 / Clock_tickPeriod);
+
+    PIN_close(powerButtonHandle);
+    PINCC26XX_setWakeup(powerButtonWakeConfig);
+    Power_shutdown(NULL,0);
 }
 
-void uartReadCallback(UART_Handle uart, void *buffer, size_t count) {
+RAMFUNC void uartReadCallback(UART_Handle uart, void *buffer, size_t count) {
     char receivedChar = *((char *)buffer);
 
+    wakeup_mark(WAKE_UART);
+    rxStamp = symbol_now();
+
     RingBuffer_Write(&uartBuffer, (uint8_t)receivedChar);
+    Semaphore_post(uartWake);
 
     UART_read(uart, UARTBuffer, 1);
 }
 
+//FLASH LOG
+// SAMPLEALL results go to the external flash through storeRing: the sensor
+// task only queues records, the UART task programs and erases the flash so
+// erase times never delay a sample.
+// Ring record: length, time (ms) and sensor id, then the channel values or,
+// for the IMU, a compressed block of samples (see imucomp.h).
+#define STORE_RING_SIZE     1024
+#define STORE_COMPRESSED    0x80    // id flag, record holds an imucomp block
+
+static uint8_t storeRingData[STORE_RING_SIZE] GPRAM_DATA;
+static RingBuffer storeRing = RINGBUFFER_INIT(storeRingData);
+static LogStore sensorLog;
+static bool storeOpen = false;
+static uint32_t storeBaseMs;        // log time is monotonic across reboots
+static uint32_t storeLastTicks;
+static uint32_t storeRingDrops = 0;
+static ImuEncoder imuEncoder;
+static volatile bool streamImu = false;  // $stream, IMU blocks also go out on the UART
+
+// Log time in ms, carries on from the newest stored record
+uint32_t storeTimeMs(void) {
+    uint32_t elapsed = (Clock_getTicks() - storeLastTicks) / (1000 / Clock_tickPeriod);
+    storeLastTicks += elapsed * (1000 / Clock_tickPeriod);
+    storeBaseMs += elapsed;
+    return storeBaseMs;
+}
+
+void storeWrite(uint32_t time, uint8_t id, const void *data, uint8_t length) {
+    uint8_t len = 1 + length;
+    int i;
+
+    if (STORE_RING_SIZE - 1 - RingBuffer_Count(&storeRing) < LOGSTORE_RECORD_HEADER + len) {
+        storeRingDrops++;
+        return;
+    }
+    RingBuffer_Write(&storeRing, len);
+    for (i = 0; i < 4; i++) {
+        RingBuffer_Write(&storeRing, (uint8_t)(time >> (8 * i)));
+    }
+    RingBuffer_Write(&storeRing, id);
+    for (i = 0; i < length; i++) {
+        RingBuffer_Write(&storeRing, ((const uint8_t *)data)[i]);
+    }
+    if (RingBuffer_Count(&storeRing) >= LOGSTORE_PAGE_SIZE) {
+        Semaphore_post(uartWake);
+    }
+}
+
+// The record is stamped when the block closes, the block header carries the
+// time of its first sample. Record times must not go back, see logstore.h.
+void storeImuBlock(const uint8_t *block, uint16_t length, uint32_t time, void *arg) {
+    storeWrite(storeTimeMs(), SENSOR_MPU9250 | STORE_COMPRESSED, block, length);
+    if (streamImu) {
+        Semaphore_post(uartWake);
+    }
+}
+
+// IMU samples are compressed, at 100 Hz raw records would take 2.5 KB/s.
+// The UART task also closes blocks (storeFlushImu), the scheduler is held
+// off while the encoder and the ring are written.
+void storeRecord(enum sensorId id, const int32_t *values, int channels, uint16_t periodMs) {
+    UInt key = Task_disable();
+    if (id == SENSOR_MPU9250 && (storeOpen || streamImu)) {
+        imucomp_push(&imuEncoder, storeTimeMs(), periodMs, values);
+    } else if (storeOpen) {
+        storeWrite(storeTimeMs(), id, values, channels * sizeof(int32_t));
+    }
+    Task_restore(key);
+}
+
+// Queues the open IMU block, on a mode change and before the log is read
+void storeFlushImu(void) {
+    UInt key = Task_disable();
+    imucomp_flush(&imuEncoder);
+    Task_restore(key);
+}
+
+void storeInit(void) {
+    const FlashDev *dev = extflash_open();
+    uint32_t blocks;
+
+    // Also feeds $stream when there is no flash
+    imucomp_init(&imuEncoder, 6, IMUCOMP_RICE, storeImuBlock, NULL);
+    if (dev == NULL) {
+        System_printf("External flash not found, sensor log disabled\n");
+        System_flush();
+        return;
+    }
+    blocks = dev->size / dev->blockSize;
+    if (blocks > LOGSTORE_MAX_BLOCKS) {
+        blocks = LOGSTORE_MAX_BLOCKS;
+    }
+    if (!logstore_open(&sensorLog, dev, 0, blocks)) {
+        extflash_close();
+        return;
+    }
+    storeLastTicks = Clock_getTicks();
+    storeBaseMs = logstore_lastTime(&sensorLog) + 1;
+    extflash_sleep();
+    storeOpen = true;
+}
+
+// Moves queued records into the log, flash work happens here. Streamed IMU
+// blocks are written to the UART as they are, imucomp_decode.py skips the
+// text around them.
+void storeDrain(UART_Handle uart, bool flush) {
+    uint8_t record[LOGSTORE_MAX_RECORD];
+    uint8_t len, byte;
+    uint32_t time;
+    int i;
+
+    while (RingBuffer_Read(&storeRing, &len) == 0) {
+        time = 0;
+        for (i = 0; i < 4; i++) {
+            RingBuffer_Read(&storeRing, &byte);
+            time |= (uint32_t)byte << (8 * i);
+        }
+        for (i = 0; i < len; i++) {
+            RingBuffer_Read(&storeRing, &record[i]);
+        }
+        if (streamImu && record[0] == (SENSOR_MPU9250 | STORE_COMPRESSED)) {
+            UART_write(uart, &record[1], len - 1);
+        }
+        if (storeOpen) {
+            logstore_append(&sensorLog, time, record, len);
+        }
+    }
+    if (!storeOpen) {
+        return;
+    }
+    if (flush) {
+        logstore_flush(&sensorLog);
+    }
+    extflash_sleep();
+}
+
+// Export format:
+//   log <dev> blocks=<n> first=<ms> last=<ms> seq=<n> pages=<n> erases=<n> torn=<n> fail=<n> drop=<n>
+//   log imu samples=<n> blocks=<n> in=<bytes> out=<bytes>
+void storeReport(UART_Handle uart) {
+    char line[176];
+
+    if (!storeOpen) {
+        UART_write(uart, "log none\r\n", 10);
+        return;
+    }
+    report_printf(uart, line, sizeof(line), "log %s blocks=%u first=%lu last=%lu seq=%lu pages=%lu erases=%lu torn=%lu fail=%lu drop=%lu\r\n",
+                  sensorLog.dev->name, sensorLog.blockCount,
+                  (unsigned long)logstore_firstTime(&sensorLog), (unsigned long)logstore_lastTime(&sensorLog),
+                  (unsigned long)sensorLog.seq, (unsigned long)sensorLog.stats.pages,
+                  (unsigned long)sensorLog.stats.erases, (unsigned long)sensorLog.stats.torn,
+                  (unsigned long)sensorLog.stats.failures,
+                  (unsigned long)(sensorLog.stats.dropped + storeRingDrops));
+    report_printf(uart, line, sizeof(line), "log imu samples=%lu blocks=%lu in=%lu out=%lu\r\n",
+                  (unsigned long)imuEncoder.stats.samples, (unsigned long)imuEncoder.stats.blocks,
+                  (unsigned long)imuEncoder.stats.bytesIn, (unsigned long)imuEncoder.stats.bytesOut);
+}
+
+// Closes the open IMU block and writes everything queued before reporting,
+// for l and $stats log
+void storeFlushReport(UART_Handle uart) {
+    storeFlushImu();
+    storeDrain(uart, true);
+    storeReport(uart);
+}
+
+// $log output, one line per record: rec <ms> <id> <data in hex>. The id is
+// a sensorId, with STORE_COMPRESSED for an imucomp block.
+static void storeDumpRecord(uint32_t time, const uint8_t *data, uint8_t len, void *arg) {
+    UART_Handle uart = (UART_Handle)arg;
+    char line[72];
+    int i, n = 0;
+
+    report_printf(uart, line, sizeof(line), "rec %lu %u ", (unsigned long)time, data[0]);
+    for (i = 1; i < len; i++) {
+        n += sprintf(&line[n], "%02x", data[i]);
+        if (n >= 64) {
+            UART_write(uart, line, n);
+            n = 0;
+        }
+    }
+    line[n++] = '\r';
+    line[n++] = '\n';
+    UART_write(uart, line, n);
+}
+
+// Writes everything queued, then dumps the records in [t0, t1]
+const char *storeDump(UART_Handle uart, uint32_t t0, uint32_t t1) {
+    char line[32];
+    int32_t count;
+
+    if (!storeOpen) {
+        return "log";
+    }
+    storeFlushImu();
+    storeDrain(uart, true);
+    count = logstore_readRange(&sensorLog, t0, t1, storeDumpRecord, uart);
+    extflash_sleep();
+    report_printf(uart, line, sizeof(line), "log records=%ld\r\n", (long)count);
+    return NULL;
+}
+
+// Symbols of the Morse key inputs go to the UART like the gestures do
+static void keySymbolFxn(char symbol, uint32_t timeUs, void *arg) {
+    symbol_post(symbol, timeUs, symbol_now());
+}
+
+//MICROPHONE
+// Acoustic Morse input, see mic.h. The tone detector reports the key state
+// every frame from the mic Swi, the classifier turns it into symbols.
+static MorseKey micKey;
+
+static void micFrameFxn(bool down, uint32_t timeUs, void *arg) {
+    morsekey_update(&micKey, down, timeUs);
+}
+
+bool micStart(void) {
+    morsekey_init(&micKey, config_getU32(CONFIG_MORSE_UNIT_US), keySymbolFxn, NULL);
+    return mic_start((uint16_t)config_getU32(CONFIG_TONE_HZ), micFrameFxn, NULL);
+}
+
+//LIGHT RECEIVER
+// Optical Morse input in mode optrx, see optrx.h. The sender flashes its LED
+// with morse_led(); both tags need the same morse_unit, at least 200 ms.
+#define LIGHTRX_TIMEOUT_US      200000  // commands are applied at least this often
+
+static MorseKey lightKey;
+static OptReceiver lightRx;
+
+void lightRxStart(I2C_Handle *i2c) {
+    morsekey_init(&lightKey, config_getU32(CONFIG_MORSE_UNIT_US), keySymbolFxn, NULL);
+    optrx_init(&lightRx, &lightKey);
+    opt3001_configure(i2c, OPT3001_CONVERSION_100MS);
+}
+
+// Export format:
+//   optrx samples=<n> marks=<n> rebases=<n> base=<clux> amp=<clux> thr=<clux>
+//   optrx key dot=<us> dash=<us> dots=<n> dashes=<n> letters=<n> words=<n> glitches=<n>
+void lightRxReport(UART_Handle uart) {
+    char line[144];
+
+    report_printf(uart, line, sizeof(line), "optrx samples=%lu marks=%lu rebases=%lu base=%ld amp=%ld thr=%ld\r\n",
+                  (unsigned long)lightRx.stats.samples, (unsigned long)lightRx.stats.marks,
+                  (unsigned long)lightRx.stats.rebases, (long)lightRx.baseline,
+                  (long)lightRx.amplitude, (long)optrx_threshold(&lightRx));
+    report_printf(uart, line, sizeof(line), "optrx key dot=%lu dash=%lu dots=%lu dashes=%lu letters=%lu words=%lu glitches=%lu\r\n",
+                  (unsigned long)lightKey.dotUs, (unsigned long)lightKey.dashUs,
+                  (unsigned long)lightKey.stats.dots, (unsigned long)lightKey.stats.dashes,
+                  (unsigned long)lightKey.stats.letters, (unsigned long)lightKey.stats.words,
+                  (unsigned long)lightKey.stats.glitches);
+}
+
+//GESTURES
+// Morse gestures in mode gyro, see gesture.h. The config key gesture picks
+// the threshold rule or the decision tree of gesture_model.h.
+static GestureWindow gestureWindow;
+
+//COMMANDS
+// $-prefixed lines on the UART, see cmdparse.h. Configuration and reports are
+// handled in the UART task; mode, rate and calibration requests are handed to
+// the sensor task, which applies them between samples.
+static CmdParser cmdParser;
+
+// Sensor task side, SENSOR_COUNT / -1 while nothing is pending
+static volatile int8_t modeRequest = -1;
+static volatile uint8_t rateRequestId = SENSOR_COUNT;
+static volatile uint16_t rateRequestMs;
+static volatile bool calRequest = false;
+
+// Indexed by enum sensorReadState
+static const char *const modeNames[] = { "menu", "gyro", "light", "all", "optrx" };
+
+typedef struct {
+    const char *name;
+    void (*report)(UART_Handle uart);
+} CommandReport;
+
+static const CommandReport commandReports[] = {
+    { "latency", latency_report },
+    { "power", powertrack_report },
+    { "wake", wakeup_report },
+    { "sched", sched_report },
+    { "rate", ratectl_report },
+    { "stack", stackmon_report },
+    { "log", storeFlushReport },
+    { "cfg", config_report },
+    { "uart", uartdma_report },
+    { "mic", mic_report },
+    { "optrx", lightRxReport },
+    { "key", straightkey_report }
+};
+#define COMMAND_REPORTS ((int)(sizeof(commandReports) / sizeof(commandReports[0])))
+
+bool commandParseValue(enum kvType type, const char *text, ConfigValue *value) {
+    if (type == KVSTORE_FLOAT) {
+        return cmdparse_float(text, &value->f);
+    }
+    if (type == KVSTORE_I32 && text[0] == '-') {
+        if (!cmdparse_uint(&text[1], &value->u) || value->u > 0x80000000) {
+            return false;
+        }
+        value->i = -(int32_t)(value->u - 1) - 1;
+        return true;
+    }
+    return cmdparse_uint(text, &value->u) && (type != KVSTORE_I32 || value->u <= 0x7FFFFFFF);
+}
+
+int commandFindSensor(const char *name) {
+    int id;
+    for (id = 0; id < SENSOR_COUNT; id++) {
+        if (strcmp(name, sensorRegistry[id]->name) == 0) {
+            return id;
+        }
+    }
+    return -1;
+}
+
+// Returns NULL on success or the reason for the err reply
+const char *commandExecute(UART_Handle uart, const Command *cmd) {
+    char line[64];
+    ConfigValue value;
+    uint32_t ms, t0, t1;
+    int key, id, len, i;
+
+    switch (cmd->op) {
+        case CMD_GET:
+            key = config_find(cmd->argv[0]);
+            if (key < 0) {
+                return "key";
+            }
+            len = config_format(line, (enum configKey)key);
+            len += sprintf(&line[len], "\r\n");
+            UART_write(uart, line, len);
+            return NULL;
+        case CMD_SET:
+            key = config_find(cmd->argv[0]);
+            if (key < 0) {
+                return "key";
+            }
+            if (!commandParseValue(config_def((enum configKey)key)->type, cmd->argv[1], &value)) {
+                return "value";
+            }
+            return config_set((enum configKey)key, value) ? NULL : "range";
+        case CMD_RESET:
+            if (strcmp(cmd->argv[0], "all") == 0) {
+                return config_resetAll() ? NULL : "flash";
+            }
+            key = config_find(cmd->argv[0]);
+            if (key < 0) {
+                return "key";
+            }
+            return config_reset((enum configKey)key) ? NULL : "flash";
+        case CMD_MODE:
+            if (cmd->argc == 0) {
+                report_printf(uart, line, sizeof(line), "mode %s\r\n", modeNames[sensorState]);
+                return NULL;
+            }
+            for (i = 0; i <= LIGHTRX; i++) {
+                if (strcmp(cmd->argv[0], modeNames[i]) == 0) {
+                    modeRequest = i;
+                    mpu9250_wom_cancel();
+                    return NULL;
+                }
+            }
+            return "mode";
+        case CMD_RATE:
+            if (cmd->argc == 0) {
+                sched_report(uart);
+                ratectl_report(uart);
+                return NULL;
+            }
+            if (cmd->argc != 2) {
+                return "arguments";
+            }
+            if (sensorState != SAMPLEALL) {
+                return "mode";
+            }
+            id = commandFindSensor(cmd->argv[0]);
+            if (id < 0) {
+                return "sensor";
+            }
+            if (!cmdparse_uint(cmd->argv[1], &ms)) {
+                return "value";
+            }
+            // 0 gives the IMU back to the rate controller
+            if (!(ms == 0 && id == SENSOR_MPU9250)
+                && (ms < sensorRegistry[id]->get_capabilities()->minPeriodMs
+                    || ms > sensorRegistry[id]->get_capabilities()->maxPeriodMs)) {
+                return "range";
+            }
+            if (rateRequestId != SENSOR_COUNT) {
+                return "busy";
+            }
+            rateRequestMs = ms;
+            rateRequestId = id;
+            return NULL;
+        case CMD_STREAM:
+            if (strcmp(cmd->argv[0], "on") == 0) {
+                streamImu = true;
+            } else if (strcmp(cmd->argv[0], "off") == 0) {
+                streamImu = false;
+            } else {
+                return "value";
+            }
+            return NULL;
+        case CMD_STATS:
+            if (cmd->argc != 0 && strcmp(cmd->argv[0], "reset") == 0) {
+                ratectl_clearStats();
+                return NULL;
+            }
+            for (i = 0; i < COMMAND_REPORTS; i++) {
+                if (cmd->argc == 0 || strcmp(cmd->argv[0], commandReports[i].name) == 0) {
+                    commandReports[i].report(uart);
+                    if (cmd->argc != 0) {
+                        return NULL;
+                    }
+                }
+            }
+            return cmd->argc == 0 ? NULL : "report";
+        case CMD_CAL:
+            if (sensorState == READLIGHT || sensorState == LIGHTRX) {
+                return "mode";
+            }
+            calRequest = true;
+            mpu9250_wom_cancel();
+            return NULL;
+        case CMD_MIC:
+            if (strcmp(cmd->argv[0], "on") == 0) {
+                return micStart() ? NULL : "mic";
+            } else if (strcmp(cmd->argv[0], "off") == 0) {
+                mic_stop();
+            } else {
+                return "value";
+            }
+            return NULL;
+        case CMD_KEY:
+            if (strcmp(cmd->argv[0], "on") == 0) {
+                straightkey_setKeying(true);
+            } else if (strcmp(cmd->argv[0], "off") == 0) {
+                straightkey_setKeying(false);
+            } else {
+                return "value";
+            }
+            return NULL;
+        case CMD_LOG:
+            if (!cmdparse_uint(cmd->argv[0], &t0) || !cmdparse_uint(cmd->argv[1], &t1)) {
+                return "value";
+            }
+            return storeDump(uart, t0, t1);
+        case CMD_HELP:
+            for (i = 0; i < CMD_OPCOUNT; i++) {
+                report_printf(uart, line, sizeof(line), "cmd %c%s\r\n", CMD_PREFIX, cmdparse_name((enum cmdOp)i));
+            }
+            return NULL;
+        default:
+            return "unknown command";
+    }
+}
+
+// Reply is "ok" or "err <reason>" after any output of the command
+void commandReply(UART_Handle uart, const char *error) {
+    char line[32];
+
+    if (error == NULL) {
+        UART_write(uart, "ok\r\n", 4);
+        return;
+    }
+    report_printf(uart, line, sizeof(line), "err %.20s\r\n", error);
+}
+
 void uartTaskFxnRead(UArg arg0, UArg arg1) {
 
     UART_Handle uart;
     UART_Params uartParams;
 
     UART_Params_init(&uartParams);
-    uartParams.writeDataMode = UART_DATA_TEXT;
+    uartParams.writeDataMode = UART_DATA_BINARY; // trace frames share the line
     uartParams.readDataMode = UART_DATA_TEXT;
     uartParams.readEcho = UART_ECHO_OFF;
     uartParams.readMode = UART_MODE_CALLBACK;
-    uartParams.baudRate = 9600;
+    uartParams.baudRate = config_getU32(CONFIG_BAUD_RATE);
     uartParams.dataLength = UART_LEN_8;
     uartParams.parityType = UART_PAR_NONE;
     uartParams.stopBits = UART_STOP_ONE;
@@ -194,26 +692,103 @@ void uartTaskFxnRead(UArg arg0, UArg arg1) {
     if (uart == NULL) {
        System_abort("Error opening the UART read");
     }
+    uartHandle = uart;
 
     UART_read(uart, UARTBuffer, 1);
 
+    storeInit();
+    cmdparse_init(&cmdParser);
+    symbol_setNotify(uartWake);
+    trace_setNotify(uartWake);
     while (true) {
         uint8_t byte;
+        bool first = true;
         while (RingBuffer_Read(&uartBuffer, &byte) == 0) {
+            Command cmd;
+            enum cmdResult result;
+            if (first) {
+                latency_record(LATENCY_RX, symbol_now() - rxStamp);
+                first = false;
+            }
+            // Command lines first, single keys and Morse playback otherwise
+            result = cmdparse_feed(&cmdParser, byte, &cmd);
+            if (result == CMDPARSE_READY) {
+                commandReply(uart, commandExecute(uart, &cmd));
+                continue;
+            }
+            if (result == CMDPARSE_ERROR) {
+                commandReply(uart, cmd.error);
+                continue;
+            }
+            if (result == CMDPARSE_PENDING) {
+                continue;
+            }
+            if (byte == '?') {
+                latency_report(uart);
+                continue;
+            }
+            if (byte == 'b') {
+                bench_run(uart);
+                continue;
+            }
+            if (byte == 's') {
+                stackmon_report(uart);
+                continue;
+            }
+            if (byte == 'p') {
+                powertrack_report(uart);
+                continue;
+            }
+            if (byte == 'w') {
+                wakeup_report(uart);
+                continue;
+            }
+            if (byte == 'c') {
+                config_report(uart);
+                continue;
+            }
+            if (byte == 'l') {
+                storeFlushReport(uart);
+                continue;
+            }
+            if (byte == 'r') {
+                sched_report(uart);
+                ratectl_report(uart);
+                continue;
+            }
+            if (byte == 't' || byte == 'T') {
+                trace_setOutput(byte == 't');
+                continue;
+            }
             morse_led(byte);
+            TRACE1("Processed %c", byte);
+        }
 
-            char message[100];
-            sprintf(message, "Processed %c", byte);
-            System_printf("%s\n", message);
-            System_flush();
+        Symbol symbol;
+        while (symbol_get(&symbol)) {
+            send_char(uart, symbol.symbol);
+            latency_record_symbol(&symbol, symbol_now());
         }
+        trace_flush(uart);
+        storeDrain(uart, housekeepingDue);
 
-        if (programState == DATA_READY) {
-           send_char(uart, char_to_send);
-           programState = WAITING;
-       }
+        if (powerOffDue) {
+            powerOff();
+        }
+
+        if (housekeepingDue) {
+            housekeepingDue = false;
+            // A partial command line idle for one to two periods is dropped
+            if (cmdparse_timeout(&cmdParser)) {
+                commandReply(uart, "timeout");
+            }
+            if (stackmon_check() > 0) {
+                stackmon_report(uart);
+            }
+        }
 
-       Task_sleep(100000 / Clock_tickPeriod);
+        // Writes above only queue, the uDMA sends them while the task waits here
+        Semaphore_pend(uartWake, BIOS_WAIT_FOREVER);
     }
 }
 // Ukko nooa
@@ -231,73 +806,280 @@ void playMusicTask(UArg arg0, UArg arg1) {
 }
 
 //SENSOR TASK
-void sensorTaskFxn(UArg arg0, UArg arg1) {
-    I2C_Handle i2c;
-    I2C_Params i2cParams;
+// Sample period as a periodic Clock, so the task wakes exactly once per sample
+static Semaphore_Struct sampleSemStruct;
+static Semaphore_Handle sampleSem;
+static Clock_Struct sampleClockStruct;
+static Clock_Handle sampleClock;
+static uint32_t sampleClockMs = 0;  // 0 while stopped
+
+void sampleClockFxn(UArg arg) {
+    wakeup_mark(WAKE_CLOCK_SENSOR);
+    Semaphore_post(sampleSem);
+}
 
-    switch (sensorState) {
-        case READGYRO: case MENU:
-            I2C_Params_init(&i2cParams);
-            i2cParams.bitRate = I2C_400kHz;
-            i2cParams.custom = (uintptr_t)&i2cMPUCfg;
-            // Power the MPU9250 sensor. Must do I2C_Close() before using another sensor, and using I2C_open() again.
-            PIN_setOutputValue(hMpuPin,Board_MPU_POWER, Board_MPU_POWER_ON);
+void waitSamplePeriod(uint32_t periodMs) {
+    if (periodMs != sampleClockMs) {
+        uint32_t ticks = periodMs * 1000 / Clock_tickPeriod;
+        Clock_stop(sampleClock);
+        Clock_setPeriod(sampleClock, ticks);
+        Clock_setTimeout(sampleClock, ticks);
+        Clock_start(sampleClock);
+        sampleClockMs = periodMs;
+    }
+    Semaphore_pend(sampleSem, BIOS_WAIT_FOREVER);
+}
 
-            System_printf("MPU9250: Power ON\n");
-            System_flush();
+// Applies a new IMU rate tier to the sensor, the MPU bus must be open
+void applyRateTier(I2C_Handle *i2c) {
+    const RateTier *tier = ratectl_get(ratectl_tier());
+    mpu9250_set_rate(i2c, tier->smplrtDiv, tier->dlpf);
+}
 
-            i2c = I2C_open(Board_I2C, &i2cParams);
-            if (i2c == NULL) {
-                System_abort("Error Initializing I2CMPU\n");
-            }
+// IMU sample in mg and cdps, the units of the sensor log
+void imuToFixed(float ax, float ay, float az, float gx, float gy, float gz, int32_t *imu) {
+    imu[0] = (int32_t)(ax * 1000.0f);
+    imu[1] = (int32_t)(ay * 1000.0f);
+    imu[2] = (int32_t)(az * 1000.0f);
+    imu[3] = (int32_t)(gx * 100.0f);
+    imu[4] = (int32_t)(gy * 100.0f);
+    imu[5] = (int32_t)(gz * 100.0f);
+}
+
+// Feeds one IMU sample to the rate controller, returns the sampling period in ms
+uint32_t trackMotion(I2C_Handle *i2c, const int32_t *imu) {
+    if (ratectl_update(&imu[0], &imu[3])) {
+        applyRateTier(i2c);
+    }
+    return ratectl_get(ratectl_tier())->periodMs;
+}
+
+// Parks the MPU9250 in wake-on-motion and blocks until the tag is moved. The
+// sensor task and the pending UART read are what keep the MCU busy in MENU;
+// the read lets go of standby for the wait (uartdma_allowStandby), so the
+// MCU stays in standby until the motion interrupt or a byte on RX. $mode and
+// $cal end the wait early (mpu9250_wom_cancel), a request queued before it
+// started skips it.
+void sleepUntilMotion(I2C_Handle *i2c) {
+    bool moved = false;
+
+    PIN_setOutputValue(ledHandle, Board_LED0, 0);
+    if (!mpu9250_wom_enter(i2c, MPU_WOM_THRESHOLD_MG, MPU9250_LPODR_3_91HZ)) {
+        return;
+    }
+    TRACE0("MPU9250: wake-on-motion");
+    powertrack_setLoad(POWER_OWNER_SENSORS, MPU_WOM_LOAD_UA);
+    Clock_stop(sampleClock);
+    sampleClockMs = 0;
+    if (modeRequest < 0 && !calRequest) {
+        if (uartHandle != NULL) {
+            uartdma_allowStandby(uartHandle, true);
+        }
+        moved = mpu9250_wom_wait(BIOS_WAIT_FOREVER);
+        if (uartHandle != NULL) {
+            uartdma_allowStandby(uartHandle, false);
+        }
+    }
+    uint32_t wakeUs = mpu9250_wom_exit(i2c);
+    if (moved) {
+        latency_record(LATENCY_WAKE, wakeUs);
+    }
+    powertrack_setLoad(POWER_OWNER_SENSORS, sensorRegistry[SENSOR_MPU9250]->get_capabilities()->activeUa);
+    ratectl_reset();
+    applyRateTier(i2c);
+}
+
+static uint16_t imuFixedMs = 0;    // $rate for the IMU, 0 while ratectl picks it
+
+void sampleFxn(enum sensorId id, const int32_t *values, int channels) {
+    memcpy(sensorValues[id], values, channels * sizeof(int32_t));
+    storeRecord(id, values, channels, sched_get(id)->periodTicks * Clock_tickPeriod / 1000);
+    if (id == SENSOR_MPU9250 && imuFixedMs == 0 && ratectl_update(&values[0], &values[3])) {
+        I2C_Handle i2c = sensor_open(SENSOR_BUS_MPU);
+        uint32_t periodMs = ratectl_get(ratectl_tier())->periodMs;
+        applyRateTier(&i2c);
+        sched_setPeriod(SENSOR_MPU9250, periodMs, periodMs / 2);
+    }
+    if (id == SENSOR_OPT3001) {
+        ambientLight = values[0];
+    }
+}
+
+// IMU 100 Hz, light, pressure, temperature and humidity 1 Hz. Periods are
+// harmonic so the slow sensors are always read in the same dispatch. With
+// tmp_alert the TMP007 only reports object temperatures outside
+// tmp_low..tmp_high.
+void startSampleAll(void) {
+    uint16_t load = 0;
+    int id;
+    PIN_setOutputValue(hMpuPin,Board_MPU_POWER, Board_MPU_POWER_ON);
+    Task_sleep(100000 / Clock_tickPeriod);
+    sched_add(SENSOR_MPU9250, 10, 5, sampleFxn);
+    sched_add(SENSOR_OPT3001, 1000, 0, sampleFxn);
+    sched_add(SENSOR_BMP280, 1000, 0, sampleFxn);
+    sched_add(SENSOR_TMP007, 1000, 0, sampleFxn);
+    if (config_getU32(CONFIG_TMP_ALERT)) {
+        I2C_Handle i2c = sensor_open(tmp007Driver.bus);
+        tmp007_set_limits(&i2c, config_getI32(CONFIG_TMP_HIGH), config_getI32(CONFIG_TMP_LOW));
+    }
+    sched_add(SENSOR_HDC1000, 1000, 0, sampleFxn);
+    for (id = 0; id < SENSOR_COUNT; id++) {
+        if (sched_get((enum sensorId)id) != NULL) {
+            load += sensorRegistry[id]->get_capabilities()->activeUa;
+        }
+    }
+    powertrack_setLoad(POWER_OWNER_SENSORS, load);
+    sched_start();
+}
 
-            System_printf("MPU9250: Setup and calibration...\n");
-            System_flush();
-            Task_sleep(100000 / Clock_tickPeriod);
-            mpu9250_setup(&i2c);
-            System_printf("MPU9250: Setup and calibration OK\n");
-            System_flush();
+// Brings up the sensors of sensorState, at start-up and on $mode
+void enterSensorState(I2C_Handle *i2c) {
+    const SensorDriver *drv = NULL;
+
+    switch (sensorState) {
+        case READGYRO: case MENU:
+            gesture_reset(&gestureWindow);
+            // Power the MPU9250 sensor. It sits on its own I2C pins, sensor_open() handles the switch.
+            PIN_setOutputValue(hMpuPin,Board_MPU_POWER, Board_MPU_POWER_ON);
+            drv = sensorRegistry[SENSOR_MPU9250];
             break;
-        case READLIGHT:
-
-            I2C_Params_init(&i2cParams);
-            i2cParams.bitRate = I2C_400kHz;
-            
-            // Power the OPT3001 sensor. Must do I2C_Close() before using another sensor, and using I2C_open() again.
-            System_printf("OPT3001: Power ON\n");
-            System_flush();
-
-            i2c = I2C_open(Board_I2C_TMP, &i2cParams);
-            if (i2c == NULL) {
-                System_abort("Error Initializing I2C\n");
-            }
-
-            System_printf("OPT3001: Setup and calibration...\n");
-            System_flush();
-            Task_sleep(100000 / Clock_tickPeriod);
-            opt3001_setup(&i2c);
-            System_printf("OPT3001: Setup and calibration OK\n");
-            System_flush();
+        case READLIGHT: case LIGHTRX:
+            drv = sensorRegistry[SENSOR_OPT3001];
+            break;
+        case SAMPLEALL:
+            startSampleAll();
             break;
         default:
             break;
     }
+    if (drv != NULL) {
+        *i2c = sensor_open(drv->bus);
+        System_printf("%s: Setup and calibration...\n", drv->name);
+        System_flush();
+        Task_sleep(100000 / Clock_tickPeriod);
+        drv->init(i2c);
+        if (sensorState == LIGHTRX) {
+            lightRxStart(i2c);
+        }
+        powertrack_setLoad(POWER_OWNER_SENSORS, drv->get_capabilities()->activeUa);
+        System_printf("%s: Setup and calibration OK\n", drv->name);
+        System_flush();
+    }
+}
+
+// Fixed IMU rate, filtered like the slowest tier that still samples as fast
+void applyFixedRate(I2C_Handle *i2c, uint32_t periodMs) {
+    enum ratectlTier t = RATECTL_HIGH;
+    while (t > RATECTL_LOW && ratectl_get(t)->periodMs < periodMs) {
+        t--;
+    }
+    mpu9250_set_rate(i2c, periodMs > 256 ? 255 : periodMs - 1, ratectl_get(t)->dlpf);
+}
+
+// Applies $mode, $rate and $cal between two samples
+void applyCommandRequests(I2C_Handle *i2c) {
+    if (modeRequest >= 0) {
+        enum sensorReadState next = (enum sensorReadState)modeRequest;
+        modeRequest = -1;
+        if (sensorState == SAMPLEALL) {
+            sched_stop();
+            storeFlushImu();
+        } else if (next == SAMPLEALL || next == READLIGHT || next == LIGHTRX) {
+            Clock_stop(sampleClock);
+            sampleClockMs = 0;
+            if (sensorState == MENU || sensorState == READGYRO) {
+                I2C_Handle bus = sensor_open(SENSOR_BUS_MPU);
+                sensorRegistry[SENSOR_MPU9250]->sleep(&bus);
+            }
+        }
+        if (sensorState == READLIGHT || sensorState == LIGHTRX) {
+            // Its conversion clock would keep waking the CPU
+            sensorRegistry[SENSOR_OPT3001]->sleep(i2c);
+        }
+        TRACE2("mode: %d -> %d", sensorState, next);
+        sensorState = next;
+        menuStatus = IDLE;
+        imuFixedMs = 0;
+        ratectl_reset();
+        enterSensorState(i2c);
+    }
+    if (rateRequestId != SENSOR_COUNT) {
+        enum sensorId id = (enum sensorId)rateRequestId;
+        uint32_t periodMs = rateRequestMs;
+        rateRequestId = SENSOR_COUNT;
+        if (id == SENSOR_MPU9250) {
+            I2C_Handle bus = sensor_open(SENSOR_BUS_MPU);
+            imuFixedMs = periodMs;
+            if (periodMs == 0) {
+                ratectl_reset();
+                applyRateTier(&bus);
+                periodMs = ratectl_get(ratectl_tier())->periodMs;
+            } else {
+                applyFixedRate(&bus, periodMs);
+            }
+            sched_setPeriod(id, periodMs, periodMs / 2);
+        } else {
+            sched_setPeriod(id, periodMs, 0);
+        }
+    }
+    if (calRequest) {
+        calRequest = false;
+        if (sensorState != READLIGHT && sensorState != LIGHTRX) {
+            const SensorDriver *drv = sensorRegistry[SENSOR_MPU9250];
+            I2C_Handle bus = sensor_open(SENSOR_BUS_MPU);
+            mpu9250_set_scale(config_getU32(CONFIG_ASCALE), config_getU32(CONFIG_GSCALE));
+            drv->init(&bus);
+            if (sensorState == SAMPLEALL) {
+                drv->start(&bus);
+            }
+            if (imuFixedMs != 0) {
+                applyFixedRate(&bus, imuFixedMs);
+            } else {
+                applyRateTier(&bus);
+            }
+        }
+    }
+}
+
+void sensorTaskFxn(UArg arg0, UArg arg1) {
+    I2C_Handle i2c;
+
+    enterSensorState(&i2c);
     double previous_time =  Clock_getTicks()/(10000 / Clock_tickPeriod); // tick period is us 1000000 us in second
     bool rotated_90 = false;
     bool rotated_90_z = false;
  
-    //Menu related variables
-    const double menuMovementThreshold = 0.40;
-    const double timerLimit = 1000; // in deciseconds
+    //Menu related variables, re-read every sample so changes apply at once
+    double menuMovementThreshold;
+    double timerLimit; // in 10 ms units
     double timer = 0;
-    char debug_msg[100];
+    uint32_t stillMs = 0;
+    ratectl_reset();
     while (true) {
+        uint32_t samplePeriodMs = 100;
+        applyCommandRequests(&i2c);
+        menuMovementThreshold = config_getFloat(CONFIG_MENU_THRESHOLD);
+        timerLimit = config_getU32(CONFIG_TIMER_LIMIT);
         switch (sensorState){
-            // Should programState be rad and if it is DATA_READY it wouldn't be read again
             case MENU: {
                 PIN_setOutputValue(ledHandle, Board_LED0, 1);
                 float ax, ay, az, gx, gy, gz;
+                int32_t imu[6];
+                wakeup_expect(WAKE_I2C, true);
                 mpu9250_get_data(&i2c, &ax, &ay, &az, &gx, &gy, &gz);
+                wakeup_expect(WAKE_I2C, false);
+                imuToFixed(ax, ay, az, gx, gy, gz, imu);
+
+                samplePeriodMs = trackMotion(&i2c, imu);
+                if (menuStatus == IDLE && ratectl_tier() == RATECTL_LOW) {
+                    stillMs += samplePeriodMs;
+                    if (stillMs >= config_getU32(CONFIG_WOM_IDLE_MS)) {
+                        sleepUntilMotion(&i2c);
+                        stillMs = 0;
+                    }
+                } else {
+                    stillMs = 0;
+                }
 
                 if( menuStatus == IDLE && menuMovementThreshold < ax){
                     buzzerOpen(hBuzzer);
@@ -305,7 +1087,6 @@ void sensorTaskFxn(UArg arg0, UArg arg1) {
                     Task_sleep(500000 / Clock_tickPeriod);
                     buzzerClose();
                     menuStatus = SERIOUS;
-                    System_flush();
                 }
                 else if(menuStatus == IDLE && ax < -menuMovementThreshold){
                     //menuStatus = FUN;
@@ -315,13 +1096,12 @@ void sensorTaskFxn(UArg arg0, UArg arg1) {
                     double deltaTime = Clock_getTicks()/(10000 / Clock_tickPeriod) - previous_time;
                     previous_time = Clock_getTicks()/(10000 / Clock_tickPeriod);
                     timer += deltaTime;
-                    sprintf(debug_msg,"Delta time: %f timer: %f", deltaTime, timer);
-                    System_printf(debug_msg);
-                    System_flush();
+                    TRACE2("Delta time: %d timer: %d", (int32_t)deltaTime, (int32_t)timer);
 
                     if(menuStatus == SERIOUS && timer <= timerLimit &&  menuMovementThreshold < ay ){
                         PIN_setOutputValue(ledHandle, Board_LED0, 0);
                         sensorState = READGYRO;
+                        gesture_reset(&gestureWindow);
                         menuStatus = IDLE;
                         timer = 0;
                     }
@@ -344,10 +1124,19 @@ void sensorTaskFxn(UArg arg0, UArg arg1) {
                 break;
             }
             case READGYRO: {
-                float threshold = 0.4f;
-                float threshold_z = 1.3f;
+                int32_t thresholdMg = (int32_t)(config_getFloat(CONFIG_THRESHOLD) * 1000.0f);
+                int32_t thresholdZMg = (int32_t)(config_getFloat(CONFIG_THRESHOLD_Z) * 1000.0f);
+                enum gestureClass gesture = GESTURE_NONE;
                 float ax, ay, az, gx, gy, gz;
+                int32_t imu[6];
+                wakeup_expect(WAKE_I2C, true);
                 mpu9250_get_data(&i2c, &ax, &ay, &az, &gx, &gy, &gz);
+                wakeup_expect(WAKE_I2C, false);
+                uint32_t tSample = symbol_now();
+                imuToFixed(ax, ay, az, gx, gy, gz, imu);
+
+                // Slow down while the tag lies still, back to full rate on the first moving sample
+                samplePeriodMs = trackMotion(&i2c, imu);
 
                 if (ax > 0.9f && ay < 0.1f && az < 0.1f && gx < 1.0f && gy < 1.0f && gz < 1.0f){
                     buzzerOpen(hBuzzer);
@@ -356,60 +1145,74 @@ void sensorTaskFxn(UArg arg0, UArg arg1) {
                     buzzerClose();
 
                     sensorState = MENU;
+                    ratectl_reset();
+                    applyRateTier(&i2c);
                 }
                 double time = Clock_getTicks()/(10000 / Clock_tickPeriod);
 
-                if(ax > threshold && ay < threshold && !rotated_90 && !rotated_90_z && az < 1.1f){
-                    buzzerOpen(hBuzzer);
-                    buzzerSetFrequency(2000);
-                    Task_sleep(100000 / Clock_tickPeriod);
-                    buzzerClose();
-                    rotated_90 = true;
-                    char_to_send = '.';
-                    programState = DATA_READY;
+                if (config_getU32(CONFIG_GESTURE)) {
+                    gesture = gesture_update(&gestureWindow, imu);
+                } else {
+                    // A gesture is latched until its axis drops under the threshold again
+                    if (!rotated_90 && !rotated_90_z) {
+                        gesture = gesture_threshold(imu, thresholdMg, thresholdZMg);
+                        rotated_90 = gesture == GESTURE_DOT;
+                        rotated_90_z = gesture == GESTURE_DASH;
+                    }
+                    if(rotated_90_z && imu[2] < thresholdZMg){
+                        rotated_90_z = false;
+                    }
+                    if(rotated_90 && imu[0] < thresholdMg){
+                        rotated_90 = false;
+                    }
                 }
 
-                if(az > threshold_z && ax < threshold && !rotated_90_z && !rotated_90){
+                if (gesture != GESTURE_NONE) {
+                    uint32_t tDecision = symbol_now();
                     buzzerOpen(hBuzzer);
                     buzzerSetFrequency(2000);
-                    Task_sleep(500000 / Clock_tickPeriod);
+                    Task_sleep((gesture == GESTURE_DOT ? 100000 : 500000) / Clock_tickPeriod);
                     buzzerClose();
-                    rotated_90_z = true;
-                    char_to_send = '-';
-                    programState = DATA_READY;
-                }
-
-                if(rotated_90_z && az < threshold_z){
-                    rotated_90_z = false;
-                }
-
-                if(rotated_90 && ax < threshold){
-                    rotated_90 = false;
+                    symbol_post(gesture == GESTURE_DOT ? '.' : '-', tSample, tDecision);
                 }
-
                 break;
             }
             case READLIGHT: {
-                double data = opt3001_get_data(&i2c);
-                char debug_msg[100];
-                sprintf(debug_msg,"...%f",data);
-                System_printf(debug_msg);
-                System_flush();
-
-                ambientLight = data;
-                programState = DATA_READY;
+                wakeup_expect(WAKE_I2C, true);
+                int32_t centilux = opt3001_get_data(&i2c);
+                wakeup_expect(WAKE_I2C, false);
+                if (centilux >= 0) {
+                    TRACE1("lux x100: %d", centilux);
+                    ambientLight = centilux;
+                }
 
                 //Change sensorState and close connection.
                 //I2C_close();
                 break;
             }
+            case SAMPLEALL: {
+                // Blocks until the next release, the scheduler does the timing
+                sched_dispatch();
+                continue;
+            }
+            case LIGHTRX: {
+                // Paced by the conversions, every result is a sample
+                int32_t centilux = opt3001_wait_data(&i2c, LIGHTRX_TIMEOUT_US);
+                if (centilux >= 0) {
+                    uint32_t now = symbol_now();
+                    TRACE2("optrx %u %d", now, centilux);
+                    ambientLight = centilux;
+                    optrx_sample(&lightRx, centilux, now);
+                }
+                continue;
+            }
             default: {
                 System_printf("Running default case. Not reading any sensors.\n");
                 System_flush();
                 break;
             }
         }
-        Task_sleep(100000 / Clock_tickPeriod);
+        waitSamplePeriod(samplePeriodMs);
     }
 }
 
@@ -428,10 +1231,39 @@ Int main(void) {
     Task_Handle musicTaskHandle;
     Task_Params musicTaskParams;
 
+    //Wakeup sources of the sensor and UART tasks
+    Semaphore_Params semParams;
+    Clock_Params clockParams;
+
     //Inits
     Board_initGeneral();
+    powertrack_init();
+    // Internal flash reads only, safe before BIOS_start
+    config_init();
+    mpu9250_set_scale(config_getU32(CONFIG_ASCALE), config_getU32(CONFIG_GSCALE));
+#ifdef CACHE_AS_RAM
+    // Keep GPRAM powered in standby, the buffers placed there are live data
+    powertrack_setConstraint(POWER_OWNER_CACHE, PowerCC26XX_SB_VIMS_CACHE_RETAIN);
+#endif
     Board_initI2C();
     Board_initUART();
+    Board_initSPI();
+
+    Semaphore_Params_init(&semParams);
+    semParams.mode = Semaphore_Mode_BINARY;
+    Semaphore_construct(&sampleSemStruct, 0, &semParams);
+    sampleSem = Semaphore_handle(&sampleSemStruct);
+    Semaphore_construct(&uartWakeStruct, 0, &semParams);
+    uartWake = Semaphore_handle(&uartWakeStruct);
+
+    Clock_Params_init(&clockParams);
+    clockParams.period = 0;
+    clockParams.startFlag = FALSE;
+    Clock_construct(&sampleClockStruct, (Clock_FuncPtr)sampleClockFxn, 1, &clockParams);
+    sampleClock = Clock_handle(&sampleClockStruct);
+    clockParams.period = UART_HOUSEKEEPING_MS * 1000 / Clock_tickPeriod;
+    clockParams.startFlag = TRUE;
+    Clock_construct(&housekeepingClock, (Clock_FuncPtr)housekeepingFxn, clockParams.period, &clockParams);
 
     // Button and led inits
     buttonHandle = PIN_open(&buttonState, buttonConfig);
@@ -442,9 +1274,20 @@ Int main(void) {
     if(!ledHandle) {
        System_abort("Error initializing LED pins\n");
     }
-    if (PIN_registerIntCb(buttonHandle, &buttonFxn) != 0) {
+    straightkey_init(keySymbolFxn, NULL);
+    if (PIN_registerIntCb(buttonHandle, &straightkey_pinFxn) != 0) {
        System_abort("Error registering button callback function");
     }
+    powerButtonHandle = PIN_open(&powerButtonState, powerButtonConfig);
+    if (!powerButtonHandle || PIN_registerIntCb(powerButtonHandle, &powerFxn) != 0) {
+       System_abort("Error initializing power button\n");
+    }
+
+    //Stack monitor, paint stacks before any task runs on them
+    stackmon_paintSystemStack();
+    stackmon_paint(sensorTaskStack, STACKSIZE);
+    stackmon_paint(uartTaskStack, STACKSIZE);
+    stackmon_paint(taskStack, STACKSIZE);
 
     //Task Inits
     Task_Params_init(&sensorTaskParams);
@@ -478,6 +1321,11 @@ Int main(void) {
     if (musicTaskHandle == NULL) {
         System_abort("Task create failed!");
     }
+
+    stackmon_register("sensor", sensorTaskStack, STACKSIZE);
+    stackmon_register("uart", uartTaskStack, STACKSIZE);
+    stackmon_register("music", taskStack, STACKSIZE);
+    stackmon_registerTask("idle", Task_getIdleTask());
     
     //Sanity Check
     System_printf("Hello world!\n");
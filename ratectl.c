@@ -0,0 +1,177 @@
+/*
+ * ratectl.c
+ *
+ *  Adaptive IMU sample rate, see ratectl.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <xdc/std.h>
+#include <ti/sysbios/hal/Hwi.h>
+#include <ti/sysbios/knl/Clock.h>
+
+#include "ratectl.h"
+#include "powertrack.h"
+#include "trace.h"
+#include "report.h"
+
+// The high tier matches the old fixed 41 Hz DLPF setting, the lower tiers
+// narrow the filter with the output rate to avoid aliasing.
+static const RateTier tiers[RATECTL_TIERCOUNT] = {
+    //  period  div  dlpf  enter  exit  hold
+    {   200,   199,   6,     0,    0, 0     },  // 5 Hz, 5 Hz DLPF
+    {    40,    39,   5,    20,   12, 10000 },  // 25 Hz, 10 Hz DLPF
+    {    10,     9,   3,    50,   30, 2000  }   // 100 Hz, 41 Hz DLPF
+};
+
+static enum ratectlTier tier = RATECTL_HIGH;
+static uint32_t level = 0;        // filtered activity << RATECTL_FILTER
+static uint32_t quietMs = 0;
+static uint64_t tierStart = 0;
+static RateStats stats[RATECTL_TIERCOUNT] = { [RATECTL_HIGH] = { 0, 1 } };
+
+static const char *tierNames[RATECTL_TIERCOUNT] = { "low", "medium", "high" };
+
+static uint32_t ratectl_isqrt(uint32_t x) {
+
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+
+    while (bit > x) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+// Hwi disabled
+static void ratectl_switch(enum ratectlTier next) {
+
+    uint64_t now = powertrack_now();
+
+    stats[tier].residencyTicks += now - tierStart;
+    if (next != tier) {
+        stats[next].entries++;
+    }
+    tierStart = now;
+    tier = next;
+    quietMs = 0;
+}
+
+static void ratectl_enter(enum ratectlTier next) {
+
+    UInt key = Hwi_disable();
+
+    ratectl_switch(next);
+    Hwi_restore(key);
+
+    TRACE2("rate: tier %d activity %u", next, level >> RATECTL_FILTER);
+}
+
+void ratectl_reset(void) {
+
+    UInt key = Hwi_disable();
+
+    ratectl_switch(RATECTL_HIGH);
+    level = 0;
+    Hwi_restore(key);
+}
+
+void ratectl_clearStats(void) {
+
+    UInt key = Hwi_disable();
+
+    memset(stats, 0, sizeof(stats));
+    stats[tier].entries = 1;
+    tierStart = powertrack_now();
+    Hwi_restore(key);
+}
+
+// Activity is the deviation of |a| from 1 g in mg plus |g| in deg/s. Returns
+// true when the tier changed, the caller then applies ratectl_get(tier).
+bool ratectl_update(const int32_t *accelMg, const int32_t *gyroCdps) {
+
+    uint32_t a2 = 0, gyro = 0, activity;
+    int32_t dev;
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        a2 += (uint32_t)(accelMg[i] * accelMg[i]);
+        gyro += (uint32_t)(gyroCdps[i] < 0 ? -gyroCdps[i] : gyroCdps[i]);
+    }
+    dev = (int32_t)ratectl_isqrt(a2) - 1000;
+    activity = (uint32_t)(dev < 0 ? -dev : dev) + gyro / 100;
+    level += activity - (level >> RATECTL_FILTER);
+
+    // No filtering on the way up
+    if (activity >= RATECTL_MOTION) {
+        if (tier != RATECTL_HIGH) {
+            ratectl_enter(RATECTL_HIGH);
+            return true;
+        }
+        quietMs = 0;
+        return false;
+    }
+
+    if (tier < RATECTL_HIGH && (level >> RATECTL_FILTER) > tiers[tier + 1].enter) {
+        ratectl_enter(tier + 1);
+        return true;
+    }
+
+    if (tier > RATECTL_LOW && (level >> RATECTL_FILTER) < tiers[tier].exit) {
+        quietMs += tiers[tier].periodMs;
+        if (quietMs >= tiers[tier].holdMs) {
+            ratectl_enter(tier - 1);
+            return true;
+        }
+    } else {
+        quietMs = 0;
+    }
+    return false;
+}
+
+enum ratectlTier ratectl_tier(void) {
+
+    return tier;
+}
+
+const RateTier *ratectl_get(enum ratectlTier t) {
+
+    return &tiers[t];
+}
+
+uint32_t ratectl_activity(void) {
+
+    return level >> RATECTL_FILTER;
+}
+
+// Export format, one line per tier:
+//   rate <tier> T=<ms> n=<entries> res=<ms>
+void ratectl_report(UART_Handle uart) {
+
+    char line[64];
+    int t;
+
+    for (t = 0; t < RATECTL_TIERCOUNT; t++) {
+        RateStats s;
+        UInt key = Hwi_disable();
+        s = stats[t];
+        if (t == tier) {
+            s.residencyTicks += powertrack_now() - tierStart;
+        }
+        Hwi_restore(key);
+
+        report_printf(uart, line, sizeof(line), "rate %s T=%u n=%lu res=%lu\r\n", tierNames[t],
+                      tiers[t].periodMs, (unsigned long)s.entries,
+                      (unsigned long)(s.residencyTicks / (1000 / Clock_tickPeriod)));
+    }
+}
@@ -0,0 +1,54 @@
+/*
+ * ratectl.h
+ *
+ *  Adaptive IMU sample rate. An activity estimate from the accelerometer and
+ *  gyro magnitudes picks one of three rate tiers. Any sample above
+ *  RATECTL_MOTION jumps straight to the high tier, so a gesture is sampled at
+ *  full rate from its second sample on; stepping down needs the filtered
+ *  activity to stay under the tier's exit level for its hold time.
+ *
+ *  ratectl_reset starts over from the high tier on a mode change or wake-up;
+ *  the residency statistics carry on through it and are only cleared by
+ *  ratectl_clearStats ($stats reset).
+ */
+
+#ifndef RATECTL_H_
+#define RATECTL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ti/drivers/UART.h>
+
+#define RATECTL_MOTION      80    // activity that means the tag is being moved
+#define RATECTL_FILTER      3     // activity EWMA weight 1/2^n
+
+enum ratectlTier {
+    RATECTL_LOW = 0,
+    RATECTL_MEDIUM,
+    RATECTL_HIGH,
+    RATECTL_TIERCOUNT
+};
+
+typedef struct {
+    uint16_t periodMs;      // host sampling period
+    uint8_t smplrtDiv;      // MPU9250 SMPLRT_DIV, 1 kHz / (1 + div)
+    uint8_t dlpf;           // MPU9250 DLPF_CFG and A_DLPFCFG
+    uint16_t enter;         // filtered activity above this steps up into the tier
+    uint16_t exit;          // filtered activity below this starts the hold time
+    uint16_t holdMs;        // quiet time before stepping down a tier
+} RateTier;
+
+typedef struct {
+    uint64_t residencyTicks;
+    uint32_t entries;
+} RateStats;
+
+void ratectl_reset(void);
+void ratectl_clearStats(void);
+bool ratectl_update(const int32_t *accelMg, const int32_t *gyroCdps);
+enum ratectlTier ratectl_tier(void);
+const RateTier *ratectl_get(enum ratectlTier tier);
+uint32_t ratectl_activity(void);
+void ratectl_report(UART_Handle uart);
+
+#endif /* RATECTL_H_ */
@@ -0,0 +1,30 @@
+/*
+ * report.c
+ *
+ *  Bounded UART report lines, see report.h.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+
+#include "report.h"
+
+// Returns the number of bytes written. vsnprintf returns the untruncated
+// length, the line ends at size - 1.
+int report_printf(UART_Handle uart, char *line, size_t size, const char *format, ...) {
+
+    va_list args;
+    int len;
+
+    va_start(args, format);
+    len = vsnprintf(line, size, format, args);
+    va_end(args);
+    if (len < 0) {
+        return 0;
+    }
+    if ((size_t)len >= size) {
+        len = (int)size - 1;
+    }
+    UART_write(uart, line, len);
+    return len;
+}
@@ -0,0 +1,17 @@
+/*
+ * report.h
+ *
+ *  Bounded lines for the UART reports. report_printf formats into the
+ *  caller's buffer and writes what fits, so a line longer than its buffer
+ *  is cut short instead of overflowing the stack.
+ */
+
+#ifndef REPORT_H_
+#define REPORT_H_
+
+#include <stddef.h>
+#include <ti/drivers/UART.h>
+
+int report_printf(UART_Handle uart, char *line, size_t size, const char *format, ...);
+
+#endif /* REPORT_H_ */
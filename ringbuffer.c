@@ -0,0 +1,31 @@
+/*
+ * ringbuffer.c
+ *
+ *  Single producer, single consumer byte ring, see ringbuffer.h.
+ */
+
+#include "ringbuffer.h"
+#include "memsection.h"
+
+RAMFUNC void RingBuffer_Write(RingBuffer *buffer, uint8_t byte) {
+    uint16_t next = (buffer->head + 1) & (buffer->size - 1);
+
+    if (next != buffer->tail) {
+        buffer->data[buffer->head] = byte;
+        buffer->head = next;
+    }
+}
+
+RAMFUNC int RingBuffer_Read(RingBuffer *buffer, uint8_t *byte) {
+    if (buffer->head == buffer->tail) {
+        return -1;
+    }
+    *byte = buffer->data[buffer->tail];
+    buffer->tail = (buffer->tail + 1) & (buffer->size - 1);
+    return 0;
+}
+
+// Bytes waiting, a producer can check size - 1 - count before a multi-byte write
+uint16_t RingBuffer_Count(const RingBuffer *buffer) {
+    return (buffer->head - buffer->tail) & (buffer->size - 1);
+}
@@ -0,0 +1,27 @@
+/*
+ * ringbuffer.h
+ *
+ *  Single producer, single consumer byte ring. The storage is supplied by the
+ *  caller so large rings can be placed in GPRAM (see memsection.h).
+ *  size must be a power of two.
+ */
+
+#ifndef RINGBUFFER_H_
+#define RINGBUFFER_H_
+
+#include <stdint.h>
+
+typedef struct {
+    uint8_t *data;
+    uint16_t size;
+    volatile uint16_t head;
+    volatile uint16_t tail;
+} RingBuffer;
+
+#define RINGBUFFER_INIT(storage) { (storage), sizeof(storage), 0, 0 }
+
+void RingBuffer_Write(RingBuffer *buffer, uint8_t byte);
+int RingBuffer_Read(RingBuffer *buffer, uint8_t *byte);
+uint16_t RingBuffer_Count(const RingBuffer *buffer);
+
+#endif /* RINGBUFFER_H_ */
@@ -0,0 +1,364 @@
+/*
+ * scheduler.c
+ *
+ *  Rate-monotonic multi-sensor sampling, see scheduler.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <xdc/std.h>
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/hal/Hwi.h>
+#include <ti/sysbios/knl/Clock.h>
+#include <ti/sysbios/knl/Semaphore.h>
+
+#include "scheduler.h"
+#include "trace.h"
+#include "wakeup.h"
+#include "report.h"
+
+// Entries are kept sorted by period, index 0 has the highest priority
+static SchedEntry entries[SENSOR_COUNT];
+static uint8_t entryCount = 0;
+
+static Clock_Struct wakeClock;
+static Clock_Handle hWakeClock = NULL;
+static Semaphore_Struct wakeSem;
+static Semaphore_Handle hWakeSem = NULL;
+static bool sortPending = false;
+
+// Liu & Layland bound n(2^(1/n) - 1) in permille for n = 1..SENSOR_COUNT
+static const uint16_t rmBound[SENSOR_COUNT] = { 1000, 828, 779, 756, 743 };
+
+static void sched_clockFxn(UArg arg) {
+
+    wakeup_mark(WAKE_CLOCK_SCHED);
+    Semaphore_post(hWakeSem);
+}
+
+static uint32_t sched_msToTicks(uint32_t ms) {
+
+    return ms * (1000 / Clock_tickPeriod);
+}
+
+static void sched_init(void) {
+
+    Clock_Params clockParams;
+    Semaphore_Params semParams;
+
+    Semaphore_Params_init(&semParams);
+    semParams.mode = Semaphore_Mode_BINARY;
+    Semaphore_construct(&wakeSem, 0, &semParams);
+    hWakeSem = Semaphore_handle(&wakeSem);
+
+    // One-shot, the timeout is set for every dispatch
+    Clock_Params_init(&clockParams);
+    clockParams.period = 0;
+    clockParams.startFlag = FALSE;
+    Clock_construct(&wakeClock, (Clock_FuncPtr)sched_clockFxn, 1, &clockParams);
+    hWakeClock = Clock_handle(&wakeClock);
+}
+
+// Must be called from a Task before sched_start(). The period is clamped to
+// the driver's capabilities and a deadline of 0 means the period.
+bool sched_add(enum sensorId id, uint32_t periodMs, uint32_t deadlineMs, SchedCallback callback) {
+
+    const SensorDriver *drv = sensorRegistry[id];
+    const SensorCaps *caps = drv->get_capabilities();
+    I2C_Handle i2c;
+    SchedEntry e;
+    int i;
+
+    for (i = 0; i < entryCount; i++) {
+        if (entries[i].id == id) {
+            return false;
+        }
+    }
+    if (entryCount == SENSOR_COUNT) {
+        return false;
+    }
+    if (hWakeSem == NULL) {
+        sched_init();
+    }
+
+    if (periodMs < caps->minPeriodMs) {
+        periodMs = caps->minPeriodMs;
+    }
+    if (periodMs > caps->maxPeriodMs) {
+        periodMs = caps->maxPeriodMs;
+    }
+    if (deadlineMs == 0 || deadlineMs > periodMs) {
+        deadlineMs = periodMs;
+    }
+
+    i2c = sensor_open(drv->bus);
+    if (!drv->init(&i2c) || !drv->start(&i2c)) {
+        TRACE1("sched: %d init failed", id);
+        return false;
+    }
+
+    memset(&e, 0, sizeof(e));
+    e.drv = drv;
+    e.id = id;
+    e.callback = callback;
+    e.periodTicks = sched_msToTicks(periodMs);
+    e.deadlineTicks = sched_msToTicks(deadlineMs);
+
+    // Rate-monotonic priority: insert before the first longer period
+    i = entryCount;
+    while (i > 0 && entries[i - 1].periodTicks > e.periodTicks) {
+        entries[i] = entries[i - 1];
+        i--;
+    }
+    entries[i] = e;
+    entryCount++;
+    return true;
+}
+
+static void sched_sort(void) {
+
+    int i, j;
+
+    for (i = 1; i < entryCount; i++) {
+        SchedEntry e = entries[i];
+        for (j = i; j > 0 && entries[j - 1].periodTicks > e.periodTicks; j--) {
+            entries[j] = entries[j - 1];
+        }
+        entries[j] = e;
+    }
+}
+
+// Changes the period of a running sensor, e.g. from a read callback. The next
+// release moves to one new period after the current one. The priority order
+// is restored after the dispatch, a callback must not move entries under it.
+bool sched_setPeriod(enum sensorId id, uint32_t periodMs, uint32_t deadlineMs) {
+
+    SchedEntry *e = (SchedEntry *)sched_get(id);
+
+    if (e == NULL) {
+        return false;
+    }
+    if (deadlineMs == 0 || deadlineMs > periodMs) {
+        deadlineMs = periodMs;
+    }
+    e->periodTicks = sched_msToTicks(periodMs);
+    e->deadlineTicks = sched_msToTicks(deadlineMs);
+    sortPending = true;
+    return true;
+}
+
+static void sched_arm(void) {
+
+    uint32_t now = Clock_getTicks();
+    int32_t wait = 0x7FFFFFFF;
+    int i;
+
+    for (i = 0; i < entryCount; i++) {
+        int32_t d = (int32_t)(entries[i].release - now);
+        if (d < wait) {
+            wait = d;
+        }
+    }
+
+    Clock_stop(hWakeClock);
+    if (wait <= 0) {
+        Semaphore_post(hWakeSem);
+    } else {
+        Clock_setTimeout(hWakeClock, wait);
+        Clock_start(hWakeClock);
+    }
+}
+
+// All sensors are released together, which is the critical instant for the
+// rate-monotonic analysis.
+void sched_start(void) {
+
+    uint32_t now = Clock_getTicks();
+    int i;
+
+    for (i = 0; i < entryCount; i++) {
+        entries[i].release = now;
+    }
+    sched_arm();
+}
+
+// Sleeps every sensor and removes all entries, from the sampling task
+void sched_stop(void) {
+
+    int i;
+
+    if (hWakeSem == NULL) {
+        return;
+    }
+    Clock_stop(hWakeClock);
+    Semaphore_pend(hWakeSem, BIOS_NO_WAIT);
+    for (i = 0; i < entryCount; i++) {
+        I2C_Handle i2c = sensor_open(entries[i].drv->bus);
+        entries[i].drv->sleep(&i2c);
+    }
+    entryCount = 0;
+    sortPending = false;
+}
+
+static void sched_read(SchedEntry *e, I2C_Handle i2c) {
+
+    int32_t values[SENSOR_MAX_CHANNELS];
+    uint32_t start, end, late;
+    int n;
+
+    start = Clock_getTicks();
+    wakeup_expect(WAKE_I2C, true);
+    n = e->drv->read(&i2c, values);
+    wakeup_expect(WAKE_I2C, false);
+    end = Clock_getTicks();
+
+    if (n > 0) {
+        e->reads++;
+        if (e->callback != NULL) {
+            e->callback(e->id, values, n);
+        }
+    } else if (n == 0) {
+        e->notReady++;
+    } else {
+        e->errors++;
+    }
+
+    if ((end - start) * Clock_tickPeriod > e->maxExecUs) {
+        e->maxExecUs = (end - start) * Clock_tickPeriod;
+    }
+    late = end - e->release;
+    if (late * Clock_tickPeriod > e->maxLatenessUs) {
+        e->maxLatenessUs = late * Clock_tickPeriod;
+    }
+    if (late > e->deadlineTicks) {
+        e->misses++;
+        TRACE2("sched: %d missed by %u us", e->id, (late - e->deadlineTicks) * Clock_tickPeriod);
+    }
+
+    // Releases that have already passed are dropped, not caught up in a burst
+    e->release += e->periodTicks;
+    while ((int32_t)(end - e->release) >= 0) {
+        e->release += e->periodTicks;
+        e->misses++;
+    }
+}
+
+// Blocks until the next release, then reads every due sensor in priority
+// order. Once a bus is open all due sensors on it are read before the bus
+// is switched.
+void sched_dispatch(void) {
+
+    bool due[SENSOR_COUNT];
+    uint32_t now;
+    int i, j;
+
+    Semaphore_pend(hWakeSem, BIOS_WAIT_FOREVER);
+
+    now = Clock_getTicks();
+    for (i = 0; i < entryCount; i++) {
+        due[i] = (int32_t)(now - entries[i].release) >= 0;
+    }
+
+    for (i = 0; i < entryCount; i++) {
+        enum sensorBus bus;
+        I2C_Handle i2c;
+
+        if (!due[i]) {
+            continue;
+        }
+        bus = entries[i].drv->bus;
+        i2c = sensor_open(bus);
+        for (j = i; j < entryCount; j++) {
+            if (due[j] && entries[j].drv->bus == bus) {
+                sched_read(&entries[j], i2c);
+                due[j] = false;
+            }
+        }
+    }
+
+    if (sortPending) {
+        sortPending = false;
+        sched_sort();
+    }
+    sched_arm();
+}
+
+static uint32_t sched_gcd(uint32_t a, uint32_t b) {
+
+    while (b != 0) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Least common multiple of the periods, 0 if it does not fit in 32 bits
+uint32_t sched_hyperperiodMs(void) {
+
+    uint64_t lcm = 1;
+    int i;
+
+    for (i = 0; i < entryCount; i++) {
+        uint32_t p = entries[i].periodTicks / (1000 / Clock_tickPeriod);
+        lcm = lcm / sched_gcd((uint32_t)lcm, p) * p;
+        if (lcm > 0xFFFFFFFF) {
+            return 0;
+        }
+    }
+    return (uint32_t)lcm;
+}
+
+// Sum of worst seen execution time / period, permille
+uint32_t sched_utilisation(void) {
+
+    uint32_t u = 0;
+    int i;
+
+    for (i = 0; i < entryCount; i++) {
+        u += (uint64_t)entries[i].maxExecUs * 1000 / (entries[i].periodTicks * Clock_tickPeriod);
+    }
+    return u;
+}
+
+const SchedEntry *sched_get(enum sensorId id) {
+
+    int i;
+
+    for (i = 0; i < entryCount; i++) {
+        if (entries[i].id == id) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+// Export format, one line per sensor in priority order and a summary:
+//   sched <name> T=<ms> D=<ms> n=<reads> nr=<not ready> err=<errors> miss=<misses> late=<us> exec=<us>
+//   sched hyper=<ms> util=<permille> bound=<permille>
+void sched_report(UART_Handle uart) {
+
+    char line[144];
+    int i;
+
+    for (i = 0; i < entryCount; i++) {
+        SchedEntry e;
+        UInt key = Hwi_disable();
+        e = entries[i];
+        Hwi_restore(key);
+
+        report_printf(uart, line, sizeof(line), "sched %s T=%lu D=%lu n=%lu nr=%lu err=%lu miss=%lu late=%lu exec=%lu\r\n",
+                      e.drv->name,
+                      (unsigned long)(e.periodTicks * Clock_tickPeriod / 1000),
+                      (unsigned long)(e.deadlineTicks * Clock_tickPeriod / 1000),
+                      (unsigned long)e.reads, (unsigned long)e.notReady,
+                      (unsigned long)e.errors, (unsigned long)e.misses,
+                      (unsigned long)e.maxLatenessUs, (unsigned long)e.maxExecUs);
+    }
+    if (entryCount > 0) {
+        report_printf(uart, line, sizeof(line), "sched hyper=%lu util=%lu bound=%u\r\n",
+                      (unsigned long)sched_hyperperiodMs(),
+                      (unsigned long)sched_utilisation(), rmBound[entryCount - 1]);
+    }
+}
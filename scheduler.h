@@ -0,0 +1,48 @@
+/*
+ * scheduler.h
+ *
+ *  Rate-monotonic sampling of several sensors at once. Every sensor gets its
+ *  own period and relative deadline; shorter periods have higher priority.
+ *  A single one-shot Clock wakes the sampling task at the earliest release,
+ *  so the task is blocked (and the MCU may enter standby) between dispatches.
+ *  Due reads are grouped by I2C bus to keep bus switches to one per group.
+ */
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ti/drivers/UART.h>
+
+#include "sensors/sensor.h"
+
+// Called from the sampling task with the channels returned by drv->read()
+typedef void (*SchedCallback)(enum sensorId id, const int32_t *values, int channels);
+
+typedef struct {
+    const SensorDriver *drv;
+    enum sensorId id;
+    SchedCallback callback;
+    uint32_t periodTicks;
+    uint32_t deadlineTicks;
+    uint32_t release;         // next release, Clock ticks
+    uint32_t reads;
+    uint32_t notReady;        // read() returned 0
+    uint32_t errors;          // read() returned -1
+    uint32_t misses;          // finished after release + deadline, or release skipped
+    uint32_t maxLatenessUs;   // release -> read finished
+    uint32_t maxExecUs;
+} SchedEntry;
+
+bool sched_add(enum sensorId id, uint32_t periodMs, uint32_t deadlineMs, SchedCallback callback);
+bool sched_setPeriod(enum sensorId id, uint32_t periodMs, uint32_t deadlineMs);
+void sched_start(void);
+void sched_stop(void);
+void sched_dispatch(void);
+uint32_t sched_hyperperiodMs(void);
+uint32_t sched_utilisation(void);
+const SchedEntry *sched_get(enum sensorId id);
+void sched_report(UART_Handle uart);
+
+#endif /* SCHEDULER_H_ */
@@ -8,163 +8,203 @@
  */
 
 #include <xdc/runtime/System.h>
+#include <ti/sysbios/knl/Task.h>
+#include <ti/sysbios/knl/Clock.h>
 #include <stdio.h>
 #include "Board.h"
 #include "bmp280.h"
+#include "trace.h"
 
 // konversiovakiot
-uint16_t dig_T1;
-int16_t  dig_T2;
-int16_t  dig_T3;
-uint16_t dig_P1;
-int16_t  dig_P2;
-int16_t  dig_P3;
-int16_t  dig_P4;
-int16_t  dig_P5;
-int16_t  dig_P6;
-int16_t  dig_P7;
-int16_t  dig_P8;
-int16_t  dig_P9;
-int32_t	 t_fine = 0;
-
-// Debug-viestit
-char str[80];
-
-void bmp280_set_trimming(char *v) {
-
-	dig_T1 = (v[1] << 8) | v[0];
-	dig_T2 = (v[3] << 8) | v[2];
-	dig_T3 = (v[5] << 8) | v[4];
-	dig_P1 = (v[7] << 8) | v[6];
-	dig_P2 = (v[9] << 8) | v[8];
-	dig_P3 = (v[11] << 8) | v[10];
-	dig_P1 = (v[7] << 8) | v[6];
-	dig_P2 = (v[9] << 8) | v[8];
-	dig_P3 = (v[11] << 8) | v[10];
-	dig_P4 = (v[13] << 8) | v[12];
-	dig_P5 = (v[15] << 8) | v[14];
-	dig_P6 = (v[17] << 8) | v[16];
-	dig_P7 = (v[19] << 8) | v[18];
-	dig_P8 = (v[21] << 8) | v[20];
-	dig_P9 = (v[23] << 8) | v[22];
+static Bmp280Calib calib;
+
+// Current ctrl_meas setting, forced mode rewrites it for every measurement
+static uint8_t ctrlMeas = 0x2F;
+
+static uint32_t bmp280_measure_time(void);
+
+// minPeriodMs and latencyUs follow the oversampling, see bmp280_configure
+static SensorCaps bmp280Caps = {
+	.minPeriodMs = 14,		// normal mode, x1/x4 oversampling
+	.maxPeriodMs = 4000,	// t_sb maximum
+	.latencyUs = 13325,		// maximum measurement time at x1/x4
+	.activeUa = 720,
+	.sleepUa = 0,
+	.channels = 2,
+	.units = "Pa,cdegC"
+};
+
+static bool bmp280_write_reg(I2C_Handle *i2c, uint8_t reg, uint8_t value) {
+
+	I2C_Transaction i2cTransaction;
+	uint8_t itxBuffer[2];
+
+	i2cTransaction.slaveAddress = Board_BMP280_ADDR;
+	itxBuffer[0] = reg;
+	itxBuffer[1] = value;
+	i2cTransaction.writeBuf = itxBuffer;
+	i2cTransaction.writeCount = 2;
+	i2cTransaction.readBuf = NULL;
+	i2cTransaction.readCount = 0;
+
+	return I2C_transfer(*i2c, &i2cTransaction);
 }
 
-double bmp280_temp_compensation(uint32_t adc_T) {
+void bmp280_setup(I2C_Handle *i2c) {
 
-	double ret = 0.0;
-	int32_t var1, var2;
+	I2C_Transaction i2cTransaction;
+	uint8_t itxBuffer[1];
+	uint8_t irxBuffer[24];
 
-	var1 = ((((adc_T>>3) - ((int32_t)dig_T1 <<1))) * ((int32_t)dig_T2)) >> 11;
-	var2 = (((((adc_T>>4) - ((int32_t)dig_T1)) * ((adc_T>>4) - ((int32_t)dig_T1))) >> 12) * ((int32_t)dig_T3)) >> 14;
-	t_fine = var1 + var2;
+	// t_sb 125 ms, filter off
+	if (bmp280_write_reg(i2c, BMP280_REG_CONFIG, 0x40)) {
 
-	ret = (double)((t_fine * 5 + 128) >> 8);
-	ret /= 100.0;
-	return ret;
+		System_printf("BMP280: Config write ok\n");
+	} else {
+		System_printf("BMP280: Config write failed!\n");
+	}
+	System_flush();
+
+	// Normal mode, temperature x1, pressure x4
+	if (bmp280_configure(i2c, BMP280_MODE_NORMAL, BMP280_OS_1X, BMP280_OS_4X)) {
+
+		System_printf("BMP280: Ctrl meas write ok\n");
+	} else {
+		System_printf("BMP280: Ctrl meas write failed!\n");
+	}
+	System_flush();
+
+	i2cTransaction.slaveAddress = Board_BMP280_ADDR;
+	itxBuffer[0] = BMP280_REG_T1;
+	i2cTransaction.writeBuf = itxBuffer;
+	i2cTransaction.writeCount = 1;
+	i2cTransaction.readBuf = irxBuffer;
+	i2cTransaction.readCount = 24;
+
+	if (I2C_transfer(*i2c, &i2cTransaction)) {
+
+		System_printf("BMP280: Trimming read ok\n");
+	} else {
+		System_printf("BMP280: Trimming read failed!\n");
+	}
+	System_flush();
+
+	bmp280_parse_calib(&calib, irxBuffer);
 }
 
-double bmp280_convert_pres(uint32_t adc_P) {
+// Forced mode takes one measurement per bmp280_get_data call and then sleeps,
+// normal mode keeps measuring every t_sb.
+bool bmp280_configure(I2C_Handle *i2c, enum bmp280Mode mode, enum bmp280Oversampling osrsT, enum bmp280Oversampling osrsP) {
 
-	double ret = 0.0;
-	int64_t var1, var2, p;
+	ctrlMeas = (osrsT << 5) | (osrsP << 2) | mode;
+	// A period shorter than the measurement only reads "not ready"
+	bmp280Caps.latencyUs = bmp280_measure_time();
+	bmp280Caps.minPeriodMs = (bmp280Caps.latencyUs + 999) / 1000;
+
+	// In forced mode the measurement is triggered by bmp280_get_data
+	return bmp280_write_reg(i2c, BMP280_REG_CTRL_MEAS,
+	                        mode == BMP280_MODE_FORCED ? (ctrlMeas & ~0x03) : ctrlMeas);
+}
 
-	var1 = ((int64_t)t_fine) - 128000;
-	var2 = var1 * var1 * (int64_t)dig_P6;
-	var2 = var2 + ((var1*(int64_t)dig_P5)<<17);
-	var2 = var2 + (((int64_t)dig_P4)<<35);
-	var1 = ((var1 * var1 * (int64_t)dig_P3)>>8) + ((var1 * (int64_t)dig_P2)<<12);
-	var1 = (((((int64_t)1)<<47)+var1))*((int64_t)dig_P1)>>33;
-	if (var1 == 0) {
-	    return 0.0;  // avoid exception caused by division by zero
+// Maximum measurement time in us for the current oversampling, s.18
+static uint32_t bmp280_measure_time(void) {
+
+	uint8_t osrsT = (ctrlMeas >> 5) & 0x07;
+	uint8_t osrsP = (ctrlMeas >> 2) & 0x07;
+	uint32_t time = 1250;
+
+	if (osrsT) {
+		time += 2300 * (1 << (osrsT - 1));
+	}
+	if (osrsP) {
+		time += 2300 * (1 << (osrsP - 1)) + 575;
 	}
-	p = 1048576 - adc_P;
-	p = (((p<<31) - var2)*3125) / var1;
-	var1 = (((int64_t)dig_P9) * (p>>13) * (p>>13)) >> 25;
-	var2 = (((int64_t)dig_P8) * p) >> 19;
-
-	ret = ((p + var1 + var2) >> 8) + (((int64_t)dig_P7)<<4);
-	ret /= 256.0;
-	return ret;
+	return time;
 }
 
-void bmp280_setup(I2C_Handle *i2c) {
+// Reads pressure (Pa) and temperature (0.01 degC) with one 6-byte burst from
+// press_msb to temp_xlsb, s.26
+bool bmp280_get_data(I2C_Handle *i2c, uint32_t *pressure, int32_t *temperature) {
+
+	uint8_t txBuffer[1];
+	uint8_t rxBuffer[6];
+	I2C_Transaction i2cMessage;
+	int32_t adc_P, adc_T, t_fine;
+
+	if ((ctrlMeas & 0x03) == BMP280_MODE_FORCED) {
+		if (!bmp280_write_reg(i2c, BMP280_REG_CTRL_MEAS, ctrlMeas)) {
+			TRACE0("BMP280: Forced trigger failed!");
+			return false;
+		}
+		Task_sleep(bmp280_measure_time() / Clock_tickPeriod + 1);
+	}
 
-	I2C_Transaction i2cTransaction;
-	char itxBuffer[4];
-	char irxBuffer[24];
-
-    i2cTransaction.slaveAddress = Board_BMP280_ADDR;
-    itxBuffer[0] = BMP280_REG_CONFIG;
-    itxBuffer[1] = 0x40;
-    i2cTransaction.writeBuf = itxBuffer;
-    i2cTransaction.writeCount = 2;
-    i2cTransaction.readBuf = NULL;
-    i2cTransaction.readCount = 0;
-
-    if (I2C_transfer(*i2c, &i2cTransaction)) {
-
-        System_printf("BMP280: Config write ok\n");
-    } else {
-        System_printf("BMP280: Config write failed!\n");
-    }
-    System_flush();
-
-    i2cTransaction.slaveAddress = Board_BMP280_ADDR;
-    itxBuffer[0] = BMP280_REG_CTRL_MEAS;
-    itxBuffer[1] = 0x2F;
-    i2cTransaction.writeBuf = itxBuffer;
-    i2cTransaction.writeCount = 2;
-    i2cTransaction.readBuf = NULL;
-    i2cTransaction.readCount = 0;
-
-    if (I2C_transfer(*i2c, &i2cTransaction)) {
-
-        System_printf("BMP280: Ctrl meas write ok\n");
-    } else {
-        System_printf("BMP280: Ctrl meas write failed!\n");
-    }
-    System_flush();
-
-    i2cTransaction.slaveAddress = Board_BMP280_ADDR;
-    itxBuffer[0] = BMP280_REG_T1;
-    i2cTransaction.writeBuf = itxBuffer;
-    i2cTransaction.writeCount = 1;
-    i2cTransaction.readBuf = irxBuffer;
-    i2cTransaction.readCount = 24;
-
-    if (I2C_transfer(*i2c, &i2cTransaction)) {
-
-        System_printf("BMP280: Trimming read ok\n");
-    } else {
-        System_printf("BMP280: Trimming read failed!\n");
-    }
-    System_flush();
-
-    bmp280_set_trimming(irxBuffer);
+	i2cMessage.slaveAddress = Board_BMP280_ADDR;
+	txBuffer[0] = BMP280_REG_PRES_MSB;
+	i2cMessage.writeBuf = txBuffer;
+	i2cMessage.writeCount = 1;
+	i2cMessage.readBuf = rxBuffer;
+	i2cMessage.readCount = 6;
+
+	if (!I2C_transfer(*i2c, &i2cMessage)) {
+		TRACE0("BMP280: Data read failed!");
+		return false;
+	}
+
+	adc_P = ((int32_t)rxBuffer[0] << 12) | ((int32_t)rxBuffer[1] << 4) | (rxBuffer[2] >> 4);
+	adc_T = ((int32_t)rxBuffer[3] << 12) | ((int32_t)rxBuffer[4] << 4) | (rxBuffer[5] >> 4);
+
+	*temperature = bmp280_compensate_temp(&calib, adc_T, &t_fine);
+	*pressure = bmp280_compensate_pres(&calib, adc_P, t_fine);
+	return true;
 }
 
-/**************** JTKJ: DO NOT MODIFY ANYTHING ABOVE THIS LINE ****************/
+/* Common driver interface, see sensor.h */
 
-void bmp280_get_data(I2C_Handle *i2c, double *pressure, double *temperature) {
+static bool bmp280_drv_init(I2C_Handle *i2c) {
 
-    // JTKJ: Find out the correct buffer sizes with this sensor?
-    // char txBuffer[ n ];
-    // char rxBuffer{ n ];
+	bmp280_setup(i2c);
+	return true;
+}
+
+static bool bmp280_drv_start(I2C_Handle *i2c) {
+
+	if ((ctrlMeas & 0x03) == BMP280_MODE_FORCED) {
+		return true; // every read triggers its own measurement
+	}
+	return bmp280_write_reg(i2c, BMP280_REG_CTRL_MEAS, ctrlMeas);
+}
 
-    // JTKJ: Fill in the i2cMessage data structure with correct values
-    //       as shown in the lecture material
-    I2C_Transaction i2cMessage;
+// Pressure in Pa and temperature in 0.01 degC
+static int bmp280_drv_read(I2C_Handle *i2c, int32_t *buf) {
 
-    if (I2C_transfer(*i2c, &i2cMessage)) {
+	uint32_t pressure;
+	int32_t temperature;
 
-        // JTKJ: Here the conversion from register value to unit values
-        //       Save the values to the function parameters pressure and temperature
+	if (!bmp280_get_data(i2c, &pressure, &temperature)) {
+		return -1;
+	}
+	buf[0] = (int32_t)pressure;
+	buf[1] = temperature;
+	return 2;
+}
+
+static bool bmp280_drv_sleep(I2C_Handle *i2c) {
+
+	return bmp280_write_reg(i2c, BMP280_REG_CTRL_MEAS, ctrlMeas & ~0x03);
+}
 
-    } else {
+static const SensorCaps *bmp280_drv_caps(void) {
 
-        // Oops, something went wrong..
-        System_printf("BMP280: Data read failed!\n");
-        System_flush();
-    }
+	return &bmp280Caps;
 }
 
+const SensorDriver bmp280Driver = {
+	.name = "bmp280",
+	.bus = SENSOR_BUS_I2C0,
+	.init = bmp280_drv_init,
+	.start = bmp280_drv_start,
+	.read = bmp280_drv_read,
+	.sleep = bmp280_drv_sleep,
+	.get_capabilities = bmp280_drv_caps
+};
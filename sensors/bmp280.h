@@ -10,8 +10,14 @@
 #ifndef BMP280_H_
 #define BMP280_H_
 
+#include <stdint.h>
+#include <stdbool.h>
 #include <ti/drivers/I2C.h>
 
+#include "sensor.h"
+#include "bmp280comp.h"
+
+#define BMP280_REG_STATUS		0xF3
 #define BMP280_REG_CTRL_MEAS	0xF4
 #define BMP280_REG_CONFIG		0xF5
 #define BMP280_REG_PRES_MSB		0xF7
@@ -30,7 +36,29 @@
 #define BMP280_REG_P9			0x9E
 */
 
+#define BMP280_STATUS_MEASURING	0x08
+
+// ctrl_meas mode bits [1:0], s.15
+enum bmp280Mode {
+	BMP280_MODE_SLEEP = 0,
+	BMP280_MODE_FORCED = 1,
+	BMP280_MODE_NORMAL = 3
+};
+
+// osrs_t [7:5] and osrs_p [4:2], s.12-13
+enum bmp280Oversampling {
+	BMP280_OS_SKIP = 0,
+	BMP280_OS_1X,
+	BMP280_OS_2X,
+	BMP280_OS_4X,
+	BMP280_OS_8X,
+	BMP280_OS_16X
+};
+
 void bmp280_setup(I2C_Handle *i2c);
-void bmp280_get_data(I2C_Handle *i2c, double *pressure, double *temperature);
+bool bmp280_configure(I2C_Handle *i2c, enum bmp280Mode mode, enum bmp280Oversampling osrsT, enum bmp280Oversampling osrsP);
+bool bmp280_get_data(I2C_Handle *i2c, uint32_t *pressure, int32_t *temperature);
+
+extern const SensorDriver bmp280Driver;
 
 #endif /* BMP280_H_ */
@@ -0,0 +1,88 @@
+/*
+ * bmp280comp.c
+ *
+ *  BMP280 compensation, see bmp280comp.h.
+ */
+
+#include "bmp280comp.h"
+
+void bmp280_parse_calib(Bmp280Calib *c, const uint8_t *v) {
+
+	c->dig_T1 = (v[1] << 8) | v[0];
+	c->dig_T2 = (v[3] << 8) | v[2];
+	c->dig_T3 = (v[5] << 8) | v[4];
+	c->dig_P1 = (v[7] << 8) | v[6];
+	c->dig_P2 = (v[9] << 8) | v[8];
+	c->dig_P3 = (v[11] << 8) | v[10];
+	c->dig_P4 = (v[13] << 8) | v[12];
+	c->dig_P5 = (v[15] << 8) | v[14];
+	c->dig_P6 = (v[17] << 8) | v[16];
+	c->dig_P7 = (v[19] << 8) | v[18];
+	c->dig_P8 = (v[21] << 8) | v[20];
+	c->dig_P9 = (v[23] << 8) | v[22];
+}
+
+// Returns temperature in 0.01 degC, s.45. t_fine is needed by the pressure
+// compensation.
+int32_t bmp280_compensate_temp(const Bmp280Calib *c, int32_t adc_T, int32_t *t_fine) {
+
+	int32_t var1, var2;
+
+	var1 = ((((adc_T>>3) - ((int32_t)c->dig_T1 <<1))) * ((int32_t)c->dig_T2)) >> 11;
+	var2 = (((((adc_T>>4) - ((int32_t)c->dig_T1)) * ((adc_T>>4) - ((int32_t)c->dig_T1))) >> 12) * ((int32_t)c->dig_T3)) >> 14;
+	*t_fine = var1 + var2;
+
+	return (*t_fine * 5 + 128) >> 8;
+}
+
+// Returns pressure in Pa using only 32-bit arithmetic, s.46
+// Signed values are scaled with multiplications where the datasheet shifts
+// them left, shifting a negative value is undefined in C.
+uint32_t bmp280_compensate_pres(const Bmp280Calib *c, int32_t adc_P, int32_t t_fine) {
+
+	int32_t var1, var2;
+	uint32_t p;
+
+	var1 = (t_fine>>1) - (int32_t)64000;
+	var2 = (((var1>>2) * (var1>>2)) >> 11 ) * ((int32_t)c->dig_P6);
+	var2 = var2 + ((var1*((int32_t)c->dig_P5))*2);
+	var2 = (var2>>2)+(((int32_t)c->dig_P4)*65536);
+	var1 = (((c->dig_P3 * (((var1>>2) * (var1>>2)) >> 13 )) >> 3) + ((((int32_t)c->dig_P2) * var1)>>1))>>18;
+	var1 = ((((32768+var1))*((int32_t)c->dig_P1))>>15);
+	if (var1 == 0) {
+		return 0; // avoid exception caused by division by zero
+	}
+	p = (((uint32_t)(((int32_t)1048576)-adc_P)-(var2>>12)))*3125;
+	if (p < 0x80000000) {
+		p = (p << 1) / ((uint32_t)var1);
+	} else {
+		p = (p / (uint32_t)var1) * 2;
+	}
+	var1 = (((int32_t)c->dig_P9) * ((int32_t)(((p>>3) * (p>>3))>>13)))>>12;
+	var2 = (((int32_t)(p>>2)) * ((int32_t)c->dig_P8))>>13;
+	p = (uint32_t)((int32_t)p + ((var1 + var2 + c->dig_P7) >> 4));
+	return p;
+}
+
+// 64-bit reference path, s.22. Returns pressure in Pa as Q24.8. Kept for
+// comparing accuracy and cycle counts with bmp280_compensate_pres.
+uint32_t bmp280_compensate_pres64(const Bmp280Calib *c, int32_t adc_P, int32_t t_fine) {
+
+	int64_t var1, var2, p;
+
+	var1 = ((int64_t)t_fine) - 128000;
+	var2 = var1 * var1 * (int64_t)c->dig_P6;
+	var2 = var2 + ((var1*(int64_t)c->dig_P5)*131072);
+	var2 = var2 + (((int64_t)c->dig_P4)*(((int64_t)1)<<35));
+	var1 = ((var1 * var1 * (int64_t)c->dig_P3)>>8) + ((var1 * (int64_t)c->dig_P2)*4096);
+	var1 = (((((int64_t)1)<<47)+var1))*((int64_t)c->dig_P1)>>33;
+	if (var1 == 0) {
+	    return 0;  // avoid exception caused by division by zero
+	}
+	p = 1048576 - adc_P;
+	p = (((p*(((int64_t)1)<<31)) - var2)*3125) / var1;
+	var1 = (((int64_t)c->dig_P9) * (p>>13) * (p>>13)) >> 25;
+	var2 = (((int64_t)c->dig_P8) * p) >> 19;
+
+	return (uint32_t)(((p + var1 + var2) >> 8) + (((int64_t)c->dig_P7)*16));
+}
@@ -0,0 +1,36 @@
+/*
+ * bmp280comp.h
+ *
+ *  BMP280 trimming parameters and the datasheet's integer compensation,
+ *  s.21-22 and s.45-46. Temperature in 0.01 degC, pressure in Pa, or Q24.8
+ *  Pa for the 64-bit path. Plain C, builds on a host.
+ */
+
+#ifndef BMP280COMP_H_
+#define BMP280COMP_H_
+
+#include <stdint.h>
+
+// Trimming parameters, s.21
+typedef struct {
+	uint16_t dig_T1;
+	int16_t  dig_T2;
+	int16_t  dig_T3;
+	uint16_t dig_P1;
+	int16_t  dig_P2;
+	int16_t  dig_P3;
+	int16_t  dig_P4;
+	int16_t  dig_P5;
+	int16_t  dig_P6;
+	int16_t  dig_P7;
+	int16_t  dig_P8;
+	int16_t  dig_P9;
+} Bmp280Calib;
+
+// Integer compensation, s.45-46. Temperature in 0.01 degC, pressure in Pa.
+void bmp280_parse_calib(Bmp280Calib *calib, const uint8_t *v);
+int32_t bmp280_compensate_temp(const Bmp280Calib *calib, int32_t adc_T, int32_t *t_fine);
+uint32_t bmp280_compensate_pres(const Bmp280Calib *calib, int32_t adc_P, int32_t t_fine);
+uint32_t bmp280_compensate_pres64(const Bmp280Calib *calib, int32_t adc_P, int32_t t_fine);
+
+#endif /* BMP280COMP_H_ */
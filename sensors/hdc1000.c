@@ -7,67 +7,179 @@
  * 	Datasheet http://www.ti.com/lit/ds/symlink/hdc1000.pdf
  */
 
+#include <xdc/std.h>
 #include <xdc/runtime/System.h>
-#include <ti/sysbios/knl/Task.h>
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/knl/Clock.h>
+#include <ti/sysbios/knl/Semaphore.h>
 
 #include "Board.h"
 #include "hdc1000.h"
+#include "trace.h"
+#include "wakeup.h"
 
-void hdc1000_setup(I2C_Handle *i2c) {
+// One-shot Clock started by hdc1000_trigger, posts the semaphore once the
+// combined conversion is done
+static Clock_Struct conversionClock;
+static Clock_Handle hConversionClock = NULL;
+static Semaphore_Struct readySem;
+static Semaphore_Handle hReadySem = NULL;
+static bool converting = false;		// triggered, result not read yet
+
+static void hdc1000_clockFxn(UArg arg) {
+
+	wakeup_mark(WAKE_CLOCK_HDC1000);
+	Semaphore_post(hReadySem);
+}
 
-    System_printf("HDC1000: Do not use this sensor!\n");
-    System_flush();
+void hdc1000_setup(I2C_Handle *i2c) {
 
-	/*
 	I2C_Transaction i2cTransaction;
-	char itxBuffer[4];
-	char irxBuffer[4];
-
-    i2cTransaction.slaveAddress = Board_HDC1000_ADDR;
-    itxBuffer[0] = HDC1000_REG_CONFIG;
-    itxBuffer[1] = 0x10; // sequential mode s.16
-    itxBuffer[2] = 0x00;
-    i2cTransaction.writeBuf = itxBuffer;
-    i2cTransaction.writeCount = 3;
-    i2cTransaction.readBuf = NULL;
-    i2cTransaction.readCount = 0;
-
-    if (I2C_transfer(*i2c, &i2cTransaction)) {
-
-        System_printf("HDC1000: Config write ok\n");
-    } else {
-        System_printf("HDC1000: Config write failed!\n");
-    }
-    */
+	uint8_t itxBuffer[3];
+
+	if (hConversionClock == NULL) {
+		Semaphore_Params semParams;
+		Semaphore_Params_init(&semParams);
+		semParams.mode = Semaphore_Mode_BINARY;
+		Semaphore_construct(&readySem, 0, &semParams);
+		hReadySem = Semaphore_handle(&readySem);
+
+		Clock_Params clockParams;
+		Clock_Params_init(&clockParams);
+		clockParams.period = 0;
+		clockParams.startFlag = FALSE;
+		Clock_construct(&conversionClock, hdc1000_clockFxn, HDC1000_CONVERSION_US / Clock_tickPeriod, &clockParams);
+		hConversionClock = Clock_handle(&conversionClock);
+	}
+
+	i2cTransaction.slaveAddress = Board_HDC1000_ADDR;
+	itxBuffer[0] = HDC1000_REG_CONFIG;
+	itxBuffer[1] = HDC1000_CONFIG_SEQUENTIAL >> 8; // 14-bit resolutions, heater off
+	itxBuffer[2] = 0x00;
+	i2cTransaction.writeBuf = itxBuffer;
+	i2cTransaction.writeCount = 3;
+	i2cTransaction.readBuf = NULL;
+	i2cTransaction.readCount = 0;
+
+	if (I2C_transfer(*i2c, &i2cTransaction)) {
+
+		System_printf("HDC1000: Config write ok\n");
+	} else {
+		System_printf("HDC1000: Config write failed!\n");
+	}
+	System_flush();
+}
+
+// Writing the temperature register pointer starts a conversion of both
+// temperature and humidity, s.14
+bool hdc1000_trigger(I2C_Handle *i2c) {
+
+	I2C_Transaction i2cMessage;
+	uint8_t txBuffer[1];
+
+	i2cMessage.slaveAddress = Board_HDC1000_ADDR;
+	txBuffer[0] = HDC1000_REG_TEMP;
+	i2cMessage.writeBuf = txBuffer;
+	i2cMessage.writeCount = 1;
+	i2cMessage.readBuf = NULL;
+	i2cMessage.readCount = 0;
+
+	if (!I2C_transfer(*i2c, &i2cMessage)) {
+		TRACE0("HDC1000: Trigger failed!");
+		converting = false;
+		return false;
+	}
+	Semaphore_reset(hReadySem, 0);
+	Clock_start(hConversionClock);
+	converting = true;
+	return true;
+}
+
+// Reads the 4-byte result of the last trigger in one transaction. Returns
+// false without touching the bus while the conversion is still running.
+// temp is in 0.01 degC, hum in 0.01 %RH.
+bool hdc1000_get_data(I2C_Handle *i2c, int32_t *temp, uint32_t *hum) {
+
+	I2C_Transaction i2cMessage;
+	uint8_t rxBuffer[4];
+
+	if (!Semaphore_pend(hReadySem, BIOS_NO_WAIT)) {
+		return false;
+	}
+	converting = false;
+
+	i2cMessage.slaveAddress = Board_HDC1000_ADDR;
+	i2cMessage.writeBuf = NULL;
+	i2cMessage.writeCount = 0;
+	i2cMessage.readBuf = rxBuffer;
+	i2cMessage.readCount = 4;
+
+	if (!I2C_transfer(*i2c, &i2cMessage)) {
+		TRACE0("HDC1000: Data read failed!");
+		return false;
+	}
+
+	// T = raw / 2^16 * 165 - 40, RH = raw / 2^16 * 100, s.14
+	uint32_t rawTemp = (rxBuffer[0] << 8) | rxBuffer[1];
+	uint32_t rawHum = (rxBuffer[2] << 8) | rxBuffer[3];
+	*temp = (int32_t)((rawTemp * 16500) >> 16) - 4000;
+	*hum = (rawHum * 10000) >> 16;
+	return true;
 }
 
-/**************** JTKJ: DO NOT MODIFY ANYTHING ABOVE THIS LINE ****************/
+/* Common driver interface, see sensor.h */
 
-void hdc1000_get_data(I2C_Handle *i2c, double *temp, double *hum) {
+static bool hdc1000_drv_init(I2C_Handle *i2c) {
 
-    System_printf("HDC1000: Do not use this sensor!\n");
-    System_flush();
+	hdc1000_setup(i2c);
+	return true;
+}
 
-    // JTKJ: Find out the correct buffer sizes with this sensor?
-    // char txBuffer[ n ];
-    // char rxBuffer{ n ];
+// Temperature in 0.01 degC and humidity in 0.01 %RH. A result, a failed
+// data read and a failed trigger all trigger the next conversion, so one
+// bus error never stops the sensor.
+static int hdc1000_drv_read(I2C_Handle *i2c, int32_t *buf) {
+
+	uint32_t hum;
+	int result = -1;
+
+	if (hdc1000_get_data(i2c, &buf[0], &hum)) {
+		buf[1] = (int32_t)hum;
+		result = 2;
+	} else if (converting) {
+		return 0;
+	}
+	hdc1000_trigger(i2c);
+	return result;
+}
 
-    // JTKJ: Fill in the i2cMessage data structure with correct values
-    //       as shown in the lecture material
-    // I2C_Transaction i2cMessage;
+static bool hdc1000_drv_sleep(I2C_Handle *i2c) {
 
-    /*
-    if (I2C_transfer(*i2c, &i2cMessage)) {
+	// The sensor powers down by itself after every conversion
+	return true;
+}
 
-        // JTKJ: Here the conversion from register value to unit values
-        //       Save the values to the function parameters pressure and temperature
+static const SensorCaps hdc1000Caps = {
+	.minPeriodMs = 15,
+	.maxPeriodMs = 60000,
+	.latencyUs = HDC1000_CONVERSION_US,
+	.activeUa = 180,
+	.sleepUa = 0,
+	.channels = 2,
+	.units = "cdegC,cRH"
+};
 
-    } else {
+static const SensorCaps *hdc1000_drv_caps(void) {
 
-        // Oops, something went wrong..
-        System_printf("HDC1000: Data read failed!\n");
-        System_flush();
-    }
-    */
+	return &hdc1000Caps;
 }
 
+const SensorDriver hdc1000Driver = {
+	.name = "hdc1000",
+	.bus = SENSOR_BUS_I2C0,
+	.init = hdc1000_drv_init,
+	.start = hdc1000_trigger,
+	.read = hdc1000_drv_read,
+	.sleep = hdc1000_drv_sleep,
+	.get_capabilities = hdc1000_drv_caps
+};
@@ -10,13 +10,25 @@
 #ifndef HDC1000_H_
 #define HDC1000_H_
 
+#include <stdint.h>
+#include <stdbool.h>
 #include <ti/drivers/I2C.h>
 
+#include "sensor.h"
+
 #define HDC1000_REG_TEMP		0x0
 #define HDC1000_REG_HUM			0x1
 #define HDC1000_REG_CONFIG		0x2
 
+#define HDC1000_CONFIG_SEQUENTIAL	0x1000	// temperature and humidity in one go, s.16
+
+// 14-bit temperature 6.35 ms + 14-bit humidity 6.5 ms, s.5, rounded up
+#define HDC1000_CONVERSION_US	15000
+
 void hdc1000_setup(I2C_Handle *i2c);
-void hdc1000_get_data(I2C_Handle *i2c, double *temp, double *hum);
+bool hdc1000_trigger(I2C_Handle *i2c);
+bool hdc1000_get_data(I2C_Handle *i2c, int32_t *temp, uint32_t *hum);
+
+extern const SensorDriver hdc1000Driver;
 
 #endif /* HDC1000_H_ */
@@ -18,9 +18,16 @@
 #include <ti/sysbios/knl/Task.h>
 #include <ti/drivers/I2C.h>
 #include <ti/sysbios/knl/Clock.h>
+#include <ti/sysbios/knl/Semaphore.h>
+#include <ti/drivers/PIN.h>
 
 #include "Board.h"
 #include "mpu9250.h"
+#include "mpu9250conv.h"
+#include "symbol.h"
+#include "trace.h"
+#include "wakeup.h"
+#include "memsection.h"
 
 #define PI	3.14159265
 
@@ -35,12 +42,16 @@
 #define GYRO_CONFIG      0x1B
 #define ACCEL_CONFIG     0x1C
 #define ACCEL_CONFIG2    0x1D
+#define LP_ACCEL_ODR     0x1E
+#define WOM_THR          0x1F
 #define FIFO_EN          0x23
 #define I2C_MST_CTRL     0x24
 #define INT_PIN_CFG      0x37
 #define INT_ENABLE       0x38
+#define INT_STATUS       0x3A
 #define ACCEL_XOUT_H     0x3B
 #define GYRO_XOUT_H      0x43
+#define MOT_DETECT_CTRL  0x69
 #define USER_CTRL        0x6A  // Bit 7 enable DMP, bit 3 reset DMP
 #define PWR_MGMT_1       0x6B // Device defaults to the SLEEP mode
 #define PWR_MGMT_2       0x6C
@@ -102,9 +113,8 @@ void writeByte(uint8_t reg, uint8_t data) {
     i2cTransaction.readCount = 0;
 
     if (!I2C_transfer(i2c, &i2cTransaction)) {
-    	System_printf("MPU9250: write=%x data=%x FAILED\n",reg,data);
+    	TRACE2("MPU9250: write=%x data=%x FAILED", reg, data);
     }
-    System_flush();
 }
 
 void readByte(uint8_t reg, uint8_t count, uint8_t *data) {
@@ -120,9 +130,8 @@ void readByte(uint8_t reg, uint8_t count, uint8_t *data) {
     i2cTransaction.readCount = count;
 
     if (!I2C_transfer(i2c, &i2cTransaction)) {
-    	System_printf("MPU9250: read=%x count=%x FAILED\n",reg,count);
+    	TRACE2("MPU9250: read=%x count=%x FAILED", reg, count);
     }
-    System_flush();
 }
 
 void delay(uint16_t delay) {
@@ -505,6 +514,13 @@ void mpu9250_get_data(I2C_Handle *i2c, float *ax, float *ay, float *az, float *g
    	// Read register values into array rawData
 	readByte( ACCEL_XOUT_H, 14, rawData);
 
+	mpu9250_convert(rawData, ax, ay, az, gx, gy, gz);
+}
+
+// Converts one ACCEL_XOUT_H..GYRO_ZOUT_L burst into g and deg/s. Runs once per
+// sample, so it executes from SRAM.
+RAMFUNC void mpu9250_convert(const uint8_t *rawData, float *ax, float *ay, float *az, float *gx, float *gy, float *gz) {
+
 	// JTKJ: Convert the 8-bit values (the _h and _l registers) in the array rawData into 16-bit values
     //       Each nx, ny and nz below is represents the 16-bit values for each axis separately
     int16_t nx = (rawData[0] << 8) | rawData[1];
@@ -525,3 +541,209 @@ void mpu9250_get_data(I2C_Handle *i2c, float *ax, float *ay, float *az, float *g
     *gz = (float)mz * gRes;
     
 }
+
+// Full scale ranges, AFS_SEL and GFS_SEL 0-3. Applied by the next setup.
+void mpu9250_set_scale(uint8_t ascale, uint8_t gscale) {
+
+	Ascale = ascale <= AFS_16G ? ascale : AFS_16G;
+	Gscale = gscale <= GFS_2000DPS ? gscale : GFS_2000DPS;
+}
+
+// Output data rate 1 kHz / (1 + smplrtDiv). dlpf sets both the gyro DLPF_CFG
+// and the accelerometer A_DLPFCFG, the output rate should stay above twice
+// the filter bandwidth.
+void mpu9250_set_rate(I2C_Handle *i2c_orig, uint8_t smplrtDiv, uint8_t dlpf) {
+
+	uint8_t c;
+
+	i2c = *i2c_orig;
+	writeByte(CONFIG, dlpf & 0x07);
+	writeByte(SMPLRT_DIV, smplrtDiv);
+	readByte(ACCEL_CONFIG2, 1, &c);
+	c = (c & ~0x0F) | (dlpf & 0x07);
+	writeByte(ACCEL_CONFIG2, c);
+}
+
+/* Wake-on-motion, s.5.6 of the register map and the accelerometer
+ * low-power mode of the product specification */
+
+// INT is active high push-pull (INT_PIN_CFG). It also pulses on every data
+// ready, so the edge interrupt is only enabled while waiting for motion.
+static PIN_Handle hIntPin = NULL;
+static PIN_State intPinState;
+static PIN_Config intPinConfig[] = {
+	Board_MPU_INT | PIN_INPUT_EN | PIN_PULLDOWN | PIN_IRQ_DIS | PIN_HYSTERESIS,
+	PIN_TERMINATE
+};
+static Semaphore_Struct motionSem;
+static Semaphore_Handle hMotionSem = NULL;
+static volatile uint32_t motionStamp;
+static volatile bool motionCancelled;
+
+// Register state saved by mpu9250_wom_enter: SMPLRT_DIV..ACCEL_CONFIG2 and
+// INT_ENABLE, PWR_MGMT_1, PWR_MGMT_2
+static uint8_t rateCache[5];
+static uint8_t intCache;
+static uint8_t pwrCache[2];
+
+static void mpu9250_intFxn(PIN_Handle handle, PIN_Id pinId) {
+
+	wakeup_mark(WAKE_PIN_MPU);
+	motionStamp = symbol_now();
+	Semaphore_post(hMotionSem);
+}
+
+// Gyro off, accelerometer duty cycled at odr. INT fires once any axis
+// changes by more than thresholdMg (4 mg steps) between two samples.
+bool mpu9250_wom_enter(I2C_Handle *i2c_orig, uint16_t thresholdMg, enum mpu9250LpOdr odr) {
+
+	uint8_t c;
+
+	i2c = *i2c_orig;
+	if (hIntPin == NULL) {
+		Semaphore_Params semParams;
+
+		Semaphore_Params_init(&semParams);
+		semParams.mode = Semaphore_Mode_BINARY;
+		Semaphore_construct(&motionSem, 0, &semParams);
+		hMotionSem = Semaphore_handle(&motionSem);
+
+		hIntPin = PIN_open(&intPinState, intPinConfig);
+		if (hIntPin == NULL || PIN_registerIntCb(hIntPin, &mpu9250_intFxn) != 0) {
+			TRACE0("MPU9250: INT pin open failed!");
+			return false;
+		}
+	}
+
+	readByte(SMPLRT_DIV, 5, rateCache);
+	readByte(INT_ENABLE, 1, &intCache);
+	readByte(PWR_MGMT_1, 2, pwrCache);
+
+	writeByte(PWR_MGMT_1, 0x01);				// awake, not cycling
+	writeByte(PWR_MGMT_2, 0x07);				// gyro x, y, z off
+	c = rateCache[4] & ~0x0F;
+	writeByte(ACCEL_CONFIG2, c | 0x09);			// accel_fchoice_b, A_DLPFCFG = 1
+	writeByte(INT_ENABLE, 0x40);				// WOM only
+	writeByte(MOT_DETECT_CTRL, 0xC0);			// ACCEL_INTEL_EN, compare to previous sample
+	writeByte(WOM_THR, thresholdMg >= 1020 ? 0xFF : thresholdMg / 4);
+	writeByte(LP_ACCEL_ODR, odr);
+	readByte(INT_STATUS, 1, &c);				// drop anything pending
+
+	Semaphore_reset(hMotionSem, 0);
+	motionCancelled = false;
+	PIN_setInterrupt(hIntPin, Board_MPU_INT | PIN_IRQ_POSEDGE);
+	writeByte(PWR_MGMT_1, 0x21);				// CYCLE
+	return true;
+}
+
+// Blocks the calling task until motion, the MCU can stay in standby meanwhile.
+// False on timeout or mpu9250_wom_cancel().
+bool mpu9250_wom_wait(UInt32 timeout) {
+
+	return Semaphore_pend(hMotionSem, timeout) && !motionCancelled;
+}
+
+// Ends a wait from another task, e.g. when a command needs the sensor task
+void mpu9250_wom_cancel(void) {
+
+	if (hMotionSem != NULL) {
+		motionCancelled = true;
+		Semaphore_post(hMotionSem);
+	}
+}
+
+// Restores the cached configuration and returns the time from the motion
+// interrupt to valid gyro data in us. The accelerometer registers are never
+// reset, so no calibration or bias reload is needed.
+uint32_t mpu9250_wom_exit(I2C_Handle *i2c_orig) {
+
+	uint8_t c;
+
+	i2c = *i2c_orig;
+	PIN_setInterrupt(hIntPin, Board_MPU_INT | PIN_IRQ_DIS);
+
+	writeByte(PWR_MGMT_1, pwrCache[0] & ~0x20);
+	writeByte(PWR_MGMT_2, pwrCache[1]);
+	writeByte(MOT_DETECT_CTRL, 0x00);
+	writeByte(INT_ENABLE, intCache);
+	writeByte(SMPLRT_DIV, rateCache[0]);
+	writeByte(CONFIG, rateCache[1]);
+	writeByte(ACCEL_CONFIG2, rateCache[4]);
+	readByte(INT_STATUS, 1, &c);
+
+	Task_sleep(MPU9250_GYRO_STARTUP_US / Clock_tickPeriod);
+	return symbol_now() - motionStamp;
+}
+
+/* Common driver interface, see sensor.h */
+
+// Accelerometer bias in mg, the hardware bias registers are not written
+static int32_t accelBiasMg[3];
+
+static bool mpu9250_drv_init(I2C_Handle *i2c_orig) {
+
+	int i;
+
+	mpu9250_setup(i2c_orig);
+	for (i = 0; i < 3; i++) {
+		accelBiasMg[i] = (int32_t)(accelBias[i] * 1000.0f);
+	}
+	return true;
+}
+
+static bool mpu9250_drv_start(I2C_Handle *i2c_orig) {
+
+	i2c = *i2c_orig; // the bus may have been reopened since setup
+	// Samples continuously at the SMPLRT_DIV rate once awake
+	writeByte(PWR_MGMT_1, 0x01);
+	return true;
+}
+
+// Accelerometer x, y, z in mg and gyro x, y, z in 0.01 deg/s, integer only
+static int mpu9250_drv_read(I2C_Handle *i2c_orig, int32_t *buf) {
+
+	uint8_t rawData[14];
+	int i;
+
+	i2c = *i2c_orig;
+	readByte(ACCEL_XOUT_H, 14, rawData);
+	for (i = 0; i < 3; i++) {
+		int16_t a = (int16_t)((rawData[2 * i] << 8) | rawData[2 * i + 1]);
+		int16_t g = (int16_t)((rawData[8 + 2 * i] << 8) | rawData[9 + 2 * i]);
+		buf[i] = mpu9250_accelMg(a, Ascale) - accelBiasMg[i];
+		buf[3 + i] = mpu9250_gyroCdps(g, Gscale);
+	}
+	return 6;
+}
+
+static bool mpu9250_drv_sleep(I2C_Handle *i2c_orig) {
+
+	i2c = *i2c_orig;
+	writeByte(PWR_MGMT_1, 0x40); // SLEEP bit
+	return true;
+}
+
+static const SensorCaps mpu9250Caps = {
+	.minPeriodMs = 5,		// 200 Hz output rate set by SMPLRT_DIV
+	.maxPeriodMs = 1000,
+	.latencyUs = 5900,		// DLPF delay at 41 Hz bandwidth
+	.activeUa = 3200,
+	.sleepUa = 8,
+	.channels = 6,
+	.units = "mg,mg,mg,cdps,cdps,cdps"
+};
+
+static const SensorCaps *mpu9250_drv_caps(void) {
+
+	return &mpu9250Caps;
+}
+
+const SensorDriver mpu9250Driver = {
+	.name = "mpu9250",
+	.bus = SENSOR_BUS_MPU,
+	.init = mpu9250_drv_init,
+	.start = mpu9250_drv_start,
+	.read = mpu9250_drv_read,
+	.sleep = mpu9250_drv_sleep,
+	.get_capabilities = mpu9250_drv_caps
+};
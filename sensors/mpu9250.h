@@ -12,9 +12,40 @@
 #ifndef MPU9250_H_
 #define MPU9250_H_
 
+#include <xdc/std.h>
 #include <ti/drivers/I2C.h>
 
+#include "sensor.h"
+
+#define MPU9250_GYRO_STARTUP_US	35000	// gyro start-up time, s.3.1
+
+// LP_ACCEL_ODR, accelerometer sample rate in wake-on-motion
+enum mpu9250LpOdr {
+	MPU9250_LPODR_0_24HZ = 0,
+	MPU9250_LPODR_0_49HZ,
+	MPU9250_LPODR_0_98HZ,
+	MPU9250_LPODR_1_95HZ,
+	MPU9250_LPODR_3_91HZ,
+	MPU9250_LPODR_7_81HZ,
+	MPU9250_LPODR_15_63HZ,
+	MPU9250_LPODR_31_25HZ,
+	MPU9250_LPODR_62_50HZ,
+	MPU9250_LPODR_125HZ,
+	MPU9250_LPODR_250HZ,
+	MPU9250_LPODR_500HZ
+};
+
 void mpu9250_setup(I2C_Handle *i2c);
 void mpu9250_get_data(I2C_Handle *i2c, float *ax, float *ay, float *az, float *gx, float *gy, float *gz);
+void mpu9250_convert(const uint8_t *rawData, float *ax, float *ay, float *az, float *gx, float *gy, float *gz);
+void mpu9250_set_rate(I2C_Handle *i2c, uint8_t smplrtDiv, uint8_t dlpf);
+void mpu9250_set_scale(uint8_t ascale, uint8_t gscale);
+
+bool mpu9250_wom_enter(I2C_Handle *i2c, uint16_t thresholdMg, enum mpu9250LpOdr odr);
+bool mpu9250_wom_wait(UInt32 timeout);
+void mpu9250_wom_cancel(void);
+uint32_t mpu9250_wom_exit(I2C_Handle *i2c);
+
+extern const SensorDriver mpu9250Driver;
 
 #endif /* MPU9250_H_ */
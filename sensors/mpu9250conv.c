@@ -0,0 +1,19 @@
+/*
+ * mpu9250conv.c
+ *
+ *  MPU9250 unit conversion, see mpu9250conv.h.
+ */
+
+#include "mpu9250conv.h"
+
+// 32768 LSB is the full scale. At 2000 deg/s it is 200000 cdps, so the
+// product needs more than 32 bits.
+int32_t mpu9250_accelMg(int16_t raw, uint8_t ascale) {
+
+	return (int32_t)((int64_t)raw * (2000 << ascale) / 32768);
+}
+
+int32_t mpu9250_gyroCdps(int16_t raw, uint8_t gscale) {
+
+	return (int32_t)((int64_t)raw * (25000 << gscale) / 32768);
+}
@@ -0,0 +1,18 @@
+/*
+ * mpu9250conv.h
+ *
+ *  MPU9250 raw register values to integer units: acceleration in mg and
+ *  angular rate in 0.01 deg/s. The full scale setting is the 2-bit
+ *  ACCEL_FS_SEL / GYRO_FS_SEL field, 2..16 g and 250..2000 deg/s. Results
+ *  are rounded towards zero. Plain C, builds on a host.
+ */
+
+#ifndef MPU9250CONV_H_
+#define MPU9250CONV_H_
+
+#include <stdint.h>
+
+int32_t mpu9250_accelMg(int16_t raw, uint8_t ascale);
+int32_t mpu9250_gyroCdps(int16_t raw, uint8_t gscale);
+
+#endif /* MPU9250CONV_H_ */
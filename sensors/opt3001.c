@@ -8,35 +8,127 @@
  */
 
 #include <string.h>
-#include <math.h>
 
+#include <xdc/std.h>
 #include <xdc/runtime/System.h>
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/knl/Clock.h>
+#include <ti/sysbios/knl/Semaphore.h>
+#include <ti/drivers/PIN.h>
 
 #include "sensors/opt3001.h"
 #include "Board.h"
+#include "trace.h"
+#include "wakeup.h"
 
-void opt3001_setup(I2C_Handle *i2c) {
+// Posted once per finished conversion, either by the INT pin in
+// end-of-conversion mode or by a Clock running at the conversion time
+static Semaphore_Struct resultSem;
+static Semaphore_Handle hResultSem = NULL;
+static Clock_Struct conversionClock;
+static Clock_Handle hConversionClock = NULL;
+static PIN_Handle hIntPin = NULL;
+static PIN_State intPinState;
+static enum opt3001ConversionTime conversionTime = OPT3001_CONVERSION_800MS;
+
+static void opt3001_intFxn(PIN_Handle handle, PIN_Id pinId) {
+
+    wakeup_mark(WAKE_PIN_OPT3001);
+    Semaphore_post(hResultSem);
+}
+
+static void opt3001_clockFxn(UArg arg) {
+
+    wakeup_mark(WAKE_CLOCK_OPT3001);
+    Semaphore_post(hResultSem);
+}
+
+static bool opt3001_write_reg(I2C_Handle *i2c, uint8_t reg, uint16_t value) {
 
     I2C_Transaction i2cTransaction;
-    char itxBuffer[3];
+    uint8_t itxBuffer[3];
 
     i2cTransaction.slaveAddress = Board_OPT3001_ADDR;
-    itxBuffer[0] = OPT3001_REG_CONFIG;
-    itxBuffer[1] = 0xCE; // continuous mode s.22
-    itxBuffer[2] = 0x02;
+    itxBuffer[0] = reg;
+    itxBuffer[1] = value >> 8;
+    itxBuffer[2] = value & 0xFF;
     i2cTransaction.writeBuf = itxBuffer;
     i2cTransaction.writeCount = 3;
     i2cTransaction.readBuf = NULL;
     i2cTransaction.readCount = 0;
 
-    if (I2C_transfer(*i2c, &i2cTransaction)) {
+    return I2C_transfer(*i2c, &i2cTransaction);
+}
+
+void opt3001_setup(I2C_Handle *i2c) {
+
+    if (hResultSem == NULL) {
+        Semaphore_Params semParams;
+        Semaphore_Params_init(&semParams);
+        semParams.mode = Semaphore_Mode_BINARY;
+        Semaphore_construct(&resultSem, 0, &semParams);
+        hResultSem = Semaphore_handle(&resultSem);
+
+        if (Board_OPT3001_INT != PIN_UNASSIGNED) {
+            PIN_Config intConfig[] = {
+                Board_OPT3001_INT | PIN_INPUT_EN | PIN_PULLUP | PIN_IRQ_NEGEDGE | PIN_HYSTERESIS,
+                PIN_TERMINATE
+            };
+            hIntPin = PIN_open(&intPinState, intConfig);
+            if (hIntPin != NULL) {
+                PIN_registerIntCb(hIntPin, &opt3001_intFxn);
+            }
+        }
+        if (hIntPin == NULL) {
+            Clock_Params clockParams;
+            Clock_Params_init(&clockParams);
+            clockParams.startFlag = FALSE;
+            Clock_construct(&conversionClock, opt3001_clockFxn, 1, &clockParams);
+            hConversionClock = Clock_handle(&conversionClock);
+        }
+    }
+
+    if (hIntPin != NULL && !opt3001_write_reg(i2c, OPT3001_REG_LOW_LIMIT, OPT3001_LOW_LIMIT_EOC)) {
+        System_printf("OPT3001: Low limit write failed!\n");
+    }
+
+    if (opt3001_configure(i2c, OPT3001_CONVERSION_800MS)) {
 
         System_printf("OPT3001: Config write ok\n");
     } else {
         System_printf("OPT3001: Config write failed!\n");
     }
     System_flush();
+}
 
+// Continuous conversions with automatic full-scale ranging. INT is left in
+// transparent mode so it follows every end of conversion without a config
+// register read in between.
+bool opt3001_configure(I2C_Handle *i2c, enum opt3001ConversionTime time) {
+
+    uint16_t config = OPT3001_RN_AUTO | OPT3001_M_CONTINUOUS;
+    uint32_t conversionUs = 100000;
+
+    conversionTime = time;
+    if (time == OPT3001_CONVERSION_800MS) {
+        config |= OPT3001_CT_800MS;
+        conversionUs = 800000;
+    }
+
+    if (hConversionClock != NULL) {
+        Clock_stop(hConversionClock);
+    }
+    if (!opt3001_write_reg(i2c, OPT3001_REG_CONFIG, config)) {
+        return false;
+    }
+    // Results of the previous setting are stale now
+    Semaphore_reset(hResultSem, 0);
+    if (hConversionClock != NULL) {
+        Clock_setPeriod(hConversionClock, conversionUs / Clock_tickPeriod);
+        Clock_setTimeout(hConversionClock, conversionUs / Clock_tickPeriod);
+        Clock_start(hConversionClock);
+    }
+    return true;
 }
 
 uint16_t opt3001_get_status(I2C_Handle *i2c) {
@@ -64,48 +156,103 @@ uint16_t opt3001_get_status(I2C_Handle *i2c) {
     return e;
 }
 
-/**************** JTKJ: DO NOT MODIFY ANYTHING ABOVE THIS LINE ****************/
+static int32_t opt3001_read_result(I2C_Handle *i2c) {
 
-double opt3001_get_data(I2C_Handle *i2c) {
+    uint8_t txBuffer[1];
+    uint8_t rxBuffer[2];
+    I2C_Transaction i2cMessage;
 
-    // JTKJ: Tehtävä 2. Muokkaa funktiota niin että se palauttaa mittausarvon lukseina
-    // JTKJ: Exercise 2. Complete this function to return the measured value as lux
+    i2cMessage.slaveAddress = Board_OPT3001_ADDR;
+    txBuffer[0] = OPT3001_REG_RESULT;
+    i2cMessage.writeBuf = txBuffer;
+    i2cMessage.writeCount = 1;
+    i2cMessage.readBuf = rxBuffer;
+    i2cMessage.readCount = 2;
 
-    double lux = -1.0; // return value of the function
-    // JTKJ: Find out the correct buffer sizes (n) with this sensor?
-    uint8_t txBuffer[ 1 ];
-    uint8_t rxBuffer[ 2 ];
+    if (!I2C_transfer(*i2c, &i2cMessage)) {
+        TRACE0("OPT3001: Data read failed!");
+        return -1;
+    }
 
-    // JTKJ: Fill in the i2cMessage data structure with correct values
-    //       as shown in the lecture material
-    I2C_Transaction i2cMessage;
-    i2cMessage.slaveAddress = Board_OPT3001_ADDR;
-    txBuffer[0] = OPT3001_REG_RESULT;      // Rekisterin osoite lähetyspuskuriin
-    i2cMessage.writeBuf = txBuffer; // Lähetyspuskurin asetus
-    i2cMessage.writeCount = 1;      // Lähetetään 1 tavu
-    i2cMessage.readBuf = rxBuffer;  // Vastaanottopuskurin asetus
-    i2cMessage.readCount = 2;       // Vastaanotetaan 2 tavua
+    // lux = 0.01 * 2^E * R, s.20
+    uint16_t result = (rxBuffer[0] << 8) | rxBuffer[1];
+    return (int32_t)(result & 0x0FFF) << (result >> 12);
+}
+
+// Returns the newest result in 0.01 lux, or -1 when no conversion has finished
+// since the previous call. Never blocks and costs one I2C transaction only
+// when there is a fresh result.
+int32_t opt3001_get_data(I2C_Handle *i2c) {
 
-    if (opt3001_get_status(i2c) & OPT3001_DATA_READY) {
+    if (!Semaphore_pend(hResultSem, BIOS_NO_WAIT)) {
+        return -1;
+    }
+    return opt3001_read_result(i2c);
+}
 
-        if (I2C_transfer(*i2c, &i2cMessage)) {
+// As opt3001_get_data, but blocks until the end of the next conversion, so
+// the result is read within an interrupt latency of being ready
+int32_t opt3001_wait_data(I2C_Handle *i2c, uint32_t timeoutUs) {
 
-            // JTKJ: Here the conversion from register value to lux
-            uint16_t lol = rxBuffer[0] << 8 | rxBuffer[1];
-            float E = lol >> 12;
-            float R = lol & 0b0000111111111111;
-            lux =  0.01 * pow(2, E) * R;
+    if (!Semaphore_pend(hResultSem, timeoutUs / Clock_tickPeriod)) {
+        return -1;
+    }
+    return opt3001_read_result(i2c);
+}
 
-        } else {
+/* Common driver interface, see sensor.h */
 
-            System_printf("OPT3001: Data read failed!\n");
-            System_flush();
-        }
+static bool opt3001_drv_init(I2C_Handle *i2c) {
 
-    } else {
-        System_printf("OPT3001: Data not ready!\n");
-        System_flush();
+    opt3001_setup(i2c);
+    return true;
+}
+
+static bool opt3001_drv_start(I2C_Handle *i2c) {
+
+    return opt3001_configure(i2c, conversionTime);
+}
+
+static int opt3001_drv_read(I2C_Handle *i2c, int32_t *buf) {
+
+    int32_t centilux = opt3001_get_data(i2c);
+
+    if (centilux < 0) {
+        return 0;
+    }
+    buf[0] = centilux;
+    return 1;
+}
+
+static bool opt3001_drv_sleep(I2C_Handle *i2c) {
+
+    if (hConversionClock != NULL) {
+        Clock_stop(hConversionClock);
     }
+    return opt3001_write_reg(i2c, OPT3001_REG_CONFIG, OPT3001_RN_AUTO); // M = 00, shutdown
+}
 
-    return lux;
+static const SensorCaps opt3001Caps = {
+    .minPeriodMs = 100,
+    .maxPeriodMs = 60000,   // 2 uA, never worth stopping between reads
+    .latencyUs = 800000,
+    .activeUa = 2,
+    .sleepUa = 0,
+    .channels = 1,
+    .units = "clux"
+};
+
+static const SensorCaps *opt3001_drv_caps(void) {
+
+    return &opt3001Caps;
 }
+
+const SensorDriver opt3001Driver = {
+    .name = "opt3001",
+    .bus = SENSOR_BUS_I2C0,
+    .init = opt3001_drv_init,
+    .start = opt3001_drv_start,
+    .read = opt3001_drv_read,
+    .sleep = opt3001_drv_sleep,
+    .get_capabilities = opt3001_drv_caps
+};
@@ -10,13 +10,36 @@
 #ifndef OPT3001_H_
 #define OPT3001_H_
 
+#include <stdint.h>
+#include <stdbool.h>
 #include <ti/drivers/I2C.h>
 
+#include "sensor.h"
+
 #define OPT3001_REG_RESULT		0x0
 #define OPT3001_REG_CONFIG		0x1
+#define OPT3001_REG_LOW_LIMIT	0x2
 #define OPT3001_DATA_READY		0x80
 
+// Configuration register fields, s.20
+#define OPT3001_RN_AUTO			0xC000	// automatic full-scale range
+#define OPT3001_CT_800MS		0x0800
+#define OPT3001_M_CONTINUOUS	0x0600
+#define OPT3001_LATCH			0x0010
+
+// Low-limit exponent 11b puts the INT pin into end-of-conversion mode, s.15
+#define OPT3001_LOW_LIMIT_EOC	0xC000
+
+enum opt3001ConversionTime {
+    OPT3001_CONVERSION_100MS = 0,
+    OPT3001_CONVERSION_800MS
+};
+
 void opt3001_setup(I2C_Handle *i2c);
-double opt3001_get_data(I2C_Handle *i2c);
+bool opt3001_configure(I2C_Handle *i2c, enum opt3001ConversionTime time);
+int32_t opt3001_get_data(I2C_Handle *i2c);
+int32_t opt3001_wait_data(I2C_Handle *i2c, uint32_t timeoutUs);
+
+extern const SensorDriver opt3001Driver;
 
 #endif /* OPT3001_H_ */
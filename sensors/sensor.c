@@ -0,0 +1,68 @@
+/*
+ * sensor.c
+ *
+ *  Driver registry and shared I2C bus handling, see sensor.h.
+ */
+
+#include <xdc/std.h>
+#include <xdc/runtime/System.h>
+#include <ti/drivers/I2C.h>
+#include <ti/drivers/i2c/I2CCC26XX.h>
+
+#include "Board.h"
+#include "sensor.h"
+#include "mpu9250.h"
+#include "opt3001.h"
+#include "bmp280.h"
+#include "tmp007.h"
+#include "hdc1000.h"
+
+const SensorDriver *const sensorRegistry[SENSOR_COUNT] = {
+    &mpu9250Driver,
+    &opt3001Driver,
+    &bmp280Driver,
+    &tmp007Driver,
+    &hdc1000Driver
+};
+
+// I2C config for reading gyro and accelerometer
+static const I2CCC26XX_I2CPinCfg i2cMPUCfg = {
+    .pinSDA = Board_I2C0_SDA1,
+    .pinSCL = Board_I2C0_SCL1
+};
+
+static I2C_Handle i2cHandle = NULL;
+static enum sensorBus openBus = SENSOR_BUS_NONE;
+
+// There is only one I2C controller, so switching between the sensor pins
+// and the MPU pins means closing and reopening it.
+I2C_Handle sensor_open(enum sensorBus bus) {
+
+    I2C_Params i2cParams;
+
+    if (bus == openBus) {
+        return i2cHandle;
+    }
+    sensor_close();
+
+    I2C_Params_init(&i2cParams);
+    i2cParams.bitRate = I2C_400kHz;
+    if (bus == SENSOR_BUS_MPU) {
+        i2cParams.custom = (uintptr_t)&i2cMPUCfg;
+    }
+    i2cHandle = I2C_open(Board_I2C, &i2cParams);
+    if (i2cHandle == NULL) {
+        System_abort("Error Initializing I2C\n");
+    }
+    openBus = bus;
+    return i2cHandle;
+}
+
+void sensor_close(void) {
+
+    if (i2cHandle != NULL) {
+        I2C_close(i2cHandle);
+        i2cHandle = NULL;
+    }
+    openBus = SENSOR_BUS_NONE;
+}
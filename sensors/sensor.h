@@ -0,0 +1,63 @@
+/*
+ * sensor.h
+ *
+ *  Common driver interface for the SensorTag sensors. Every driver exports a
+ *  const SensorDriver; sensorRegistry lists them all so sampling code can
+ *  handle any sensor without knowing its registers.
+ *
+ *  All calls run in Task context with the driver's bus open (sensor_open).
+ *  read() never blocks: it returns the number of channels written into buf,
+ *  0 when there is no new result yet, and -1 on a bus error.
+ */
+
+#ifndef SENSOR_H_
+#define SENSOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ti/drivers/I2C.h>
+
+#define SENSOR_MAX_CHANNELS 6
+
+enum sensorId {
+    SENSOR_MPU9250 = 0,
+    SENSOR_OPT3001,
+    SENSOR_BMP280,
+    SENSOR_TMP007,
+    SENSOR_HDC1000,
+    SENSOR_COUNT
+};
+
+// The MPU9250 sits on the same I2C controller but on different pins
+enum sensorBus {
+    SENSOR_BUS_I2C0 = 0,
+    SENSOR_BUS_MPU,
+    SENSOR_BUS_NONE
+};
+
+typedef struct {
+    uint32_t minPeriodMs;     // fastest useful sampling period
+    uint32_t maxPeriodMs;     // slowest period before the sensor should sleep
+    uint32_t latencyUs;       // start() -> first result available
+    uint16_t activeUa;        // typical current while measuring
+    uint16_t sleepUa;         // typical current after sleep()
+    uint8_t channels;
+    const char *units;        // comma separated, one per channel
+} SensorCaps;
+
+typedef struct {
+    const char *name;
+    enum sensorBus bus;
+    bool (*init)(I2C_Handle *i2c);
+    bool (*start)(I2C_Handle *i2c);
+    int (*read)(I2C_Handle *i2c, int32_t *buf);
+    bool (*sleep)(I2C_Handle *i2c);
+    const SensorCaps *(*get_capabilities)(void);
+} SensorDriver;
+
+extern const SensorDriver *const sensorRegistry[SENSOR_COUNT];
+
+I2C_Handle sensor_open(enum sensorBus bus);
+void sensor_close(void);
+
+#endif /* SENSOR_H_ */
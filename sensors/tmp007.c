@@ -7,39 +7,220 @@
  *  Datakirja: http://www.ti.com/lit/ds/symlink/tmp007.pdf
  */
 
+#include <xdc/std.h>
 #include <xdc/runtime/System.h>
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/knl/Semaphore.h>
+#include <ti/drivers/PIN.h>
 #include <string.h>
 #include "Board.h"
 #include "tmp007.h"
+#include "trace.h"
+#include "wakeup.h"
 
-void tmp007_setup(I2C_Handle *i2c) {
+// ALERT is open drain and active low on Board_TMP_RDY. Depending on the
+// status mask it fires on conversion ready or on an object limit crossing.
+static Semaphore_Struct alertSem;
+static Semaphore_Handle hAlertSem = NULL;
+static PIN_Handle hAlertPin = NULL;
+static PIN_State alertPinState;
+static PIN_Config alertPinConfig[] = {
+	Board_TMP_RDY | PIN_INPUT_EN | PIN_PULLUP | PIN_IRQ_NEGEDGE | PIN_HYSTERESIS,
+	PIN_TERMINATE
+};
+
+static uint16_t config = TMP007_CONFIG_CONV_ON | TMP007_CONFIG_ALERT_EN | TMP007_CONFIG_INT_MODE;
+
+// minPeriodMs and latencyUs follow the averaging, see tmp007_configure
+static SensorCaps tmp007Caps = {
+	.minPeriodMs = 1010,
+	.maxPeriodMs = 4010,
+	.latencyUs = 1010000,	// four averaged conversions
+	.activeUa = 270,
+	.sleepUa = 2,
+	.channels = 2,
+	.units = "cdegC,cdegC"
+};
+
+static void tmp007_alertFxn(PIN_Handle handle, PIN_Id pinId) {
+
+	wakeup_mark(WAKE_PIN_TMP007);
+	Semaphore_post(hAlertSem);
+}
+
+static bool tmp007_write_reg(I2C_Handle *i2c, uint8_t reg, uint16_t value) {
 
-	System_printf("TMP007: Config OK!\n");
-    System_flush();
+	I2C_Transaction i2cTransaction;
+	uint8_t txBuffer[3];
+
+	i2cTransaction.slaveAddress = Board_TMP007_ADDR;
+	txBuffer[0] = reg;
+	txBuffer[1] = value >> 8;
+	txBuffer[2] = value & 0xFF;
+	i2cTransaction.writeBuf = txBuffer;
+	i2cTransaction.writeCount = 3;
+	i2cTransaction.readBuf = NULL;
+	i2cTransaction.readCount = 0;
+
+	return I2C_transfer(*i2c, &i2cTransaction);
 }
 
-/**************** JTKJ: DO NOT MODIFY ANYTHING ABOVE THIS LINE ****************/
+static bool tmp007_read_reg(I2C_Handle *i2c, uint8_t reg, uint16_t *value) {
 
-double tmp007_get_data(I2C_Handle *i2c) {
+	I2C_Transaction i2cTransaction;
+	uint8_t txBuffer[1];
+	uint8_t rxBuffer[2];
 
-	double temperature = 0.0; // return value of the function
-    // JTKJ: Find out the correct buffer sizes with this sensor?
-    // char txBuffer[ n ];
-    // char rxBuffer{ n ];
+	i2cTransaction.slaveAddress = Board_TMP007_ADDR;
+	txBuffer[0] = reg;
+	i2cTransaction.writeBuf = txBuffer;
+	i2cTransaction.writeCount = 1;
+	i2cTransaction.readBuf = rxBuffer;
+	i2cTransaction.readCount = 2;
 
-    // JTKJ: Fill in the i2cMessage data structure with correct values
-    //       as shown in the lecture material
-    I2C_Transaction i2cMessage;
+	if (!I2C_transfer(*i2c, &i2cTransaction)) {
+		return false;
+	}
+	*value = (rxBuffer[0] << 8) | rxBuffer[1];
+	return true;
+}
 
-	if (I2C_transfer(*i2c, &i2cMessage)) {
+void tmp007_setup(I2C_Handle *i2c) {
+
+	if (hAlertSem == NULL) {
+		Semaphore_Params semParams;
+		Semaphore_Params_init(&semParams);
+		semParams.mode = Semaphore_Mode_BINARY;
+		Semaphore_construct(&alertSem, 0, &semParams);
+		hAlertSem = Semaphore_handle(&alertSem);
 
-        // JTKJ: Here the conversion from register value to temperature
+		hAlertPin = PIN_open(&alertPinState, alertPinConfig);
+		if (hAlertPin == NULL || PIN_registerIntCb(hAlertPin, &tmp007_alertFxn) != 0) {
+			System_abort("TMP007: Alert pin open failed!\n");
+		}
+	}
 
+	if (tmp007_configure(i2c, TMP007_AVG_4)) {
+
+		System_printf("TMP007: Config OK!\n");
 	} else {
+		System_printf("TMP007: Config write failed!\n");
+	}
+	System_flush();
+}
+
+// Sets the averaging (and with it the conversion rate) and switches ALERT to
+// data-ready mode. A conversion takes 0.26 s per averaged sample pair,
+// faster sampling would only poll "not ready".
+bool tmp007_configure(I2C_Handle *i2c, enum tmp007Averaging averaging) {
+
+	uint32_t conversionMs = (250 << averaging) + 10;
+
+	config = (config & ~0x0E00) | (averaging << 9);
+	tmp007Caps.minPeriodMs = conversionMs;
+	tmp007Caps.latencyUs = conversionMs * 1000;
+
+	return tmp007_write_reg(i2c, TMP007_REG_CONFIG, config)
+	    && tmp007_write_reg(i2c, TMP007_REG_MASK, TMP007_STATUS_ALERT | TMP007_STATUS_READY);
+}
+
+// Switches ALERT from data-ready to threshold mode. high and low are object
+// temperatures in 0.01 degC; the limit registers have 0.5 degC resolution in
+// bits 15:6, s.28. From then on ALERT, and with it a result from drv_read,
+// only comes when the object temperature is outside the window; until then
+// the driver does no I2C traffic at all.
+bool tmp007_set_limits(I2C_Handle *i2c, int32_t high, int32_t low) {
+
+	uint16_t highReg = (uint16_t)((high / 50) * 64);
+	uint16_t lowReg = (uint16_t)((low / 50) * 64);
+
+	return tmp007_write_reg(i2c, TMP007_REG_OBJ_HIGH, highReg)
+	    && tmp007_write_reg(i2c, TMP007_REG_OBJ_LOW, lowReg)
+	    && tmp007_write_reg(i2c, TMP007_REG_MASK,
+	                        TMP007_STATUS_ALERT | TMP007_STATUS_OBJ_HIGH | TMP007_STATUS_OBJ_LOW);
+}
+
+// Blocks until ALERT fires or timeout (Clock ticks) expires. Returns the status
+// register, which also releases ALERT, or 0 on timeout.
+uint16_t tmp007_wait(I2C_Handle *i2c, uint32_t timeout) {
 
-		System_printf("TMP007: Data read failed!\n");
-		System_flush();
+	uint16_t status;
+
+	if (!Semaphore_pend(hAlertSem, timeout)) {
+		return 0;
+	}
+	if (!tmp007_read_reg(i2c, TMP007_REG_STATUS, &status)) {
+		TRACE0("TMP007: Status read failed!");
+		return 0;
+	}
+	return status;
+}
+
+// Object and die temperature in 0.01 degC. The registers hold 14-bit two's
+// complement values in bits 15:2 with 1/32 degC per LSB, s.25.
+bool tmp007_get_data(I2C_Handle *i2c, int32_t *object, int32_t *die) {
+
+	uint16_t rawObject, rawDie;
+
+	if (!tmp007_read_reg(i2c, TMP007_REG_TEMP, &rawObject) ||
+	    !tmp007_read_reg(i2c, TMP007_REG_DIE_TEMP, &rawDie)) {
+		TRACE0("TMP007: Data read failed!");
+		return false;
+	}
+	if (rawObject & 0x0001) {
+		// nDVF, the object result is not valid
+		return false;
 	}
 
-	return temperature;
+	*object = ((int32_t)((int16_t)rawObject >> 2) * 25) / 8;
+	*die = ((int32_t)((int16_t)rawDie >> 2) * 25) / 8;
+	return true;
 }
+
+/* Common driver interface, see sensor.h */
+
+static bool tmp007_drv_init(I2C_Handle *i2c) {
+
+	tmp007_setup(i2c);
+	return true;
+}
+
+static bool tmp007_drv_start(I2C_Handle *i2c) {
+
+	config |= TMP007_CONFIG_CONV_ON;
+	return tmp007_write_reg(i2c, TMP007_REG_CONFIG, config);
+}
+
+// Object and die temperature in 0.01 degC, once per finished conversion or,
+// in threshold mode, once per conversion outside the limits
+static int tmp007_drv_read(I2C_Handle *i2c, int32_t *buf) {
+
+	if (!(tmp007_wait(i2c, BIOS_NO_WAIT) & (TMP007_STATUS_READY | TMP007_STATUS_OBJ_HIGH | TMP007_STATUS_OBJ_LOW))) {
+		return 0;
+	}
+	if (!tmp007_get_data(i2c, &buf[0], &buf[1])) {
+		return -1;
+	}
+	return 2;
+}
+
+static bool tmp007_drv_sleep(I2C_Handle *i2c) {
+
+	config &= ~TMP007_CONFIG_CONV_ON;
+	return tmp007_write_reg(i2c, TMP007_REG_CONFIG, config);
+}
+
+static const SensorCaps *tmp007_drv_caps(void) {
+
+	return &tmp007Caps;
+}
+
+const SensorDriver tmp007Driver = {
+	.name = "tmp007",
+	.bus = SENSOR_BUS_I2C0,
+	.init = tmp007_drv_init,
+	.start = tmp007_drv_start,
+	.read = tmp007_drv_read,
+	.sleep = tmp007_drv_sleep,
+	.get_capabilities = tmp007_drv_caps
+};
@@ -10,11 +10,46 @@
 #ifndef TMP007_H_
 #define TMP007_H_
 
+#include <stdint.h>
+#include <stdbool.h>
 #include <ti/drivers/I2C.h>
 
-#define TMP007_REG_TEMP	0x03
+#include "sensor.h"
+
+#define TMP007_REG_DIE_TEMP		0x01
+#define TMP007_REG_CONFIG		0x02
+#define TMP007_REG_TEMP			0x03
+#define TMP007_REG_STATUS		0x04
+#define TMP007_REG_MASK			0x05
+#define TMP007_REG_OBJ_HIGH		0x06
+#define TMP007_REG_OBJ_LOW		0x07
+
+// Configuration register, s.26
+#define TMP007_CONFIG_CONV_ON	0x1000
+#define TMP007_CONFIG_ALERT_EN	0x0100
+#define TMP007_CONFIG_INT_MODE	0x0020	// ALERT clears on status read
+
+// Status and status mask registers share the bit layout, s.27
+#define TMP007_STATUS_ALERT		0x8000
+#define TMP007_STATUS_READY		0x4000
+#define TMP007_STATUS_OBJ_HIGH	0x2000
+#define TMP007_STATUS_OBJ_LOW	0x1000
+
+// Conversion rate (CR bits): number of averaged conversions, s.26
+enum tmp007Averaging {
+	TMP007_AVG_1 = 0,	// 0.26 s
+	TMP007_AVG_2,		// 0.51 s
+	TMP007_AVG_4,		// 1.01 s
+	TMP007_AVG_8,		// 2.01 s
+	TMP007_AVG_16		// 4.01 s
+};
 
 void tmp007_setup(I2C_Handle *i2c);
-double tmp007_get_data(I2C_Handle *i2c);
+bool tmp007_configure(I2C_Handle *i2c, enum tmp007Averaging averaging);
+bool tmp007_set_limits(I2C_Handle *i2c, int32_t high, int32_t low);
+uint16_t tmp007_wait(I2C_Handle *i2c, uint32_t timeout);
+bool tmp007_get_data(I2C_Handle *i2c, int32_t *object, int32_t *die);
+
+extern const SensorDriver tmp007Driver;
 
 #endif /* TMP007_H_ */
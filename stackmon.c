@@ -0,0 +1,123 @@
+/*
+ * stackmon.c
+ *
+ *  Stack high-water marks and RAM budget, see stackmon.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <xdc/std.h>
+#include <xdc/runtime/Memory.h>
+
+#include "stackmon.h"
+#include "trace.h"
+#include "memsection.h"
+#include "report.h"
+
+// Defined in CC2650STK.cmd
+extern uint8_t ramBssSize[], ramDataSize[];
+extern uint8_t ramSysStack[], ramSysStackSize[];
+extern uint8_t ramFuncSize[];
+
+static StackInfo stacks[STACKMON_MAX_STACKS];
+static uint8_t stackCount = 0;
+
+void stackmon_paint(void *stack, uint32_t size) {
+
+    memset(stack, STACKMON_FILL, size);
+}
+
+// main() runs on the system (Hwi/Swi) stack, so only the part below the
+// current frame can be painted. 64 bytes are left for the callee frames.
+void stackmon_paintSystemStack(void) {
+
+    uint8_t marker;
+    uint8_t *top = &marker - 64;
+
+    if (top > ramSysStack) {
+        memset(ramSysStack, STACKMON_FILL, top - ramSysStack);
+    }
+    stackmon_register("system", ramSysStack, (uint32_t)(uintptr_t)ramSysStackSize);
+}
+
+void stackmon_register(const char *name, void *stack, uint32_t size) {
+
+    if (stackCount < STACKMON_MAX_STACKS) {
+        stacks[stackCount].name = name;
+        stacks[stackCount].base = stack;
+        stacks[stackCount].size = size;
+        stacks[stackCount].highWater = 0;
+        stackCount++;
+    }
+}
+
+void stackmon_registerTask(const char *name, Task_Handle task) {
+
+    Task_Stat stat;
+
+    Task_stat(task, &stat);
+    stackmon_register(name, stat.stack, stat.stackSize);
+}
+
+static uint32_t stackmon_highWater(const StackInfo *info) {
+
+    uint32_t untouched = 0;
+
+    while (untouched < info->size && info->base[untouched] == STACKMON_FILL) {
+        untouched++;
+    }
+    return info->size - untouched;
+}
+
+// Updates the high-water marks. Returns the number of stacks that are within
+// STACKMON_WARN_BYTES of overflowing.
+int stackmon_check(void) {
+
+    int i, warnings = 0;
+
+    if (stackmon_ramFuncSize() > RAMFUNC_BUDGET) {
+        TRACE2("WARN ramfunc %u > %u bytes", stackmon_ramFuncSize(), RAMFUNC_BUDGET);
+        warnings++;
+    }
+    for (i = 0; i < stackCount; i++) {
+        stacks[i].highWater = stackmon_highWater(&stacks[i]);
+        if (stacks[i].size - stacks[i].highWater < STACKMON_WARN_BYTES) {
+            TRACE2("WARN stack %x: %u bytes left", i, stacks[i].size - stacks[i].highWater);
+            warnings++;
+        }
+    }
+    return warnings;
+}
+
+uint32_t stackmon_ramFuncSize(void) {
+
+    return (uint32_t)(uintptr_t)ramFuncSize;
+}
+
+// One line per stack, then heap and static data:
+//   stack <name> <used>/<size>[ WARN]
+//   heap <used>/<size> largest=<free block>
+//   bss=<bytes> data=<bytes> ramfunc=<bytes>/<budget>
+void stackmon_report(UART_Handle uart) {
+
+    char line[64];
+    int i;
+    Memory_Stats heap;
+
+    stackmon_check();
+    for (i = 0; i < stackCount; i++) {
+        report_printf(uart, line, sizeof(line), "stack %s %lu/%lu%s\r\n", stacks[i].name,
+                      (unsigned long)stacks[i].highWater, (unsigned long)stacks[i].size,
+                      stacks[i].size - stacks[i].highWater < STACKMON_WARN_BYTES ? " WARN" : "");
+    }
+
+    Memory_getStats(NULL, &heap);
+    report_printf(uart, line, sizeof(line), "heap %lu/%lu largest=%lu\r\n",
+                  (unsigned long)(heap.totalSize - heap.totalFreeSize),
+                  (unsigned long)heap.totalSize, (unsigned long)heap.largestFreeSize);
+
+    report_printf(uart, line, sizeof(line), "bss=%lu data=%lu ramfunc=%lu/%u\r\n",
+                  (unsigned long)(uintptr_t)ramBssSize, (unsigned long)(uintptr_t)ramDataSize,
+                  (unsigned long)stackmon_ramFuncSize(), RAMFUNC_BUDGET);
+}
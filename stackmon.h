@@ -0,0 +1,35 @@
+/*
+ * stackmon.h
+ *
+ *  Stack high-water marks and RAM budget. Task stacks are filled with
+ *  STACKMON_FILL before the tasks start; the high-water mark is the deepest
+ *  byte that no longer holds the fill pattern.
+ */
+
+#ifndef STACKMON_H_
+#define STACKMON_H_
+
+#include <stdint.h>
+#include <ti/sysbios/knl/Task.h>
+#include <ti/drivers/UART.h>
+
+#define STACKMON_FILL           0xBE   // same pattern SYS/BIOS uses
+#define STACKMON_MAX_STACKS     6
+#define STACKMON_WARN_BYTES     256    // warn when less than this is left
+
+typedef struct {
+    const char *name;
+    uint8_t *base;       // lowest address, stacks grow down towards it
+    uint32_t size;
+    uint32_t highWater;  // deepest use seen so far, bytes
+} StackInfo;
+
+void stackmon_paint(void *stack, uint32_t size);
+void stackmon_paintSystemStack(void);
+void stackmon_register(const char *name, void *stack, uint32_t size);
+void stackmon_registerTask(const char *name, Task_Handle task);
+int stackmon_check(void);
+void stackmon_report(UART_Handle uart);
+uint32_t stackmon_ramFuncSize(void);
+
+#endif /* STACKMON_H_ */
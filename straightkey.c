@@ -0,0 +1,198 @@
+/*
+ * straightkey.c
+ *
+ *  Debounced button straight key, see straightkey.h.
+ */
+
+#include <stdio.h>
+
+#include <xdc/std.h>
+#include <ti/sysbios/hal/Hwi.h>
+#include <ti/sysbios/knl/Clock.h>
+#include <ti/drivers/PIN.h>
+
+#include "straightkey.h"
+#include "cycles.h"
+#include "wakeup.h"
+#include "memsection.h"
+#include "report.h"
+
+static Clock_Struct debounceClockStruct;
+static Clock_Handle debounceClock;
+static Clock_Struct gapClockStruct;
+static Clock_Handle gapClock;
+
+// Raw edges of the current burst, written by the pin callback
+static volatile bool burst = false;
+static volatile uint32_t firstTicks;
+static volatile uint32_t lastTicks;
+static volatile bool lastDown;
+static volatile uint8_t burstEdges;
+
+static bool stableDown = false;
+static volatile bool keying = false;
+static MorseKey key;
+static MorseSymbolFxn symbolFxn;
+static void *symbolArg;
+static StraightKeyStats stats;
+
+// Installed as the PIN callback of Board_BUTTON0 with both edges enabled.
+// Pressed reads low, the input is pulled up.
+RAMFUNC void straightkey_pinFxn(PIN_Handle handle, PIN_Id pinId) {
+
+    uint32_t start = cycles_now();
+    uint32_t now, cycles;
+    bool down, arm;
+    UInt hwiKey;
+
+    wakeup_mark(WAKE_PIN_BUTTON);
+    now = Clock_getTicks();
+    down = PIN_getInputValue(pinId) == 0;
+    hwiKey = Hwi_disable();
+    arm = !burst;
+    if (arm) {
+        burst = true;
+        firstTicks = now;
+        burstEdges = 0;
+    }
+    lastTicks = now;
+    lastDown = down;
+    burstEdges++;
+    Hwi_restore(hwiKey);
+    if (arm) {
+        Clock_start(debounceClock);
+    }
+
+    cycles = cycles_now() - start;
+    stats.edges++;
+    stats.isrCycles += cycles;
+    if (cycles > stats.isrMaxCycles) {
+        stats.isrMaxCycles = cycles;
+    }
+}
+
+// Keeps the classifier running through the pause so gaps come out in time
+static void straightkey_armGap(void) {
+
+    Clock_stop(gapClock);
+    Clock_setTimeout(gapClock, key.dotUs / Clock_tickPeriod);
+    Clock_start(gapClock);
+}
+
+static void straightkey_gapFxn(UArg arg) {
+
+    wakeup_mark(WAKE_CLOCK_BUTTON);
+    if (keying && !stableDown) {
+        morsekey_update(&key, false, Clock_getTicks() * Clock_tickPeriod);
+        if (key.started) {
+            straightkey_armGap();
+        }
+    }
+}
+
+// Runs STRAIGHTKEY_DEBOUNCE_US after the first edge of a burst, and again
+// until the button has been quiet that long
+static void straightkey_debounceFxn(UArg arg) {
+
+    uint32_t debounceTicks = STRAIGHTKEY_DEBOUNCE_US / Clock_tickPeriod;
+    uint32_t now = Clock_getTicks();
+    uint32_t first;
+    uint8_t edges;
+    bool down;
+    UInt hwiKey;
+
+    wakeup_mark(WAKE_CLOCK_BUTTON);
+    hwiKey = Hwi_disable();
+    if (now - lastTicks < debounceTicks) {
+        Clock_setTimeout(debounceClock, debounceTicks - (now - lastTicks));
+        Hwi_restore(hwiKey);
+        Clock_start(debounceClock);
+        return;
+    }
+    first = firstTicks;
+    edges = burstEdges;
+    down = lastDown;
+    // The next burst arms the clock with the full time again
+    Clock_setTimeout(debounceClock, debounceTicks);
+    burst = false;
+    Hwi_restore(hwiKey);
+
+    if (down == stableDown) {
+        stats.bounces += edges;
+        return;
+    }
+    stableDown = down;
+    stats.bounces += edges - 1;
+    if (down) {
+        stats.presses++;
+    }
+    if (keying) {
+        Clock_stop(gapClock);
+        morsekey_update(&key, down, first * Clock_tickPeriod);
+        if (!down) {
+            straightkey_armGap();
+        }
+    } else if (down) {
+        symbolFxn(' ', first * Clock_tickPeriod, symbolArg);
+    }
+}
+
+// Before the button callback is registered
+void straightkey_init(MorseSymbolFxn fxn, void *arg) {
+
+    Clock_Params clockParams;
+
+    Clock_Params_init(&clockParams);
+    clockParams.startFlag = FALSE;
+    Clock_construct(&debounceClockStruct, (Clock_FuncPtr)straightkey_debounceFxn,
+                    STRAIGHTKEY_DEBOUNCE_US / Clock_tickPeriod, &clockParams);
+    debounceClock = Clock_handle(&debounceClockStruct);
+    Clock_construct(&gapClockStruct, (Clock_FuncPtr)straightkey_gapFxn, 1, &clockParams);
+    gapClock = Clock_handle(&gapClockStruct);
+
+    symbolFxn = fxn;
+    symbolArg = arg;
+    morsekey_init(&key, STRAIGHTKEY_DOT_US, fxn, arg);
+    cycles_init();
+}
+
+// Every switch starts learning the speed from STRAIGHTKEY_DOT_US again
+void straightkey_setKeying(bool on) {
+
+    UInt hwiKey;
+
+    Clock_stop(gapClock);
+    hwiKey = Hwi_disable();
+    morsekey_init(&key, STRAIGHTKEY_DOT_US, symbolFxn, symbolArg);
+    keying = on;
+    Hwi_restore(hwiKey);
+}
+
+bool straightkey_keying(void) {
+
+    return keying;
+}
+
+// Export format:
+//   key mode=<morse|space> edges=<n> presses=<n> bounces=<n> isr max=<cycles> avg=<cycles>
+//   key dot=<us> dash=<us> dots=<n> dashes=<n> letters=<n> words=<n> glitches=<n>
+void straightkey_report(UART_Handle uart) {
+
+    char line[128];
+    StraightKeyStats s;
+    MorseKey k;
+    UInt hwiKey = Hwi_disable();
+
+    s = stats;
+    k = key;
+    Hwi_restore(hwiKey);
+
+    report_printf(uart, line, sizeof(line), "key mode=%s edges=%lu presses=%lu bounces=%lu isr max=%lu avg=%lu\r\n",
+                  keying ? "morse" : "space", (unsigned long)s.edges, (unsigned long)s.presses,
+                  (unsigned long)s.bounces, (unsigned long)s.isrMaxCycles,
+                  (unsigned long)(s.edges ? s.isrCycles / s.edges : 0));
+    report_printf(uart, line, sizeof(line), "key dot=%lu dash=%lu dots=%lu dashes=%lu letters=%lu words=%lu glitches=%lu\r\n",
+                  (unsigned long)k.dotUs, (unsigned long)k.dashUs, (unsigned long)k.stats.dots,
+                  (unsigned long)k.stats.dashes, (unsigned long)k.stats.letters,
+                  (unsigned long)k.stats.words, (unsigned long)k.stats.glitches);
+}
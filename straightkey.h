@@ -0,0 +1,44 @@
+/*
+ * straightkey.h
+ *
+ *  Board_BUTTON0 as a Morse straight key. The pin callback
+ *  (straightkey_pinFxn) timestamps both edges and arms a debounce Clock;
+ *  nothing else runs there. The Clock function (Clock Swi) waits until the
+ *  button has been quiet for STRAIGHTKEY_DEBOUNCE_US and takes the first
+ *  edge of the burst as the time of the press or release. Stable edges go to a MorseKey
+ *  (morsekey.h), which learns the operator's speed; a second Clock keeps
+ *  it updated while the key is up so letter and word gaps are reported
+ *  without waiting for the next press.
+ *
+ *  With keying off the button sends a ' ' on every press, as it always did.
+ *  The cycles spent in the pin callback are measured with the DWT.
+ */
+
+#ifndef STRAIGHTKEY_H_
+#define STRAIGHTKEY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ti/drivers/PIN.h>
+#include <ti/drivers/UART.h>
+
+#include "morsekey.h"
+
+#define STRAIGHTKEY_DEBOUNCE_US     10000
+#define STRAIGHTKEY_DOT_US          100000      // 12 wpm, where learning starts
+
+typedef struct {
+    uint32_t edges;         // raw edges seen by the callback
+    uint32_t presses;       // debounced
+    uint32_t bounces;       // raw edges that were not a debounced edge
+    uint32_t isrMaxCycles;  // pin callback, per edge
+    uint64_t isrCycles;
+} StraightKeyStats;
+
+void straightkey_init(MorseSymbolFxn fxn, void *arg);
+void straightkey_pinFxn(PIN_Handle handle, PIN_Id pinId);
+void straightkey_setKeying(bool on);
+bool straightkey_keying(void);
+void straightkey_report(UART_Handle uart);
+
+#endif /* STRAIGHTKEY_H_ */
@@ -0,0 +1,72 @@
+/*
+ * symbol.c
+ *
+ *  Queue of outgoing Morse symbols. Producers run in Task and Swi context
+ *  (pin callbacks), so the queue indices are updated with interrupts disabled.
+ */
+
+#include <xdc/std.h>
+#include <ti/sysbios/hal/Hwi.h>
+#include <ti/sysbios/knl/Clock.h>
+#include <ti/sysbios/knl/Semaphore.h>
+
+#include "symbol.h"
+#include "memsection.h"
+
+static Symbol queue[SYMBOL_QUEUE_SIZE];
+static volatile uint16_t head = 0;
+static volatile uint16_t tail = 0;
+static Semaphore_Handle notifySem = NULL;
+
+// Microsecond timestamp used for every pipeline stage. Wraps after ~71 min,
+// differences are taken with unsigned arithmetic so the wrap is harmless.
+uint32_t symbol_now(void) {
+
+    return Clock_getTicks() * Clock_tickPeriod;
+}
+
+RAMFUNC bool symbol_post(char symbol, uint32_t tSample, uint32_t tDecision) {
+
+    UInt key = Hwi_disable();
+    uint16_t next = (head + 1) % SYMBOL_QUEUE_SIZE;
+
+    if (next == tail) {
+        Hwi_restore(key);
+        return false;
+    }
+    queue[head].symbol = symbol;
+    queue[head].tSample = tSample;
+    queue[head].tDecision = tDecision;
+    queue[head].tEnqueue = symbol_now();
+    head = next;
+    Hwi_restore(key);
+    if (notifySem != NULL) {
+        Semaphore_post(notifySem);
+    }
+    return true;
+}
+
+bool symbol_get(Symbol *symbol) {
+
+    UInt key = Hwi_disable();
+
+    if (head == tail) {
+        Hwi_restore(key);
+        return false;
+    }
+    *symbol = queue[tail];
+    tail = (tail + 1) % SYMBOL_QUEUE_SIZE;
+    Hwi_restore(key);
+    return true;
+}
+
+// Posted for every queued symbol so the consumer can block instead of polling
+void symbol_setNotify(Semaphore_Handle sem) {
+
+    notifySem = sem;
+}
+
+uint16_t symbol_count(void) {
+
+    return (head + SYMBOL_QUEUE_SIZE - tail) % SYMBOL_QUEUE_SIZE;
+}
@@ -0,0 +1,31 @@
+/*
+ * symbol.h
+ *
+ *  Queue of outgoing Morse symbols ('.', '-', ' ') between the producers
+ *  (gesture logic, buttons) and the UART task. Every symbol carries the
+ *  timestamps of its pipeline stages so the end-to-end latency can be measured.
+ */
+
+#ifndef SYMBOL_H_
+#define SYMBOL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ti/sysbios/knl/Semaphore.h>
+
+#define SYMBOL_QUEUE_SIZE   16
+
+typedef struct {
+    char symbol;
+    uint32_t tSample;     // sample acquisition, us
+    uint32_t tDecision;   // gesture/button decision, us
+    uint32_t tEnqueue;    // queued for the UART task, us
+} Symbol;
+
+uint32_t symbol_now(void);
+bool symbol_post(char symbol, uint32_t tSample, uint32_t tDecision);
+bool symbol_get(Symbol *symbol);
+uint16_t symbol_count(void);
+void symbol_setNotify(Semaphore_Handle sem);
+
+#endif /* SYMBOL_H_ */
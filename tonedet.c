@@ -0,0 +1,119 @@
+/*
+ * tonedet.c
+ *
+ *  Decimator and Goertzel tone detector, see tonedet.h.
+ */
+
+#include <math.h>
+
+#include "tonedet.h"
+
+#define TONEDET_PI  3.14159265f
+
+// 2 cos(2 pi f / fs) in Q14
+static int32_t tonedet_coef(uint32_t hz, uint32_t rate) {
+
+    return (int32_t)(2.0f * cosf(2.0f * TONEDET_PI * hz / rate) * (1 << TONEDET_COEF_SHIFT) + 0.5f);
+}
+
+// The tone and both reference bins must stay under the decimated Nyquist
+// frequency. Only here is floating point used.
+bool tonedet_init(ToneDetector *det, uint32_t sampleRate, uint16_t toneHz, ToneFrameFxn fxn, void *arg) {
+
+    uint32_t rate = sampleRate / TONEDET_DECIMATION;
+    int b;
+
+    if (toneHz == 0 || (uint32_t)toneHz * 3 / 2 >= rate / 2) {
+        return false;
+    }
+    det->coef[0] = tonedet_coef(toneHz, rate);
+    det->coef[1] = tonedet_coef(toneHz * 2 / 3, rate);
+    det->coef[2] = tonedet_coef(toneHz * 3 / 2, rate);
+    for (b = 0; b < TONEDET_BINS; b++) {
+        det->s1[b] = det->s2[b] = 0;
+    }
+    det->acc = 0;
+    det->phase = 0;
+    det->count = 0;
+    det->noise = 0;
+    det->down = false;
+    det->toneHz = toneHz;
+    det->sampleUsQ8 = (1000000UL << 8) / sampleRate;
+    det->fxn = fxn;
+    det->arg = arg;
+    det->stats.frames = det->stats.downFrames = 0;
+    det->stats.tone = det->stats.reference = det->stats.noise = 0;
+    return true;
+}
+
+static uint32_t tonedet_power(const ToneDetector *det, int b) {
+
+    int64_t s1 = det->s1[b], s2 = det->s2[b];
+    int64_t p = s1 * s1 + s2 * s2 - ((det->coef[b] * s1) >> TONEDET_COEF_SHIFT) * s2;
+
+    return p <= 0 ? 0 : (uint32_t)(p >> TONEDET_POWER_SHIFT);
+}
+
+// Key decision at the end of a frame, with hysteresis
+static void tonedet_frame(ToneDetector *det, uint32_t timeUs) {
+
+    uint32_t tone = tonedet_power(det, 0);
+    uint32_t reference = (tonedet_power(det, 1) + tonedet_power(det, 2)) / 2;
+    uint32_t level = reference;
+    int b;
+
+    if (level < det->noise) {
+        level = det->noise;
+    }
+    if (level < TONEDET_MIN_POWER) {
+        level = TONEDET_MIN_POWER;
+    }
+    if (!det->down && tone / TONEDET_ON_RATIO > level) {
+        det->down = true;
+    } else if (det->down && tone / TONEDET_OFF_RATIO < level) {
+        det->down = false;
+    }
+    if (!det->down) {
+        det->noise += (int32_t)(((int64_t)tone - det->noise) / (1 << TONEDET_NOISE_FILTER));
+    } else {
+        det->stats.downFrames++;
+    }
+
+    det->stats.frames++;
+    det->stats.tone = tone;
+    det->stats.reference = reference;
+    det->stats.noise = det->noise;
+    for (b = 0; b < TONEDET_BINS; b++) {
+        det->s1[b] = det->s2[b] = 0;
+    }
+    det->count = 0;
+    det->fxn(det->down, timeUs, det->arg);
+}
+
+// timeUs is the time of the last sample in pcm
+void tonedet_process(ToneDetector *det, const int16_t *pcm, uint16_t count, uint32_t timeUs) {
+
+    uint16_t i;
+    int b;
+
+    for (i = 0; i < count; i++) {
+        int32_t x;
+
+        det->acc += pcm[i];
+        if (++det->phase < TONEDET_DECIMATION) {
+            continue;
+        }
+        x = det->acc / (TONEDET_DECIMATION << TONEDET_INPUT_SHIFT);
+        det->acc = 0;
+        det->phase = 0;
+
+        for (b = 0; b < TONEDET_BINS; b++) {
+            int32_t s = x + (int32_t)(((int64_t)det->coef[b] * det->s1[b]) >> TONEDET_COEF_SHIFT) - det->s2[b];
+            det->s2[b] = det->s1[b];
+            det->s1[b] = s;
+        }
+        if (++det->count == TONEDET_FRAME) {
+            tonedet_frame(det, timeUs - (((uint32_t)(count - 1 - i) * det->sampleUsQ8) >> 8));
+        }
+    }
+}
@@ -0,0 +1,65 @@
+/*
+ * tonedet.h
+ *
+ *  Fixed-point tone detector for acoustic Morse input. 16-bit PCM is
+ *  decimated by TONEDET_DECIMATION (block average) and run through a
+ *  Goertzel filter bank: one bin on the tone and two reference bins at 2/3
+ *  and 3/2 of it. Every TONEDET_FRAME decimated samples the tone power is
+ *  compared with the reference bins and a noise floor learnt while the key
+ *  is up; the key goes down above TONEDET_ON_RATIO times that level and up
+ *  again below TONEDET_OFF_RATIO.
+ *
+ *  At 16 kHz a frame is 16 ms and a bin 62.5 Hz wide. The cost per input
+ *  sample is one add, per decimated sample three 32x32->64 multiplies.
+ *  Plain C, builds on a host; tools/tonedet_bench.c measures it on synthetic
+ *  Morse audio.
+ */
+
+#ifndef TONEDET_H_
+#define TONEDET_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TONEDET_DECIMATION      4
+#define TONEDET_FRAME           64      // decimated samples per decision
+#define TONEDET_BINS            3       // tone, low and high reference
+#define TONEDET_COEF_SHIFT      14      // Goertzel coefficients Q14
+#define TONEDET_INPUT_SHIFT     4       // decimated samples kept to 12 bits
+#define TONEDET_POWER_SHIFT     10
+#define TONEDET_ON_RATIO        8
+#define TONEDET_OFF_RATIO       3
+#define TONEDET_NOISE_FILTER    4       // noise floor EWMA weight 1/2^n
+#define TONEDET_MIN_POWER       64      // absolute floor, silence never keys
+
+// Called once per frame with the key state and the time of the frame's end
+typedef void (*ToneFrameFxn)(bool down, uint32_t timeUs, void *arg);
+
+typedef struct {
+    uint32_t frames;
+    uint32_t downFrames;
+    uint32_t tone;          // powers of the last frame
+    uint32_t reference;
+    uint32_t noise;
+} ToneDetStats;
+
+typedef struct {
+    int32_t coef[TONEDET_BINS];
+    int32_t s1[TONEDET_BINS];
+    int32_t s2[TONEDET_BINS];
+    int32_t acc;
+    uint8_t phase;          // input samples in acc
+    uint16_t count;         // decimated samples in the frame
+    uint32_t noise;
+    bool down;
+    uint16_t toneHz;
+    uint32_t sampleUsQ8;    // input sample period, us << 8
+    ToneFrameFxn fxn;
+    void *arg;
+    ToneDetStats stats;
+} ToneDetector;
+
+bool tonedet_init(ToneDetector *det, uint32_t sampleRate, uint16_t toneHz, ToneFrameFxn fxn, void *arg);
+void tonedet_process(ToneDetector *det, const int16_t *pcm, uint16_t count, uint32_t timeUs);
+
+#endif /* TONEDET_H_ */
@@ -0,0 +1,199 @@
+/*
+ * bmp280_bench.c
+ *
+ *  Host check and benchmark of the BMP280 compensation (sensors/bmp280comp.c).
+ *
+ *  The datasheet example (s.23) is the reference vector: the trimming
+ *  registers 0x88..0x9F are parsed from raw bytes, then adc_T = 519888 has to
+ *  give T = 2508 (25.08 degC) and t_fine = 128422, and adc_P = 415148 has to
+ *  give 100653 Pa on the 64-bit path. The 32-bit path rounds its
+ *  intermediates, so it only has to land within PRES32_TOLERANCE Pa.
+ *
+ *  After that a sweep over the sensor's temperature and pressure range
+ *  compares both integer paths with the floating point formulas of s.8.1,
+ *  and both are timed. The on-target cycle counts are the "bmp280" lines of
+ *  the benchmark.
+ *
+ *  Build and run from the repository root:
+ *      cc -O2 -I. -Isensors -o bmp280_bench tools/bmp280_bench.c sensors/bmp280comp.c -lm
+ *      ./bmp280_bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "bmp280comp.h"
+
+#define EXAMPLE_ADC_T       519888
+#define EXAMPLE_ADC_P       415148
+#define EXAMPLE_T           2508
+#define EXAMPLE_T_FINE      128422
+#define EXAMPLE_P           100653
+#define PRES32_TOLERANCE    8       // Pa
+#define PRES64_TOLERANCE    1       // Pa
+#define TEMP_TOLERANCE      1       // 0.01 degC
+#define TIMED_PASSES        2000000
+
+// Datasheet example, s.23
+static const Bmp280Calib example = {
+    27504, 26435, -1000, 36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000
+};
+
+static int failures = 0;
+
+static void check(int ok, const char *what, double got, double want) {
+
+    if (!ok) {
+        failures++;
+        printf("FAIL %s: got %.2f, expected %.2f\n", what, got, want);
+    }
+}
+
+// The trimming registers as the burst read returns them, LSB first
+static void calib_bytes(const Bmp280Calib *c, uint8_t *v) {
+
+    const uint16_t words[12] = {
+        c->dig_T1, (uint16_t)c->dig_T2, (uint16_t)c->dig_T3,
+        c->dig_P1, (uint16_t)c->dig_P2, (uint16_t)c->dig_P3,
+        (uint16_t)c->dig_P4, (uint16_t)c->dig_P5, (uint16_t)c->dig_P6,
+        (uint16_t)c->dig_P7, (uint16_t)c->dig_P8, (uint16_t)c->dig_P9
+    };
+    int i;
+
+    for (i = 0; i < 12; i++) {
+        v[2 * i] = words[i] & 0xFF;
+        v[2 * i + 1] = words[i] >> 8;
+    }
+}
+
+// Floating point compensation, s.8.1. Returns degC and sets t_fine.
+static double ref_temp(const Bmp280Calib *c, int32_t adc_T, double *t_fine) {
+
+    double var1, var2;
+
+    var1 = (adc_T / 16384.0 - c->dig_T1 / 1024.0) * c->dig_T2;
+    var2 = (adc_T / 131072.0 - c->dig_T1 / 8192.0);
+    var2 = var2 * var2 * c->dig_T3;
+    *t_fine = var1 + var2;
+    return (var1 + var2) / 5120.0;
+}
+
+// Pa
+static double ref_pres(const Bmp280Calib *c, int32_t adc_P, double t_fine) {
+
+    double var1, var2, p;
+
+    var1 = t_fine / 2.0 - 64000.0;
+    var2 = var1 * var1 * c->dig_P6 / 32768.0;
+    var2 = var2 + var1 * c->dig_P5 * 2.0;
+    var2 = var2 / 4.0 + c->dig_P4 * 65536.0;
+    var1 = (c->dig_P3 * var1 * var1 / 524288.0 + c->dig_P2 * var1) / 524288.0;
+    var1 = (1.0 + var1 / 32768.0) * c->dig_P1;
+    if (var1 == 0.0) {
+        return 0;
+    }
+    p = 1048576.0 - adc_P;
+    p = (p - var2 / 4096.0) * 6250.0 / var1;
+    var1 = c->dig_P9 * p * p / 2147483648.0;
+    var2 = p * c->dig_P8 / 32768.0;
+    return p + (var1 + var2 + c->dig_P7) / 16.0;
+}
+
+static void check_example(void) {
+
+    Bmp280Calib parsed;
+    uint8_t raw[24];
+    int32_t t, t_fine;
+    uint32_t p32, p64;
+
+    calib_bytes(&example, raw);
+    bmp280_parse_calib(&parsed, raw);
+    check(memcmp(&parsed, &example, sizeof(parsed)) == 0, "parsed trimming", 0, 0);
+
+    t = bmp280_compensate_temp(&parsed, EXAMPLE_ADC_T, &t_fine);
+    check(t == EXAMPLE_T, "example T", t, EXAMPLE_T);
+    check(t_fine == EXAMPLE_T_FINE, "example t_fine", t_fine, EXAMPLE_T_FINE);
+
+    p64 = bmp280_compensate_pres64(&parsed, EXAMPLE_ADC_P, t_fine);
+    check(p64 >> 8 == EXAMPLE_P, "example P, 64-bit", p64 / 256.0, EXAMPLE_P);
+
+    p32 = bmp280_compensate_pres(&parsed, EXAMPLE_ADC_P, t_fine);
+    check(labs((long)p32 - EXAMPLE_P) <= PRES32_TOLERANCE, "example P, 32-bit", p32, EXAMPLE_P);
+
+    printf("example: T %d (0.01 degC), t_fine %d, P %u Pa 32-bit, %.2f Pa 64-bit\n",
+           t, t_fine, p32, p64 / 256.0);
+}
+
+// -40..85 degC and 300..1100 hPa, the datasheet's operating range
+static void check_sweep(void) {
+
+    double worstT = 0, worst32 = 0, worst64 = 0;
+    long points = 0;
+    int32_t adc_T, adc_P;
+
+    for (adc_T = 380000; adc_T <= 660000; adc_T += 2000) {
+        double ref_t_fine;
+        double tRef = ref_temp(&example, adc_T, &ref_t_fine);
+        int32_t t_fine;
+        int32_t t = bmp280_compensate_temp(&example, adc_T, &t_fine);
+
+        if (tRef < -40.0 || tRef > 85.0) {
+            continue;
+        }
+        worstT = fmax(worstT, fabs(t - tRef * 100.0));
+        for (adc_P = 100000; adc_P <= 900000; adc_P += 1000) {
+            double pRef = ref_pres(&example, adc_P, ref_t_fine);
+            double p32, p64;
+
+            if (pRef < 30000.0 || pRef > 110000.0) {
+                continue;
+            }
+            p32 = bmp280_compensate_pres(&example, adc_P, t_fine);
+            p64 = bmp280_compensate_pres64(&example, adc_P, t_fine) / 256.0;
+            worst32 = fmax(worst32, fabs(p32 - pRef));
+            worst64 = fmax(worst64, fabs(p64 - pRef));
+            points++;
+        }
+    }
+    check(points > 0, "sweep points", points, 1);
+    check(worstT <= TEMP_TOLERANCE, "sweep T error", worstT, TEMP_TOLERANCE);
+    check(worst32 <= PRES32_TOLERANCE, "sweep P error, 32-bit", worst32, PRES32_TOLERANCE);
+    check(worst64 <= PRES64_TOLERANCE, "sweep P error, 64-bit", worst64, PRES64_TOLERANCE);
+    printf("sweep: %ld points, worst error T %.2f (0.01 degC), P %.2f Pa 32-bit, %.2f Pa 64-bit\n",
+           points, worstT, worst32, worst64);
+}
+
+static void bench(void) {
+
+    volatile uint32_t sink = 0;
+    clock_t start;
+    double ns32, ns64;
+    int32_t t_fine;
+    int i;
+
+    bmp280_compensate_temp(&example, EXAMPLE_ADC_T, &t_fine);
+    start = clock();
+    for (i = 0; i < TIMED_PASSES; i++) {
+        sink += bmp280_compensate_pres(&example, EXAMPLE_ADC_P + (i & 1023), t_fine);
+    }
+    ns32 = (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / TIMED_PASSES;
+    start = clock();
+    for (i = 0; i < TIMED_PASSES; i++) {
+        sink += bmp280_compensate_pres64(&example, EXAMPLE_ADC_P + (i & 1023), t_fine);
+    }
+    ns64 = (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / TIMED_PASSES;
+    printf("pressure: %.1f ns 32-bit, %.1f ns 64-bit per call\n", ns32, ns64);
+    (void)sink;
+}
+
+int main(void) {
+
+    check_example();
+    check_sweep();
+    bench();
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,404 @@
+/*
+ * cmdparse_fuzz.c
+ *
+ *  Host fuzz test of the UART command parser (cmdparse.c).
+ *
+ *  Feeds the parser a stream of random bytes, valid command lines, and
+ *  valid lines with bytes flipped, inserted, dropped or repeated. After
+ *  every byte it checks the invariants the UART task relies on:
+ *
+ *   - a byte is passed through only outside a command, and a '$' never is
+ *   - the line never grows past CMD_MAX_LINE
+ *   - a ready command has a known op, an argument count in that op's range,
+ *     and arguments that are non-empty printable tokens inside the line
+ *   - an error has a reason and leaves the parser idle
+ *   - an unmutated valid line always parses back to its own tokens
+ *
+ *  A stray prefix must not swallow what follows it. After a prefix and a
+ *  partial line, each of these has to leave the parser idle so the next
+ *  plain byte passes through again: two cmdparse_timeout calls without a
+ *  byte in between, a byte outside the command alphabet, and a line longer
+ *  than CMD_MAX_LINE (one "too long" error, the rest of that line skipped up
+ *  to its end). A second prefix has to start a fresh line.
+ *
+ *  It also checks cmdparse_uint and cmdparse_float against strtoull and
+ *  strtod on random digit strings. Any violation is printed with the
+ *  iteration number and the test exits with 1.
+ *
+ *  Build and run from the repository root, with the sanitizers:
+ *      cc -O1 -g -fsanitize=address,undefined -I. -o cmdparse_fuzz tools/cmdparse_fuzz.c cmdparse.c -lm
+ *      ./cmdparse_fuzz [iterations] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cmdparse.h"
+
+// Argument counts as cmdparse.c defines them
+static const uint8_t minArgs[CMD_OPCOUNT] = { 1, 2, 1, 0, 0, 1, 0, 0, 1, 1, 2, 0 };
+static const uint8_t maxArgs[CMD_OPCOUNT] = { 1, 2, 1, 1, 2, 1, 1, 0, 1, 1, 2, 0 };
+
+static const char *words[] = {
+    "threshold", "tone_hz", "all", "gyro", "menu", "optrx", "on", "off", "imu", "10",
+    "0", "-1", "0.4", "4294967295", "4294967296", "log", "power", "x"
+};
+#define WORDS ((int)(sizeof(words) / sizeof(words[0])))
+
+static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789 .-_";
+#define ALPHABET ((int)sizeof(alphabet) - 1)
+
+static long failures = 0;
+static long iteration;
+
+static void fail(const char *what) {
+
+    if (failures++ < 20) {
+        printf("iteration %ld: %s\n", iteration, what);
+    }
+}
+
+// Feeds one byte and checks everything that must hold after it
+static enum cmdResult feed(CmdParser *parser, uint8_t byte, Command *cmd) {
+
+    bool wasActive = parser->active;
+    bool wasSkipping = parser->overflow;
+    enum cmdResult result = cmdparse_feed(parser, byte, cmd);
+    int i;
+
+    if (parser->len > CMD_MAX_LINE) {
+        fail("line longer than CMD_MAX_LINE");
+    }
+    switch (result) {
+        case CMDPARSE_PASS:
+            if (wasActive || byte == CMD_PREFIX) {
+                fail("byte passed through inside a command");
+            }
+            break;
+        case CMDPARSE_PENDING:
+            if (!parser->active && !wasSkipping) {
+                fail("pending with an idle parser");
+            }
+            break;
+        case CMDPARSE_READY:
+            if (parser->active) {
+                fail("ready with the parser still active");
+            }
+            if (cmd->op >= CMD_OPCOUNT) {
+                fail("unknown op");
+                break;
+            }
+            if (cmd->argc < minArgs[cmd->op] || cmd->argc > maxArgs[cmd->op]) {
+                fail("argument count out of range");
+            }
+            for (i = 0; i < cmd->argc; i++) {
+                const char *a = cmd->argv[i];
+                const char *p;
+                if (a < parser->line || a >= parser->line + sizeof(parser->line)) {
+                    fail("argument outside the line");
+                    continue;
+                }
+                if (*a == '\0') {
+                    fail("empty argument");
+                }
+                for (p = a; *p != '\0'; p++) {
+                    if (p >= parser->line + CMD_MAX_LINE || strchr(alphabet, *p) == NULL || *p == ' ') {
+                        fail("argument outside the command alphabet");
+                        break;
+                    }
+                }
+            }
+            break;
+        case CMDPARSE_ERROR:
+            if (cmd->error == NULL || cmd->error[0] == '\0') {
+                fail("error without a reason");
+            }
+            if (parser->active) {
+                fail("error with the parser still active");
+            }
+            break;
+        default:
+            fail("unknown result");
+            break;
+    }
+    return result;
+}
+
+// A valid command line without the prefix and the end of line
+static int valid_line(char *line, int *op) {
+
+    int len, i, argc;
+
+    *op = rand() % CMD_OPCOUNT;
+    argc = minArgs[*op] + rand() % (maxArgs[*op] - minArgs[*op] + 1);
+    len = sprintf(line, "%s", cmdparse_name((enum cmdOp)*op));
+    for (i = 0; i < argc; i++) {
+        len += sprintf(&line[len], "%.*s%s", 1 + rand() % 2, "  ", words[rand() % WORDS]);
+    }
+    if (len > CMD_MAX_LINE) {
+        return -1;
+    }
+    return len;
+}
+
+static void check_roundtrip(CmdParser *parser) {
+
+    char line[CMD_MAX_LINE * 2], copy[CMD_MAX_LINE * 2];
+    char *tokens[CMD_MAX_ARGS + 1], *p;
+    enum cmdResult result = CMDPARSE_PENDING;
+    Command cmd;
+    int len, op, count = 0, i;
+
+    if ((len = valid_line(line, &op)) < 0) {
+        return;
+    }
+    strcpy(copy, line);
+    for (p = strtok(copy, " "); p != NULL && count <= CMD_MAX_ARGS; p = strtok(NULL, " ")) {
+        tokens[count++] = p;
+    }
+
+    // End whatever the random bytes left open, then the line on its own
+    feed(parser, '\n', &cmd);
+    feed(parser, CMD_PREFIX, &cmd);
+    for (i = 0; i < len; i++) {
+        if (feed(parser, (uint8_t)line[i], &cmd) != CMDPARSE_PENDING) {
+            fail("valid line ended early");
+            return;
+        }
+    }
+    result = feed(parser, rand() % 2 ? '\r' : '\n', &cmd);
+    if (result != CMDPARSE_READY || (int)cmd.op != op || cmd.argc != count - 1) {
+        fail("valid line did not parse back");
+        return;
+    }
+    for (i = 0; i < cmd.argc; i++) {
+        if (strcmp(cmd.argv[i], tokens[i + 1]) != 0) {
+            fail("argument changed");
+        }
+    }
+}
+
+static uint8_t random_byte(void) {
+
+    switch (rand() % 8) {
+        case 0:
+            return CMD_PREFIX;
+        case 1:
+            return rand() % 2 ? '\r' : '\n';
+        case 2:
+            return rand() % 2 ? '\b' : 0x7F;
+        case 3:
+            return ' ';
+        default:
+            return (uint8_t)(rand() % 256);
+    }
+}
+
+static void check_mutated(CmdParser *parser) {
+
+    char line[CMD_MAX_LINE * 2];
+    Command cmd;
+    int len, op, i;
+
+    if ((len = valid_line(line, &op)) < 0) {
+        return;
+    }
+    feed(parser, CMD_PREFIX, &cmd);
+    for (i = 0; i < len; i++) {
+        switch (rand() % 16) {
+            case 0:
+                feed(parser, random_byte(), &cmd);
+                break;
+            case 1:
+                continue;                           // dropped
+            case 2:
+                feed(parser, (uint8_t)(line[i] ^ (1 << (rand() % 8))), &cmd);
+                continue;
+            case 3:
+                feed(parser, (uint8_t)line[i], &cmd);  // repeated
+                break;
+            default:
+                break;
+        }
+        feed(parser, (uint8_t)line[i], &cmd);
+    }
+    feed(parser, '\r', &cmd);
+}
+
+// A prefix and up to max - 1 bytes of the command alphabet
+static void partial_line(CmdParser *parser, int max) {
+
+    Command cmd;
+    int len = rand() % max, i;
+
+    feed(parser, CMD_PREFIX, &cmd);
+    for (i = 0; i < len; i++) {
+        if (feed(parser, (uint8_t)alphabet[rand() % ALPHABET], &cmd) != CMDPARSE_PENDING) {
+            fail("partial line ended early");
+        }
+    }
+}
+
+// The parser has to be idle again: a plain byte passes through
+static void expect_idle(CmdParser *parser, const char *what) {
+
+    Command cmd;
+
+    if (feed(parser, 'b', &cmd) != CMDPARSE_PASS) {
+        fail(what);
+    }
+}
+
+static void check_abandon(CmdParser *parser) {
+
+    char line[CMD_MAX_LINE * 2];
+    Command cmd;
+    enum cmdResult result;
+    int len, op, i, errors;
+
+    // Leave whatever came before
+    feed(parser, '\n', &cmd);
+    cmdparse_timeout(parser);
+    switch (rand() % 4) {
+        case 0:
+            // Idle for two housekeeping periods
+            partial_line(parser, CMD_MAX_LINE);
+            if (cmdparse_timeout(parser)) {
+                fail("timeout right after a byte");
+            }
+            if (!cmdparse_timeout(parser) || parser->active) {
+                fail("idle partial line not dropped");
+            }
+            if (cmdparse_timeout(parser)) {
+                fail("timeout with nothing pending");
+            }
+            expect_idle(parser, "byte swallowed after a timeout");
+            break;
+        case 1:
+            // A byte outside the alphabet, but not a prefix or line control
+            partial_line(parser, CMD_MAX_LINE);
+            do {
+                i = rand() % 256;
+            } while (strchr(alphabet, i) != NULL || i == CMD_PREFIX || i == '\r' || i == '\n' ||
+                     i == '\b' || i == 0x7F);
+            if (feed(parser, (uint8_t)i, &cmd) != CMDPARSE_ERROR) {
+                fail("byte outside the alphabet did not end the line");
+            }
+            expect_idle(parser, "byte swallowed after a bad byte");
+            break;
+        case 2:
+            // Too long, the rest of that line is skipped up to its end
+            feed(parser, CMD_PREFIX, &cmd);
+            len = CMD_MAX_LINE + 1 + rand() % CMD_MAX_LINE;
+            errors = 0;
+            for (i = 0; i < len; i++) {
+                result = feed(parser, (uint8_t)alphabet[rand() % ALPHABET], &cmd);
+                if (result == CMDPARSE_ERROR) {
+                    errors++;
+                    if (i != CMD_MAX_LINE || strcmp(cmd.error, "too long") != 0) {
+                        fail("long line rejected at the wrong byte");
+                    }
+                } else if (result != CMDPARSE_PENDING) {
+                    fail("rest of a long line not skipped");
+                }
+            }
+            if (errors != 1) {
+                fail("long line not rejected exactly once");
+            }
+            if (rand() % 2) {
+                if (feed(parser, '\r', &cmd) != CMDPARSE_PENDING) {
+                    fail("end of a long line not consumed");
+                }
+            } else {
+                cmdparse_timeout(parser);
+                if (cmdparse_timeout(parser)) {
+                    fail("timeout reported for a skipped long line");
+                }
+            }
+            expect_idle(parser, "byte swallowed after a long line");
+            break;
+        default:
+            // A second prefix starts over
+            if ((len = valid_line(line, &op)) < 0) {
+                return;
+            }
+            partial_line(parser, CMD_MAX_LINE);
+            feed(parser, CMD_PREFIX, &cmd);
+            for (i = 0; i < len; i++) {
+                feed(parser, (uint8_t)line[i], &cmd);
+            }
+            if (feed(parser, '\n', &cmd) != CMDPARSE_READY || (int)cmd.op != op) {
+                fail("second prefix did not start a new line");
+            }
+            break;
+    }
+}
+
+static void check_numbers(void) {
+
+    char s[24];
+    int len = rand() % 14, i;
+    uint32_t u;
+    float f;
+    bool ok;
+
+    for (i = 0; i < len; i++) {
+        s[i] = "0123456789.-x"[rand() % (rand() % 4 ? 10 : 13)];
+    }
+    s[len] = '\0';
+
+    ok = cmdparse_uint(s, &u);
+    if (len > 0 && strspn(s, "0123456789") == (size_t)len) {
+        unsigned long long want = strtoull(s, NULL, 10);
+        if (len < 20 && (ok != (want <= 0xFFFFFFFFull) || (ok && u != want))) {
+            fail("cmdparse_uint disagrees with strtoull");
+        }
+    } else if (ok) {
+        fail("cmdparse_uint accepted a non-number");
+    }
+
+    if (cmdparse_float(s, &f)) {
+        char *end;
+        double want = strtod(s, &end);
+        if (*end != '\0' || fabs(want - f) > 1e-6 * fabs(want) + 1e-6) {
+            fail("cmdparse_float disagrees with strtod");
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+
+    long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+    unsigned seed = argc > 2 ? (unsigned)atol(argv[2]) : 1;
+    CmdParser parser;
+    Command cmd;
+    long counts[4] = { 0, 0, 0, 0 };
+
+    srand(seed);
+    cmdparse_init(&parser);
+    for (iteration = 0; iteration < iterations; iteration++) {
+        switch (rand() % 5) {
+            case 0:
+                counts[feed(&parser, random_byte(), &cmd)]++;
+                break;
+            case 1:
+                check_roundtrip(&parser);
+                break;
+            case 2:
+                check_mutated(&parser);
+                break;
+            case 3:
+                check_abandon(&parser);
+                break;
+            default:
+                check_numbers();
+                break;
+        }
+    }
+    printf("%ld iterations, seed %u: random bytes pass=%ld pending=%ld ready=%ld error=%ld, %ld failures\n",
+           iterations, seed, counts[CMDPARSE_PASS], counts[CMDPARSE_PENDING],
+           counts[CMDPARSE_READY], counts[CMDPARSE_ERROR], failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,503 @@
+#!/usr/bin/env python3
+"""Train the Morse gesture decision tree and write gesture_model.h.
+
+Usage: gesture_train.py [recording.csv ...] [--synthetic] [-o gesture_model.h]
+
+Recordings are IMU streams decoded by imucomp_decode.py: one sample per
+line, time in ms, then ax,ay,az in mg and gx,gy,gz in cdps, at 100 Hz. Each
+recording needs a <recording>.csv.labels file with one gesture per line:
+
+    <start_ms> <end_ms> <. or ->
+
+The interval is where the tag should report the gesture: a '.' while it
+is tilted onto its x side, a '-' from the start of the flick until its
+peak has passed. Windows that end outside every interval are rest.
+
+--synthetic adds generated recordings: '.' and '-' gestures sent with a
+shaky grip, held at different angles, in between rest, pick-ups, shakes,
+shallow tilts and tilts the other ways. Every fourth recording is held out.
+
+Features (imufeat.c), the tree walk and the hold rule are computed
+exactly as gesture.c does it. The report compares the tree with the threshold rule
+the firmware used before (the config defaults), per window and as sent
+symbols, with the buzzer pauses of the sensor task after each symbol.
+"""
+
+import argparse
+import math
+import random
+import sys
+
+WINDOW_LOG2 = 4
+WINDOW = 1 << WINDOW_LOG2
+AXES = 6
+HOLD = 2
+DOT_AZ_MG = 1100
+PERIOD_MS = 10
+PAUSE_SAMPLES = {1: 10, 2: 50}      # buzzer Task_sleep after '.' and '-'
+
+NONE, DOT, DASH = 0, 1, 2
+CLASS_NAMES = ["none", "dot", "dash"]
+SYMBOLS = {".": DOT, "-": DASH}
+AXIS_NAMES = ["ax", "ay", "az", "gx", "gy", "gz"]
+FEATURE_NAMES = ["mean", "min", "max", "last", "p2p", "var", "zc", "jerk"]
+INT32_MAX = (1 << 31) - 1
+
+
+# --- recordings ---
+
+def load_recording(path):
+    samples = []
+    with open(path) as f:
+        for line in f:
+            fields = line.strip().split(",")
+            if len(fields) < 7:
+                continue
+            try:
+                values = [int(v) for v in fields[:7]]
+            except ValueError:
+                continue
+            samples.append(values)
+    labels = []
+    with open(path + ".labels") as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) >= 3 and fields[2] in SYMBOLS:
+                labels.append((int(fields[0]), int(fields[1]), SYMBOLS[fields[2]]))
+    labels.sort()
+    return samples, labels
+
+
+def smoothstep(x):
+    x = min(max(x, 0.0), 1.0)
+    return x * x * (3 - 2 * x)
+
+
+def synthetic_recording(rng, symbols=24):
+    """Samples [t, ax, ay, az, gx, gy, gz] and labels [(start, end, class)]."""
+    # Pitch towards +x and roll towards +y in degrees, linear acceleration
+    # in mg, all per 10 ms
+    pitch, roll, lin = [], [], []
+    labels = []
+
+    def rest(n, p, r):
+        for _ in range(n):
+            pitch.append(p)
+            roll.append(r)
+            lin.append([0.0, 0.0, 0.0])
+
+    def tilt(p0, r0, p1, r1, rise, hold, fall):
+        for i in range(rise):
+            s = smoothstep((i + 1) / rise)
+            pitch.append(p0 + (p1 - p0) * s)
+            roll.append(r0 + (r1 - r0) * s)
+            lin.append([0.0, 0.0, 0.0])
+        rest(hold, p1, r1)
+        for i in range(fall):
+            s = smoothstep((i + 1) / fall)
+            pitch.append(p1 + (p0 - p1) * s)
+            roll.append(r1 + (r0 - r1) * s)
+            lin.append([0.0, 0.0, 0.0])
+
+    def bump(p, r, amplitude, length, axis=2):
+        # Push and the slower stop of a hand move, sine lobes
+        for i in range(length):
+            a = [0.0, 0.0, 0.0]
+            a[axis] = amplitude * math.sin(math.pi * (i + 0.5) / length)
+            pitch.append(p)
+            roll.append(r)
+            lin.append(a)
+        stop = int(length * 1.6)
+        for i in range(stop):
+            a = [0.0, 0.0, 0.0]
+            a[axis] = -amplitude * 0.6 * math.sin(math.pi * (i + 0.5) / stop)
+            pitch.append(p)
+            roll.append(r)
+            lin.append(a)
+
+    p0 = rng.uniform(-12, 12)
+    r0 = rng.uniform(-12, 12)
+    rest(rng.randint(40, 120), p0, r0)
+    for _ in range(symbols):
+        if rng.random() < 0.3:
+            kind = rng.choice(["pickup", "shake", "shallow", "roll", "back"])
+            if kind == "pickup":
+                bump(p0, r0, rng.uniform(100, 330), rng.randint(10, 25), rng.choice([0, 1, 2, 2]))
+            elif kind == "shake":
+                amplitude = rng.uniform(300, 800)
+                hz = rng.uniform(3, 6)
+                n = rng.randint(30, 70)
+                for i in range(n):
+                    pitch.append(p0)
+                    roll.append(r0)
+                    lin.append([amplitude * math.sin(2 * math.pi * hz * i / 100.0), 0.0, 0.0])
+            elif kind == "shallow":
+                tilt(p0, r0, rng.uniform(12, 20), r0, rng.randint(15, 35), rng.randint(20, 60), rng.randint(15, 35))
+            elif kind == "roll":
+                tilt(p0, r0, p0, rng.uniform(50, 85), rng.randint(15, 35), rng.randint(20, 60), rng.randint(15, 35))
+            else:
+                tilt(p0, r0, rng.uniform(-85, -50), r0, rng.randint(15, 35), rng.randint(20, 60), rng.randint(15, 35))
+            rest(rng.randint(30, 90), p0, r0)
+        start = len(pitch)
+        if rng.random() < 0.5:
+            top = rng.uniform(55, 80)
+            rise, hold, fall = rng.randint(15, 35), rng.randint(25, 60), rng.randint(15, 35)
+            tilt(p0, r0, top, r0 + rng.uniform(-25, 25), rise, hold, fall)
+            # Past 40 degrees on the way up until the same on the way down
+            up = start + int(rise * 0.55)
+            down = start + rise + hold + int(fall * 0.45)
+            labels.append((up * PERIOD_MS, down * PERIOD_MS, DOT))
+        else:
+            length = rng.randint(8, 20)
+            bump(p0, r0, rng.uniform(350, 1200), length)
+            labels.append((start * PERIOD_MS, (start + length + 6) * PERIOD_MS, DASH))
+        rest(rng.randint(40, 120), p0, r0)
+        # The grip wanders between symbols
+        p0 = min(max(p0 + rng.uniform(-4, 4), -12), 12)
+        r0 = min(max(r0 + rng.uniform(-4, 4), -12), 12)
+
+    samples = []
+    tremor = [0.0, 0.0, 0.0]
+    for i in range(len(pitch)):
+        p = math.radians(pitch[i])
+        r = math.radians(roll[i])
+        g = [math.sin(p) * math.cos(r), math.sin(r), math.cos(p) * math.cos(r)]
+        tremor = [0.9 * t + rng.gauss(0, 4) for t in tremor]
+        accel = [int(round(1000 * g[a] + lin[i][a] + tremor[a] + rng.gauss(0, 5))) for a in range(3)]
+        dp = (pitch[i] - pitch[i - 1]) * 100 if i else 0.0
+        dr = (roll[i] - roll[i - 1]) * 100 if i else 0.0
+        gyro = [int(round(100 * dr + rng.gauss(0, 30))),
+                int(round(100 * dp + rng.gauss(0, 30))),
+                int(round(rng.gauss(0, 30)))]
+        # Full scale at the default ascale and gscale, 8 g and 250 dps
+        accel = [min(max(v, -8000), 8000) for v in accel]
+        gyro = [min(max(v, -25000), 25000) for v in gyro]
+        samples.append([i * PERIOD_MS] + accel + gyro)
+    return samples, labels
+
+
+# --- features and classifiers, as gesture.c ---
+
+def features(samples, end):
+    """Features of the window ending with samples[end], as imufeat.c."""
+    out = []
+    for a in range(1, AXES + 1):
+        column = [s[a] for s in samples[end - WINDOW + 1:end + 1]]
+        total = sum(column)
+        variance = ((sum(x * x for x in column) << WINDOW_LOG2) - total * total) >> (2 * WINDOW_LOG2)
+        pairs = list(zip(column, column[1:]))
+        out += [total >> WINDOW_LOG2, min(column), max(column), column[-1],
+                max(column) - min(column), min(variance, INT32_MAX),
+                sum((p < 0) != (x < 0) for p, x in pairs),
+                sum(abs(x - p) for p, x in pairs) // (WINDOW - 1)]
+    return out
+
+
+def label_at(labels, t):
+    for start, end, c in labels:
+        if start <= t <= end:
+            return c
+    return NONE
+
+
+def windows(recording):
+    samples, labels = recording
+    return [(features(samples, i), label_at(labels, samples[i][0]))
+            for i in range(WINDOW - 1, len(samples))]
+
+
+def threshold_rule(s, threshold, threshold_z):
+    ax, ay, az = s[1], s[2], s[3]
+    if ax > threshold and ay < threshold and az < DOT_AZ_MG:
+        return DOT
+    if az > threshold_z and ax < threshold:
+        return DASH
+    return NONE
+
+
+def classify(nodes, x):
+    node = nodes[0]
+    for _ in range(len(nodes)):
+        if node[0] < 0:
+            break
+        node = nodes[node[1] if x[node[0]] <= node[3] else node[2]]
+    return node[1] if node[0] < 0 else NONE
+
+
+# --- training ---
+
+def gini(counts, total):
+    return 1.0 - sum((c / total) ** 2 for c in counts) if total else 0.0
+
+
+def best_split(X, y, w, idx):
+    total = [0.0] * 3
+    for i in idx:
+        total[y[i]] += w[y[i]]
+    n = sum(total)
+    best = (gini(total, n), None, None)
+    for f in range(len(X[0])):
+        order = sorted(idx, key=lambda i: X[i][f])
+        left = [0.0] * 3
+        for k in range(len(order) - 1):
+            i = order[k]
+            left[y[i]] += w[y[i]]
+            a, b = X[i][f], X[order[k + 1]][f]
+            if a == b:
+                continue
+            nl = sum(left)
+            right = [total[c] - left[c] for c in range(3)]
+            score = (nl * gini(left, nl) + (n - nl) * gini(right, n - nl)) / n
+            if score < best[0] - 1e-12:
+                best = (score, f, (a + b) // 2)
+    return best[1], best[2]
+
+
+def train(X, y, max_depth, min_leaf):
+    counts = [y.count(c) for c in range(3)]
+    w = [len(y) / (3.0 * c) if c else 0.0 for c in counts]
+    nodes = []
+
+    def majority(idx):
+        votes = [0.0] * 3
+        for i in idx:
+            votes[y[i]] += w[y[i]]
+        return votes.index(max(votes))
+
+    def build(idx, depth):
+        here = len(nodes)
+        nodes.append(None)
+        f = None
+        if depth < max_depth and len(idx) >= 2 * min_leaf and len(set(y[i] for i in idx)) > 1:
+            f, threshold = best_split(X, y, w, idx)
+        if f is not None:
+            left = [i for i in idx if X[i][f] <= threshold]
+            right = [i for i in idx if X[i][f] > threshold]
+            if len(left) < min_leaf or len(right) < min_leaf:
+                f = None
+        if f is None:
+            nodes[here] = (-1, majority(idx), 0, 0)
+            return here
+        l = build(left, depth + 1)
+        r = build(right, depth + 1)
+        nodes[here] = (f, l, r, threshold)
+        return here
+
+    build(list(range(len(y))), 0)
+    return prune(nodes)
+
+
+def prune(nodes):
+    """Merges splits whose two sides are leaves of the same class and renumbers."""
+    changed = True
+    while changed:
+        changed = False
+        for k, node in enumerate(nodes):
+            if node is None or node[0] < 0:
+                continue
+            l, r = nodes[node[1]], nodes[node[2]]
+            if l[0] < 0 and r[0] < 0 and l[1] == r[1]:
+                nodes[k] = (-1, l[1], 0, 0)
+                nodes[node[1]] = nodes[node[2]] = None
+                changed = True
+    index = {}
+    for k, node in enumerate(nodes):
+        if node is not None:
+            index[k] = len(index)
+    out = []
+    for node in nodes:
+        if node is None:
+            continue
+        if node[0] < 0:
+            out.append(node)
+        else:
+            out.append((node[0], index[node[1]], index[node[2]], node[3]))
+    return out
+
+
+# --- evaluation ---
+
+def run_tree(nodes, samples):
+    """Symbols and their sample indices as gesture_update() emits them, with
+    the buzzer pauses of the sensor task."""
+    window, state, candidate, run = [], NONE, NONE, 0
+    out = []
+    i = 0
+    while i < len(samples):
+        window = (window + [samples[i]])[-WINDOW:]
+        c = classify(nodes, features(window, WINDOW - 1)) if len(window) == WINDOW else NONE
+        emitted = NONE
+        if c == state:
+            run = 0
+        else:
+            if c != candidate:
+                candidate, run = c, 0
+            run += 1
+            if run >= HOLD:
+                state, run = c, 0
+                emitted = c
+        if emitted != NONE:
+            out.append((emitted, i))
+            i += PAUSE_SAMPLES[emitted]
+        i += 1
+    return out
+
+
+def run_threshold(samples, threshold, threshold_z):
+    """Symbols of the latched threshold rule as the sensor task had it."""
+    dot_latch = dash_latch = False
+    out = []
+    i = 0
+    while i < len(samples):
+        s = samples[i]
+        c = threshold_rule(s, threshold, threshold_z)
+        emitted = NONE
+        if not dot_latch and not dash_latch and c != NONE:
+            emitted = c
+            dot_latch = c == DOT
+            dash_latch = c == DASH
+        if dash_latch and s[3] < threshold_z:
+            dash_latch = False
+        if dot_latch and s[1] < threshold:
+            dot_latch = False
+        if emitted != NONE:
+            out.append((emitted, i))
+            i += PAUSE_SAMPLES[emitted]
+        i += 1
+    return out
+
+
+def edit_distance(a, b):
+    row = list(range(len(b) + 1))
+    for i in range(1, len(a) + 1):
+        prev, row[0] = row[0], i
+        for j in range(1, len(b) + 1):
+            cur = min(row[j] + 1, row[j - 1] + 1, prev + (a[i - 1] != b[j - 1]))
+            prev, row[j] = row[j], cur
+    return row[-1]
+
+
+def latency(labels, symbols, samples):
+    """Mean ms from the start of a labelled gesture to its symbol."""
+    total = count = 0
+    for start, end, c in labels:
+        for s, i in symbols:
+            t = samples[i][0]
+            if s == c and start - 200 <= t <= end + 200:
+                total += t - start
+                count += 1
+                break
+    return total / count if count else 0.0
+
+
+def evaluate(nodes, recordings, threshold, threshold_z):
+    confusion = {"tree": [[0] * 3 for _ in range(3)], "rule": [[0] * 3 for _ in range(3)]}
+    errors = {"tree": 0, "rule": 0}
+    delay = {"tree": 0.0, "rule": 0.0}
+    sent = 0
+    for samples, labels in recordings:
+        for i in range(WINDOW - 1, len(samples)):
+            truth = label_at(labels, samples[i][0])
+            confusion["tree"][truth][classify(nodes, features(samples, i))] += 1
+            confusion["rule"][truth][threshold_rule(samples[i], threshold, threshold_z)] += 1
+        want = [c for _, _, c in labels]
+        sent += len(want)
+        for name, symbols in (("tree", run_tree(nodes, samples)),
+                              ("rule", run_threshold(samples, threshold, threshold_z))):
+            errors[name] += edit_distance(want, [c for c, _ in symbols])
+            delay[name] += latency(labels, symbols, samples) / len(recordings)
+    result = {}
+    for name in ("tree", "rule"):
+        m = confusion[name]
+        total = sum(map(sum, m))
+        result[name] = (100.0 * sum(m[c][c] for c in range(3)) / total,
+                        100.0 * errors[name] / max(sent, 1), delay[name], m)
+    return result, sent
+
+
+def print_report(result, sent, out):
+    for name, label in (("tree", "decision tree"), ("rule", "threshold rule")):
+        accuracy, symbol_errors, delay, m = result[name]
+        out.write("%s: windows %.1f %%, symbol errors %.1f %% of %d, latency %.0f ms\n"
+                  % (label, accuracy, symbol_errors, sent, delay))
+        out.write("    truth\\out  %s\n" % "  ".join("%6s" % c for c in CLASS_NAMES))
+        for c in range(3):
+            out.write("    %9s  %s\n" % (CLASS_NAMES[c], "  ".join("%6d" % v for v in m[c])))
+
+
+# --- output ---
+
+def write_header(path, nodes, source, result, sent, max_depth):
+    tree, rule = result["tree"], result["rule"]
+    with open(path, "w") as f:
+        f.write("/*\n * gesture_model.h\n *\n")
+        f.write(" *  Generated by tools/gesture_train.py, do not edit.\n")
+        f.write(" *  Trained on %s, depth %d.\n" % (source, max_depth))
+        f.write(" *  Held out: windows %.1f %% correct (threshold rule %.1f %%),\n"
+                % (tree[0], rule[0]))
+        f.write(" *  symbol errors %.1f %% of %d (threshold rule %.1f %%).\n"
+                % (tree[1], sent, rule[1]))
+        f.write(" */\n\n#ifndef GESTURE_MODEL_H_\n#define GESTURE_MODEL_H_\n\n")
+        f.write("#include \"gesture.h\"\n\n")
+        f.write("#define GESTURE_MODEL_NODES %d\n\n" % len(nodes))
+        f.write("static const GestureNode gestureModel[GESTURE_MODEL_NODES] = {\n")
+        for k, (feature, left, right, threshold) in enumerate(nodes):
+            sep = "," if k < len(nodes) - 1 else ""
+            if feature < 0:
+                entry = "{ -1, %d, 0, 0 }%s" % (left, sep)
+                comment = CLASS_NAMES[left]
+            else:
+                entry = "{ %d, %d, %d, %d }%s" % (feature, left, right, threshold, sep)
+                comment = "%s %s <= %d" % (AXIS_NAMES[feature // len(FEATURE_NAMES)],
+                                          FEATURE_NAMES[feature % len(FEATURE_NAMES)], threshold)
+            f.write("    %-26s // %d: %s\n" % (entry, k, comment))
+        f.write("};\n\n#endif /* GESTURE_MODEL_H_ */\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("recordings", nargs="*")
+    parser.add_argument("--synthetic", type=int, nargs="?", const=40, default=0, metavar="N",
+                        help="add N generated recordings (40)")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--depth", type=int, default=5, help="maximum tree depth")
+    parser.add_argument("--min-leaf", type=int, default=20, help="fewest training windows in a leaf")
+    parser.add_argument("--stride", type=int, default=2, help="train on every n-th window")
+    parser.add_argument("--threshold", type=int, default=400, help="threshold rule, mg")
+    parser.add_argument("--threshold-z", type=int, default=1300, help="threshold rule on z, mg")
+    parser.add_argument("-o", "--output", help="write the model header here")
+    args = parser.parse_args()
+
+    recordings = [load_recording(path) for path in args.recordings]
+    rng = random.Random(args.seed)
+    recordings += [synthetic_recording(rng) for _ in range(args.synthetic)]
+    if not recordings:
+        parser.error("no recordings, give some or --synthetic")
+    held = recordings[3::4] or recordings
+    if held is recordings:
+        sys.stderr.write("fewer than 4 recordings, reporting on the training data\n")
+    training = [r for k, r in enumerate(recordings) if k % 4 != 3] or recordings
+
+    X, y = [], []
+    for recording in training:
+        for k, (x, label) in enumerate(windows(recording)):
+            if k % args.stride == 0:
+                X.append(x)
+                y.append(label)
+    nodes = train(X, y, args.depth, args.min_leaf)
+    result, sent = evaluate(nodes, held, args.threshold, args.threshold_z)
+    sys.stdout.write("%d training windows, %d held out recordings, %d nodes\n"
+                     % (len(y), len(held), len(nodes)))
+    print_report(result, sent, sys.stdout)
+
+    if args.output:
+        parts = []
+        if args.recordings:
+            parts.append("%d recordings" % len(args.recordings))
+        if args.synthetic:
+            parts.append("%d synthetic recordings (seed %d)" % (args.synthetic, args.seed))
+        write_header(args.output, nodes, " and ".join(parts), result, sent, args.depth)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+"""Decode compressed sample blocks (see imucomp.h) to CSV.
+
+Usage: imucomp_decode.py <blocks.bin> [--stats]
+
+The input is a capture or log dump holding blocks back to back. Blocks are
+self-delimiting; bytes that do not parse as a block are skipped. Output has
+one line per sample: time in ms, then the axes.
+"""
+
+import argparse
+import sys
+
+MAGIC = 0xD7
+RICE = 1
+RICE_ESCAPE = 16
+ORDER2 = 0x80
+
+
+class BitReader:
+    def __init__(self, data, pos):
+        self.data = data
+        self.bit = pos * 8
+
+    def get(self, n):
+        value = 0
+        for _ in range(n):
+            byte = self.bit >> 3
+            if byte >= len(self.data):
+                raise EOFError
+            value = value << 1 | (self.data[byte] >> (7 - (self.bit & 7))) & 1
+            self.bit += 1
+        return value
+
+    def varint(self):
+        u = shift = 0
+        while True:
+            byte = self.get(8)
+            u |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80 or shift >= 35:
+                return u & 0xFFFFFFFF
+
+    def rice(self, k):
+        q = 0
+        while q < RICE_ESCAPE and self.get(1):
+            q += 1
+        if q == RICE_ESCAPE:
+            return self.get(32)
+        return q << k | self.get(k)
+
+
+def unzigzag(u):
+    return (u >> 1) ^ -(u & 1)
+
+
+def wrap32(v):
+    return (v + (1 << 31)) % (1 << 32) - (1 << 31)
+
+
+def decode_block(data, pos):
+    """Return (time, period, samples, end) for the block at data[pos]."""
+    if data[pos] != MAGIC or pos + 10 > len(data):
+        raise ValueError
+    coding, axes = data[pos + 1] >> 4, data[pos + 1] & 0x0F
+    count = data[pos + 2] | data[pos + 3] << 8
+    time = int.from_bytes(data[pos + 4:pos + 8], "little")
+    period = data[pos + 8] | data[pos + 9] << 8
+    if not 1 <= axes <= 6 or coding > RICE or count == 0:
+        raise ValueError
+    modes = data[pos + 10:pos + 10 + axes]
+    r = BitReader(data, pos + 10 + axes)
+
+    prev = [unzigzag(r.varint()) for _ in range(axes)]
+    delta = [0] * axes
+    samples = [list(prev)]
+    for i in range(1, count):
+        for a in range(axes):
+            u = r.rice(modes[a] & 0x1F) if coding == RICE else r.varint()
+            d = unzigzag(u)
+            if modes[a] & ORDER2 and i >= 2:
+                delta[a] = wrap32(delta[a] + d)
+            else:
+                delta[a] = d
+            prev[a] = wrap32(prev[a] + delta[a])
+        samples.append(list(prev))
+    return time, period, samples, (r.bit + 7) // 8
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("blocks")
+    parser.add_argument("--stats", action="store_true",
+                        help="print block count and compression ratio to stderr")
+    args = parser.parse_args()
+
+    with open(args.blocks, "rb") as f:
+        data = f.read()
+
+    pos = blocks = samples = raw = packed = skipped = 0
+    while pos < len(data):
+        try:
+            time, period, block, end = decode_block(data, pos)
+        except (ValueError, EOFError, IndexError):
+            pos += 1
+            skipped += 1
+            continue
+        for i, sample in enumerate(block):
+            sys.stdout.write("%d,%s\n" % (time + i * period, ",".join(map(str, sample))))
+        blocks += 1
+        samples += len(block)
+        raw += len(block) * len(block[0]) * 2
+        packed += end - pos
+        pos = end
+
+    if args.stats:
+        sys.stderr.write("blocks=%d samples=%d raw=%d packed=%d ratio=%.2f skipped=%d\n"
+                         % (blocks, samples, raw, packed, raw / packed if packed else 0, skipped))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,433 @@
+/*
+ * logstore_bench.c
+ *
+ *  Host check and benchmark of the flash log (logstore.c on flashram.c).
+ *
+ *  The log runs on a RAM flash with the SensorTag's external flash geometry.
+ *  A model follows every page the log programs and every block it erases,
+ *  so the records a read has to return are always known. The checks:
+ *
+ *   - append through several laps of the ring, reading the whole log back
+ *     after every page and comparing records, times and data
+ *   - power loss: a program cut short at a random length with
+ *     flashram_failAfter, then logstore_open on the same flash has to find
+ *     every earlier page, skip the torn one and carry on appending
+ *   - logstore_readRange at the edges: empty and reversed ranges, single
+ *     times, runs of equal times across page and block boundaries, and
+ *     ranges before, after and around what the ring still holds
+ *   - wear: the erase count of every block from flashram_stats() may differ
+ *     by at most one
+ *
+ *  Then it times appends and reads and prints the flash traffic per record.
+ *
+ *  Build and run from the repository root:
+ *      cc -O2 -I. -o logstore_bench tools/logstore_bench.c logstore.c flashram.c crc16.c
+ *      ./logstore_bench [laps] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "logstore.h"
+#include "flashram.h"
+
+#define PAGE_SIZE       256             // as extflash.h
+#define BLOCK_SIZE      4096
+#define FIRST_BLOCK     1               // keep block 0 out, the log has a base
+#define BLOCKS          8
+#define DEVICE_BLOCKS   (FIRST_BLOCK + BLOCKS + 1)
+#define PAGES_PER_BLOCK (BLOCK_SIZE / LOGSTORE_PAGE_SIZE)
+#define PAGES           (BLOCKS * PAGES_PER_BLOCK)
+#define MAX_RECORDS     200000
+#define RANGE_CHECKS    2000
+
+typedef struct {
+    uint32_t time;
+    uint8_t len;
+} Record;
+
+// Every record appended, and per log page the records it holds, [first, end)
+static Record records[MAX_RECORDS];
+static int32_t recordCount;
+static int32_t pendingFirst;            // first record of the RAM page
+static int32_t pageFirst[PAGES];
+static int32_t pageEnd[PAGES];
+static uint32_t pagesProgrammed;        // over reopens, unlike ls.stats
+
+static uint8_t flash[DEVICE_BLOCKS * BLOCK_SIZE];
+static const FlashDev *dev;
+static LogStore ls;
+static uint32_t now;
+static long failures = 0;
+static uint32_t powerLosses;
+
+static void fail(const char *what, long a, long b) {
+
+    if (failures++ < 20) {
+        printf("FAIL %s (%ld, %ld)\n", what, a, b);
+    }
+}
+
+static uint8_t data_byte(int32_t record, int i) {
+
+    return (uint8_t)(record * 31 + i * 7);
+}
+
+// Mostly sensor sized records, now and then up to the largest
+static uint8_t record_len(void) {
+
+    switch (rand() % 16) {
+        case 0:
+            return LOGSTORE_MAX_RECORD - rand() % 8;
+        case 1:
+            return 0;
+        default:
+            return 4 + rand() % 24;
+    }
+}
+
+// Updates the model for the page the log programmed at head, if it did
+static void model_page(uint32_t head, const LogStoreStats *before, int32_t end) {
+
+    int page = head / LOGSTORE_PAGE_SIZE;
+    int i;
+
+    if (ls.stats.pages == before->pages) {
+        return;
+    }
+    if (head % BLOCK_SIZE == 0) {
+        for (i = page; i < page + PAGES_PER_BLOCK; i++) {
+            pageFirst[i] = pageEnd[i] = 0;
+        }
+    }
+    if (ls.stats.failures == before->failures) {
+        pageFirst[page] = pendingFirst;
+        pageEnd[page] = end;
+    }
+    pendingFirst = end;
+    pagesProgrammed++;
+}
+
+static void append(uint8_t len) {
+
+    uint8_t data[LOGSTORE_MAX_RECORD];
+    LogStoreStats before = ls.stats;
+    uint32_t head = ls.head;
+    int i;
+
+    if (recordCount == MAX_RECORDS) {
+        return;
+    }
+    now += rand() % 4 == 0 ? 0 : 1 + rand() % 3;    // runs of equal times
+    for (i = 0; i < len; i++) {
+        data[i] = data_byte(recordCount, i);
+    }
+    if (!logstore_append(&ls, now, data, len)) {
+        fail("append", recordCount, len);
+        return;
+    }
+    model_page(head, &before, recordCount);
+    records[recordCount].time = now;
+    records[recordCount].len = len;
+    recordCount++;
+}
+
+static void flush(void) {
+
+    LogStoreStats before = ls.stats;
+    uint32_t head = ls.head;
+
+    logstore_flush(&ls);
+    model_page(head, &before, recordCount);
+}
+
+// Records in flash in log order. Pages hold consecutive records and the
+// ring is in time order, so sorting the pages by first record is enough.
+static int32_t expected[MAX_RECORDS];
+static int32_t expectedCount;
+
+static int page_order(const void *a, const void *b) {
+
+    return pageFirst[*(const int *)a] - pageFirst[*(const int *)b];
+}
+
+static void model_expected(void) {
+
+    int order[PAGES], n = 0, i;
+    int32_t r;
+
+    for (i = 0; i < PAGES; i++) {
+        if (pageEnd[i] > pageFirst[i]) {
+            order[n++] = i;
+        }
+    }
+    qsort(order, n, sizeof(order[0]), page_order);
+    expectedCount = 0;
+    for (i = 0; i < n; i++) {
+        for (r = pageFirst[order[i]]; r < pageEnd[order[i]]; r++) {
+            expected[expectedCount++] = r;
+        }
+    }
+}
+
+typedef struct {
+    int32_t next;           // index into expected
+    int32_t end;
+} ReadCheck;
+
+static void read_record(uint32_t time, const uint8_t *data, uint8_t len, void *arg) {
+
+    ReadCheck *check = arg;
+    int32_t r;
+    int i;
+
+    if (check->next >= check->end) {
+        fail("record past the range", time, check->end);
+        return;
+    }
+    r = expected[check->next++];
+    if (time != records[r].time || len != records[r].len) {
+        fail("record time or length", time, records[r].time);
+        return;
+    }
+    for (i = 0; i < len; i++) {
+        if (data[i] != data_byte(r, i)) {
+            fail("record data", r, i);
+            return;
+        }
+    }
+}
+
+// Compares a range read with the model
+static void check_range(uint32_t t0, uint32_t t1) {
+
+    ReadCheck check;
+    int32_t count, want;
+
+    check.next = 0;
+    check.end = 0;
+    if (t0 <= t1) {
+        while (check.next < expectedCount && records[expected[check.next]].time < t0) {
+            check.next++;
+        }
+        check.end = check.next;
+        while (check.end < expectedCount && records[expected[check.end]].time <= t1) {
+            check.end++;
+        }
+    }
+    want = check.end - check.next;
+    count = logstore_readRange(&ls, t0, t1, read_record, &check);
+    if (count != want || check.next != check.end) {
+        fail("range count", count, want);
+        printf("     range %u..%u\n", t0, t1);
+    }
+}
+
+static void check_all(void) {
+
+    model_expected();
+    check_range(0, UINT32_MAX);
+    if (expectedCount > 0) {
+        if (logstore_firstTime(&ls) != records[expected[0]].time) {
+            fail("first time", logstore_firstTime(&ls), records[expected[0]].time);
+        }
+        if (logstore_lastTime(&ls) != records[expected[expectedCount - 1]].time) {
+            fail("last time", logstore_lastTime(&ls), records[expected[expectedCount - 1]].time);
+        }
+    }
+}
+
+// A time near a stored record, or outside what is stored
+static uint32_t pick_time(void) {
+
+    uint32_t t;
+
+    switch (rand() % 8) {
+        case 0:
+            return 0;
+        case 1:
+            return records[expected[0]].time - 1;
+        case 2:
+            return records[expected[expectedCount - 1]].time + 1 + rand() % 3;
+        case 3:
+            // Dropped by the ring already
+            return records[expected[0]].time / 2;
+        default:
+            t = records[expected[rand() % expectedCount]].time;
+            return t + rand() % 3 - 1;
+    }
+}
+
+static void check_ranges(void) {
+
+    int i;
+
+    model_expected();
+    if (expectedCount == 0) {
+        return;
+    }
+    check_range(1, 0);
+    check_range(UINT32_MAX, UINT32_MAX);
+    for (i = 0; i < RANGE_CHECKS; i++) {
+        uint32_t t0 = pick_time();
+        uint32_t t1 = rand() % 4 == 0 ? t0 : pick_time();
+        check_range(t0, t1);
+    }
+    // Both edges of every block, where the runs of equal times matter most
+    for (i = 0; i < PAGES; i += PAGES_PER_BLOCK) {
+        if (pageEnd[i] > pageFirst[i]) {
+            uint32_t t = records[pageFirst[i]].time;
+            check_range(t, t);
+            check_range(t - 1, t);
+            check_range(t, t + 1);
+            check_range(0, t);
+        }
+    }
+}
+
+// Cuts the next program short, then reopens as after a power loss. The RAM
+// page and the torn page are lost.
+static void power_loss(void) {
+
+    uint32_t seq, lastTime;
+
+    while (ls.fill + LOGSTORE_RECORD_HEADER + 32 <= LOGSTORE_PAYLOAD_SIZE) {
+        append(4 + rand() % 24);
+    }
+    flashram_failAfter(rand() % (LOGSTORE_HEADER_SIZE + ls.fill));
+    powerLosses++;
+    flush();
+    append(record_len());
+    pendingFirst = recordCount;
+
+    seq = ls.seq;
+    lastTime = ls.lastTime;
+    if (!logstore_open(&ls, dev, FIRST_BLOCK, BLOCKS)) {
+        fail("reopen", 0, 0);
+        return;
+    }
+    if (ls.seq != seq && ls.seq != seq - 1) {
+        fail("sequence after reopen", ls.seq, seq);
+    }
+    model_expected();
+    if (expectedCount > 0 && ls.lastTime != records[expected[expectedCount - 1]].time) {
+        fail("last time after reopen", ls.lastTime, lastTime);
+    }
+    check_all();
+}
+
+// A power loss on the first page of a block makes the reopened log erase it
+// again, so this runs on a log without any
+static void check_wear(void) {
+
+    const FlashRamStats *s = flashram_stats();
+    uint32_t lo = UINT32_MAX, hi = 0;
+    int b;
+
+    printf("erases per block:");
+    for (b = 0; b < DEVICE_BLOCKS; b++) {
+        printf(" %u", s->blockErases[b]);
+        if (b >= FIRST_BLOCK && b < FIRST_BLOCK + BLOCKS) {
+            lo = s->blockErases[b] < lo ? s->blockErases[b] : lo;
+            hi = s->blockErases[b] > hi ? s->blockErases[b] : hi;
+        } else if (s->blockErases[b] != 0) {
+            fail("erase outside the log", b, s->blockErases[b]);
+        }
+    }
+    printf("\n");
+    if (hi - lo > 1 || hi == 0) {
+        fail("uneven wear", lo, hi);
+    }
+    if (s->violations != 0) {
+        fail("NOR rule violations", s->violations, 0);
+    }
+}
+
+static void counter(uint32_t time, const uint8_t *data, uint8_t len, void *arg) {
+
+    (*(int32_t *)arg)++;
+}
+
+// Appends of 16 byte records and reads of the whole log and of one second
+static void bench(void) {
+
+    const FlashRamStats *s = flashram_stats();
+    uint8_t data[16] = { 0 };
+    int32_t count = 0, n, i;
+    uint32_t t;
+    clock_t start;
+    double us;
+
+    flashram_erase();
+    flashram_resetStats();
+    logstore_open(&ls, dev, FIRST_BLOCK, BLOCKS);
+    n = 100000;
+    start = clock();
+    for (i = 0; i < n; i++) {
+        logstore_append(&ls, (uint32_t)i * 10, data, sizeof(data));
+    }
+    us = (double)(clock() - start) / CLOCKS_PER_SEC * 1e6 / n;
+    printf("append: %.3f us per record, %.1f flash bytes per %u byte record, %u erases\n",
+           us, (double)s->programBytes / n, (unsigned)sizeof(data), s->erases);
+    check_wear();
+
+    t = logstore_lastTime(&ls);
+    flashram_resetStats();
+    start = clock();
+    n = logstore_readRange(&ls, 0, UINT32_MAX, counter, &count);
+    us = (double)(clock() - start) / CLOCKS_PER_SEC * 1e6;
+    printf("read all: %d records in %.1f us, %u reads, %u bytes\n", n, us, s->reads, s->readBytes);
+
+    flashram_resetStats();
+    start = clock();
+    n = logstore_readRange(&ls, t - 1000, t, counter, &count);
+    us = (double)(clock() - start) / CLOCKS_PER_SEC * 1e6;
+    printf("read last second: %d records in %.1f us, %u reads, %u bytes\n", n, us, s->reads, s->readBytes);
+}
+
+int main(int argc, char **argv) {
+
+    int laps = argc > 1 ? atoi(argv[1]) : 5;
+    unsigned seed = argc > 2 ? (unsigned)atol(argv[2]) : 1;
+    uint32_t pages;
+
+    srand(seed);
+    dev = flashram_open(flash, sizeof(flash), PAGE_SIZE, BLOCK_SIZE);
+    flashram_erase();
+    if (!logstore_open(&ls, dev, FIRST_BLOCK, BLOCKS)) {
+        printf("open failed\n");
+        return 1;
+    }
+    check_all();
+
+    // Too long a record is refused and counted
+    if (logstore_append(&ls, now, flash, LOGSTORE_MAX_RECORD + 1) || ls.stats.dropped != 1) {
+        fail("oversized record", ls.stats.dropped, 1);
+    }
+
+    pages = (uint32_t)laps * PAGES;
+    while (pagesProgrammed < pages && recordCount < MAX_RECORDS) {
+        uint32_t before = pagesProgrammed;
+        append(record_len());
+        if (pagesProgrammed != before) {
+            check_all();
+            if (pagesProgrammed % (PAGES / 2) == 0) {
+                check_ranges();
+            }
+            if (rand() % 16 == 0) {
+                power_loss();
+            }
+        }
+    }
+    flush();
+    check_all();
+    check_ranges();
+
+    printf("%d laps, seed %u: %d records, %u pages, %u power losses\n",
+           laps, seed, recordCount, pagesProgrammed, powerLosses);
+    bench();
+    printf("%ld failures\n", failures);
+    return failures ? 1 : 0;
+}
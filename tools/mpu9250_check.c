@@ -0,0 +1,54 @@
+/*
+ * mpu9250_check.c
+ *
+ *  Host check of the MPU9250 unit conversion (sensors/mpu9250conv.c).
+ *
+ *  Every raw value at every full scale setting is converted and compared
+ *  with the exact value rounded towards zero. The ends of each range are
+ *  checked explicitly: 32767 and -32768 LSB at 2000 deg/s are 199993 and
+ *  -200000 cdps, which do not fit a 32-bit product.
+ *
+ *  Build and run from the repository root:
+ *      cc -O2 -I. -Isensors -o mpu9250_check tools/mpu9250_check.c sensors/mpu9250conv.c
+ *      ./mpu9250_check
+ */
+
+#include <stdio.h>
+
+#include "mpu9250conv.h"
+
+static int failures = 0;
+
+static void check(const char *what, int scale, int32_t raw, int32_t got, int32_t want) {
+
+    if (got != want && failures++ < 20) {
+        printf("FAIL %s scale %d raw %d: got %d, expected %d\n", what, scale, raw, got, want);
+    }
+}
+
+int main(void) {
+
+    int32_t raw;
+    int scale;
+
+    for (scale = 0; scale < 4; scale++) {
+        int64_t accelFull = 2000 << scale;      // mg at 32768 LSB
+        int64_t gyroFull = 25000 << scale;      // cdps at 32768 LSB
+
+        for (raw = -32768; raw <= 32767; raw++) {
+            check("accel", scale, raw, mpu9250_accelMg((int16_t)raw, scale),
+                  (int32_t)(raw * accelFull / 32768));
+            check("gyro", scale, raw, mpu9250_gyroCdps((int16_t)raw, scale),
+                  (int32_t)(raw * gyroFull / 32768));
+        }
+    }
+    check("gyro full scale", 3, 32767, mpu9250_gyroCdps(32767, 3), 199993);
+    check("gyro full scale", 3, -32768, mpu9250_gyroCdps(-32768, 3), -200000);
+    check("gyro full scale", 2, 32767, mpu9250_gyroCdps(32767, 2), 99996);
+    check("accel full scale", 3, 32767, mpu9250_accelMg(32767, 3), 15999);
+    check("accel full scale", 3, -32768, mpu9250_accelMg(-32768, 3), -16000);
+    check("gyro sign", 3, -1, mpu9250_gyroCdps(-1, 3), -6);
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,232 @@
+/*
+ * optrx_bench.c
+ *
+ *  Host benchmark of the optical Morse receiver (optrx.c + morsekey.c).
+ *
+ *  Without arguments it synthesises light traces of a test text flashed by
+ *  another tag's LED, keyed as morse_led() does. Each trace is sampled the
+ *  way the OPT3001 does it: a 100 ms integration per result, a conversion
+ *  clock a few percent off, and auto-range quantisation. The background has
+ *  a slow drift and sensor noise. For every dot length and LED brightness it
+ *  prints the symbol error rate (edit distance to the sent symbols).
+ *
+ *  With -f it replays a recorded trace: the "optrx <us> <clux>" lines the
+ *  light receive mode traces, as printed by tools/trace_decode.py. It then
+ *  prints the decoded symbols.
+ *
+ *  Build and run from the repository root:
+ *      cc -O2 -I. -o optrx_bench tools/optrx_bench.c optrx.c morsekey.c -lm
+ *      ./optrx_bench
+ *      ./optrx_bench -f capture.txt [dot_us]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "optrx.h"
+#include "morsekey.h"
+
+#define STEP_US         1000            // light model resolution
+#define CONVERSION_US   100000
+#define AMBIENT         30000           // 300 lux office light
+#define DRIFT           0.03            // of it, over a 40 s period
+#define MAX_SYMBOLS     4096
+
+static const char *text = "PARIS CQ TEST SOS 73";
+
+static const char *codes[26] = {
+    ".-", "-...", "-.-.", "-..", ".", "..-.", "--.", "....", "..", ".---", "-.-", ".-..", "--",
+    "-.", "---", ".--.", "--.-", ".-.", "...", "-", "..-", "...-", ".--", "-..-", "-.--", "--.."
+};
+static const char *digits[10] = {
+    "-----", ".----", "..---", "...--", "....-", ".....", "-....", "--...", "---..", "----."
+};
+
+static char received[MAX_SYMBOLS];
+static int receivedCount;
+
+static void symbolFxn(char symbol, uint32_t timeUs, void *arg) {
+
+    if (receivedCount < MAX_SYMBOLS - 1) {
+        received[receivedCount++] = symbol;
+    }
+}
+
+// Symbols as the UART protocol has them: ' ' after a letter, two after a word
+static int symbols(char *out) {
+
+    int n = 0;
+    const char *p;
+
+    for (p = text; *p != '\0'; p++) {
+        const char *code = *p >= 'A' && *p <= 'Z' ? codes[*p - 'A']
+                         : *p >= '0' && *p <= '9' ? digits[*p - '0'] : NULL;
+        if (code == NULL) {
+            out[n++] = ' ';
+            continue;
+        }
+        while (*code != '\0') {
+            out[n++] = *code++;
+        }
+        out[n++] = ' ';
+    }
+    out[n++] = ' ';
+    out[n] = '\0';
+    return n;
+}
+
+// LED state per dot unit, as morse_led() sends the symbols
+static int keying(const char *sym, uint8_t *units) {
+
+    int n = 10;                             // background before the first flash
+
+    for (; *sym != '\0'; sym++) {
+        if (*sym == ' ') {
+            n += 3;
+            continue;
+        }
+        memset(&units[n], 1, *sym == '.' ? 1 : 3);
+        n += *sym == '.' ? 2 : 4;
+    }
+    return n + 10;
+}
+
+static uint32_t lcg = 12345;
+
+static double gauss(void) {
+
+    double s = 0;
+    int i;
+
+    for (i = 0; i < 12; i++) {
+        lcg = lcg * 1664525 + 1013904223;
+        s += (lcg >> 8) / 16777216.0;
+    }
+    return s - 6.0;
+}
+
+// Result register: 12-bit mantissa, the smallest exponent that fits
+static int32_t quantise(double clux) {
+
+    int32_t v = clux < 0 ? 0 : (int32_t)clux;
+    int e = 0;
+
+    while ((v >> e) > 0x0FFF) {
+        e++;
+    }
+    return (v >> e) << e;
+}
+
+static int distance(const char *a, int na, const char *b, int nb) {
+
+    static int row[2][MAX_SYMBOLS + 1];
+    int i, j;
+
+    for (j = 0; j <= nb; j++) {
+        row[0][j] = j;
+    }
+    for (i = 1; i <= na; i++) {
+        int *cur = row[i & 1], *prev = row[(i - 1) & 1];
+        cur[0] = i;
+        for (j = 1; j <= nb; j++) {
+            int d = prev[j - 1] + (a[i - 1] != b[j - 1]);
+            if (prev[j] + 1 < d) {
+                d = prev[j] + 1;
+            }
+            if (cur[j - 1] + 1 < d) {
+                d = cur[j - 1] + 1;
+            }
+            cur[j] = d;
+        }
+    }
+    return row[na & 1][nb];
+}
+
+static int replay(const char *path, uint32_t dotUs) {
+
+    FILE *f = fopen(path, "r");
+    char line[160];
+    OptReceiver rx;
+    MorseKey key;
+
+    if (f == NULL) {
+        perror(path);
+        return 1;
+    }
+    morsekey_init(&key, dotUs, symbolFxn, NULL);
+    optrx_init(&rx, &key);
+    receivedCount = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        const char *p = strstr(line, "optrx ");
+        unsigned long us;
+        long clux;
+        if (p != NULL && sscanf(p + 6, "%lu %ld", &us, &clux) == 2) {
+            optrx_sample(&rx, (int32_t)clux, (uint32_t)us);
+        }
+    }
+    fclose(f);
+    received[receivedCount] = '\0';
+    printf("samples=%lu marks=%lu rebases=%lu dot=%lu us\n%s\n",
+           (unsigned long)rx.stats.samples, (unsigned long)rx.stats.marks,
+           (unsigned long)rx.stats.rebases, (unsigned long)key.dotUs, received);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+
+    static const uint32_t dots[] = { 150000, 200000, 250000, 300000, 400000 };
+    static const int leds[] = { 2000, 500 };            // 20 lux close up, 5 lux further away
+    static const double clockErrors[] = { -0.05, 0.0, 0.05 };
+    static uint8_t units[2048];
+    static char want[MAX_SYMBOLS];
+    int wantCount, unitCount;
+    unsigned d, l, c;
+
+    if (argc > 2 && strcmp(argv[1], "-f") == 0) {
+        return replay(argv[2], argc > 3 ? (uint32_t)atol(argv[3]) : 300000);
+    }
+
+    wantCount = symbols(want);
+    unitCount = keying(want, units);
+    printf("%d symbols, %d lux background +-%d%%, %d ms conversions\n", wantCount, AMBIENT / 100,
+           (int)(DRIFT * 100), CONVERSION_US / 1000);
+    for (d = 0; d < sizeof(dots) / sizeof(dots[0]); d++) {
+        for (l = 0; l < sizeof(leds) / sizeof(leds[0]); l++) {
+            int errors = 0, count = 0;
+            for (c = 0; c < sizeof(clockErrors) / sizeof(clockErrors[0]); c++) {
+                uint32_t periodUs = (uint32_t)(CONVERSION_US * (1.0 + clockErrors[c]));
+                uint32_t endUs = unitCount * dots[d];
+                uint32_t t, sampleStart = 0;
+                double sum = 0;
+                OptReceiver rx;
+                MorseKey key;
+
+                // Both tags use the same morse_unit, the receiver starts there
+                morsekey_init(&key, dots[d], symbolFxn, NULL);
+                optrx_init(&rx, &key);
+                receivedCount = 0;
+                for (t = 0; t < endUs; t += STEP_US) {
+                    double light = AMBIENT * (1.0 + DRIFT * sin(2 * M_PI * t / 40e6));
+                    if (units[t / dots[d]]) {
+                        light += leds[l];
+                    }
+                    sum += light;
+                    if (t + STEP_US - sampleStart >= periodUs) {
+                        double mean = sum * STEP_US / periodUs;
+                        optrx_sample(&rx, quantise(mean * (1.0 + 0.002 * gauss())), t + STEP_US);
+                        sampleStart = t + STEP_US;
+                        sum = 0;
+                    }
+                }
+                errors += distance(want, wantCount, received, receivedCount);
+                count += wantCount;
+            }
+            printf("dot=%3lu ms (%4.1f wpm) led=%2d lux  errors=%3d/%d (%5.1f%%)\n",
+                   (unsigned long)(dots[d] / 1000), 1200000.0 / dots[d], leds[l] / 100,
+                   errors, count, 100.0 * errors / count);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,201 @@
+/*
+ * tonedet_bench.c
+ *
+ *  Host benchmark of the acoustic Morse path (tonedet.c + morsekey.c) on
+ *  synthetic audio: a test text keyed as a 16 kHz tone with white noise,
+ *  at several speeds and signal-to-noise ratios. The receiver starts at
+ *  20 wpm and has to adapt. For every case it prints the symbol error rate
+ *  (edit distance to the sent symbols), the learnt dot length and the host
+ *  time per 64-sample PCM block.
+ *
+ *  Build and run from the repository root:
+ *      cc -O2 -I. -o tonedet_bench tools/tonedet_bench.c tonedet.c morsekey.c -lm
+ *      ./tonedet_bench [tone_hz]
+ *
+ *  The on-target cycles per block are the "tonedet" line of the benchmark,
+ *  to be held under MIC_BUDGET_CYCLES (mic.h).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "tonedet.h"
+#include "morsekey.h"
+
+#define RATE            16000
+#define BLOCK           64
+#define AMPLITUDE       8000
+#define MAX_SYMBOLS     4096
+
+static const char *text = "PARIS CQ TEST SOS 73";
+
+static const char *codes[26] = {
+    ".-", "-...", "-.-.", "-..", ".", "..-.", "--.", "....", "..", ".---", "-.-", ".-..", "--",
+    "-.", "---", ".--.", "--.-", ".-.", "...", "-", "..-", "...-", ".--", "-..-", "-.--", "--.."
+};
+static const char *digits[10] = {
+    "-----", ".----", "..---", "...--", "....-", ".....", "-....", "--...", "---..", "----."
+};
+
+static char received[MAX_SYMBOLS];
+static int receivedCount;
+
+static void symbolFxn(char symbol, uint32_t timeUs, void *arg) {
+
+    if (receivedCount < MAX_SYMBOLS - 1) {
+        received[receivedCount++] = symbol;
+    }
+}
+
+static void frameFxn(bool down, uint32_t timeUs, void *arg) {
+
+    morsekey_update((MorseKey *)arg, down, timeUs);
+}
+
+// Expected symbol string as morsekey reports it: one ' ' after a letter,
+// two after a word
+static int expected(char *out) {
+
+    int n = 0;
+    const char *p;
+
+    for (p = text; *p != '\0'; p++) {
+        const char *code = *p >= 'A' && *p <= 'Z' ? codes[*p - 'A']
+                         : *p >= '0' && *p <= '9' ? digits[*p - '0'] : NULL;
+        if (code == NULL) {
+            out[n++] = ' ';
+            continue;
+        }
+        while (*code != '\0') {
+            out[n++] = *code++;
+        }
+        out[n++] = ' ';
+    }
+    out[n++] = ' ';
+    out[n] = '\0';
+    return n;
+}
+
+// Keying in dot units, 1 = tone
+static int keying(uint8_t *units) {
+
+    int n = 0;
+    const char *p;
+
+    for (p = text; *p != '\0'; p++) {
+        const char *code = *p >= 'A' && *p <= 'Z' ? codes[*p - 'A']
+                         : *p >= '0' && *p <= '9' ? digits[*p - '0'] : NULL;
+        if (code == NULL) {
+            n += 4;                         // 3 after the letter + 4 = word gap
+            continue;
+        }
+        for (; *code != '\0'; code++) {
+            int len = *code == '.' ? 1 : 3;
+            memset(&units[n], 1, len);
+            n += len;
+            units[n++] = 0;
+        }
+        n += 2;
+    }
+    n += 10;
+    return n;
+}
+
+static uint32_t lcg = 12345;
+
+static double gauss(void) {
+
+    double s = 0;
+    int i;
+
+    for (i = 0; i < 12; i++) {
+        lcg = lcg * 1664525 + 1013904223;
+        s += (lcg >> 8) / 16777216.0;
+    }
+    return s - 6.0;
+}
+
+// Levenshtein distance, the symbol error count
+static int distance(const char *a, int na, const char *b, int nb) {
+
+    static int row[2][MAX_SYMBOLS + 1];
+    int i, j;
+
+    for (j = 0; j <= nb; j++) {
+        row[0][j] = j;
+    }
+    for (i = 1; i <= na; i++) {
+        int *cur = row[i & 1], *prev = row[(i - 1) & 1];
+        cur[0] = i;
+        for (j = 1; j <= nb; j++) {
+            int d = prev[j - 1] + (a[i - 1] != b[j - 1]);
+            if (prev[j] + 1 < d) {
+                d = prev[j] + 1;
+            }
+            if (cur[j - 1] + 1 < d) {
+                d = cur[j - 1] + 1;
+            }
+            cur[j] = d;
+        }
+    }
+    return row[na & 1][nb];
+}
+
+int main(int argc, char **argv) {
+
+    static const int wpms[] = { 10, 20, 30 };
+    static const int snrs[] = { 20, 10, 6, 3 };
+    static uint8_t units[2048];
+    static char want[MAX_SYMBOLS];
+    int toneHz = argc > 1 ? atoi(argv[1]) : 700;
+    int unitCount = keying(units);
+    int wantCount = expected(want);
+    int w, s;
+
+    printf("tone %d Hz, %d symbols\n", toneHz, wantCount);
+    for (w = 0; w < 3; w++) {
+        for (s = 0; s < 4; s++) {
+            uint32_t dotUs = 1200000 / wpms[w];
+            long samples = (long)unitCount * dotUs * RATE / 1000000;
+            double noise = AMPLITUDE / sqrt(2.0) / pow(10.0, snrs[s] / 20.0);
+            int16_t *pcm = malloc(samples * sizeof(int16_t));
+            ToneDetector det;
+            MorseKey key;
+            struct timespec t0, t1;
+            long i, blocks = 0;
+            double ns;
+            int errors;
+
+            for (i = 0; i < samples; i++) {
+                long unit = i * 1000000 / RATE / dotUs;
+                double v = units[unit] ? AMPLITUDE * sin(2 * M_PI * toneHz * i / RATE) : 0;
+                v += noise * gauss();
+                pcm[i] = v > 32767 ? 32767 : v < -32768 ? -32768 : (int16_t)v;
+            }
+            receivedCount = 0;
+            morsekey_init(&key, 60000, symbolFxn, NULL);
+            if (!tonedet_init(&det, RATE, toneHz, frameFxn, &key)) {
+                fprintf(stderr, "tone %d Hz out of range\n", toneHz);
+                return 1;
+            }
+
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            for (i = 0; i + BLOCK <= samples; i += BLOCK) {
+                tonedet_process(&det, &pcm[i], BLOCK, (uint32_t)((i + BLOCK - 1) * 1000000LL / RATE));
+                blocks++;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            ns = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / blocks;
+
+            errors = distance(want, wantCount, received, receivedCount);
+            printf("wpm=%2d snr=%2d dB  symbols=%3d errors=%3d (%5.1f%%)  dot=%6lu us  %6.1f ns/block\n",
+                   wpms[w], snrs[s], receivedCount, errors, 100.0 * errors / wantCount,
+                   (unsigned long)key.dotUs, ns);
+            free(pcm);
+        }
+    }
+    return 0;
+}
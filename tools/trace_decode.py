@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""Decode binary trace frames (see trace.h) captured from the SensorTag UART.
+
+Usage: trace_decode.py <firmware.out> <capture.bin> [--tick-us 10]
+
+Format strings are looked up in the .trace_fmt section of the ELF image.
+Bytes outside of trace frames (Morse symbols, text reports) are echoed as is.
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+FRAME_MARKER = 0xA5
+
+
+def load_section(elf_path, name):
+    """Return (address, bytes) of an ELF32 little-endian section."""
+    with open(elf_path, "rb") as f:
+        elf = f.read()
+    if elf[:4] != b"\x7fELF" or elf[4] != 1 or elf[5] != 1:
+        raise ValueError("expected a 32-bit little-endian ELF file")
+    shoff, = struct.unpack_from("<I", elf, 0x20)
+    shentsize, shnum, shstrndx = struct.unpack_from("<HHH", elf, 0x2E)
+
+    def header(i):
+        return struct.unpack_from("<IIIIIIIIII", elf, shoff + i * shentsize)
+
+    strtab = header(shstrndx)
+    for i in range(shnum):
+        sh = header(i)
+        start = strtab[4] + sh[0]
+        sh_name = elf[start:elf.index(b"\0", start)].decode()
+        if sh_name == name or sh_name.startswith(name + ":"):
+            return sh[3], elf[sh[4]:sh[4] + sh[5]]
+    raise ValueError("section %s not found" % name)
+
+
+def format_string(section, address):
+    base, data = section
+    offset = address - base
+    if offset < 0 or offset >= len(data):
+        return None
+    return data[offset:data.index(b"\0", offset)].decode(errors="replace")
+
+
+C_CONVERSION = re.compile(r"%([-+ 0#]*\d*)(?:hh|h|ll|l)?([diuxXc%])")
+
+
+def render(fmt, args):
+    values = iter(args)
+
+    def convert(match):
+        flags, conv = match.groups()
+        if conv == "%":
+            return "%"
+        value = next(values, 0)
+        if conv in "di" and value & 0x80000000:
+            value -= 1 << 32
+        if conv == "c":
+            return chr(value & 0xFF)
+        if conv == "u":
+            conv = "d"
+        return ("%" + flags + conv) % value
+
+    return C_CONVERSION.sub(convert, fmt)
+
+
+def decode(section, stream, tick_us, out):
+    i = 0
+    while i < len(stream):
+        if stream[i] != FRAME_MARKER or i + 9 > len(stream):
+            out.write(chr(stream[i]))
+            i += 1
+            continue
+        nargs = stream[i + 1]
+        length = 9 + 4 * nargs
+        if nargs > 3 or i + length > len(stream):
+            out.write(chr(stream[i]))
+            i += 1
+            continue
+        address = stream[i + 2] | stream[i + 3] << 8 | stream[i + 4] << 16
+        ticks, = struct.unpack_from("<I", stream, i + 5)
+        args = struct.unpack_from("<%dI" % nargs, stream, i + 9)
+        fmt = format_string(section, address)
+        if fmt is None:
+            text = "<unknown format 0x%05x> %s" % (address, " ".join(map(hex, args)))
+        else:
+            text = render(fmt, args)
+        out.write("\n[%10.3f ms] %s\n" % (ticks * tick_us / 1000.0, text))
+        i += length
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf")
+    parser.add_argument("capture")
+    parser.add_argument("--tick-us", type=float, default=10.0,
+                        help="Clock.tickPeriod from empty.cfg")
+    args = parser.parse_args()
+
+    section = load_section(args.elf, ".trace_fmt")
+    with open(args.capture, "rb") as f:
+        decode(section, f.read(), args.tick_us, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
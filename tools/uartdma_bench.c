@@ -0,0 +1,256 @@
+/*
+ * uartdma_bench.c
+ *
+ *  Host check and benchmark of the double transmit buffer of the uDMA UART
+ *  (dblbuf.c), driven the way uartdma.c drives it.
+ *
+ *  The check writes frames of random length and content through the same
+ *  put / start loop as uartdma_write, against a simulated uDMA channel that
+ *  finishes its transfer at random points in between. It checks that
+ *
+ *   - the bytes on the line are the bytes written, in order
+ *   - a buffer is never written while it is in flight
+ *   - a transfer only starts when none is running, never empty
+ *   - lengths stay within DBLBUF_SIZE and the queue within both buffers
+ *   - a full queue only stalls the writer until the next completion
+ *
+ *  The benchmark then runs a timed line model: 4-byte symbol frames and
+ *  bursts of report lines at the given baud rate, with the transfer time
+ *  of each batch. It prints the batches, the average batch size and the
+ *  highest queue length, and the host time per write.
+ *
+ *  Build and run from the repository root, with the sanitizers:
+ *      cc -O1 -g -fsanitize=address,undefined -I. -o uartdma_bench tools/uartdma_bench.c dblbuf.c
+ *      ./uartdma_bench [iterations] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "dblbuf.h"
+
+#define MAX_FRAME       600         // longer than both buffers together
+#define STREAM_SIZE     (1 << 22)
+#define TIMED_WRITES    2000000
+
+static long failures = 0;
+static long iteration;
+
+static void fail(const char *what) {
+
+    if (failures++ < 20) {
+        printf("iteration %ld: %s\n", iteration, what);
+    }
+}
+
+// The simulated uDMA channel and what went out on the line
+typedef struct {
+    DblBuf tx;
+    const uint8_t *flight;          // buffer the channel reads, NULL when idle
+    uint16_t flightLen;
+    uint8_t snapshot[DBLBUF_SIZE];  // its contents at the start
+    uint8_t *line;
+    size_t lineLen;
+    long batches;
+    long stalls;
+    uint16_t maxQueued;
+} Channel;
+
+static void channel_start(Channel *ch) {
+
+    const uint8_t *data;
+    uint16_t len;
+
+    if (ch->flight != NULL) {
+        fail("transfer started while one is running");
+        return;
+    }
+    len = dblbuf_start(&ch->tx, &data);
+    if (len == 0) {
+        fail("empty transfer");
+        return;
+    }
+    if (len > DBLBUF_SIZE || data == ch->tx.data[ch->tx.fill]) {
+        fail("transfer of the fill buffer");
+    }
+    if (dblbuf_start(&ch->tx, &data) != 0) {
+        fail("second transfer while the first runs");
+    }
+    ch->flight = data;
+    ch->flightLen = len;
+    memcpy(ch->snapshot, data, len);
+    ch->batches++;
+}
+
+// The completion interrupt: the bytes go out, the next batch starts
+static void channel_done(Channel *ch) {
+
+    if (ch->flight == NULL) {
+        return;
+    }
+    if (memcmp(ch->flight, ch->snapshot, ch->flightLen) != 0) {
+        fail("buffer changed while in flight");
+    }
+    if (ch->line != NULL) {
+        memcpy(&ch->line[ch->lineLen], ch->flight, ch->flightLen);
+    }
+    ch->lineLen += ch->flightLen;
+    ch->flight = NULL;
+    if (dblbuf_done(&ch->tx)) {
+        channel_start(ch);
+    }
+}
+
+// uartdma_write without the locking: a full queue waits for a completion
+static void channel_write(Channel *ch, const uint8_t *src, size_t size, int completeOneIn) {
+
+    bool stalled = false;
+
+    while (size > 0) {
+        size_t n = dblbuf_put(&ch->tx, src, size);
+        uint16_t queued;
+
+        if (n == 0) {
+            if (ch->flight == NULL || stalled) {
+                fail(stalled ? "completion did not free a buffer" : "writer stalled with no transfer running");
+                return;
+            }
+            ch->stalls++;
+            channel_done(ch);
+            stalled = true;
+            continue;
+        }
+        stalled = false;
+        if (!ch->tx.active) {
+            channel_start(ch);
+        }
+        queued = dblbuf_queued(&ch->tx);
+        if (queued > 2 * DBLBUF_SIZE || ch->tx.len[0] > DBLBUF_SIZE || ch->tx.len[1] > DBLBUF_SIZE) {
+            fail("queue beyond the buffers");
+        }
+        if (queued > ch->maxQueued) {
+            ch->maxQueued = queued;
+        }
+        src += n;
+        size -= n;
+        if (completeOneIn > 0 && rand() % completeOneIn == 0) {
+            channel_done(ch);
+        }
+    }
+}
+
+static void check_stream(long iterations) {
+
+    static uint8_t in[STREAM_SIZE], out[STREAM_SIZE];
+    Channel ch;
+    size_t inLen = 0;
+
+    memset(&ch, 0, sizeof(ch));
+    dblbuf_init(&ch.tx);
+    ch.line = out;
+    for (iteration = 0; iteration < iterations && inLen + MAX_FRAME <= STREAM_SIZE; iteration++) {
+        size_t len = 1 + (rand() % 4 ? rand() % 16 : rand() % MAX_FRAME);
+        size_t i;
+
+        for (i = 0; i < len; i++) {
+            in[inLen + i] = (uint8_t)rand();
+        }
+        channel_write(&ch, &in[inLen], len, 1 + rand() % 8);
+        inLen += len;
+        if (rand() % 4 == 0) {
+            channel_done(&ch);
+        }
+    }
+    // The batch in flight and at most one more
+    channel_done(&ch);
+    channel_done(&ch);
+    if (ch.flight != NULL || dblbuf_queued(&ch.tx) != 0 || ch.tx.active) {
+        fail("queue not empty after the last completion");
+    }
+    if (ch.lineLen != inLen || memcmp(in, out, inLen) != 0) {
+        fail("line differs from what was written");
+    }
+    printf("stream: %ld frames, %zu bytes in %ld batches, %ld stalls, max queue %u\n",
+           iteration, inLen, ch.batches, ch.stalls, ch.maxQueued);
+}
+
+// Symbols every symbolUs and a report of reportBytes every reportUs, for
+// one simulated minute; a batch of n bytes takes 10 n bits on the line
+static void model(unsigned baud, unsigned symbolUs, unsigned reportBytes, unsigned reportUs) {
+
+    static const uint8_t frame[4] = { '.', '\r', '\n', '\0' };
+    static uint8_t report[MAX_FRAME];
+    Channel ch;
+    double now = 0, nextSymbol = 0, nextReport = 0, doneAt = 0;
+    long writes = 0;
+    size_t bytes = 0;
+    bool idle;
+
+    memset(&ch, 0, sizeof(ch));
+    memset(report, 'r', sizeof(report));
+    dblbuf_init(&ch.tx);
+    while (now < 60e6) {
+        bool symbol = nextSymbol <= nextReport;
+        now = symbol ? nextSymbol : nextReport;
+        // Completions due before this write, each one starts the next batch
+        while (ch.flight != NULL && doneAt <= now) {
+            channel_done(&ch);
+            if (ch.flight != NULL) {
+                doneAt += ch.flightLen * 10e6 / baud;
+            }
+        }
+        idle = ch.flight == NULL;
+        if (symbol) {
+            channel_write(&ch, frame, sizeof(frame), 0);
+            bytes += sizeof(frame);
+            nextSymbol += symbolUs;
+        } else {
+            channel_write(&ch, report, reportBytes, 0);
+            bytes += reportBytes;
+            nextReport += reportUs;
+        }
+        if (idle && ch.flight != NULL) {
+            doneAt = now + ch.flightLen * 10e6 / baud;
+        }
+        writes++;
+    }
+    printf("model %u baud: %ld writes, %zu bytes, %ld batches, avg %.1f bytes, max queue %u, %ld stalls\n",
+           baud, writes, bytes, ch.batches, (double)bytes / ch.batches, ch.maxQueued, ch.stalls);
+}
+
+static void bench(void) {
+
+    static const uint8_t frame[4] = { '-', '\r', '\n', '\0' };
+    Channel ch;
+    clock_t start;
+    long i;
+
+    memset(&ch, 0, sizeof(ch));
+    dblbuf_init(&ch.tx);
+    start = clock();
+    for (i = 0; i < TIMED_WRITES; i++) {
+        channel_write(&ch, frame, sizeof(frame), 0);
+        if ((i & 31) == 31) {
+            channel_done(&ch);
+        }
+    }
+    printf("write: %.1f ns per 4-byte frame\n",
+           (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / TIMED_WRITES);
+}
+
+int main(int argc, char **argv) {
+
+    long iterations = argc > 1 ? atol(argv[1]) : 100000;
+    unsigned seed = argc > 2 ? (unsigned)atol(argv[2]) : 1;
+
+    srand(seed);
+    check_stream(iterations);
+    model(9600, 20000, 120, 1000000);
+    model(115200, 2000, 400, 100000);
+    bench();
+    printf("%ld failures\n", failures);
+    return failures ? 1 : 0;
+}
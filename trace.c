@@ -0,0 +1,147 @@
+/*
+ * trace.c
+ *
+ *  Deferred binary logging, see trace.h for the record and frame format.
+ */
+
+#include <string.h>
+
+#include <xdc/std.h>
+#include <ti/sysbios/hal/Hwi.h>
+#include <ti/sysbios/knl/Clock.h>
+
+#include "trace.h"
+#include "memsection.h"
+
+#define TRACE_RING_MASK     (TRACE_RING_WORDS - 1)
+#define TRACE_FRAME_MAX     (9 + 4 * TRACE_MAX_ARGS)
+
+// Ring of 32-bit words. A record is a header word (marker, nargs, format
+// address), a timestamp word and nargs argument words.
+static uint32_t traceRing[TRACE_RING_WORDS] GPRAM_DATA;
+static volatile uint16_t ringHead = 0;
+static volatile uint16_t ringTail = 0;
+static volatile uint32_t droppedRecords = 0;
+
+// Encoded frames waiting for the UART task
+static uint8_t traceOut[TRACE_OUT_SIZE];
+static volatile uint16_t traceOutCount = 0;
+static volatile bool outputEnabled = false;
+static Semaphore_Handle notifySem = NULL;
+
+RAMFUNC void trace_write(const char *fmt, uint32_t nargs, uint32_t a0, uint32_t a1, uint32_t a2) {
+
+    UInt key = Hwi_disable();
+    uint16_t head = ringHead;
+    uint16_t used = (head - ringTail) & TRACE_RING_MASK;
+
+    if (TRACE_RING_WORDS - 1 - used < 2 + nargs) {
+        droppedRecords++;
+        Hwi_restore(key);
+        return;
+    }
+    traceRing[head] = ((uint32_t)TRACE_FRAME_MARKER << 24) | (nargs << 20) | ((uint32_t)(uintptr_t)fmt & 0xFFFFF);
+    head = (head + 1) & TRACE_RING_MASK;
+    traceRing[head] = Clock_getTicks();
+    head = (head + 1) & TRACE_RING_MASK;
+    if (nargs > 0) {
+        traceRing[head] = a0;
+        head = (head + 1) & TRACE_RING_MASK;
+    }
+    if (nargs > 1) {
+        traceRing[head] = a1;
+        head = (head + 1) & TRACE_RING_MASK;
+    }
+    if (nargs > 2) {
+        traceRing[head] = a2;
+        head = (head + 1) & TRACE_RING_MASK;
+    }
+    ringHead = head;
+    Hwi_restore(key);
+}
+
+static void trace_put32(uint8_t *dst, uint32_t value) {
+
+    dst[0] = value & 0xFF;
+    dst[1] = (value >> 8) & 0xFF;
+    dst[2] = (value >> 16) & 0xFF;
+    dst[3] = (value >> 24) & 0xFF;
+}
+
+// Runs in the Idle task. Moves complete records from the ring into the frame
+// buffer; when output is disabled the records are just consumed so the ring
+// never fills up and the latest history stays visible in a memory dump.
+void trace_idleFxn(void) {
+
+    uint8_t frame[TRACE_FRAME_MAX];
+    bool encoded = false;
+
+    while (ringTail != ringHead) {
+        uint16_t tail = ringTail;
+        uint32_t header = traceRing[tail];
+        uint32_t nargs = (header >> 20) & 0xF;
+        uint16_t len = 9 + 4 * nargs;
+        uint32_t i;
+
+        if (outputEnabled) {
+            frame[0] = TRACE_FRAME_MARKER;
+            frame[1] = nargs;
+            frame[2] = header & 0xFF;
+            frame[3] = (header >> 8) & 0xFF;
+            frame[4] = (header >> 16) & 0x0F;
+            for (i = 0; i < 1 + nargs; i++) {
+                trace_put32(&frame[5 + 4 * i], traceRing[(tail + 1 + i) & TRACE_RING_MASK]);
+            }
+
+            UInt key = Hwi_disable();
+            if (traceOutCount + len > TRACE_OUT_SIZE) {
+                // UART task has not caught up yet, try again on the next idle pass
+                Hwi_restore(key);
+                break;
+            }
+            memcpy(&traceOut[traceOutCount], frame, len);
+            traceOutCount += len;
+            Hwi_restore(key);
+            encoded = true;
+        }
+        ringTail = (tail + 2 + nargs) & TRACE_RING_MASK;
+    }
+
+    if (encoded && notifySem != NULL) {
+        Semaphore_post(notifySem);
+    }
+}
+
+// Posted from the Idle task whenever new frames are ready for trace_flush
+void trace_setNotify(Semaphore_Handle sem) {
+
+    notifySem = sem;
+}
+
+void trace_setOutput(bool enable) {
+
+    outputEnabled = enable;
+}
+
+// Called from the UART task; sends everything the Idle task has encoded so far
+// with a single UART_write. The UART must be in binary write mode.
+void trace_flush(UART_Handle uart) {
+
+    uint8_t buffer[TRACE_OUT_SIZE];
+    uint16_t count;
+
+    UInt key = Hwi_disable();
+    count = traceOutCount;
+    memcpy(buffer, traceOut, count);
+    traceOutCount = 0;
+    Hwi_restore(key);
+
+    if (count > 0) {
+        UART_write(uart, buffer, count);
+    }
+}
+
+uint32_t trace_dropped(void) {
+
+    return droppedRecords;
+}
@@ -0,0 +1,48 @@
+/*
+ * trace.h
+ *
+ *  Deferred binary logging. A TRACEn() call stores only the address of its
+ *  format string and up to three 32-bit arguments in a RAM ring; nothing is
+ *  formatted on the target. The Idle task drains the ring into a binary
+ *  frame buffer that the UART task sends, and tools/trace_decode.py rebuilds
+ *  the text from the .trace_fmt section of the ELF.
+ *
+ *  Frame on the wire (little endian):
+ *      0xA5, nargs, fmt[3], timestamp[4], args[4 * nargs]
+ *  fmt is the flash address of the format string, timestamp is in Clock ticks.
+ *  Formats may use %d, %u, %x and %c.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ti/sysbios/knl/Semaphore.h>
+#include <ti/drivers/UART.h>
+
+#define TRACE_RING_WORDS    256
+#define TRACE_OUT_SIZE      128
+#define TRACE_FRAME_MARKER  0xA5
+#define TRACE_MAX_ARGS      3
+
+#define TRACE_FMT(fmt) \
+    static const char _traceFmt[] __attribute__((section(".trace_fmt"), used)) = fmt
+
+#define TRACE0(fmt) \
+    do { TRACE_FMT(fmt); trace_write(_traceFmt, 0, 0, 0, 0); } while (0)
+#define TRACE1(fmt, a) \
+    do { TRACE_FMT(fmt); trace_write(_traceFmt, 1, (uint32_t)(a), 0, 0); } while (0)
+#define TRACE2(fmt, a, b) \
+    do { TRACE_FMT(fmt); trace_write(_traceFmt, 2, (uint32_t)(a), (uint32_t)(b), 0); } while (0)
+#define TRACE3(fmt, a, b, c) \
+    do { TRACE_FMT(fmt); trace_write(_traceFmt, 3, (uint32_t)(a), (uint32_t)(b), (uint32_t)(c)); } while (0)
+
+void trace_write(const char *fmt, uint32_t nargs, uint32_t a0, uint32_t a1, uint32_t a2);
+void trace_idleFxn(void);
+void trace_setOutput(bool enable);
+void trace_flush(UART_Handle uart);
+void trace_setNotify(Semaphore_Handle sem);
+uint32_t trace_dropped(void);
+
+#endif /* TRACE_H_ */
@@ -0,0 +1,461 @@
+/*
+ * uartdma.c
+ *
+ *  UART driver with a double buffered uDMA transmit path, see uartdma.h.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <xdc/std.h>
+#include <xdc/runtime/Types.h>
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/hal/Hwi.h>
+#include <ti/sysbios/knl/Clock.h>
+#include <ti/sysbios/knl/Semaphore.h>
+#include <ti/drivers/Power.h>
+#include <ti/drivers/power/PowerCC26XX.h>
+#include <ti/drivers/pin/PINCC26XX.h>
+
+#include <inc/hw_memmap.h>
+#include <inc/hw_uart.h>
+#include <driverlib/uart.h>
+#include <driverlib/udma.h>
+
+#include "uartdma.h"
+#include "powertrack.h"
+#include "wakeup.h"
+#include "report.h"
+
+#define RX_INTS     (UART_INT_RX | UART_INT_RT | UART_INT_OE | UART_INT_BE | UART_INT_PE | UART_INT_FE)
+
+ALLOCATE_CONTROL_TABLE_ENTRY(dmaUart0TxControlTableEntry, UDMA_CHAN_UART0_TX);
+
+static void uartdma_init(UART_Handle handle) {
+
+    UartDmaObject *obj = handle->object;
+
+    obj->opened = false;
+}
+
+// Hwi context or Hwi disabled. Sends the filled buffer, writes go to the other one.
+static void uartdma_start(UART_Handle handle) {
+
+    UartDmaObject *obj = handle->object;
+    const UartDmaHWAttrs *hw = handle->hwAttrs;
+    volatile tDMAControlTable *entry = &dmaUart0TxControlTableEntry;
+    const uint8_t *data;
+    uint16_t len = dblbuf_start(&obj->tx, &data);
+
+    if (len == 0) {
+        return;
+    }
+    entry->pvSrcEndAddr = (void *)&data[len - 1];
+    entry->pvDstEndAddr = (void *)(hw->baseAddr + UART_O_DR);
+    entry->ui32Control = UDMA_MODE_BASIC | UDMA_SIZE_8 | UDMA_SRC_INC_8 | UDMA_DST_INC_NONE
+                       | UDMA_ARB_4 | UDMACC26XX_SET_TRANSFER_SIZE(len);
+    UDMACC26XX_channelEnable(obj->udma, hw->txChannelBitMask);
+    UARTDMAEnable(hw->baseAddr, UART_DMA_TX);
+
+    // A batch chained from the completion interrupt finds the line still
+    // busy and the constraint already held
+    if (!obj->txDraining && !obj->txBusy) {
+        obj->txStart = Clock_getTicks();
+        powertrack_setConstraint(POWER_OWNER_UART, PowerCC26XX_SB_DISALLOW);
+    }
+    UARTIntDisable(hw->baseAddr, UART_INT_EOT);
+    obj->txDraining = false;
+    obj->txBusy = true;
+    obj->stats.batches++;
+}
+
+static void uartdma_txDone(UART_Handle handle) {
+
+    UartDmaObject *obj = handle->object;
+    const UartDmaHWAttrs *hw = handle->hwAttrs;
+
+    UARTDMADisable(hw->baseAddr, UART_DMA_TX);
+    if (dblbuf_done(&obj->tx)) {
+        uartdma_start(handle);
+    } else {
+        // The FIFO still holds up to 32 bytes, keep standby off until they are out
+        obj->txBusy = false;
+        obj->txDraining = true;
+        UARTIntClear(hw->baseAddr, UART_INT_EOT);
+        UARTIntEnable(hw->baseAddr, UART_INT_EOT);
+    }
+    if (obj->txWaiting) {
+        obj->txWaiting = false;
+        Semaphore_post(Semaphore_handle(&obj->txFree));
+    }
+}
+
+static void uartdma_hwiFxn(UArg arg) {
+
+    UART_Handle handle = (UART_Handle)arg;
+    UartDmaObject *obj = handle->object;
+    const UartDmaHWAttrs *hw = handle->hwAttrs;
+    uint32_t status = UARTIntStatus(hw->baseAddr, true);
+
+    wakeup_mark(WAKE_UART);
+    UARTIntClear(hw->baseAddr, status);
+
+    if (status & RX_INTS) {
+        while (UARTCharsAvail(hw->baseAddr)) {
+            uint8_t byte = (uint8_t)UARTCharGetNonBlocking(hw->baseAddr);
+            obj->stats.rxBytes++;
+            if (obj->readBuf == NULL) {
+                obj->stats.rxDropped++;
+                continue;
+            }
+            obj->readBuf[obj->readCount++] = byte;
+            if (obj->readCount == obj->readSize) {
+                // The callback normally queues the next read at once
+                uint8_t *buf = obj->readBuf;
+                obj->readBuf = NULL;
+                obj->readCallback(handle, buf, obj->readCount);
+            }
+        }
+    }
+
+    if (UDMACC26XX_channelDone(obj->udma, hw->txChannelBitMask)) {
+        UDMACC26XX_clearInterrupt(obj->udma, hw->txChannelBitMask);
+        uartdma_txDone(handle);
+    }
+
+    if ((status & UART_INT_EOT) && obj->txDraining) {
+        UARTIntDisable(hw->baseAddr, UART_INT_EOT);
+        obj->txDraining = false;
+        obj->stats.busyTicks += Clock_getTicks() - obj->txStart;
+        powertrack_releaseConstraint(POWER_OWNER_UART, PowerCC26XX_SB_DISALLOW);
+    }
+}
+
+// Baud rate, FIFO levels and interrupts. Standby powers the SERIAL domain
+// down, so this runs again from the wake notification.
+static void uartdma_setup(UART_Handle handle) {
+
+    UartDmaObject *obj = handle->object;
+    const UartDmaHWAttrs *hw = handle->hwAttrs;
+    Types_FreqHz freq;
+
+    uDMAChannelAttributeDisable(UDMA0_BASE, UDMA_CHAN_UART0_TX,
+                                UDMA_ATTR_ALTSELECT | UDMA_ATTR_HIGH_PRIORITY | UDMA_ATTR_REQMASK);
+    BIOS_getCpuFreq(&freq);
+    UARTDisable(hw->baseAddr);
+    UARTConfigSetExpClk(hw->baseAddr, freq.lo, obj->baudRate,
+                        UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE | UART_CONFIG_PAR_NONE);
+    // uDMA bursts of 4 while the TX FIFO has 16 free, RX interrupt at 16 or on timeout
+    UARTFIFOLevelSet(hw->baseAddr, UART_FIFO_TX4_8, UART_FIFO_RX4_8);
+    UARTIntClear(hw->baseAddr, RX_INTS | UART_INT_EOT);
+    UARTIntEnable(hw->baseAddr, RX_INTS);
+    UARTEnable(hw->baseAddr);
+}
+
+static int uartdma_awakeFxn(unsigned int eventType, uintptr_t eventArg, uintptr_t clientArg) {
+
+    uartdma_setup((UART_Handle)clientArg);
+    return Power_NOTIFYDONE;
+}
+
+// Falling edge on RX while standby is allowed. The start bit woke the MCU,
+// which stays awake for the rest of the line; that first byte is lost when
+// the UART was powered down.
+static void uartdma_rxEdgeFxn(PIN_Handle pins, PIN_Id pinId) {
+
+    // pins is &obj->pinState
+    UartDmaObject *obj = (UartDmaObject *)((uint8_t *)pins - offsetof(UartDmaObject, pinState));
+
+    wakeup_mark(WAKE_UART);
+    PIN_setInterrupt(pins, pinId | PIN_IRQ_DIS);
+    if (!obj->readHeld && obj->readBuf != NULL) {
+        obj->readHeld = true;
+        powertrack_setConstraint(POWER_OWNER_UART, PowerCC26XX_SB_DISALLOW);
+    }
+}
+
+static UART_Handle uartdma_open(UART_Handle handle, UART_Params *params) {
+
+    UartDmaObject *obj = handle->object;
+    const UartDmaHWAttrs *hw = handle->hwAttrs;
+    PIN_Config pinConfig[] = {
+        hw->txPin | PIN_GPIO_OUTPUT_EN | PIN_GPIO_HIGH | PIN_PUSHPULL | PIN_INPUT_DIS,
+        hw->rxPin | PIN_INPUT_EN | PIN_PULLUP,
+        PIN_TERMINATE
+    };
+    Hwi_Params hwiParams;
+    Semaphore_Params semParams;
+    UInt key = Hwi_disable();
+
+    if (obj->opened || params->readMode != UART_MODE_CALLBACK || params->dataLength != UART_LEN_8
+        || params->parityType != UART_PAR_NONE || params->stopBits != UART_STOP_ONE) {
+        Hwi_restore(key);
+        return NULL;
+    }
+    obj->opened = true;
+    Hwi_restore(key);
+
+    obj->pins = PIN_open(&obj->pinState, pinConfig);
+    if (obj->pins == NULL) {
+        obj->opened = false;
+        return NULL;
+    }
+    PINCC26XX_setMux(obj->pins, hw->txPin, IOC_PORT_MCU_UART0_TX);
+    PINCC26XX_setMux(obj->pins, hw->rxPin, IOC_PORT_MCU_UART0_RX);
+    PIN_registerIntCb(obj->pins, uartdma_rxEdgeFxn);
+
+    Power_setDependency(hw->powerMngrId);
+    obj->udma = UDMACC26XX_open();
+    UDMACC26XX_clearInterrupt(obj->udma, hw->txChannelBitMask);
+
+    obj->readCallback = params->readCallback;
+    obj->writeTimeout = params->writeTimeout;
+    obj->baudRate = params->baudRate;
+    obj->readBuf = NULL;
+    obj->readHeld = false;
+    dblbuf_init(&obj->tx);
+    obj->txBusy = obj->txDraining = obj->txWaiting = false;
+    memset(&obj->stats, 0, sizeof(obj->stats));
+    obj->openTicks = Clock_getTicks();
+
+    Semaphore_Params_init(&semParams);
+    semParams.mode = Semaphore_Mode_BINARY;
+    Semaphore_construct(&obj->txFree, 0, &semParams);
+
+    Hwi_Params_init(&hwiParams);
+    hwiParams.arg = (UArg)handle;
+    hwiParams.priority = hw->intPriority;
+    Hwi_construct(&obj->hwi, hw->intNum, uartdma_hwiFxn, &hwiParams, NULL);
+
+    uartdma_setup(handle);
+    Power_registerNotify(&obj->awakeNotify, PowerCC26XX_AWAKE_STANDBY,
+                         (Power_NotifyFxn)uartdma_awakeFxn, (uintptr_t)handle);
+    return handle;
+}
+
+static void uartdma_writeCancel(UART_Handle handle) {
+
+    UartDmaObject *obj = handle->object;
+    const UartDmaHWAttrs *hw = handle->hwAttrs;
+    UInt key = Hwi_disable();
+
+    if (obj->txBusy || obj->txDraining) {
+        UDMACC26XX_channelDisable(obj->udma, hw->txChannelBitMask);
+        UARTDMADisable(hw->baseAddr, UART_DMA_TX);
+        UARTIntDisable(hw->baseAddr, UART_INT_EOT);
+        obj->stats.busyTicks += Clock_getTicks() - obj->txStart;
+        powertrack_releaseConstraint(POWER_OWNER_UART, PowerCC26XX_SB_DISALLOW);
+    }
+    dblbuf_init(&obj->tx);
+    obj->txBusy = obj->txDraining = false;
+    if (obj->txWaiting) {
+        obj->txWaiting = false;
+        Semaphore_post(Semaphore_handle(&obj->txFree));
+    }
+    Hwi_restore(key);
+}
+
+static void uartdma_readCancel(UART_Handle handle) {
+
+    UartDmaObject *obj = handle->object;
+    uint8_t *buf;
+    size_t count;
+    UInt key = Hwi_disable();
+
+    buf = obj->readBuf;
+    count = obj->readCount;
+    obj->readBuf = NULL;
+    if (obj->readHeld) {
+        obj->readHeld = false;
+        powertrack_releaseConstraint(POWER_OWNER_UART, PowerCC26XX_SB_DISALLOW);
+    }
+    Hwi_restore(key);
+
+    if (buf != NULL) {
+        obj->readCallback(handle, buf, count);
+    }
+}
+
+static void uartdma_close(UART_Handle handle) {
+
+    UartDmaObject *obj = handle->object;
+    const UartDmaHWAttrs *hw = handle->hwAttrs;
+
+    uartdma_writeCancel(handle);
+    uartdma_readCancel(handle);
+    Power_unregisterNotify(&obj->awakeNotify);
+    PIN_setInterrupt(obj->pins, hw->rxPin | PIN_IRQ_DIS);
+    UARTIntDisable(hw->baseAddr, RX_INTS | UART_INT_EOT);
+    UARTDisable(hw->baseAddr);
+    Hwi_destruct(&obj->hwi);
+    Semaphore_destruct(&obj->txFree);
+    UDMACC26XX_close(obj->udma);
+    Power_releaseDependency(hw->powerMngrId);
+    PIN_close(obj->pins);
+    obj->opened = false;
+}
+
+static int uartdma_control(UART_Handle handle, unsigned int cmd, void *arg) {
+
+    return UART_STATUS_UNDEFINEDCMD;
+}
+
+// Callback mode: returns at once, the callback gets the data from the Hwi
+static int uartdma_read(UART_Handle handle, void *buffer, size_t size) {
+
+    UartDmaObject *obj = handle->object;
+    UInt key = Hwi_disable();
+
+    if (obj->readBuf != NULL || size == 0) {
+        Hwi_restore(key);
+        return UART_ERROR;
+    }
+    obj->readCount = 0;
+    obj->readSize = size;
+    obj->readBuf = buffer;
+    if (!obj->readHeld) {
+        obj->readHeld = true;
+        powertrack_setConstraint(POWER_OWNER_UART, PowerCC26XX_SB_DISALLOW);
+    }
+    Hwi_restore(key);
+    return 0;
+}
+
+// While allowed, a pending read no longer holds standby off; a falling edge
+// on RX takes the constraint back (uartdma_rxEdgeFxn), as does the next
+// UART_read. Writes still hold it until the last bit is out.
+void uartdma_allowStandby(UART_Handle uart, bool allow) {
+
+    UartDmaObject *obj = uart->object;
+    const UartDmaHWAttrs *hw = uart->hwAttrs;
+    UInt key = Hwi_disable();
+
+    if (allow && obj->readHeld) {
+        obj->readHeld = false;
+        powertrack_releaseConstraint(POWER_OWNER_UART, PowerCC26XX_SB_DISALLOW);
+        PIN_setInterrupt(obj->pins, hw->rxPin | PIN_IRQ_NEGEDGE);
+    } else if (!allow) {
+        PIN_setInterrupt(obj->pins, hw->rxPin | PIN_IRQ_DIS);
+        if (!obj->readHeld && obj->readBuf != NULL) {
+            obj->readHeld = true;
+            powertrack_setConstraint(POWER_OWNER_UART, PowerCC26XX_SB_DISALLOW);
+        }
+    }
+    Hwi_restore(key);
+}
+
+static int uartdma_readPolling(UART_Handle handle, void *buffer, size_t size) {
+
+    const UartDmaHWAttrs *hw = handle->hwAttrs;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        ((uint8_t *)buffer)[i] = (uint8_t)UARTCharGet(hw->baseAddr);
+    }
+    return size;
+}
+
+// Queues the data and returns, blocking only while both buffers are full.
+// The copy runs with interrupts off, 256 bytes at most (about 6 us).
+static int uartdma_write(UART_Handle handle, const void *buffer, size_t size) {
+
+    UartDmaObject *obj = handle->object;
+    const uint8_t *src = buffer;
+    size_t left = size;
+
+    while (left > 0) {
+        UInt key = Hwi_disable();
+        size_t n = dblbuf_put(&obj->tx, src, left);
+        uint16_t queued;
+
+        if (n == 0) {
+            uint32_t start = Clock_getTicks();
+            bool ok;
+            obj->txWaiting = true;
+            obj->stats.stalls++;
+            Hwi_restore(key);
+            wakeup_expect(WAKE_UART, true);
+            ok = Semaphore_pend(Semaphore_handle(&obj->txFree), obj->writeTimeout);
+            wakeup_expect(WAKE_UART, false);
+            obj->stats.stallTicks += Clock_getTicks() - start;
+            if (!ok) {
+                obj->txWaiting = false;
+                break;
+            }
+            continue;
+        }
+        if (!obj->tx.active) {
+            uartdma_start(handle);
+        }
+        queued = dblbuf_queued(&obj->tx);
+        if (queued > obj->stats.maxQueued) {
+            obj->stats.maxQueued = queued;
+        }
+        obj->stats.queuedSum += queued;
+        obj->stats.writes++;
+        obj->stats.bytes += n;
+        Hwi_restore(key);
+        src += n;
+        left -= n;
+    }
+    return size - left;
+}
+
+static int uartdma_writePolling(UART_Handle handle, const void *buffer, size_t size) {
+
+    const UartDmaHWAttrs *hw = handle->hwAttrs;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        UARTCharPut(hw->baseAddr, ((const uint8_t *)buffer)[i]);
+    }
+    return size;
+}
+
+const UART_FxnTable uartdma_fxnTable = {
+    uartdma_close,
+    uartdma_control,
+    uartdma_init,
+    uartdma_open,
+    uartdma_read,
+    uartdma_readPolling,
+    uartdma_readCancel,
+    uartdma_write,
+    uartdma_writePolling,
+    uartdma_writeCancel
+};
+
+// Export format:
+//   utx bytes=<n> batches=<n> avg=<bytes/batch> rate=<B/s> busy=<permille> q=<bytes> maxq=<bytes> avgq=<bytes> stalls=<n> stall=<ms>
+//   urx bytes=<n> drop=<n>
+void uartdma_report(UART_Handle uart) {
+
+    UartDmaObject *obj = uart->object;
+    char line[176];
+    UartDmaStats s;
+    uint32_t elapsed, queued;
+    UInt key = Hwi_disable();
+
+    s = obj->stats;
+    elapsed = Clock_getTicks() - obj->openTicks;
+    queued = dblbuf_queued(&obj->tx);
+    if (obj->txBusy || obj->txDraining) {
+        s.busyTicks += Clock_getTicks() - obj->txStart;
+    }
+    Hwi_restore(key);
+
+    if (elapsed == 0) {
+        elapsed = 1;
+    }
+    report_printf(uart, line, sizeof(line), "utx bytes=%lu batches=%lu avg=%lu rate=%lu busy=%lu q=%lu maxq=%u avgq=%lu stalls=%lu stall=%lu\r\n",
+                  (unsigned long)s.bytes, (unsigned long)s.batches,
+                  (unsigned long)(s.batches ? s.bytes / s.batches : 0),
+                  (unsigned long)((uint64_t)s.bytes * (1000000 / Clock_tickPeriod) / elapsed),
+                  (unsigned long)((uint64_t)s.busyTicks * 1000 / elapsed),
+                  (unsigned long)queued, s.maxQueued,
+                  (unsigned long)(s.writes ? s.queuedSum / s.writes : 0),
+                  (unsigned long)s.stalls,
+                  (unsigned long)(s.stallTicks / (1000 / Clock_tickPeriod)));
+    report_printf(uart, line, sizeof(line), "urx bytes=%lu drop=%lu\r\n", (unsigned long)s.rxBytes, (unsigned long)s.rxDropped);
+}
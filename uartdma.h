@@ -0,0 +1,85 @@
+/*
+ * uartdma.h
+ *
+ *  UART driver with a uDMA transmit path, installed in UART_config in place
+ *  of UARTCC26XX. UART_write copies the data into one of two buffers
+ *  (dblbuf.h) and returns; the other buffer is on its way out through the
+ *  UART0 TX uDMA channel. The completion interrupt starts the filled buffer, so frames
+ *  written while a transfer runs go out together as one batch. A writer only
+ *  blocks when both buffers are full.
+ *
+ *  Receive is interrupt driven from the RX FIFO into the buffer given to
+ *  UART_read, callback mode only. 8N1 and binary data only. Standby is held
+ *  off while a read is pending or data is still being shifted out, unless
+ *  uartdma_allowStandby releases the read: then a falling edge on the RX pin
+ *  wakes the MCU and takes the constraint back. The registers are set up
+ *  again after every standby.
+ */
+
+#ifndef UARTDMA_H_
+#define UARTDMA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ti/sysbios/hal/Hwi.h>
+#include <ti/sysbios/knl/Semaphore.h>
+#include <ti/drivers/PIN.h>
+#include <ti/drivers/Power.h>
+#include <ti/drivers/UART.h>
+#include <ti/drivers/dma/UDMACC26XX.h>
+
+#include "dblbuf.h"
+
+typedef struct {
+    uint32_t baseAddr;
+    int powerMngrId;
+    int intNum;
+    uint8_t intPriority;
+    uint32_t txChannelBitMask;
+    uint8_t txPin;
+    uint8_t rxPin;
+} UartDmaHWAttrs;
+
+typedef struct {
+    uint32_t bytes;         // accepted by UART_write
+    uint32_t writes;
+    uint32_t batches;       // uDMA transfers
+    uint32_t queuedSum;     // queue length after each write, for the average
+    uint16_t maxQueued;
+    uint32_t stalls;        // writes that waited for a free buffer
+    uint32_t stallTicks;
+    uint32_t busyTicks;     // first byte queued -> last bit sent
+    uint32_t rxBytes;
+    uint32_t rxDropped;     // no read pending
+} UartDmaStats;
+
+typedef struct {
+    bool opened;
+    uint32_t writeTimeout;
+    uint32_t baudRate;
+    UART_Callback readCallback;
+    uint8_t *readBuf;
+    size_t readSize;
+    size_t readCount;
+    bool readHeld;          // standby constraint for the pending read
+    PIN_State pinState;
+    PIN_Handle pins;
+    Power_NotifyObj awakeNotify;
+    Hwi_Struct hwi;
+    Semaphore_Struct txFree;
+    UDMACC26XX_Handle udma;
+    DblBuf tx;
+    bool txBusy;            // uDMA running, standby constraint held
+    bool txDraining;        // uDMA done, waiting for the end of transmission
+    bool txWaiting;         // a writer pends on txFree
+    uint32_t txStart;
+    uint32_t openTicks;
+    UartDmaStats stats;
+} UartDmaObject;
+
+extern const UART_FxnTable uartdma_fxnTable;
+
+void uartdma_allowStandby(UART_Handle uart, bool allow);
+void uartdma_report(UART_Handle uart);
+
+#endif /* UARTDMA_H_ */
@@ -0,0 +1,113 @@
+/*
+ * wakeup.c
+ *
+ *  Wakeup attribution, see wakeup.h.
+ */
+
+#include <stdio.h>
+
+#include <xdc/std.h>
+#include <ti/sysbios/hal/Hwi.h>
+#include <ti/sysbios/knl/Clock.h>
+
+#include "wakeup.h"
+#include "powertrack.h"
+#include "memsection.h"
+#include "report.h"
+
+static WakeStats stats[WAKE_SOURCECOUNT];
+static volatile uint8_t idle = false;
+static volatile uint8_t marked = WAKE_NONE;    // first mark while idle
+static volatile uint32_t expected = 0;         // bit per source
+static uint8_t current = WAKE_OTHER;           // source of the running awake period
+static uint32_t wakeStart;
+
+static const char *sourceNames[WAKE_SOURCECOUNT] = {
+    "other", "clk_sensor", "clk_sched", "clk_uart", "clk_opt3001", "clk_hdc1000", "clk_button",
+    "pin_button", "pin_power", "pin_mpu", "pin_tmp007", "pin_opt3001",
+    "uart", "i2c"
+};
+
+// Called first thing in interrupt, pin and Clock callbacks
+RAMFUNC void wakeup_mark(enum wakeSource source) {
+
+    if (idle && marked == WAKE_NONE) {
+        marked = source;
+    }
+}
+
+// Names the source of unmarked wakes while the calling task is blocked in a
+// driver call
+void wakeup_expect(enum wakeSource source, bool expect) {
+
+    UInt key = Hwi_disable();
+
+    if (expect) {
+        expected |= 1UL << source;
+    } else {
+        expected &= ~(1UL << source);
+    }
+    Hwi_restore(key);
+}
+
+// Both run from powertrack_policy in the Idle task, around the standby policy
+void wakeup_enterIdle(void) {
+
+    UInt key = Hwi_disable();
+
+    stats[current].awakeTicks += Clock_getTicks() - wakeStart;
+    marked = WAKE_NONE;
+    idle = true;
+    Hwi_restore(key);
+}
+
+void wakeup_exitIdle(void) {
+
+    UInt key = Hwi_disable();
+
+    idle = false;
+    if (marked != WAKE_NONE) {
+        current = marked;
+    } else {
+        current = WAKE_OTHER;
+        while (current < WAKE_SOURCECOUNT && !(expected & (1UL << current))) {
+            current++;
+        }
+        if (current == WAKE_SOURCECOUNT) {
+            current = WAKE_OTHER;
+        }
+    }
+    stats[current].wakes++;
+    wakeStart = Clock_getTicks();
+    Hwi_restore(key);
+}
+
+// Export format, one line per source that has woken the CPU and a summary:
+//   wake <source> n=<wakes> awake=<ms> avg=<us>
+//   wake total n=<wakes> rate=<wakes per s>
+void wakeup_report(UART_Handle uart) {
+
+    char line[72];
+    uint32_t total = 0, seconds;
+    int i;
+
+    for (i = 0; i < WAKE_SOURCECOUNT; i++) {
+        WakeStats s;
+        UInt key = Hwi_disable();
+        s = stats[i];
+        Hwi_restore(key);
+
+        if (s.wakes == 0) {
+            continue;
+        }
+        total += s.wakes;
+        report_printf(uart, line, sizeof(line), "wake %s n=%lu awake=%lu avg=%lu\r\n", sourceNames[i],
+                      (unsigned long)s.wakes,
+                      (unsigned long)(s.awakeTicks * Clock_tickPeriod / 1000),
+                      (unsigned long)(s.awakeTicks * Clock_tickPeriod / s.wakes));
+    }
+
+    seconds = (uint32_t)(powertrack_now() / (1000000 / Clock_tickPeriod));
+    report_printf(uart, line, sizeof(line), "wake total n=%lu rate=%lu\r\n", (unsigned long)total,
+                  (unsigned long)(seconds ? total / seconds : total));
+}
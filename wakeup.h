@@ -0,0 +1,50 @@
+/*
+ * wakeup.h
+ *
+ *  Wakeup attribution. Interrupt and Clock callbacks call wakeup_mark() with
+ *  their source; the first mark after the CPU went idle names the source that
+ *  woke it. The time until the CPU is idle again is charged to that source.
+ *  Wakes nobody marked go to the source set with wakeup_expect(), which a task
+ *  uses while it blocks on a driver (I2C, UART write), and otherwise to
+ *  "other": kernel timeouts such as Task_sleep and driver interrupts. When
+ *  several tasks expect a wake, the lowest source number gets it.
+ */
+
+#ifndef WAKEUP_H_
+#define WAKEUP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ti/drivers/UART.h>
+
+enum wakeSource {
+    WAKE_OTHER = 0,
+    WAKE_CLOCK_SENSOR,      // sensor task sample period
+    WAKE_CLOCK_SCHED,       // multi-sensor scheduler release
+    WAKE_CLOCK_UART,        // UART task housekeeping
+    WAKE_CLOCK_OPT3001,     // OPT3001 conversion time fallback
+    WAKE_CLOCK_HDC1000,     // HDC1000 conversion time
+    WAKE_CLOCK_BUTTON,      // straight key debounce and gaps
+    WAKE_PIN_BUTTON,
+    WAKE_PIN_POWER,
+    WAKE_PIN_MPU,
+    WAKE_PIN_TMP007,
+    WAKE_PIN_OPT3001,
+    WAKE_UART,
+    WAKE_I2C,
+    WAKE_SOURCECOUNT,
+    WAKE_NONE = WAKE_SOURCECOUNT
+};
+
+typedef struct {
+    uint32_t wakes;
+    uint64_t awakeTicks;
+} WakeStats;
+
+void wakeup_mark(enum wakeSource source);
+void wakeup_expect(enum wakeSource source, bool expect);
+void wakeup_enterIdle(void);
+void wakeup_exitIdle(void);
+void wakeup_report(UART_Handle uart);
+
+#endif /* WAKEUP_H_ */